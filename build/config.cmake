@@ -45,10 +45,28 @@ if("${MODULE_TLS_ENABLED}" EQUAL "1")
 	endif(NOT ("${OPENSSL_FOUND}" STREQUAL "TRUE" AND "${OPENSSL_VERSION}" MATCHES "^1\\.0\\..*$"))
 endif("${MODULE_TLS_ENABLED}" EQUAL "1")
 
+##io_uring
+constant(OS_EVENT_IO_URING_ENABLED 1)
+if("${OS_EVENT_IO_URING_ENABLED}" EQUAL "1")
+	include(CheckIncludeFile)
+	check_include_file("linux/io_uring.h" HAS_LINUX_IO_URING_H)
+	if(NOT "${HAS_LINUX_IO_URING_H}")
+		message("linux/io_uring.h not found, disable the io_uring event backend")
+		set(OS_EVENT_IO_URING_ENABLED "0")
+	endif(NOT "${HAS_LINUX_IO_URING_H}")
+endif("${OS_EVENT_IO_URING_ENABLED}" EQUAL "1")
+
 ##LibPlumber Configurations
 constant(DO_NOT_COMPILE_ITC_MODULE_TEST 0)
 
 constant(UTILS_THREAD_GENERIC_ALLOC_UNIT 8)
+constant(UTILS_THREAD_MAX_CPUS 1024)
+constant(UTILS_MEMPOOL_PAGE_MAX_NUMA_NODES 8)
+constant(UTILS_MEMPOOL_PAGE_ARENA_REGION_SIZE 0x400000)
+constant(UTILS_MEMPOOL_PAGE_HUGE_PAGE_SIZE 0x200000)
+constant(UTILS_MEMPOOL_PAGE_HUGE_PAGE 1)
+constant(UTILS_MEMPOOL_PAGE_BATCH_SIZE 64)
+constant(UTILS_MEMPOOL_OBJPOOL_MAGAZINE_SIZE 64)
 
 constant(RUNTIME_SERVLET_DEFINE_SYM __servdef__)
 constant(RUNTIME_ADDRESS_TABLE_SYM __plumber_address_table)
@@ -62,6 +80,9 @@ constant(RUNTIME_SERVLET_NS1_PREFIX \"/tmp/plumber-servlet.\")
 
 constant(MODULE_TCP_MAX_ASYNC_BUF_SIZE 4096)
 
+constant(OS_EVENT_IO_URING_QUEUE_DEPTH 1024)
+constant(OS_EVENT_IO_URING_REG_BLOCK_SIZE 256)
+
 constant(SCHED_SERVICE_BUFFER_NODE_LIST_INIT_SIZE 32)
 constant(SCHED_SERVICE_BUFFER_OUT_GOING_LIST_INIT_SIZE 8)
 constant(SCHED_SERVICE_MAX_NUM_NODES 0x100000ul)
@@ -69,10 +90,13 @@ constant(SCHED_SERVICE_MAX_NUM_EDGES 0x1000000ul)
 constant(SCHED_TASK_TABLE_SLOT_SIZE 37813)
 constant(SCHED_LOOP_EVENT_QUEUE_SIZE 4096)
 constant(SCHED_LOOP_MAX_PENDING_TASKS 0x100000)
+constant(SCHED_LOOP_MAX_DISPATCH_BATCH_SIZE 32)
 constant(SCHED_CNODE_BOUNDARY_INIT_SIZE 8)
 constant(SCHED_PROF_INIT_THREAD_CAPACITY 1)
+constant(SCHED_TRACE_MAX_PIPES 8)
 constant(SCHED_RSCOPE_ENTRY_TABLE_INIT_SIZE  4096)
 constant(SCHED_RSCOPE_ENTRY_TABLE_SIZE_LIMIT 0x100000)
+constant(SCHED_RSCOPE_ARENA_ALIGNMENT 16)
 constant(SCHED_TYPE_ENV_HASH_SIZE 97)
 constant(SCHED_TYPE_MAX 65536)
 constant(SCHED_DAEMON_MAX_ID_LEN 128)
@@ -84,6 +108,7 @@ constant(SCHED_DAEMON_LOCK_SUFFIX \".lock\")
 constant(ITC_MODULE_EVENT_QUEUE_SIZE 128)
 constant(ITC_MODULE_CALLBACK_READ_BUF_SIZE 4096)
 constant(ITC_EQUEUE_VEC_INIT_SIZE 4)
+constant(ITC_EQUEUE_SHARED_RING_SIZE 4096)
 constant(ITC_MODTAB_MAX_PATH 4096)
 
 constant(LANG_LEX_SEARCH_LIST_INIT_SIZE 4)
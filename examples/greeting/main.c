@@ -107,7 +107,7 @@ static int _entry_point(int argc, char** argv)
 	{
 		itc_module_pipe_t *in, *out;
 		itc_module_pipe_accept(mod_tcp, request_param, &in, &out);
-		sched_task_new_request(stc, service, in, out);
+		sched_task_new_request(stc, service, in, out, 0);
 
 		while(sched_step_next(stc, mem_pipe) > 0);
 	}
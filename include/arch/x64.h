@@ -73,6 +73,17 @@ static inline void arch_atomic_sw_assignment_u32(uint32_t* var, uint32_t val)
 	(*var) = val;
 }
 
+/**
+ * @brief Hint the CPU that we are in a spin-wait loop
+ * @note This is used by the busy waiting code, it reduces the power consumption and the penalty
+ *       of the memory order violation when the loop exits
+ * @return nothing
+ **/
+static inline void arch_cpu_relax(void)
+{
+	asm volatile ("pause" : : : "memory");
+}
+
 /**
  * @brief Switch current stack
  * @param baseaddr the stack base address
@@ -33,6 +33,14 @@ int itc_eloop_finalize(void);
  **/
 int itc_eloop_start(void);
 
+/**
+ * @brief check if the event loops have been started
+ * @details Once the event loops are started, the set of event accepting module instances is fixed,
+ *          so any module instance created after that won't get an event loop
+ * @return the check result, or error code
+ **/
+int itc_eloop_started(void);
+
 /**
  * @brief set the accept param for a module instance
  * @details when the event loop accept param is set, all the event loop will use the given pipe param to
@@ -50,4 +58,11 @@ int itc_eloop_set_accept_param(itc_module_type_t module, itc_module_pipe_param_t
  **/
 int itc_eloop_set_all_accept_param(itc_module_pipe_param_t param);
 
+/**
+ * @brief get the event queue token used by the event loop of the module instance
+ * @param module the module ID
+ * @return the token, or error code if the module instance doesn't have a running event loop
+ **/
+itc_equeue_token_t itc_eloop_get_token(itc_module_type_t module);
+
 #endif /* __PLUMBER_ITC_ELOOP_H__ */
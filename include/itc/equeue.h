@@ -41,6 +41,7 @@ typedef struct _sched_task_t sched_task_t;
 typedef struct {
 	itc_module_pipe_t* in;   /*!< the input pipe handle */
 	itc_module_pipe_t* out;  /*!< the output pipe handle */
+	uint64_t           ts;   /*!< the monotonic timestamp in nanoseconds when the request has been accepted, 0 if unknown (see utils/clock.h) */
 } itc_equeue_io_event_t;
 
 /**
@@ -148,6 +149,16 @@ int itc_equeue_init(void);
  **/
 int itc_equeue_finalize(void);
 
+/**
+ * @brief The snapshot of the event queue statistics
+ **/
+typedef struct {
+	itc_equeue_event_type_t type;   /*!< The event type of the queue */
+	uint32_t                shared:1;/*!< If the queue is the lock-free ring shared by all the tokens with the same event type */
+	uint32_t                size;   /*!< The capacity of the queue */
+	uint32_t                depth;  /*!< How many events are currently in the queue */
+} itc_equeue_stat_t;
+
 /**
  * @brief create new module thread token, this is used for event loop to get a new
  *        event queue token
@@ -216,4 +227,25 @@ int itc_equeue_wait(itc_equeue_token_t token, const int* killed, itc_equeue_wait
  **/
 int itc_equeue_wait_interrupt(void);
 
+/**
+ * @brief Switch the event queue between the locked mode and the lock-free mode
+ * @details In the lock-free mode, all the module tokens with the same event type share a
+ *          lock-free multi-producer ring, and the dispatcher only gets blocked when all the
+ *          rings it's interested in are empty. The API behaves exactly the same in both modes.
+ * @note This must be called before any token is created
+ * @param enabled If we want to use the lock-free mode
+ * @return status code
+ **/
+int itc_equeue_set_lock_free(int enabled);
+
+/**
+ * @brief Get the statistics of the queue used by the module token
+ * @note In the lock-free mode, the token doesn't have its own queue, so the statistics of the
+ *       shared ring is returned. The counters are read without locking the queue
+ * @param token The module token
+ * @param buf The result buffer
+ * @return status code
+ **/
+int itc_equeue_get_stat(itc_equeue_token_t token, itc_equeue_stat_t* buf);
+
 #endif /*__PLUMBER_QUEUE_H__ */
@@ -43,6 +43,7 @@ typedef struct {
 	void*               context;   /*!< the module context */
 	const char*         path;      /*!< the path for the module */
 	mempool_objpool_t*  handle_pool; /*!< the memory pool use to allocate the pipe handle for this module */
+	char*               eloop_cpus;  /*!< the CPU list the event loop thread of this module should be pinned to, NULL if not specified */
 } itc_modtab_instance_t;
 
 /**
@@ -279,6 +279,15 @@ itc_module_pipe_t* itc_module_pipe_fork(itc_module_pipe_t* handle, runtime_api_p
  **/
 int itc_module_is_pipe_shadow(const itc_module_pipe_t* handle);
 
+/**
+ * @brief check if the pipe shares its resource with other pipe handles, for example, the other end of the
+ *        pipe which hasn't been deallocated, or the pipes forked from the same pipe
+ * @note the companion list isn't thread-safe, so all the pipes in the list should be used by the same thread
+ * @param handle the pipe to check
+ * @return the result or error code
+ **/
+int itc_module_pipe_has_companion(const itc_module_pipe_t* handle);
+
 /**
  * @brief check if the pipe is an input pipe
  * @param handle the pipe to check
@@ -341,4 +350,13 @@ int itc_module_pipe_set_error(itc_module_pipe_t* handle);
  **/
 int itc_module_pipe_is_touched(const itc_module_pipe_t* handle);
 
+/**
+ * @brief Get the number of body bytes that has been written to the output pipe
+ * @note This only works with output side of the pipe, and the bytes written by the data source
+ *       callback are not counted. For the shadow pipe, this is always 0
+ * @param handle The handle to check
+ * @return the number of bytes, or error code
+ **/
+size_t itc_module_pipe_bytes_written(const itc_module_pipe_t* handle);
+
 #endif /* __PLUMBER_ITC_MODULE__ */
@@ -107,6 +107,16 @@ typedef struct {
 	 * @return status code
 	 **/
 	int    (*close)(void* __restrict handle);
+	/**
+	 * @brief optional, expose the remaining bytes of the data source as a range of a file, so that the module is able
+	 *        to send the bytes from the file without copying them to the user-space
+	 * @note once the range is returned, the bytes in the range are consumed from the data source, see
+	 *       runtime_api_scope_entity_t.fd_func for details
+	 * @param handle the data handle
+	 * @param range_buf the buffer used to return the file range
+	 * @return 1 if the range has been returned, 0 if the data source is not backed by a file, or error code
+	 **/
+	int    (*fd_range)(void* __restrict handle, runtime_api_scope_fd_range_t* __restrict range_buf);
 } itc_module_data_source_t;
 
 /**
@@ -338,7 +348,9 @@ typedef struct {
 	 *        For example for module instance with Id 0x01, the user space opcode 0x01000002 will be foward into the cntl module call of module 0x01,
 	 *        and the opcode param shouldbe 0x2, because the module id is stripped
 	 * @param ap the va_args
-	 * @return status code
+	 * @note  the typed header of the pipe is processed before the module call, and the module call can return a positive
+	 *        number to indicate that the data has been written to the output pipe
+	 * @return status code, or a positive number if the call has written the output pipe
 	 **/
 	int  (*cntl)(void* __restrict context, void* __restrict pipe, uint32_t opcode, va_list va_args);
 
@@ -0,0 +1,102 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+/**
+ * @brief the API header for the memory pipe module
+ * @details The memory pipe allows the servlet passes the data to the downstream without copying the bytes. <br/>
+ *          The upstream servlet can donate a page allocated by pstd_mempool_page_alloc or a buffer it owns to the
+ *          output pipe, and the pipe takes the ownership of the memory. <br/>
+ *          The downstream servlet can move all the unread data of its input pipe to its output pipe, in this case the
+ *          output pipe only references the pages of the input pipe. <br/>
+ *          All the control calls are ignored if the pipe is not a memory pipe, so the servlet should initialize the
+ *          result variable to 0 and fall back to the normal IO if it's still 0 after the call.
+ * @file mem/api.h
+ **/
+#ifndef __MODULE_MEM_API_H__
+#define __MODULE_MEM_API_H__
+
+/**
+ * @brief the module prefix used by the memory pipe module
+ **/
+#define MODULE_MEM_API_MODULE_PREFIX "pipe.mem"
+
+/**
+ * @brief the callback function used to dispose a buffer donated to the pipe
+ * @param buffer the buffer to dispose
+ * @param data the additional data passed along with the buffer
+ * @return status code
+ **/
+typedef int (*module_mem_free_func_t)(void* buffer, void* data);
+
+/**
+ * @brief donate a page to the output pipe, the params are (void* page, size_t size, int* accepted). <br/>
+ *        The page must be allocated by pstd_mempool_page_alloc and the data starts from the beginning of the page.
+ *        The accepted flag is set to 1 once the pipe takes the ownership of the page
+ **/
+#define MODULE_MEM_CNTL_WRITE_PAGE_RAW 0x0
+
+/**
+ * @brief donate a buffer to the output pipe, the params are
+ *        (void* buffer, size_t size, module_mem_free_func_t free_func, void* free_data, int* accepted). <br/>
+ *        The free_func is called with the buffer and free_data once the pipe doesn't need the buffer anymore,
+ *        and the accepted flag is set to 1 once the pipe takes the ownership of the buffer
+ **/
+#define MODULE_MEM_CNTL_WRITE_BUFFER_RAW 0x1
+
+/**
+ * @brief get the data buffer of an input pipe which can be moved to the output pipe, the params are (void** result). <br/>
+ *        The result is only valid until the input pipe is disposed. Since the data of the buffer will be moved, the typed
+ *        header of the input pipe is skipped by this call, so the servlet should read the header before this if it needs it
+ **/
+#define MODULE_MEM_CNTL_GET_BUFFER_RAW 0x2
+
+/**
+ * @brief move all the unread data of the input pipe to the output pipe without copying, the params are
+ *        (void* buffer, size_t* moved). The buffer is the result of MODULE_MEM_CNTL_GET_BUFFER on the input pipe,
+ *        and the moved is set to the number of bytes have been moved. All the moved data is consumed from the input pipe
+ **/
+#define MODULE_MEM_CNTL_MOVE_RAW 0x3
+
+#	ifdef __PSERVLET__
+
+PIPE_DEFINE_MOD_OPCODE_GETTER(MODULE_MEM_API_MODULE_PREFIX, MODULE_MEM_CNTL_WRITE_PAGE_RAW);
+
+PIPE_DEFINE_MOD_OPCODE_GETTER(MODULE_MEM_API_MODULE_PREFIX, MODULE_MEM_CNTL_WRITE_BUFFER_RAW);
+
+PIPE_DEFINE_MOD_OPCODE_GETTER(MODULE_MEM_API_MODULE_PREFIX, MODULE_MEM_CNTL_GET_BUFFER_RAW);
+
+PIPE_DEFINE_MOD_OPCODE_GETTER(MODULE_MEM_API_MODULE_PREFIX, MODULE_MEM_CNTL_MOVE_RAW);
+
+/**
+ * @brief the opcode used to donate a page to the pipe
+ **/
+#		define MODULE_MEM_CNTL_WRITE_PAGE PIPE_MOD_OPCODE(MODULE_MEM_CNTL_WRITE_PAGE_RAW)
+
+/**
+ * @brief the opcode used to donate a buffer to the pipe
+ **/
+#		define MODULE_MEM_CNTL_WRITE_BUFFER PIPE_MOD_OPCODE(MODULE_MEM_CNTL_WRITE_BUFFER_RAW)
+
+/**
+ * @brief the opcode used to get the movable buffer of the input pipe
+ **/
+#		define MODULE_MEM_CNTL_GET_BUFFER PIPE_MOD_OPCODE(MODULE_MEM_CNTL_GET_BUFFER_RAW)
+
+/**
+ * @brief the opcode used to move the data of the input pipe to the output pipe
+ **/
+#		define MODULE_MEM_CNTL_MOVE PIPE_MOD_OPCODE(MODULE_MEM_CNTL_MOVE_RAW)
+
+#	else /* __PSERVLET__ */
+
+#		define MODULE_MEM_CNTL_WRITE_PAGE MODULE_MEM_CNTL_WRITE_PAGE_RAW
+
+#		define MODULE_MEM_CNTL_WRITE_BUFFER MODULE_MEM_CNTL_WRITE_BUFFER_RAW
+
+#		define MODULE_MEM_CNTL_GET_BUFFER MODULE_MEM_CNTL_GET_BUFFER_RAW
+
+#		define MODULE_MEM_CNTL_MOVE MODULE_MEM_CNTL_MOVE_RAW
+
+#	endif /* __PSERVLET__ */
+
+#endif /* __MODULE_MEM_API_H__ */
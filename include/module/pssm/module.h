@@ -35,7 +35,8 @@ enum {
 	MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_CLOSE,  /*!< Close a RLS stream */
 	MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_EOF,    /*!< Check if the stream has reached the end */
 	MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_READ,   /*!< Read the stream */
-	MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_READY_EVENT  /*!< Query the ready event */
+	MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_READY_EVENT, /*!< Query the ready event */
+	MODULE_PSSM_MODULE_OPCODE_ARENA_ALLOCATE       /*!< Allocate memory from the request arena, which is released when the request is done */
 };
 
 #endif /* __PLUMBER_MODULE_PSSM_MODULE_H__ */
@@ -25,6 +25,11 @@
 #ifndef __MODULE_TCP_ASYNC__
 #define __MODULE_TCP_ASYNC__
 
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <os/os.h>
+
 /**
  * @brief the incompete type for an asnyc loop
  **/
@@ -70,6 +75,52 @@ typedef int (*module_tcp_async_write_error_func_t)(uint32_t conn_id, module_tcp_
  **/
 typedef int (*module_tcp_async_write_empty_func_t)(uint32_t conn_id, module_tcp_async_loop_t* callber);
 
+/**
+ * @brief the callback function used to expose the pending data buffers without copying
+ * @details This allows the async loop gather multiple pending buffers into a single writev call.
+ *          The buffers must be kept valid until they are consumed, and the callback should stop at the
+ *          first pending data which can not be exposed as a memory buffer, for example a data source callback
+ * @param conn_id the id of the connection object invokes this function
+ * @param iov the IO vector buffer
+ * @param iovcnt the capacity of the IO vector buffer
+ * @param caller the caller async object
+ * @return the number of IO vector entries has been filled, 0 means the caller should use the data source callback, or error code
+ **/
+typedef int (*module_tcp_async_write_iov_func_t)(uint32_t conn_id, struct iovec* iov, int iovcnt, module_tcp_async_loop_t* caller);
+
+/**
+ * @brief the callback function used to consume the bytes previously exposed by the iov callback
+ * @param conn_id the id of the connection object invokes this function
+ * @param nbytes the number of bytes has been written to the socket
+ * @param caller the caller async object
+ * @return status code
+ **/
+typedef int (*module_tcp_async_write_consume_func_t)(uint32_t conn_id, size_t nbytes, module_tcp_async_loop_t* caller);
+
+/**
+ * @brief the callback function used to expose the pending data which is a range of a file
+ * @details This allows the async loop send the bytes with the sendfile system call, so that the bytes are sent
+ *          from the page cache without copying to the user-space. The bytes has been sent are reported with the
+ *          consume callback
+ * @param conn_id the id of the connection object invokes this function
+ * @param fd_buf the buffer used to return the file descriptor
+ * @param offset_buf the buffer used to return the offset of the first pending byte in the file
+ * @param size_buf the buffer used to return the number of pending bytes in the file
+ * @param caller the caller async object
+ * @return 1 if the first pending data is a file range, 0 if not, or error code
+ **/
+typedef int (*module_tcp_async_write_file_func_t)(uint32_t conn_id, int* fd_buf, off_t* offset_buf, size_t* size_buf, module_tcp_async_loop_t* caller);
+
+/**
+ * @brief the statistics of an async loop
+ **/
+typedef struct {
+	uint64_t    write_calls;   /*!< the number of write system calls, including write, writev, sendfile and the setsockopt calls for the cork */
+	uint64_t    finished;      /*!< the number of async write operations has been finished */
+	uint64_t    sendfile_bytes;/*!< the number of bytes has been sent from files without copying */
+	os_event_backend_t backend;/*!< the kernel interface used by the poll object of the loop */
+} module_tcp_async_loop_stat_t;
+
 /**
  * @brief create and start a tcp asnyc loop
  * @param pool_size the connection pool size, which is used as the maximum size of the async object it can hold
@@ -81,6 +132,44 @@ typedef int (*module_tcp_async_write_empty_func_t)(uint32_t conn_id, module_tcp_
  **/
 module_tcp_async_loop_t* module_tcp_async_loop_new(uint32_t pool_size, uint32_t event_size, time_t ttl, time_t data_ttl, ssize_t (*write)(int, const void*, size_t));
 
+/**
+ * @brief let the async loop gather the pending data with the iov callback and write them with a single writev call
+ * @note this should be called before any async object is registered
+ * @param loop the target async loop
+ * @param get_iov the callback that exposes the pending data buffers
+ * @param consume the callback that consumes the written bytes
+ * @return status code
+ **/
+int module_tcp_async_loop_set_gather(module_tcp_async_loop_t* loop, module_tcp_async_write_iov_func_t get_iov, module_tcp_async_write_consume_func_t consume);
+
+/**
+ * @brief let the async loop send the pending file ranges with the sendfile system call
+ * @note this should be called after the gathered write is enabled, because the bytes has been sent are
+ *       reported with the consume callback. If the system doesn't support sendfile, the loop falls back to the
+ *       data source callback, so the data source callback should be able to read the file range as well
+ * @param loop the target async loop
+ * @param get_file the callback that exposes the pending file range, NULL to disable
+ * @return status code
+ **/
+int module_tcp_async_loop_set_sendfile(module_tcp_async_loop_t* loop, module_tcp_async_write_file_func_t get_file);
+
+/**
+ * @brief indicates the sockets are corked before the async write begins, so the loop should remove the cork once the
+ *        async write finishes or it's waiting for the data source, otherwise the last partial frame may be delayed
+ * @param loop the target async loop
+ * @param cork if the sockets are corked
+ * @return status code
+ **/
+int module_tcp_async_loop_set_cork(module_tcp_async_loop_t* loop, int cork);
+
+/**
+ * @brief get the statistics of the async loop
+ * @param loop the target async loop
+ * @param buf the result buffer
+ * @return status code
+ **/
+int module_tcp_async_loop_get_stat(const module_tcp_async_loop_t* loop, module_tcp_async_loop_stat_t* buf);
+
 /**
  * @brief stop the async loop and dispose all the resources
  * @param loop the target async loop
@@ -9,6 +9,8 @@
 #ifndef __PLUMBER_MODULE_TCP_POOL__
 #define __PLUMBER_MODULE_TCP_POOL__
 
+#include <utils/mempool/account.h>
+
 /**
  * @brief indicates that we want the framework automatically decide what to do
  * @details This means, if we pass a NULL pointer as data, the pool will automatically put mark the connection object as inactive <br/>
@@ -50,12 +52,20 @@ typedef struct {
 	time_t      min_timeout;/*!< the minimum time out vlaue */
 	int         tcp_backlog;/*!< the backlog value for the tcp connection */
 	int         reuseaddr;  /*!< indicates if we want to reuse the binding address */
+	int         reuseport;  /*!< indicates if each forked pool binds its own listening socket with SO_REUSEPORT, so that the kernel
+	                         *   distributes the new connections among the pools. Otherwise the forks share the listening socket
+	                         *   of the master pool */
 	int         ipv6;       /*!< indicates we want to bind to a ipv6 address */
 	uint32_t    size;       /*!< the maximum number of connections the pool can hold*/
 	const char* bind_addr;  /*!< the bind address */
 	size_t      event_size; /*!< the size for the event array */
 	uint32_t    accept_retry_interval;  /*!< The most time we sleep if we can not accept the socket (This is useful when we used up the FD) */
+	int         nodelay;    /*!< indicates if we want to disable the Nagle's algorithm on the accepted sockets */
 	int         (*dispose_data)(void*); /* the callback function used to dispose the unused data */
+	mempool_account_t* account;         /*!< the memory account of the connections, the pool stops accepting new connections while
+	                                     *   either the account or the global memory budget is over limit */
+	int         (*backpressure)(void);  /*!< optional, returns non-zero while the writes pending on the connections are over limit, and the pool
+	                                     *   stops accepting new connections until it returns 0 */
 } module_tcp_pool_configure_t;
 
 /**
@@ -67,6 +77,19 @@ typedef struct {
 	void*    data;  /*!< the addtional data previously attached to the fd */
 } module_tcp_pool_conninfo_t;
 
+/**
+ * @brief the snapshot of the connection pool statistics
+ **/
+typedef struct {
+	uint32_t capacity;      /*!< the maximum number of connections the pool can hold */
+	uint32_t inactive;      /*!< the number of idle connections which are waiting for the next request */
+	uint32_t active;        /*!< the number of connections currently owned by the scheduler */
+	uint32_t waiting;       /*!< the number of connections which have data and are waiting to be picked up */
+	uint32_t release_queue; /*!< the number of release requests haven't been processed by the event loop */
+	uint32_t paused;        /*!< if the pool has stopped accepting new connections because the memory or the pending writes are over limit */
+	int      listen_fd;     /*!< the listening socket FD, which is shared with the master pool unless the pool binds its own with SO_REUSEPORT */
+} module_tcp_pool_stat_t;
+
 /**
  * @brief create a new TCP connection pool
  * @return the newly created connection pool object
@@ -89,6 +112,15 @@ module_tcp_pool_t* module_tcp_pool_fork(module_tcp_pool_t* pool);
  **/
 int module_tcp_pool_num_forks(const module_tcp_pool_t* pool);
 
+/**
+ * @brief Get the connection statistics of the pool
+ * @note  This can be called from any thread, the counters are read without locking the pool
+ * @param pool The pool to examine
+ * @param buf The result buffer
+ * @return status code
+ **/
+int module_tcp_pool_get_stat(const module_tcp_pool_t* pool, module_tcp_pool_stat_t* buf);
+
 /**
  * @brief dispose the used TCP connection pool
  * @param pool the connection pool to dispose
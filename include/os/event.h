@@ -19,7 +19,10 @@ typedef enum {
 	OS_EVENT_KERNEL_EVENT_IN,      /*!< The kernel event that indicates a FD is current readable */
 	OS_EVENT_KERNEL_EVENT_OUT,     /*!< The kernel event that indicates a FD is current writeable */
 	OS_EVENT_KERNEL_EVENT_BIDIR,   /*!< The kernel event that indicates a FD is either readable or writable */
-	OS_EVENT_KERNEL_EVENT_CONNECT  /*!< The kernel event for establishing a scoket */
+	OS_EVENT_KERNEL_EVENT_CONNECT, /*!< The kernel event for establishing a scoket */
+	OS_EVENT_KERNEL_EVENT_CONNECT_SHARED  /*!< The same as OS_EVENT_KERNEL_EVENT_CONNECT, but the listening socket is shared by
+	                                       *   multiple poll objects, so only one of them should be woken up by a new connection
+	                                       *   if the operating system supports it */
 } os_event_kernel_type_t;
 
 /**
@@ -54,6 +57,39 @@ typedef struct {
  **/
 typedef struct _os_event_poll_t os_event_poll_t;
 
+/**
+ * @brief The kernel interface used by the event poll objects
+ **/
+typedef enum {
+	OS_EVENT_BACKEND_DEFAULT,   /*!< The default interface of the operating system, epoll for Linux and kqueue for Darwin */
+	OS_EVENT_BACKEND_IO_URING   /*!< The Linux io_uring interface, the changes to the poll object are submitted in batch when we wait for the events */
+} os_event_backend_t;
+
+/**
+ * @brief Set the kernel interface used by the poll objects created after this call
+ * @note  If the io_uring backend is selected but the kernel doesn't support it, the poll object falls back to the default backend. <br/>
+ *        With the io_uring backend, the poll object should only be changed by the thread waiting for it, since the change
+ *        only takes effect when the thread waits for the events next time
+ * @param backend The backend to use
+ * @return status code
+ **/
+int os_event_set_backend(os_event_backend_t backend);
+
+/**
+ * @brief Get the kernel interface used by the poll objects created from now on
+ * @return The backend
+ **/
+os_event_backend_t os_event_get_backend(void);
+
+/**
+ * @brief Get the kernel interface actually used by the poll object
+ * @details This may be different from the backend selected when the poll object was created, since the poll
+ *          object falls back to the default backend when the selected one isn't available
+ * @param poll The poll object
+ * @return The backend
+ **/
+os_event_backend_t os_event_poll_get_backend(const os_event_poll_t* poll);
+
 /**
  * @brief Create a new event poll object
  * @return the newly created OS poll event or NULL on error
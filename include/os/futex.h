@@ -0,0 +1,40 @@
+/**
+ * Copyright (C) 2017-2018, Hao Hou
+ **/
+/**
+ * @brief The address based wait/wake primitive
+ * @details This is the abstraction of the Linux futex, which allows a thread parks on a 32 bit
+ *          word and another thread wakes it up without any lock round-trip. On the system without
+ *          futex support, it's emulated by a set of hashed condition variables
+ * @file os/futex.h
+ **/
+#ifndef __OS_FUTEX_H__
+#define __OS_FUTEX_H__
+
+#include <limits.h>
+
+/**
+ * @brief The count passed to os_futex_wake to wake up all the threads parked on the word
+ **/
+#define OS_FUTEX_WAKE_ALL ((uint32_t)INT_MAX)
+
+/**
+ * @brief Block the caller thread if the value of the word equals to the expected value
+ * @note The function may return spuriously, so the caller should recheck the condition. <br/>
+ *       If the value has been changed before the caller gets parked, it returns immediately
+ * @param addr The address of the word
+ * @param expected The expected value
+ * @param timeout The time limit in milliseconds, negative value means wait forever
+ * @return status code
+ **/
+int os_futex_wait(volatile uint32_t* addr, uint32_t expected, int timeout);
+
+/**
+ * @brief Wake up the threads that are parked on the word
+ * @param addr The address of the word
+ * @param count The maximum number of threads to wake up
+ * @return status code
+ **/
+int os_futex_wake(volatile uint32_t* addr, uint32_t count);
+
+#endif /* __OS_FUTEX_H__ */
@@ -0,0 +1,78 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+/**
+ * @brief The io_uring based poll object used by the Linux event interface
+ * @details Each watched FD is armed with a multishot poll request, so the poll object doesn't need any
+ *          syscall when a FD is added, modified or removed. All the requests queued since the last wait
+ *          are submitted by the same io_uring_enter call which waits for the completions.
+ * @note This is the internal interface of the Linux event poll object, and it's not thread-safe
+ * @file os/linux/uring.h
+ **/
+#if !defined(__OS_LINUX_URING_H__) && defined(__LINUX__)
+#define __OS_LINUX_URING_H__
+
+/**
+ * @brief The io_uring poll object
+ **/
+typedef struct _os_event_uring_t os_event_uring_t;
+
+/**
+ * @brief Create a new io_uring poll object
+ * @return The newly created poll object, NULL if the kernel doesn't support the features we need
+ **/
+os_event_uring_t* os_event_uring_new(void);
+
+/**
+ * @brief Dispose the io_uring poll object
+ * @param uring The poll object
+ * @return status code
+ **/
+int os_event_uring_free(os_event_uring_t* uring);
+
+/**
+ * @brief Start watching the FD
+ * @param uring The poll object
+ * @param fd The FD to watch
+ * @param events The poll event mask, e.g. POLLIN
+ * @param data The data returned when the FD gets ready
+ * @return status code
+ **/
+int os_event_uring_add(os_event_uring_t* uring, int fd, uint32_t events, void* data);
+
+/**
+ * @brief Change the event mask and the data of the FD, if the FD is not being watched, start watching it
+ * @param uring The poll object
+ * @param fd The FD
+ * @param events The new event mask
+ * @param data The new data
+ * @return status code
+ **/
+int os_event_uring_modify(os_event_uring_t* uring, int fd, uint32_t events, void* data);
+
+/**
+ * @brief Stop watching the FD
+ * @param uring The poll object
+ * @param fd The FD
+ * @return status code
+ **/
+int os_event_uring_del(os_event_uring_t* uring, int fd);
+
+/**
+ * @brief Submit all the queued changes and wait for the FD events
+ * @param uring The poll object
+ * @param max_events The maximum number of events to return
+ * @param timeout The timeout in milliseconds, negative means wait forever
+ * @return The number of events, or error code
+ **/
+int os_event_uring_wait(os_event_uring_t* uring, size_t max_events, int timeout);
+
+/**
+ * @brief Take the idx-th result from the last wait
+ * @param uring The poll object
+ * @param idx The index
+ * @return The data of the FD
+ **/
+void* os_event_uring_take_result(os_event_uring_t* uring, size_t idx);
+
+#endif /* __OS_LINUX_URING_H__ */
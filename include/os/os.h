@@ -14,4 +14,5 @@
 #endif
 #include <os/const.h>
 #include <os/event.h>
+#include <os/futex.h>
 #endif /* __OS_H__ */
@@ -387,6 +387,17 @@ typedef struct {
 	int32_t   timeout; /*!< The time limit for the RLS token not gets ready */
 } runtime_api_scope_ready_event_t;
 
+/**
+ * @brief Describe a range of a file which carries the remaining bytes of a RLS byte stream
+ * @details This allows the framework send the bytes directly from the file, for example with the sendfile
+ *          system call, rather than reading them into the user-space buffer first
+ **/
+typedef struct {
+	int       fd;      /*!< The file descriptor, which is owned by the stream and valid until the stream is closed */
+	uint64_t  offset;  /*!< The offset of the first byte of the range in the file */
+	size_t    size;    /*!< The number of bytes in the range */
+} runtime_api_scope_fd_range_t;
+
 /**
  * @brief Represent an entity in the scope. It's actually a group of callback function for the opeartion
  *        that is supported by the scope entity and a memory address which represent the entity data
@@ -462,6 +473,17 @@ typedef struct {
 	 * @return status code
 	 **/
 	 int (*close_func)(void* handle);
+
+	/**
+	 * @brief expose the remaining bytes of the byte stream as a range of a file
+	 * @note this callback is optional. Once the range is returned, all the bytes in the range are considered
+	 *       consumed by the caller, so the stream should reach the end-of-stream after the call. The caller
+	 *       then reads the bytes from the file directly, thus the FD should be valid until the stream is closed.
+	 * @param handle the byte stream handle
+	 * @param range_buf the buffer used to return the file range
+	 * @return 1 if the range has been returned, 0 if the stream is not backed by a file, error code on error cases
+	 **/
+	int (*fd_func)(void* __restrict handle, runtime_api_scope_fd_range_t* __restrict range_buf);
 } runtime_api_scope_entity_t;
 
 /**
@@ -41,6 +41,16 @@
 #ifndef __SCHED_ASYNC_H__
 #define __SCHED_ASYNC_H__
 
+/**
+ * @brief The snapshot of the async task processor statistics
+ **/
+typedef struct {
+	uint32_t queue_size;   /*!< The capacity of the async task queue */
+	uint32_t queue_depth;  /*!< The number of async tasks waiting for an async thread */
+	uint32_t nthreads;     /*!< The number of async threads */
+	uint32_t busy_threads; /*!< The number of async threads that are currently running a task */
+} sched_async_stat_t;
+
 /**
  * @brief Initialize the async subsystem
  * @return status code
@@ -65,6 +75,14 @@ int sched_async_start(void);
  **/
 int sched_async_kill(void);
 
+/**
+ * @brief Get the statistics of the async task processor
+ * @note The counters are read without locking the queue
+ * @param buf The result buffer
+ * @return status code
+ **/
+int sched_async_get_stat(sched_async_stat_t* buf);
+
 /**
  * @brief Post as new task to the async task pool, and wait one of the async thread picking up the task
  * @param loop The scheduler loop which posts this task
@@ -85,4 +85,19 @@ int sched_daemon_read_control_sock(void);
  **/
 int sched_daemon_reload(const char* daemon_name, const sched_service_t* service);
 
+/**
+ * @brief Query the runtime statistics of the daemon
+ * @details The result is a text, each line of which is a key and an integer value seperated by a space.
+ *          The key is a dot-seperated name, for example: <br/>
+ *          sched.worker.&lt;tid&gt;.ring_used:  The number of events in the event ring of the worker <br/>
+ *          sched.dispatcher.pending_events: The number of events the dispatcher can not dispatch right now <br/>
+ *          &lt;module-path&gt;.equeue.depth: The number of events in the event queue of the module event loop <br/>
+ *          profiler.node.&lt;nid&gt;.wall_p99: The 99th percentile wall time of the node, only available when the profiler is enabled <br/>
+ *          See the documentation of each component for the detailed description of the statistics
+ * @param daemon_name The name of the daemon
+ * @param result The buffer used to return the result text, the caller should dispose it after use
+ * @return status code
+ **/
+int sched_daemon_stats(const char* daemon_name, char** result);
+
 #endif /* __SCHED_DAEMON_H__ */
@@ -10,6 +10,23 @@
  **/
 typedef struct _sched_loop_t sched_loop_t;
 
+/* The scheduler task, see sched/task.h for details */
+struct _sched_task_t;
+
+/**
+ * @brief The snapshot of the runtime statistics of a scheduler loop
+ * @note  The counters are read without any synchronization, so they are only accurate
+ *        to the extent of a monitoring value
+ **/
+typedef struct {
+	uint32_t thread_id;        /*!< The thread id of the scheduler */
+	uint32_t ring_size;        /*!< The size of the event ring of the scheduler */
+	uint32_t ring_used;        /*!< How many events in the event ring haven't been taken by the scheduler */
+	uint32_t num_running_reqs; /*!< How many requests are currently running by this scheduler */
+	uint32_t pending_reqs;     /*!< How many requests have been dispatched to the scheduler but not started yet */
+	uint32_t idle;             /*!< If the scheduler is currently parked and waiting for the new event */
+} sched_loop_stat_t;
+
 /**
  * @brief start scheduler loop
  * @param service the service to run
@@ -27,6 +44,32 @@ int sched_loop_start(sched_service_t** service, int fork_twice);
  **/
 int sched_loop_kill(int no_error);
 
+/**
+ * @brief Claim an idle peer of the scheduler, so that the scheduler can hand over its ready task to the peer
+ * @note  This only works when the parallel branches mode is enabled, and the peer should be released by
+ *        sched_loop_release_peer if the task can not be handed over. Otherwise the peer releases itself
+ *        once it has done with the task
+ * @param loop The scheduler that wants a peer
+ * @return the idle peer, NULL if there's no idle peer
+ **/
+sched_loop_t* sched_loop_acquire_idle_peer(sched_loop_t* loop);
+
+/**
+ * @brief Release the peer that is claimed by sched_loop_acquire_idle_peer but not used
+ * @param peer The peer to release
+ * @return status code
+ **/
+int sched_loop_release_peer(sched_loop_t* peer);
+
+/**
+ * @brief Send the task to the peer scheduler with the task event
+ * @note  This should be only called from the thread owns the task
+ * @param peer The peer scheduler
+ * @param task The task to send
+ * @return status code
+ **/
+int sched_loop_offload_task(sched_loop_t* peer, struct _sched_task_t* task);
+
 /**
  * @brief set the number of thread that should be used
  * @param n the number of thread
@@ -67,4 +110,35 @@ int sched_loop_deploy_service_object(sched_service_t* service);
  * @return If the deployment is completed, or error code
  **/
 int sched_loop_deploy_completed(void);
+
+/**
+ * @brief Get the runtime statistics of the scheduler loop
+ * @param index The thread id of the scheduler loop
+ * @param buf The result buffer
+ * @return 1 if the statistics has been returned, 0 if there's no such scheduler, or error code
+ **/
+int sched_loop_get_stat(uint32_t index, sched_loop_stat_t* buf);
+
+/**
+ * @brief Get the number of events the dispatcher holds in its pending list, because the
+ *        target schedulers are either saturated or having their event ring full
+ * @note This function must be called from the dispatcher thread
+ * @return The number of pending events
+ **/
+uint32_t sched_loop_num_pending_events(void);
+
+/**
+ * @brief Get the service that is currently running by the scheduler loops
+ * @note The service may be disposed once a deployment completes, so the caller should make sure
+ *       there's no deployment in progress while the service is being used
+ * @return The service, NULL if the scheduler is not started
+ **/
+const sched_service_t* sched_loop_get_service(void);
+
+/**
+ * @brief Get the thread id of the scheduler loop
+ * @param loop The scheduler loop
+ * @return The thread id or error code
+ **/
+uint32_t sched_loop_get_id(const sched_loop_t* loop);
 #endif /* __PLUMBER_SCHED_LOOP_H__ */
@@ -4,19 +4,32 @@
 /**
  * @brief The plumber built-in profiler utilies
  * @note the profiler utilities will be controlled by the
- *       variable scheduler.prof.enabled = 0 / 1
+ *       variable profiler.enabled = 0 / 1
  * @file sched/prof.h
  **/
 #ifndef __PLUMBER_SCHED_PROF_H__
 #define __PLUMBER_SCHED_PROF_H__
+
+#include <utils/histogram.h>
+
 /**
  * @brief the data structure used in the profiler file
+ * @details All the time is in nanoseconds. The CPU time is the time consumed by the worker thread
+ *          running the node, the wall time is the elapsed time of the execution and the queueing
+ *          delay is the time between the task gets ready and the task actually starts. <br/>
+ *          The records of the same node from different threads or different flushes can be
+ *          combined with utils_histogram_merge
  **/
 typedef struct {
-	uint32_t                thread;  /*!< the thread id */
-	sched_service_node_id_t node;    /*!< the node id */
-	uint64_t                time;    /*!< the time used by this node */
-	uint64_t                count;   /*!< the number of execution of this node */
+	uint32_t                thread;      /*!< the thread id */
+	sched_service_node_id_t node;        /*!< the node id */
+	uint64_t                time;        /*!< the CPU time used by this node */
+	uint64_t                count;       /*!< the number of execution of this node */
+	uint64_t                wall_time;   /*!< the wall time used by this node */
+	uint64_t                queue_time;  /*!< the total queueing delay of this node */
+	utils_histogram_t       cpu_hist;    /*!< the distribution of the CPU time of each execution */
+	utils_histogram_t       wall_hist;   /*!< the distribution of the wall time of each execution */
+	utils_histogram_t       queue_hist;  /*!< the distribution of the queueing delay of each execution */
 } sched_prof_record_t;
 
 /**
@@ -58,12 +71,15 @@ int sched_prof_free(sched_prof_t* prof);
  * @brief start the timer for the node
  * @param prof the profiler
  * @param node current node
+ * @param ready_time the monotonic time in nanoseconds when the task gets ready, 0 if we don't know
+ *        and the queueing delay is not recorded
  * @return status code
  **/
-int sched_prof_start_timer(sched_prof_t* prof, sched_service_node_id_t node);
+int sched_prof_start_timer(sched_prof_t* prof, sched_service_node_id_t node, uint64_t ready_time);
 
 /**
  * @brief stop the timer for the node
+ * @note the data of current thread is flushed once the number of executions reaches profiler.flush_interval
  * @param prof the profiler
  * @return status code
  **/
@@ -76,4 +92,14 @@ int sched_prof_stop_timer(sched_prof_t* prof);
  **/
 int sched_prof_flush(sched_prof_t* prof);
 
+/**
+ * @brief get the data of the node collected by all the threads since the profiler is created
+ * @note the data a thread collected is only visible after the thread flushes it, see profiler.flush_interval
+ * @param prof the profiler
+ * @param node the node id
+ * @param buf the result buffer, the thread field is set to error code
+ * @return status code
+ **/
+int sched_prof_get_stat(sched_prof_t* prof, sched_service_node_id_t node, sched_prof_record_t* buf);
+
 #endif /* __PLUMBER_SCHED_PROF_H__ */
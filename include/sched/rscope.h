@@ -30,6 +30,11 @@ typedef struct {
  **/
 typedef struct _sched_rscope_stream_t sched_rscope_stream_t;
 
+/**
+ * @brief the entry table which holds all the request local scope entries of a scheduler thread
+ **/
+typedef struct _sched_rscope_table_t sched_rscope_table_t;
+
 /**
  * @brief initialize the request scope global objects
  * @return status code
@@ -54,6 +59,31 @@ int sched_rscope_init_thread(void);
  **/
 int sched_rscope_finalize_thread(void);
 
+/**
+ * @brief set if the entry tables can be shared between the scheduler threads
+ * @details The RLS token is an index to the entry table of the thread which creates the request scope,
+ *          so if a task of the request is executed by other thread, the thread must borrow the entry table
+ *          of the request owner. In this case, all the table operation should be protected by the table lock.
+ * @note this should be called before any scheduler thread starts
+ * @param shared if the tables are shared
+ * @return status code
+ **/
+int sched_rscope_set_shared(int shared);
+
+/**
+ * @brief get the entry table owned by current thread
+ * @return the entry table, NULL on error
+ **/
+sched_rscope_table_t* sched_rscope_thread_table(void);
+
+/**
+ * @brief make current thread use the given entry table for all the following operations
+ * @note the table owned by other thread is only allowed when the tables are shared
+ * @param table the entry table to use
+ * @return the entry table previously used, NULL on error
+ **/
+sched_rscope_table_t* sched_rscope_switch_table(sched_rscope_table_t* table);
+
 /**
  * @brief create a new request scope
  * @return the newly created request local scope, NULL on error case
@@ -68,6 +98,18 @@ sched_rscope_t* sched_rscope_new(void);
  **/
 int sched_rscope_free(sched_rscope_t* scope);
 
+/**
+ * @brief allocate memory from the request arena, which is a bump allocator owns by the request scope
+ * @details the memory is allocated from the pages of the page memory pool, and there's no way to
+ *          free the memory individually. All the memory allocated from the arena is released at once
+ *          when the request scope is disposed. This is useful for the small and short-lived buffers
+ *          which lives until the request is done
+ * @param scope the request scope
+ * @param size the number of bytes to allocate
+ * @return the allocated memory, which is aligned to SCHED_RSCOPE_ARENA_ALIGNMENT, or NULL on error
+ **/
+void* sched_rscope_arena_alloc(sched_rscope_t* scope, size_t size);
+
 /**
  * @brief add a new pointer to the request scope
  * @param scope the request scope
@@ -137,4 +179,14 @@ size_t sched_rscope_stream_read(sched_rscope_stream_t* stream, void* buffer, siz
  * @return The number of events has been returned, or error code
  **/
 int sched_rscope_stream_get_event(sched_rscope_stream_t* stream, runtime_api_scope_ready_event_t* buf);
+
+/**
+ * @brief Get the file range which carries the remaining bytes of the stream
+ * @note Once the range is returned, the stream reaches the end-of-stream, see the documentation of
+ *       runtime_api_scope_entity_t.fd_func for details
+ * @param stream The stream object
+ * @param buf The buffer used to return the file range
+ * @return 1 if the range has been returned, 0 if the stream is not backed by a file, or error code
+ **/
+int sched_rscope_stream_get_fd_range(sched_rscope_stream_t* stream, runtime_api_scope_fd_range_t* buf);
 #endif /* __SCHED_RSCOPE_H__ */
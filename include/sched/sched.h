@@ -16,6 +16,7 @@
 #include <sched/loop.h>
 #include <sched/cnode.h>
 #include <sched/prof.h>
+#include <sched/trace.h>
 #include <sched/type.h>
 #include <sched/async.h>
 #include <sched/daemon.h>
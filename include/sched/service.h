@@ -9,6 +9,8 @@
 #ifndef __PLUMBER_SCHED_SERVICE_H__
 #define __PLUMBER_SCHED_SERVICE_H__
 
+#include <utils/mempool/account.h>
+
 /**
  * @brief the previous definition of the cnode info array
  **/
@@ -39,6 +41,21 @@ typedef struct {
 	runtime_api_pipe_id_t destination_pipe_desc; /*!< the pipe descriptor for the output end*/
 } sched_service_pipe_descriptor_t;
 
+/**
+ * @brief the precompiled execution plan for an outgoing pipe of a node
+ * @details this is everything the scheduler needs to set up a pipe when the source task is ready to run.
+ *          None of this changes after the service is type checked, so it is built once when
+ *          the service is created
+ **/
+typedef struct {
+	sched_service_pipe_descriptor_t desc;          /*!< the pipe descriptor */
+	itc_module_pipe_param_t         param;         /*!< the pipe param that is used to allocate the pipe */
+	runtime_api_pipe_id_t           shadow_target; /*!< the target pipe id if this is a shadow pipe, otherwise error code */
+	runtime_api_pipe_flags_t        shadow_flags;  /*!< the flags used to fork the target pipe if this is a shadow pipe */
+	uint32_t                        downstream_slot;   /*!< the index of the downstream task in the task slot block of the request */
+	uint32_t                        downstream_inputs; /*!< the number of inputs the downstream task requires */
+} sched_service_edge_plan_t;
+
 /**
  * @brief convert a service to a pipe descriptor, which means treat the entire service as a pipe
  *        which is a input node, input pipe end; a output node, a output pipe end
@@ -148,6 +165,84 @@ const sched_service_pipe_descriptor_t* sched_service_get_incoming_pipes(const sc
  **/
 const sched_service_pipe_descriptor_t* sched_service_get_outgoing_pipes(const sched_service_t* service, sched_service_node_id_t nid, uint32_t* nresult);
 
+/**
+ * @brief get the precompiled execution plan of all outgoing pipes
+ * @note the plan is in the same order as the list returned by sched_service_get_outgoing_pipes
+ * @param service the target service
+ * @param nid the node id
+ * @param nresult the buffer that used to return how many pipe is returned
+ * @return the pointer to the head of the plan, NULL if error happens
+ **/
+const sched_service_edge_plan_t* sched_service_get_outgoing_plan(const sched_service_t* service, sched_service_node_id_t nid, uint32_t* nresult);
+
+/**
+ * @brief check if the node is chained with its upstream node
+ * @details when a node's only input is the only output of its upstream node, the two nodes forms a
+ *          linear chain. The chained node is handed to the worker running the upstream node as its next
+ *          task, without going through the ready queue, unless a request with an earlier deadline is ready.
+ *          The data still goes through the pipe between the two nodes
+ * @param service the target service
+ * @param nid the node id
+ * @return 1 if the node is chained, 0 if not, or error code
+ **/
+int sched_service_node_chained(const sched_service_t* service, sched_service_node_id_t nid);
+
+/**
+ * @brief enable or disable the linear chain handoff for the service created afterwards
+ * @param enabled if the handoff is enabled
+ * @return status code
+ **/
+int sched_service_set_chain_handoff(int enabled);
+
+/**
+ * @brief check if the linear chain handoff is enabled
+ * @return if the handoff is enabled
+ **/
+int sched_service_get_chain_handoff(void);
+
+/**
+ * @brief set the request deadline for the services created afterwards
+ * @details Once the request can not be done within the deadline, the scheduler stops the request and
+ *          writes the deadline response to the output if it has been configured
+ * @param ms the deadline in milliseconds, 0 means the request doesn't have a deadline
+ * @return status code
+ **/
+int sched_service_set_request_deadline(uint32_t ms);
+
+/**
+ * @brief get the request deadline for the services created afterwards
+ * @return the deadline in milliseconds
+ **/
+uint32_t sched_service_get_request_deadline(void);
+
+/**
+ * @brief set the response for the request rejected because of the deadline, for the services created afterwards
+ * @param response the response, NULL if we don't write anything
+ * @return status code
+ **/
+int sched_service_set_deadline_response(const char* response);
+
+/**
+ * @brief get the deadline response for the services created afterwards
+ * @return the response, NULL if it's not configured
+ **/
+const char* sched_service_get_deadline_response(void);
+
+/**
+ * @brief get the request deadline of the service
+ * @param service the service
+ * @return the deadline in nanoseconds, 0 if the request doesn't have a deadline, error code on error
+ **/
+uint64_t sched_service_deadline(const sched_service_t* service);
+
+/**
+ * @brief get the deadline response of the service
+ * @param service the service
+ * @param size the buffer used to return the size of the response
+ * @return the response, NULL if it's not configured
+ **/
+const char* sched_service_deadline_response(const sched_service_t* service, size_t* size);
+
 /**
  * @brief set the input pipe of this service buffer
  * @param buffer the target service buffer
@@ -176,6 +271,15 @@ int sched_service_buffer_set_output(sched_service_buffer_t* buffer, sched_servic
  **/
 char const* const* sched_service_get_node_args(const sched_service_t* service, sched_service_node_id_t nid, uint32_t* argc);
 
+/**
+ * @brief get the memory account of a node, which the memory allocated for the requests while the node
+ *        is running is charged to
+ * @param service the target service
+ * @param nid the node ID
+ * @return the memory account, NULL on error
+ **/
+mempool_account_t* sched_service_get_node_account(const sched_service_t* service, sched_service_node_id_t nid);
+
 /**
  * @brief get the pipe flags for a given pipe of a given node
  * @param service the target service
@@ -217,9 +321,10 @@ const sched_cnode_info_t* sched_service_get_cnode_info(const sched_service_t* se
  * @brief get the profiler for this service
  * @param service the target service
  * @param node the node to start profiler
+ * @param ready_time the monotonic time in nanoseconds when the task gets ready, 0 if unknown
  * @return status code
  **/
-int sched_service_profiler_timer_start(const sched_service_t* service, sched_service_node_id_t node);
+int sched_service_profiler_timer_start(const sched_service_t* service, sched_service_node_id_t node, uint64_t ready_time);
 
 /**
  * @brief stop the profiler timer
@@ -235,6 +340,16 @@ int sched_service_profiler_timer_stop(const sched_service_t* service);
  **/
 int sched_service_profiler_flush(const sched_service_t* service);
 
+/* The profiler, see sched/prof.h for details */
+struct _sched_prof_t;
+
+/**
+ * @brief get the profiler of the service
+ * @param service the target service
+ * @return the profiler, NULL if the profiler is disabled or error happens
+ **/
+struct _sched_prof_t* sched_service_get_profiler(const sched_service_t* service);
+
 /**
  * @brief get the concrete type name of the given pipe in the given node
  * @note the returned type must be the concrete type
@@ -24,10 +24,27 @@
  **/
 int sched_step_next(sched_task_context_t* stc, itc_module_type_t type);
 
+/**
+ * @brief run the task which is handed over by the peer scheduler
+ * @details This only executes the task and sets the signal pipes, all the pipes has been
+ *          assigned by the owner, and the owner will notify the downstream tasks once the
+ *          task is sent back
+ * @param task the task to run
+ * @param table the request local scope entry table of the task owner
+ * @return status code
+ **/
+int sched_step_run_offloaded(sched_task_t* task, sched_rscope_table_t* table);
+
 /**
  * @brief get the current request scope object
  * @return the current request local scope, NULL if the program stack is outside of a task or error case
  **/
 sched_rscope_t* sched_step_current_scope(void);
 
+/**
+ * @brief get the memory account of the node which is currently running
+ * @return the memory account, NULL if the program stack is outside of a task
+ **/
+mempool_account_t* sched_step_current_account(void);
+
 #endif /* __PLUMBER_SCHED_DRIVER_H__ */
@@ -78,9 +78,11 @@ int sched_task_context_free(sched_task_context_t* ctx);
  * @param service the target service
  * @param input_pipe the input of this request
  * @param output_pipe the output for this request
+ * @param arrival the monotonic time in nanoseconds when the request has been accepted, 0 means now.
+ *        If the service has a request deadline, the deadline is counted from this time
  * @return the request identifier or negative status code
  **/
-sched_task_request_t sched_task_new_request(sched_task_context_t* ctx, const sched_service_t* service, itc_module_pipe_t* input_pipe, itc_module_pipe_t* output_pipe);
+sched_task_request_t sched_task_new_request(sched_task_context_t* ctx, const sched_service_t* service, itc_module_pipe_t* input_pipe, itc_module_pipe_t* output_pipe, uint64_t arrival);
 
 /**
  * @brief notify the task table there's a newly create pipe which can connect to the given node, given pipe
@@ -111,6 +113,18 @@ int sched_task_input_pipe(sched_task_context_t* ctx, const sched_service_t* serv
                           sched_service_node_id_t node, runtime_api_pipe_id_t pipe,
                           itc_module_pipe_t* handle, int async);
 
+/**
+ * @brief assign the downstream end of an outgoing pipe of the task with the precompiled execution plan
+ * @details this is the same as sched_task_input_pipe, but the downstream task slot is located from the
+ *          slot of the upstream task and the plan, so neither the request table nor the service is looked up
+ * @param task the upstream task
+ * @param plan the execution plan of the outgoing pipe
+ * @param handle the pipe handle
+ * @param async if the downstream end shouldn't be set to ready right away (see sched_task_input_pipe)
+ * @return status code
+ **/
+int sched_task_input_pipe_planned(sched_task_t* task, const sched_service_edge_plan_t* plan, itc_module_pipe_t* handle, int async);
+
 /**
  * @brief get next runnable task, and remove the task from the list
  * @note  the caller should create all the output pipes before actually launch the task
@@ -192,6 +206,47 @@ int sched_task_request_status(const sched_task_context_t* ctx, sched_task_reques
  **/
 int sched_task_launch_async(sched_task_t* task);
 
+/**
+ * @brief Hand over a ready sync task to a peer scheduler, so that the independent branches of
+ *        the request can run in parallel
+ * @details The task goes back to the owner scheduler with the task event, just like the async task
+ *          completion. The caller should assign all the downstream pipes in stage 1 mode (see sched_task_input_pipe)
+ *          before this is called, and the pipes are set to ready once the task comes back
+ * @param task The task to hand over
+ * @param peer The peer scheduler which is going to run the task
+ * @return status code
+ **/
+int sched_task_offload(sched_task_t* task, sched_loop_t* peer);
+
+/**
+ * @brief Check if the task has been handed over to the peer scheduler
+ * @param task The task to check
+ * @return the check result or error code
+ **/
+int sched_task_offloaded(const sched_task_t* task);
+
+/**
+ * @brief Get the number of the tasks of the same request that are currently in the ready queue
+ * @param task The task
+ * @return the number of ready tasks or error code
+ **/
+uint32_t sched_task_num_ready_siblings(sched_task_t* task);
+
+/**
+ * @brief Get the time when the task gets ready to run
+ * @note the time is only tracked when the profiler is compiled, see ENABLE_PROFILER
+ * @param task The task
+ * @return the monotonic time in nanoseconds, 0 if it's not tracked, or error code
+ **/
+uint64_t sched_task_ready_time(const sched_task_t* task);
+
+/**
+ * @brief Get the scheduler loop which owns the task
+ * @param task The task
+ * @return the scheduler loop, NULL on error
+ **/
+sched_loop_t* sched_task_get_loop(const sched_task_t* task);
+
 /**
  * @brief Get the number of running requests
  * @param ctx The context
@@ -0,0 +1,65 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+/**
+ * @brief The sampling request tracer
+ * @details The tracer records a span for each task execution of the sampled requests, which
+ *          includes the node, the thread actually runs the task, the start and end timestamps
+ *          and the number of bytes the task has written to each of its output pipes. The async
+ *          tasks are recorded as three spans, the async_setup, async_exec and async_cleanup. <br/>
+ *          Each thread writes the spans to its own buffer, so there's no synchronization on the
+ *          recording path. Once the buffer is full, or the tracer is finalized, the spans are
+ *          written to the output file as Chrome trace JSON, which can be loaded by chrome://tracing
+ *          or Perfetto. <br/>
+ *          The tracer is controlled by the following variables: <br/>
+ *          tracer.sample_rate = N: trace one of every N requests, 0 disables the tracer (default) <br/>
+ *          tracer.output = "path": the trace output file, the tracer do not trace anything without an output <br/>
+ *          tracer.buffer_size = N: the number of spans each thread buffers before it writes them to the output
+ * @file sched/trace.h
+ **/
+#ifndef __PLUMBER_SCHED_TRACE_H__
+#define __PLUMBER_SCHED_TRACE_H__
+
+/**
+ * @brief the phase of the task execution a span describes
+ **/
+typedef enum {
+	SCHED_TRACE_PHASE_EXEC,           /*!< the sync task execution */
+	SCHED_TRACE_PHASE_ASYNC_SETUP,    /*!< the async_setup of an async task */
+	SCHED_TRACE_PHASE_ASYNC_EXEC,     /*!< the async_exec of an async task, which runs on the async processor */
+	SCHED_TRACE_PHASE_ASYNC_CLEANUP   /*!< the async_cleanup of an async task */
+} sched_trace_phase_t;
+
+/**
+ * @brief initialize the tracer
+ * @return status code
+ **/
+int sched_trace_init(void);
+
+/**
+ * @brief finalize the tracer, all the buffered spans are written to the output at this point
+ * @note all the threads that records spans should be stopped before this is called
+ * @return status code
+ **/
+int sched_trace_finalize(void);
+
+/**
+ * @brief check if the request the task belongs to should be traced
+ * @param task the task to check
+ * @return the check result, 0 if the tracer is disabled
+ **/
+int sched_trace_sampled(const sched_task_t* task);
+
+/**
+ * @brief record a span for the task execution
+ * @note the caller should check if the task is sampled with sched_trace_sampled first. For the sync
+ *       execution and the async_cleanup phase, the bytes written to the output pipes are collected
+ *       from the task, thus this should be called before the task is disposed
+ * @param task the task
+ * @param phase the execution phase
+ * @param start the monotonic timestamp in nanoseconds when the execution starts
+ * @return status code
+ **/
+int sched_trace_span(const sched_task_t* task, sched_trace_phase_t phase, uint64_t start);
+
+#endif /* __PLUMBER_SCHED_TRACE_H__ */
@@ -0,0 +1,28 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+/**
+ * @brief The clock utilities
+ * @file utils/clock.h
+ **/
+
+#ifndef __PLUMBER_UTILS_CLOCK_H__
+#define __PLUMBER_UTILS_CLOCK_H__
+
+#include <time.h>
+
+/**
+ * @brief Get the current time from the monotonic clock
+ * @note The value is only meaningful when comparing with another value get from this function,
+ *       it's not related to the wall clock
+ * @return the timestamp in nanoseconds, 0 when error
+ **/
+static inline uint64_t utils_clock_now_ns(void)
+{
+	struct timespec ts;
+	if(clock_gettime(CLOCK_MONOTONIC, &ts) < 0) return 0;
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#endif /* __PLUMBER_UTILS_CLOCK_H__ */
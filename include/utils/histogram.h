@@ -0,0 +1,116 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+/**
+ * @brief The log-linear histogram
+ * @details The value range is divided into power of 2 ranges and each of the range is divided
+ *          into UTILS_HISTOGRAM_SUB_BUCKETS equal sized buckets. So the relative error of any
+ *          value read from the histogram is bounded by 1 / UTILS_HISTOGRAM_SUB_BUCKETS, no matter how
+ *          large the value is. <br/>
+ *          The histogram is a plain fixed sized array, thus the histograms collected by different
+ *          threads can be merged by adding the bucket counters
+ * @note  this file do not requires initialization and finalization
+ * @file utils/histogram.h
+ **/
+#ifndef __UTILS_HISTOGRAM_H__
+#define __UTILS_HISTOGRAM_H__
+
+#include <stdint.h>
+
+/**
+ * @brief the number of bits used to index the sub-bucket in each power of 2 range
+ **/
+#define UTILS_HISTOGRAM_SUB_BITS 3
+
+/**
+ * @brief the number of sub-buckets in each power of 2 range
+ **/
+#define UTILS_HISTOGRAM_SUB_BUCKETS (1u << UTILS_HISTOGRAM_SUB_BITS)
+
+/**
+ * @brief the number of significant bits of the largest value we can distinguish, all the values
+ *        greater than this are counted in the last bucket
+ * @note  if the value is in nanoseconds, this is about 18 minutes
+ **/
+#define UTILS_HISTOGRAM_MAX_BITS 40
+
+/**
+ * @brief the number of buckets in the histogram
+ **/
+#define UTILS_HISTOGRAM_NBUCKETS ((UTILS_HISTOGRAM_MAX_BITS - UTILS_HISTOGRAM_SUB_BITS + 1) << UTILS_HISTOGRAM_SUB_BITS)
+
+/**
+ * @brief the histogram
+ **/
+typedef struct {
+	uint64_t count;                              /*!< the number of values recorded */
+	uint64_t sum;                                /*!< the sum of the values recorded */
+	uint64_t max;                                /*!< the largest value recorded */
+	uint64_t buckets[UTILS_HISTOGRAM_NBUCKETS];  /*!< the bucket counters */
+} utils_histogram_t;
+
+/**
+ * @brief get the bucket index for the value
+ * @param value the value
+ * @return the bucket index
+ **/
+static inline uint32_t utils_histogram_bucket(uint64_t value)
+{
+	if(value < UTILS_HISTOGRAM_SUB_BUCKETS) return (uint32_t)value;
+
+	uint32_t exp = 63u - (uint32_t)__builtin_clzll(value);
+	if(exp >= UTILS_HISTOGRAM_MAX_BITS) return UTILS_HISTOGRAM_NBUCKETS - 1;
+
+	uint32_t sub = (uint32_t)(value >> (exp - UTILS_HISTOGRAM_SUB_BITS)) & (UTILS_HISTOGRAM_SUB_BUCKETS - 1);
+
+	return ((exp - UTILS_HISTOGRAM_SUB_BITS + 1) << UTILS_HISTOGRAM_SUB_BITS) + sub;
+}
+
+/**
+ * @brief record a value in the histogram
+ * @param hist the histogram
+ * @param value the value to record
+ * @return nothing
+ **/
+static inline void utils_histogram_record(utils_histogram_t* hist, uint64_t value)
+{
+	hist->count ++;
+	hist->sum += value;
+	if(hist->max < value) hist->max = value;
+	hist->buckets[utils_histogram_bucket(value)] ++;
+}
+
+/**
+ * @brief get the largest value which falls into the bucket
+ * @param bucket the bucket index
+ * @return the upper bound of the bucket
+ **/
+uint64_t utils_histogram_bucket_upper_bound(uint32_t bucket);
+
+/**
+ * @brief add all the values recorded by the source histogram to the destination histogram
+ * @param dest the destination histogram
+ * @param src the source histogram
+ * @return status code
+ **/
+int utils_histogram_merge(utils_histogram_t* dest, const utils_histogram_t* src);
+
+/**
+ * @brief get the value at the given percentile
+ * @details the result is the upper bound of the bucket where the percentile falls in, but it
+ *          never exceeds the largest value has been recorded
+ * @param hist the histogram
+ * @param percentile the percentile in [0, 100]
+ * @return the value, 0 if the histogram is empty, or error code
+ **/
+uint64_t utils_histogram_percentile(const utils_histogram_t* hist, double percentile);
+
+/**
+ * @brief clear all the values in the histogram
+ * @param hist the histogram
+ * @return status code
+ **/
+int utils_histogram_reset(utils_histogram_t* hist);
+
+#endif /* __UTILS_HISTOGRAM_H__ */
@@ -0,0 +1,113 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+/**
+ * @brief the memory accounting
+ * @details An account counts the memory held by one part of the system, for example the pages used by a
+ *          pipe module or the request arena memory allocated by a servlet node. <br/>
+ *          The account may have a high watermark and a low watermark. Once the memory charged to the account
+ *          goes beyond the high watermark, the account is over limit until the memory drops to the low watermark,
+ *          so that the component which brings more memory into the process, for example the TCP module which
+ *          accepts new connections, is able to back off before the process runs out of memory. <br/>
+ *          The sum of all the accounts is limited by the global budget in the same way.
+ * @note this is thread-safe
+ * @file mempool/account.h
+ **/
+#ifndef __PLUMBER_UTILS_MEMPOOL_ACCOUNT_H__
+#define __PLUMBER_UTILS_MEMPOOL_ACCOUNT_H__
+
+/**
+ * @brief the memory account
+ **/
+typedef struct _mempool_account_t mempool_account_t;
+
+/**
+ * @brief the snapshot of a memory account
+ **/
+typedef struct {
+	const char* name;            /*!< the name of the account, NULL for the global budget */
+	size_t      bytes;           /*!< the number of bytes currently charged */
+	size_t      peak;            /*!< the max number of bytes has been charged at the same time */
+	size_t      high_watermark;  /*!< the high watermark, 0 means no limit */
+	size_t      low_watermark;   /*!< the low watermark */
+	int         over_limit;      /*!< if the account is currently over limit */
+} mempool_account_stat_t;
+
+/**
+ * @brief initialize the memory accounting
+ * @return status code
+ **/
+int mempool_account_init(void);
+
+/**
+ * @brief finalize the memory accounting
+ * @return status code
+ **/
+int mempool_account_finalize(void);
+
+/**
+ * @brief create a new memory account
+ * @param name the name of the account
+ * @return the newly created account, NULL on error
+ **/
+mempool_account_t* mempool_account_new(const char* name);
+
+/**
+ * @brief dispose a memory account
+ * @note the bytes still charged to the account are removed from the global budget
+ * @param account the account to dispose
+ * @return status code
+ **/
+int mempool_account_free(mempool_account_t* account);
+
+/**
+ * @brief set the watermarks of the account
+ * @param account the target account, NULL for the global budget
+ * @param high the high watermark in bytes, 0 means no limit
+ * @param low the low watermark in bytes, if it's 0 or larger than the high watermark, use the high watermark
+ * @return status code
+ **/
+int mempool_account_set_watermark(mempool_account_t* account, size_t high, size_t low);
+
+/**
+ * @brief charge the memory to the account
+ * @param account the account, NULL means the memory is not accounted
+ * @param bytes the number of bytes
+ * @return status code
+ **/
+int mempool_account_charge(mempool_account_t* account, size_t bytes);
+
+/**
+ * @brief give back the memory charged to the account
+ * @param account the account, NULL means the memory is not accounted
+ * @param bytes the number of bytes
+ * @return status code
+ **/
+int mempool_account_uncharge(mempool_account_t* account, size_t bytes);
+
+/**
+ * @brief check if the account or the global budget is over limit
+ * @param account the account, NULL if we only check the global budget
+ * @return 1 if it's over limit, 0 if not
+ **/
+int mempool_account_over_limit(const mempool_account_t* account);
+
+/**
+ * @brief get the snapshot of the account
+ * @param account the account, NULL for the global budget
+ * @param buf the result buffer
+ * @return status code
+ **/
+int mempool_account_get_stat(const mempool_account_t* account, mempool_account_stat_t* buf);
+
+/**
+ * @brief call the function with the snapshot of each account
+ * @note the accounts are locked during the traverse, so the callback should not create or dispose any account
+ * @param func the callback function
+ * @param data the additional data passed to the callback
+ * @return status code
+ **/
+int mempool_account_foreach(int (*func)(const mempool_account_stat_t* stat, void* data), void* data);
+
+#endif /* __PLUMBER_UTILS_MEMPOOL_ACCOUNT_H__ */
@@ -11,6 +11,8 @@
 #ifndef __PLUMBER_UTILS_MEMPOOL_OBJECT_H__
 #define __PLUMBER_UTILS_MEMPOOL_OBJECT_H__
 
+#include <utils/mempool/account.h>
+
 /**
  * @brief The thread local pool policy
  * @note This is the description of the behavior of the thread local object memory pool,
@@ -33,9 +35,35 @@
  *       instead.
  **/
 typedef struct {
-	uint32_t   cache_limit;     /*!< the size of the thread local pool (this actually guareentee the number of objects is not larger than 2 * cache_limit) */
+	uint32_t   cache_limit;     /*!< the size of the thread local pool (this actually guareentee the number of objects is not larger than 2 * cache_limit),
+	                             *   the magazine size is min(cache_limit, UTILS_MEMPOOL_OBJPOOL_MAGAZINE_SIZE) */
 	uint32_t   alloc_unit;      /*!< the global allocation unit, how many object we want to allocate from the local pool */
 } mempool_objpool_tlp_policy_t;
+/**
+ * @brief the statistics of all the object pools in the process
+ **/
+typedef struct {
+	uint32_t   num_pools;   /*!< the number of object pools */
+	uint64_t   num_pages;   /*!< the number of pages used by all the object pools */
+	uint64_t   depot_hits;  /*!< the number of times a thread refilled its cache with a full magazine from the depot */
+	uint64_t   depot_misses;/*!< the number of times the depot had no full magazine and the thread took the pool mutex */
+} mempool_objpool_stat_t;
+
+/**
+ * @brief the statistics of the magazine depot of an object pool
+ * @details each thread caches two magazines of objects, once they are both empty or both full, the thread
+ *          exchanges a magazine with the depot, which is a lock-free stack of full magazines and a lock-free stack
+ *          of empty magazines. The pool mutex is only used when the depot cannot serve the request
+ **/
+typedef struct {
+	uint64_t   alloc_hits;      /*!< the number of times a thread got a full magazine from the depot */
+	uint64_t   alloc_misses;    /*!< the number of times the depot had no full magazine for a thread */
+	uint64_t   dealloc_hits;    /*!< the number of times a thread got an empty magazine from the depot */
+	uint64_t   dealloc_misses;  /*!< the number of times the depot had no empty magazine for a thread */
+	uint32_t   full_magazines;  /*!< the number of full magazines in the depot */
+	uint32_t   empty_magazines; /*!< the number of empty magazines in the depot */
+} mempool_objpool_pool_stat_t;
+
 /**
  * @brief the incomplete type for a fix-sized mem pool
  **/
@@ -99,6 +127,21 @@ uint32_t mempool_objpool_get_obj_size(const mempool_objpool_t* pool);
  **/
 uint32_t mempool_objpool_get_page_count(const mempool_objpool_t* pool);
 
+/**
+ * @brief get the statistics of all the object pools
+ * @param buf the result buffer
+ * @return status code
+ **/
+int mempool_objpool_get_stat(mempool_objpool_stat_t* buf);
+
+/**
+ * @brief get the magazine depot statistics of the given object pool
+ * @param pool the target pool
+ * @param buf the result buffer
+ * @return status code
+ **/
+int mempool_objpool_get_pool_stat(const mempool_objpool_t* pool, mempool_objpool_pool_stat_t* buf);
+
 /**
  * @brief set the global allocation unit for the given types of threads
  * @note  the global allocation unit means how many object we want to get from the global object pool to the thread local pool
@@ -121,4 +164,15 @@ uint32_t mempool_objpool_get_page_count(const mempool_objpool_t* pool);
  * @return status code
  **/
 int mempool_objpool_set_thread_policy(mempool_objpool_t* pool, unsigned thread_mask, mempool_objpool_tlp_policy_t policy);
+
+/**
+ * @brief charge the pages used by the object pool to the memory account
+ * @note the pool never returns its pages until it's disposed, so the account sees the peak memory the pool
+ *       has ever used rather than the objects currently in use. The pages the pool already holds are moved from
+ *       the previous account to the new one
+ * @param pool the object pool
+ * @param account the memory account, NULL if we want to stop accounting
+ * @return status code
+ **/
+int mempool_objpool_set_account(mempool_objpool_t* pool, mempool_account_t* account);
 #endif /* __PLUMBER_UTILS_MEMPOOL_BLOCK_H__ */
@@ -3,12 +3,39 @@
  **/
 /**
  * @brief the page allocator
+ * @details the pages are carved from the large memory regions reserved by the page arena, which
+ *          are backed by huge pages whenever it's possible, so that the pages used by the pipes and
+ *          buffers do not spread over the TLB. Each thread has a local page pool, and the free pages
+ *          are exchanged with the global pool in batches through a lock-free stack per NUMA node.
  * @note this allocator is designed to be thread-safe
  * @file mempool/page.h
  **/
 #ifndef __PLUMBER_UTILS_MEMPOOL_PAGE_H__
 #define __PLUMBER_UTILS_MEMPOOL_PAGE_H__
 
+#include <utils/mempool/account.h>
+
+/**
+ * @brief the snapshot of the page allocator statistics
+ **/
+typedef struct {
+	size_t free_pages;       /*!< the number of free pages in the global pool */
+	size_t max_free_pages;   /*!< the max number of free pages the global pool can hold */
+	size_t cached_pages;     /*!< the number of free pages cached by the thread local pools */
+	size_t num_thread_pools; /*!< the number of thread local pools */
+	size_t arena_pages;      /*!< the number of pages the arena has reserved from the OS */
+	size_t retired_pages;    /*!< the number of pages whose memory has been returned to the OS because of the free page limit */
+} mempool_page_stat_t;
+
+/**
+ * @brief how the page arena uses the huge pages
+ **/
+typedef enum {
+	MEMPOOL_PAGE_HUGE_PAGE_NONE,         /*!< do not use huge pages */
+	MEMPOOL_PAGE_HUGE_PAGE_TRANSPARENT,  /*!< align the regions to the huge page boundary and ask for transparent huge pages */
+	MEMPOOL_PAGE_HUGE_PAGE_EXPLICIT      /*!< map the regions from the hugetlb pool, fall back to transparent huge pages if it fails */
+} mempool_page_huge_page_t;
+
 /**
  * @brief initialize the page allocator
  * @return the status code
@@ -33,13 +60,46 @@ void* mempool_page_alloc(void);
  **/
 int mempool_page_dealloc(void* page);
 
+/**
+ * @brief allocate a single page and charge it to the memory account
+ * @param account the memory account
+ * @return the allocated page or error code
+ **/
+void* mempool_page_alloc_account(mempool_account_t* account);
+
+/**
+ * @brief dealloc a single page which is allocated by mempool_page_alloc_account
+ * @param account the memory account the page has been charged to
+ * @param page the page
+ * @return the status code
+ **/
+int mempool_page_dealloc_account(mempool_account_t* account, void* page);
+
 /**
  * @brief set the max number of free page should have in the pool
+ * @note the pages exceed the limit are not unmapped, but their memory is returned to the OS and the
+ *       page will be reused once the arena needs a new page
  * @param npages how many free pages
  * @return status code
  **/
 int mempool_page_set_free_page_limit(size_t npages);
 
+/**
+ * @brief set how the page arena uses the huge pages
+ * @note this only affects the regions reserved after this call, the default is UTILS_MEMPOOL_PAGE_HUGE_PAGE
+ * @param mode the huge page mode
+ * @return status code
+ **/
+int mempool_page_set_huge_page(mempool_page_huge_page_t mode);
+
+/**
+ * @brief get the statistics of the page allocator
+ * @note the counters of the thread local pools are read without synchronization, so the result is approximate
+ * @param buf the result buffer
+ * @return status code
+ **/
+int mempool_page_get_stat(mempool_page_stat_t* buf);
+
 /**
  * @brief disable the memory pool
  **/
@@ -225,6 +225,39 @@ int thread_free(thread_t* thread, void** ret);
  **/
 const char* thread_type_name(thread_type_t type, char* buf, size_t size);
 
+/**
+ * @brief set the CPU affinity policy for the given type of thread
+ * @details the CPU list is a comma separated list of CPU ids or CPU ranges, for example "0-3,8". <br/>
+ *          Each thread of this type created after this call will be pinned to one of the CPUs
+ *          in the list, in a round-robin manner.
+ * @param type the thread type, must be exactly one type
+ * @param cpus the CPU list, NULL or empty string removes the policy
+ * @return status code
+ **/
+int thread_set_affinity_policy(thread_type_t type, const char* cpus);
+
+/**
+ * @brief get the CPU affinity policy for the given type of thread
+ * @param type the thread type
+ * @return the CPU list, empty string if there's no policy, NULL on error
+ **/
+const char* thread_get_affinity_policy(thread_type_t type);
+
+/**
+ * @brief pin current thread to the CPUs in the list
+ * @param cpus the CPU list, see thread_set_affinity_policy for the format
+ * @return status code
+ **/
+int thread_set_current_affinity(const char* cpus);
+
+/**
+ * @brief get the NUMA node current thread is running on
+ * @note the result is cached, so this is only accurate when the thread has been pinned
+ *       to the CPUs on the same node. 0 is returned if the platform doesn't support this
+ * @return the node id
+ **/
+uint32_t thread_get_current_numa_node(void);
+
 /**
  * @brief Run the main function for testing, for more information see the
  *        documentation for thread_test_main_t
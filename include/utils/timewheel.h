@@ -0,0 +1,107 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+/**
+ * @brief the hierarchical timing wheel, a timer queue with O(1) arm, re-arm and cancel
+ * @details The timers are addressed by an integer ID in [0, capacity), so the caller can use the
+ *          index of its own object as the timer ID and doesn't need to keep any handle.
+ *          The wheel has several levels and the timer far in the future is placed in the higher level
+ *          and cascaded to the lower level when the wheel gets close to its expiration time.
+ *          The time unit is defined by the caller, the wheel only assumes it's an integer tick, for example
+ *          the TCP module uses seconds.
+ * @note the timing wheel is not thread-safe
+ * @file utils/timewheel.h
+ **/
+#include <stdint.h>
+#include <time.h>
+
+#ifndef __PLUMBER_UTILS_TIMEWHEEL_H__
+#define __PLUMBER_UTILS_TIMEWHEEL_H__
+
+/**
+ * @brief the timing wheel data structure
+ **/
+typedef struct _timewheel_t timewheel_t;
+
+/**
+ * @brief the callback function that is called when a timer expires
+ * @details the timer is already disarmed when the callback is called, so the callback is allowed to
+ *          re-arm or cancel any timer in the same wheel, including the expired one. If the expired timer
+ *          is re-armed with a time which has already passed, it will expire in the next advance call.
+ * @param id the timer ID
+ * @param data the additional data passed to timewheel_advance
+ * @return status code, if the callback fails, the error will be logged and the advance continues
+ **/
+typedef int (*timewheel_expire_func_t)(uint32_t id, void* data);
+
+/**
+ * @brief create a new timing wheel
+ * @param capacity the number of timers, the valid timer ID is [0, capacity)
+ * @param now the current time
+ * @return the newly created timing wheel, NULL on error
+ **/
+timewheel_t* timewheel_new(uint32_t capacity, time_t now);
+
+/**
+ * @brief dispose a timing wheel
+ * @param wheel the timing wheel
+ * @return status code
+ **/
+int timewheel_free(timewheel_t* wheel);
+
+/**
+ * @brief arm the timer, if the timer has already been armed, re-arm it with the new expiration time
+ * @param wheel the timing wheel
+ * @param id the timer ID
+ * @param expire when the timer expires
+ * @return status code
+ **/
+int timewheel_arm(timewheel_t* wheel, uint32_t id, time_t expire);
+
+/**
+ * @brief cancel the timer, do nothing if the timer is not armed
+ * @param wheel the timing wheel
+ * @param id the timer ID
+ * @return status code
+ **/
+int timewheel_cancel(timewheel_t* wheel, uint32_t id);
+
+/**
+ * @brief check if the timer is armed
+ * @param wheel the timing wheel
+ * @param id the timer ID
+ * @return 1 if the timer is armed, 0 if not, or error code
+ **/
+int timewheel_armed(const timewheel_t* wheel, uint32_t id);
+
+/**
+ * @brief get the number of timers that are currently armed
+ * @param wheel the timing wheel
+ * @return the number of armed timers or error code
+ **/
+uint32_t timewheel_size(const timewheel_t* wheel);
+
+/**
+ * @brief get the time before which no timer will expire
+ * @details the result is a lower bound of the earliest expiration time, which means it's safe for the
+ *          caller to sleep until then and call timewheel_advance. It's exact when the earliest timer
+ *          is in the lowest level, otherwise it's the time when the next cascade happens.
+ * @param wheel the timing wheel
+ * @param result the buffer for the result
+ * @return 1 if there's any armed timer and the result is written, 0 if the wheel is empty, or error code
+ **/
+int timewheel_next_expire(const timewheel_t* wheel, time_t* result);
+
+/**
+ * @brief move the wheel forward to the given time and expire all the timers that are due by then
+ * @details all the expired timers are collected in a batch and the callback is called once for each of them
+ * @param wheel the timing wheel
+ * @param now the current time
+ * @param func the expiration callback
+ * @param data the additional data passed to the callback
+ * @return the number of expired timers or error code
+ **/
+int timewheel_advance(timewheel_t* wheel, time_t now, timewheel_expire_func_t func, void* data);
+
+#endif /* __PLUMBER_UTILS_TIMEWHEEL_H__ */
@@ -39,6 +39,9 @@ typedef runtime_api_async_handle_t async_handle_t;
 /** @brief The type used to describe the scope stream ready event */
 typedef runtime_api_scope_ready_event_t scope_ready_event_t;
 
+/** @brief The type used to describe the file range of a scope stream */
+typedef runtime_api_scope_fd_range_t scope_fd_range_t;
+
 /** @brief flag indicates that this is an input pipe */
 #define PIPE_INPUT RUNTIME_API_PIPE_INPUT
 
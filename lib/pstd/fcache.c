@@ -713,11 +713,28 @@ int pstd_fcache_seek(pstd_fcache_file_t* file, size_t offset)
 	{
 		if(-1 == fseek(file->file, (off_t)offset, SEEK_SET))
 		    ERROR_RETURN_LOG_ERRNO(int, "Cannot seek the file");
+		file->offset = offset;
 	}
 
 	return 0;
 }
 
+int pstd_fcache_get_fd(const pstd_fcache_file_t* file, int* fd_buf, size_t* offset_buf)
+{
+	if(NULL == file || NULL == fd_buf || NULL == offset_buf)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if(file->cached) return 0;
+
+	int fd = fileno(file->file);
+	if(fd < 0) ERROR_RETURN_LOG_ERRNO(int, "Cannot get the FD for the file pointer");
+
+	*fd_buf = fd;
+	*offset_buf = file->offset;
+
+	return 1;
+}
+
 size_t pstd_fcache_read(pstd_fcache_file_t* file, void* buf, size_t bufsize)
 {
 	if(NULL == file || NULL == buf)
@@ -75,4 +75,15 @@ int pstd_fcache_stat(const char* filename, struct stat* buf);
  **/
 int pstd_fcache_seek(pstd_fcache_file_t* file, size_t offset);
 
+/**
+ * @brief Get the FD and the current offset of the file, if the file is read from the disk directly
+ * @details This is used when we want to send the file content without reading it to the user-space.
+ *          For the file served from the cache, the content is already in memory, so there's no FD for it
+ * @param file The reference to the file
+ * @param fd_buf The buffer used to return the FD, which is valid until the file reference is closed
+ * @param offset_buf The buffer used to return the current offset
+ * @return 1 if the file is read from the disk directly, 0 if it's served from the cache, or error code
+ **/
+int pstd_fcache_get_fd(const pstd_fcache_file_t* file, int* fd_buf, size_t* offset_buf);
+
 #endif /*__PSTD_FCACHE_H__ */
@@ -35,4 +35,15 @@ void* pstd_mempool_page_alloc(void);
  **/
 int pstd_mempool_page_dealloc(void* page);
 
+/**
+ * @brief allocate memory from the request arena
+ * @details the memory lives until the current request is done, and it's released along with the request
+ *          local scope. So there's no way to free the memory individually, which makes the allocation
+ *          very cheap and suitable for the small buffers that only used during the request
+ * @note this should be called from the exec callback of the servlet, because there's no request outside it
+ * @param size the size of the memory to allocate
+ * @return the allocated memory or NULL on error case
+ **/
+void* pstd_arena_alloc(size_t size);
+
 #endif /* __PSTD_MEMPOOL_H__ */
@@ -64,3 +64,17 @@ int pstd_mempool_page_dealloc(void* page)
 
 	return pipe_cntl(pipe, PIPE_CNTL_INVOKE, page);
 }
+
+void* pstd_arena_alloc(size_t size)
+{
+	static pipe_t pipe = ERROR_CODE(pipe_t);
+
+	if(ERROR_CODE(pipe_t) == pipe && ERROR_CODE(pipe_t) == (pipe = module_require_function("plumber.std", "arena_allocate")))
+	    ERROR_PTR_RETURN_LOG("Cannot get the service module method reference for plumber.std.arena_allocate, PSSM may not be loaded");
+
+	void* ret;
+	if(ERROR_CODE(int) == pipe_cntl(pipe, PIPE_CNTL_INVOKE, size, &ret) || NULL == ret)
+	    ERROR_PTR_RETURN_LOG("Cannot allocate memory from the request arena");
+
+	return ret;
+}
@@ -358,6 +358,59 @@ static inline size_t _read(void* __restrict stream_mem, void* __restrict buf, si
 #endif
 }
 
+/**
+ * @brief the callback exposes the remaining bytes of the file stream as a file range, called by RLS infrastructure
+ * @param stream_mem the stream handle
+ * @param range_buf the buffer used to return the file range
+ * @return 1 if the range has been returned, 0 if the file is served from the file cache, or error code
+ **/
+static inline int _fd_range(void* __restrict stream_mem, scope_fd_range_t* __restrict range_buf)
+{
+	_stream_t* s = (_stream_t*)stream_mem;
+	int fd;
+	size_t offset, size;
+
+#ifdef PSTD_FILE_NO_CACHE
+	if((fd = fileno(s->file)) < 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot get the FD for the RLS file stream");
+
+	off_t pos = ftello(s->file);
+	if(pos < 0) ERROR_RETURN_LOG_ERRNO(int, "Cannot get the current offset of the RLS file stream");
+
+	struct stat st;
+	if(fstat(fd, &st) < 0) ERROR_RETURN_LOG_ERRNO(int, "Cannot get the size of the RLS file stream");
+
+	offset = (size_t)pos;
+	size = (size_t)st.st_size;
+#else
+	int rc = pstd_fcache_get_fd(s->file, &fd, &offset);
+	if(ERROR_CODE(int) == rc)
+	    ERROR_RETURN_LOG(int, "Cannot get the FD of the file cache reference");
+
+	/* The file is already in memory, so reading it is cheaper */
+	if(rc == 0) return 0;
+
+	size = pstd_fcache_size(s->file);
+	if(ERROR_CODE(size_t) == size)
+	    ERROR_RETURN_LOG(int, "Cannot get the size of the file cache reference");
+#endif
+
+	size = size > offset ? size - offset : 0;
+	if(s->remaining != (size_t)-1 && size > s->remaining)
+	    size = s->remaining;
+
+	range_buf->fd = fd;
+	range_buf->offset = offset;
+	range_buf->size = size;
+
+	/* All the remaining bytes are taken by the caller */
+	s->remaining = 0;
+
+	LOG_DEBUG("RLS file byte stream has been exposed as the file range [%zu, %zu)", offset, offset + size);
+
+	return 1;
+}
+
 scope_token_t pstd_file_commit(pstd_file_t* file)
 {
 	if(NULL == file || file->committed)
@@ -370,7 +423,8 @@ scope_token_t pstd_file_commit(pstd_file_t* file)
 		.open_func = _open,
 		.close_func = _close,
 		.eos_func = _eos,
-		.read_func = _read
+		.read_func = _read,
+		.fd_func = _fd_range
 	};
 
 	scope_token_t ret = pstd_scope_add(&ent);
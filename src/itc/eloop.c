@@ -12,12 +12,17 @@
 
 #include <error.h>
 #include <barrier.h>
+#include <os/os.h>
+#include <lang/prop.h>
 #include <utils/log.h>
 #include <utils/thread.h>
+#include <utils/clock.h>
+#include <utils/mempool/objpool.h>
 #include <utils/static_assertion.h>
 #include <runtime/api.h>
 #include <itc/module_types.h>
 #include <itc/module.h>
+#include <itc/modtab.h>
 #include <itc/equeue.h>
 #include <itc/eloop.h>
 
@@ -26,6 +31,7 @@
  **/
 typedef struct {
 	itc_module_type_t module_type; /*!< the type code of the module */
+	itc_equeue_token_t token; /*!< the event queue token used by this event loop, error code if the loop haven't got one */
 	uint8_t buffer_valid:1; /*!< the valid dual buffer */
 	itc_module_pipe_param_t accept_param[2]; /*!< the accept param use by this pipe dual buffer */
 	uint32_t started:1; /*!< indicates if this thread has been started */
@@ -65,11 +71,22 @@ static inline void* _module_event_loop_main(void* data)
 
 	LOG_INFO("Starting event loop for module #%u", _self->module_type);
 
+	const itc_modtab_instance_t* inst = itc_modtab_get_from_module_type(_self->module_type);
+	if(NULL != inst && NULL != inst->eloop_cpus)
+	{
+		if(ERROR_CODE(int) == thread_set_current_affinity(inst->eloop_cpus))
+		    LOG_WARNING("Cannot pin the event loop of module #%u to CPUs %s", _self->module_type, inst->eloop_cpus);
+		else
+		    LOG_INFO("Event loop of module #%u has been pinned to CPUs %s", _self->module_type, inst->eloop_cpus);
+	}
+
 	itc_equeue_token_t token = itc_equeue_module_token(ITC_MODULE_EVENT_QUEUE_SIZE, ITC_EQUEUE_EVENT_TYPE_IO);
 
 	if(ERROR_CODE(itc_equeue_token_t) == token)
 	    ERROR_PTR_RETURN_LOG("Cannot allocate token from the event queue from module #%"PRIu32, _self->module_type);
 
+	_self->token = token;
+
 	for(;!_self->killed;)
 	{
 		itc_equeue_event_t event;
@@ -94,6 +111,9 @@ static inline void* _module_event_loop_main(void* data)
 			continue;
 		}
 
+		/* The scheduler uses this to tell how long the request has been waiting */
+		event.io.ts = utils_clock_now_ns();
+
 		if(itc_equeue_put(token, event) == ERROR_CODE(int))
 		{
 			LOG_ERROR("Cannot put the newly received resueat to the event queue");
@@ -145,6 +165,7 @@ static inline int _init_eloop(void)
 	for(j = 0; j < i; j ++)
 	{
 		_thread_data[j].module_type = modules[j];
+		_thread_data[j].token = ERROR_CODE(itc_equeue_token_t);
 		_thread_data[j].killed = 0;
 		_thread_data[j].started = 0;
 		_thread_data[j].buffer_valid = 0;
@@ -197,8 +218,73 @@ int itc_eloop_start(void)
 	return 0;
 }
 
+int itc_eloop_started(void)
+{
+	return _thread_data != NULL;
+}
+
+static int _set_prop(const char* symbol, lang_prop_value_t value, const void* data)
+{
+	(void)data;
+	if(NULL == symbol || LANG_PROP_TYPE_ERROR == value.type || LANG_PROP_TYPE_NONE == value.type)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	/* The backend is used by the poll objects created later, so it should be set before the modules are loaded */
+	if(strcmp(symbol, "backend") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_STRING) ERROR_RETURN_LOG(int, "Type mismatch");
+
+		os_event_backend_t backend;
+		if(strcmp(value.str, "default") == 0) backend = OS_EVENT_BACKEND_DEFAULT;
+		else if(strcmp(value.str, "io_uring") == 0) backend = OS_EVENT_BACKEND_IO_URING;
+		else ERROR_RETURN_LOG(int, "Unknown event loop backend %s", value.str);
+
+		if(ERROR_CODE(int) == os_event_set_backend(backend))
+		    ERROR_RETURN_LOG(int, "Cannot change the event loop backend");
+	}
+	else
+	{
+		LOG_WARNING("Unrecognized symbol name %s", symbol);
+		return 0;
+	}
+
+	return 1;
+}
+
+static lang_prop_value_t _get_prop(const char* symbol, const void* data)
+{
+	(void)data;
+	lang_prop_value_t ret = {
+		.type = LANG_PROP_TYPE_NONE
+	};
+
+	if(strcmp(symbol, "backend") == 0)
+	{
+		const char* name = os_event_get_backend() == OS_EVENT_BACKEND_IO_URING ? "io_uring" : "default";
+		if(NULL == (ret.str = strdup(name)))
+		{
+			LOG_ERROR_ERRNO("Cannot allocate memory for the backend name");
+			ret.type = LANG_PROP_TYPE_ERROR;
+			return ret;
+		}
+		ret.type = LANG_PROP_TYPE_STRING;
+	}
+
+	return ret;
+}
+
 int itc_eloop_init(void)
 {
+	lang_prop_callback_t cb = {
+		.param = NULL,
+		.get   = _get_prop,
+		.set   = _set_prop,
+		.symbol_prefix = "itc.eloop"
+	};
+
+	if(ERROR_CODE(int) == lang_prop_register_callback(&cb))
+	    ERROR_RETURN_LOG(int, "Cannot register the property callback for the event loop");
+
 	return 0;
 }
 int itc_eloop_finalize(void)
@@ -233,6 +319,9 @@ int itc_eloop_finalize(void)
 	}
 	free(_thread_data);
 
+	if(ERROR_CODE(int) == os_event_set_backend(OS_EVENT_BACKEND_DEFAULT))
+	    LOG_WARNING("Cannot reset the event loop backend");
+
 	return 0;
 }
 
@@ -277,3 +366,13 @@ int itc_eloop_set_all_accept_param(itc_module_pipe_param_t param)
 	LOG_DEBUG("Accept param for all module has been successfully updated");
 	return 0;
 }
+
+itc_equeue_token_t itc_eloop_get_token(itc_module_type_t module)
+{
+	uint32_t i;
+	for(i = 0; i < _thread_count && _thread_data[i].module_type != module; i ++);
+
+	if(i == _thread_count) return ERROR_CODE(itc_equeue_token_t);
+
+	return _thread_data[i].token;
+}
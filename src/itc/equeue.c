@@ -14,6 +14,8 @@
 #include <fallthrough.h>
 #include <barrier.h>
 #include <arch/arch.h>
+#include <os/os.h>
+#include <lang/prop.h>
 
 #include <utils/vector.h>
 #include <utils/static_assertion.h>
@@ -70,6 +72,326 @@ static pthread_cond_t  _take_cond;
  **/
 volatile uint32_t _sched_waiting;
 
+/**
+ * @brief A cell in the lock-free multi-producer ring
+ **/
+typedef struct {
+	uint32_t           seq;     /*!< The sequence number of the cell, which indicates the cell is ready for which round of producer or consumer */
+	itc_equeue_event_t event;   /*!< The event data */
+} _mpsc_cell_t;
+
+/**
+ * @brief The lock-free multi-producer single-consumer ring
+ * @details This is the bounded queue with the per-cell sequence number. A producer claims the cell
+ *          by advancing the tail with CAS, and then publish the event by updating the cell sequence.
+ *          Since we only have one dispatcher, the head is owned by the consumer. <br/>
+ *          In the lock-free mode, all the module tokens with the same event type share one ring,
+ *          so the dispatcher doesn't need to scan all the token queues and no one takes a lock
+ *          unless the ring is either empty or full.
+ **/
+typedef struct {
+	uint32_t           size;              /*!< The size of the ring, must be power of 2 */
+	uint32_t           tail;              /*!< The next cell for the producers to claim */
+	uint32_t           head;              /*!< The next cell for the consumer to read, only the dispatcher can access this */
+	uint32_t           space_seq;         /*!< The futex word the producers are parked on when the ring is full */
+	uint32_t           producers_waiting; /*!< The number of producers which are parked */
+	uintpad_t          __padding__[0];
+	_mpsc_cell_t       cells[0];          /*!< The cells */
+} _mpsc_ring_t;
+
+STATIC_ASSERTION_LAST(_mpsc_ring_t, cells);
+STATIC_ASSERTION_SIZE(_mpsc_ring_t, cells, 0);
+
+/**
+ * @brief Indicates if the event queue is running in the lock-free mode
+ **/
+static int _lock_free = 0;
+
+/**
+ * @brief The shared rings for each type of event, only used in lock-free mode
+ **/
+static _mpsc_ring_t* _rings[ITC_EQUEUE_EVENT_TYPE_COUNT];
+
+/**
+ * @brief The futex word the dispatcher is parked on in the lock-free mode
+ **/
+static uint32_t _take_seq;
+
+/**
+ * @brief Dispose an unprocessed event
+ * @param event The event to dispose
+ * @return status code
+ **/
+static inline int _dispose_event(itc_equeue_event_t* event)
+{
+	int rc = 0;
+	switch(event->type)
+	{
+		case ITC_EQUEUE_EVENT_TYPE_IO:
+		{
+			itc_module_pipe_t* in = event->io.in;
+			itc_module_pipe_t* out = event->io.out;
+
+			if(in != NULL && itc_module_pipe_deallocate(in) == ERROR_CODE(int))
+			{
+				LOG_ERROR("Cannot deallocate the input event pipe");
+				rc = ERROR_CODE(int);
+			}
+			if(out != NULL && itc_module_pipe_deallocate(out) == ERROR_CODE(int))
+			{
+				LOG_ERROR("Cannot deallocate the output event pipe");
+				rc = ERROR_CODE(int);
+			}
+			break;
+		}
+		case ITC_EQUEUE_EVENT_TYPE_TASK:
+		{
+			/* We don't call the cleanup task at this point for now.
+			 * TODO: do we need a way to make it properly cleaned up */
+
+			if(event->task.async_handle != NULL && ERROR_CODE(int) == sched_async_handle_dispose(event->task.async_handle))
+			{
+				LOG_ERROR("Cannot deallocatet the task handle");
+				rc = ERROR_CODE(int);
+			}
+
+			break;
+		}
+		default:
+		    rc = ERROR_CODE(int);
+		    LOG_ERROR("Invalid type of event");
+	}
+
+	return rc;
+}
+
+/**
+ * @brief Create a new lock-free ring
+ * @param size The size of the ring, must be power of 2
+ * @return The newly created ring, NULL on error
+ **/
+static inline _mpsc_ring_t* _mpsc_ring_new(uint32_t size)
+{
+	_mpsc_ring_t* ret = (_mpsc_ring_t*)calloc(1, sizeof(_mpsc_ring_t) + sizeof(_mpsc_cell_t) * size);
+	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the lock-free ring");
+
+	ret->size = size;
+	uint32_t i;
+	for(i = 0; i < size; i ++)
+	    ret->cells[i].seq = i;
+
+	return ret;
+}
+
+/**
+ * @brief Check if the ring has event to read
+ * @note This function must be called from the dispatcher
+ * @param ring The ring to check
+ * @return The check result
+ **/
+static inline int _mpsc_ring_ready(const _mpsc_ring_t* ring)
+{
+	if(NULL == ring) return 0;
+	uint32_t head = ring->head;
+	return ring->cells[head & (ring->size - 1)].seq == head + 1;
+}
+
+/**
+ * @brief Check if any of the lock-free rings selected by the mask has event to read
+ * @param mask The event mask
+ * @return The first ready ring or NULL if none of them is ready
+ **/
+static inline _mpsc_ring_t* _mpsc_ready_ring(itc_equeue_event_mask_t mask)
+{
+	uint32_t i;
+	for(i = 0; i < ITC_EQUEUE_EVENT_TYPE_COUNT; i ++)
+	    if(ITC_EQUEUE_EVENT_MASK_ALLOWS(mask, i) && _mpsc_ring_ready(_rings[i]))
+	        return _rings[i];
+	return NULL;
+}
+
+/**
+ * @brief Wake up the dispatcher if it's currently waiting for the given type of event
+ * @param type The event type
+ * @return nothing
+ **/
+static inline void _mpsc_notify_dispatcher(itc_equeue_event_type_t type)
+{
+	__sync_synchronize();
+
+	if(!ITC_EQUEUE_EVENT_MASK_ALLOWS(_sched_waiting, type)) return;
+
+	__sync_fetch_and_add(&_take_seq, 1);
+	if(ERROR_CODE(int) == os_futex_wake(&_take_seq, 1))
+	    LOG_WARNING("Cannot wake up the dispatcher");
+}
+
+/**
+ * @brief Put an event to the lock-free ring
+ * @param ring The target ring
+ * @param event The event to put
+ * @return status code
+ **/
+static inline int _mpsc_ring_put(_mpsc_ring_t* ring, const itc_equeue_event_t* event)
+{
+	_mpsc_cell_t* cell;
+	uint32_t pos;
+	for(;;)
+	{
+		pos = ring->tail;
+		cell = ring->cells + (pos & (ring->size - 1));
+		BARRIER();
+		int32_t diff = (int32_t)(cell->seq - pos);
+
+		if(diff == 0)
+		{
+			if(__sync_bool_compare_and_swap(&ring->tail, pos, pos + 1))
+			    break;
+		}
+		else if(diff < 0)
+		{
+			/* The ring is full, so we need to wait until the dispatcher consumes the cell */
+			uint32_t seq = ring->space_seq;
+			__sync_fetch_and_add(&ring->producers_waiting, 1);
+
+			if((int32_t)(cell->seq - pos) < 0 && ERROR_CODE(int) == os_futex_wait(&ring->space_seq, seq, 1000))
+			    LOG_WARNING("Cannot wait for the ring gets ready");
+
+			__sync_fetch_and_sub(&ring->producers_waiting, 1);
+
+			if(itc_eloop_thread_killed == 1)
+			{
+				LOG_INFO("event thread gets killed");
+				/* The event will never be taken, so we own it at this point */
+				itc_equeue_event_t dropped = *event;
+				return _dispose_event(&dropped);
+			}
+		}
+	}
+
+	cell->event = *event;
+
+	/* Make sure the data is ready, then publish the cell */
+	__sync_synchronize();
+
+	cell->seq = pos + 1;
+
+	_mpsc_notify_dispatcher(event->type);
+
+	return 0;
+}
+
+/**
+ * @brief Take events from the lock-free ring
+ * @note This function must be called from the dispatcher
+ * @param ring The ring
+ * @param buffer The buffer for the result
+ * @param buffer_size The size of the buffer
+ * @return The number of events has been taken
+ **/
+static inline uint32_t _mpsc_ring_take(_mpsc_ring_t* ring, itc_equeue_event_t* buffer, uint32_t buffer_size)
+{
+	uint32_t ret;
+	for(ret = 0; ret < buffer_size; ret ++)
+	{
+		_mpsc_cell_t* cell = ring->cells + (ring->head & (ring->size - 1));
+		if(cell->seq != ring->head + 1) break;
+
+		BARRIER();
+		buffer[ret] = cell->event;
+		__sync_synchronize();
+
+		/* Make the cell avaliable for the producer of next round */
+		cell->seq = ring->head + ring->size;
+		ring->head ++;
+	}
+
+	__sync_synchronize();
+
+	if(ret > 0 && ring->producers_waiting > 0)
+	{
+		LOG_DEBUG("scheduler thread: notifying the more free space in the lock-free ring");
+		__sync_fetch_and_add(&ring->space_seq, 1);
+		if(ERROR_CODE(int) == os_futex_wake(&ring->space_seq, OS_FUTEX_WAKE_ALL))
+		    LOG_WARNING("Cannot wake up the producers");
+	}
+
+	return ret;
+}
+
+/**
+ * @brief Wait until any of the ring selected by the event mask is ready, in the lock-free mode
+ * @param killed The killed flag
+ * @param interrupt The interrupt callback
+ * @return status code
+ **/
+static inline int _mpsc_wait(const int* killed, itc_equeue_wait_interrupt_t* interrupt)
+{
+	itc_equeue_event_mask_t mask = (1u << ITC_EQUEUE_EVENT_TYPE_COUNT) - 1;
+
+	while(killed == NULL || *killed == 0)
+	{
+		/* Take the snapshot before the interrupt callback runs, otherwise an interrupt between the
+		 * callback and the futex wait won't wake us up */
+		uint32_t seq = _take_seq;
+		__sync_synchronize();
+
+		if(interrupt != NULL && ITC_EQUEUE_EVENT_MASK_NONE == (mask = interrupt->func(interrupt->data)))
+		    ERROR_RETURN_LOG(int, "The equeue wait interrupt callback returns an error");
+
+		if(NULL != _mpsc_ready_ring(mask)) break;
+
+		_sched_waiting = mask;
+		__sync_synchronize();
+
+		/* The producer publishes the event before it checks the waiting flag, so we must recheck
+		 * the rings after the waiting flag is set */
+		if(NULL == _mpsc_ready_ring(mask) && ERROR_CODE(int) == os_futex_wait(&_take_seq, seq, 1000))
+		    ERROR_RETURN_LOG(int, "Cannot wait for the dispatcher futex");
+
+		_sched_waiting = 0;
+	}
+
+	return 0;
+}
+
+static int _set_prop(const char* symbol, lang_prop_value_t value, const void* data)
+{
+	(void)data;
+	if(NULL == symbol || LANG_PROP_TYPE_ERROR == value.type || LANG_PROP_TYPE_NONE == value.type)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if(strcmp(symbol, "lock_free") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(ERROR_CODE(int) == itc_equeue_set_lock_free(value.num != 0))
+		    ERROR_RETURN_LOG(int, "Cannot change the event queue mode");
+	}
+	else
+	{
+		LOG_WARNING("Unrecognized symbol name %s", symbol);
+		return 0;
+	}
+
+	return 1;
+}
+
+static lang_prop_value_t _get_prop(const char* symbol, const void* data)
+{
+	(void)data;
+	lang_prop_value_t ret = {
+		.type = LANG_PROP_TYPE_NONE
+	};
+
+	if(strcmp(symbol, "lock_free") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = _lock_free;
+	}
+
+	return ret;
+}
+
 
 /**
  * @todo using larger initial size when there's such need for that
@@ -96,12 +418,29 @@ int itc_equeue_init()
 	if((errno = pthread_mutex_init(&_take_mutex, NULL)) != 0)
 	    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot initialize the read condition mutex");
 
+	stage = 4;
+	lang_prop_callback_t cb = {
+		.param = NULL,
+		.get   = _get_prop,
+		.set   = _set_prop,
+		.symbol_prefix = "itc.equeue"
+	};
+	if(ERROR_CODE(int) == lang_prop_register_callback(&cb))
+	    ERROR_LOG_GOTO(ERR, "Cannot register the property callback for the event queue");
+
+	_lock_free = 0;
+	memset(_rings, 0, sizeof(_rings));
+	_take_seq = 0;
+
 	LOG_DEBUG("Event Queue has been initialized");
 	return 0;
 
 ERR:
 	switch(stage)
 	{
+		case 4:
+		    pthread_mutex_destroy(&_take_mutex);
+		    FALLTHROUGH();
 		case 3:
 		    pthread_cond_destroy(&_take_cond);
 		    FALLTHROUGH();
@@ -133,46 +472,8 @@ int itc_equeue_finalize()
 			{
 				uint64_t j;
 				for(j = queue->front; j != queue->rear; j ++)
-				{
-					switch(queue->events[j & (queue->size - 1)].type)
-					{
-						case ITC_EQUEUE_EVENT_TYPE_IO:
-						{
-							itc_module_pipe_t* in = queue->events[j & (queue->size - 1)].io.in;
-							itc_module_pipe_t* out = queue->events[j & (queue->size - 1)].io.out;
-
-							if(in != NULL && itc_module_pipe_deallocate(in) == ERROR_CODE(int))
-							{
-								LOG_ERROR("Cannot deallocate the input event pipe");
-								rc = ERROR_CODE(int);
-							}
-							if(out != NULL && itc_module_pipe_deallocate(out) == ERROR_CODE(int))
-							{
-								LOG_ERROR("Cannot deallocate the output event pipe");
-								rc = ERROR_CODE(int);
-							}
-							break;
-						}
-						case ITC_EQUEUE_EVENT_TYPE_TASK:
-						{
-							itc_equeue_task_event_t* event = &queue->events[j & (queue->size - 1)].task;
-
-							/* We don't call the cleanup task at this point for now.
-							 * TODO: do we need a way to make it properly cleaned up */
-
-							if(event->async_handle != NULL && ERROR_CODE(int) == sched_async_handle_dispose(event->async_handle))
-							{
-								LOG_ERROR("Cannot deallocatet the task handle");
-								rc = ERROR_CODE(int);
-							}
-
-							break;
-						}
-						default:
-						    rc = ERROR_CODE(int);
-						    LOG_ERROR("Invalid type of event");
-					}
-				}
+				    if(ERROR_CODE(int) == _dispose_event(queue->events + (j & (queue->size - 1))))
+				        rc = ERROR_CODE(int);
 				if((errno = pthread_mutex_destroy(&queue->mutex)) != 0)
 				{
 					LOG_ERROR_ERRNO("Cannot destroy the queue specified mutex");
@@ -188,6 +489,21 @@ int itc_equeue_finalize()
 		}
 		vector_free(_queues);
 	}
+
+	uint32_t t;
+	for(t = 0; t < ITC_EQUEUE_EVENT_TYPE_COUNT; t ++)
+	{
+		if(NULL == _rings[t]) continue;
+
+		itc_equeue_event_t event;
+		while(_mpsc_ring_take(_rings[t], &event, 1) > 0)
+		    if(ERROR_CODE(int) == _dispose_event(&event))
+		        rc = ERROR_CODE(int);
+
+		free(_rings[t]);
+		_rings[t] = NULL;
+	}
+
 	if((errno = pthread_mutex_unlock(&_global_mutex)) != 0)
 	{
 		LOG_ERROR_ERRNO("Cannot destroy the global mutex");
@@ -229,9 +545,28 @@ itc_equeue_token_t itc_equeue_module_token(uint32_t size, itc_equeue_event_type_
 	    ERROR_RETURN_LOG_ERRNO(itc_equeue_token_t, "Cannot lock the global mutex");
 
 	ret = (_next_token ++);
-	queue = (_queue_t*)calloc(1, sizeof(_queue_t) + sizeof(itc_equeue_event_t) * q_size);
+
+	/* In the lock-free mode, the token queue is only used to track the event type, since all the
+	 * events goes to the shared ring */
+	queue = (_queue_t*)calloc(1, sizeof(_queue_t) + (_lock_free ? 0 : sizeof(itc_equeue_event_t) * q_size));
 	if(NULL == queue) ERROR_LOG_GOTO(ERR, "Cannot allocate memory for event queue");
 
+	if(_lock_free && NULL == _rings[type])
+	{
+		uint32_t ring_size = q_size;
+		for(;ring_size < ITC_EQUEUE_SHARED_RING_SIZE; ring_size <<= 1);
+
+		_mpsc_ring_t* ring = _mpsc_ring_new(ring_size);
+		if(NULL == ring) ERROR_LOG_GOTO(ERR, "Cannot create the shared ring for the event type");
+
+		/* Make sure the ring is fully initialized before the dispatcher can see it */
+		__sync_synchronize();
+
+		_rings[type] = ring;
+
+		LOG_INFO("Lock-free ring for event type %u has been created: Size = %u", type, ring_size);
+	}
+
 	if((errno = pthread_mutex_init(&queue->mutex, NULL)) != 0) ERROR_LOG_GOTO(ERR, "Cannot initialize the queue mutex");
 
 	stage = 1;
@@ -304,6 +639,9 @@ int itc_equeue_put(itc_equeue_token_t token, itc_equeue_event_t event)
 	if(queue->type != event.type)
 	    ERROR_RETURN_LOG(int, "Invalid event type, the queue do not accept specified event type");
 
+	if(_lock_free)
+	    return _mpsc_ring_put(_rings[event.type], &event);
+
 	LOG_DEBUG("token %u: wait for the queue have space for the new event", token);
 
 	struct timespec abstime;
@@ -328,7 +666,7 @@ int itc_equeue_put(itc_equeue_token_t token, itc_equeue_event_t event)
 				LOG_INFO("event thread gets killed");
 				if((errno = pthread_mutex_unlock(&queue->mutex)) != 0)
 				    LOG_WARNING_ERRNO("cannot release the queue mutex");
-				return 0;
+				return _dispose_event(&event);
 			}
 
 			abstime.tv_sec ++;
@@ -378,6 +716,13 @@ uint32_t itc_equeue_take(itc_equeue_token_t token, itc_equeue_event_mask_t type_
 
 	if(token != _SCHED_TOKEN) ERROR_RETURN_LOG(uint32_t, "Cannot call the take method from event thread");
 
+	if(_lock_free)
+	{
+		_mpsc_ring_t* ring = _mpsc_ready_ring(type_mask);
+		if(NULL == ring) ERROR_RETURN_LOG(uint32_t, "Cannot find the event mask = %x", type_mask);
+		return _mpsc_ring_take(ring, buffer, buffer_size);
+	}
+
 	/* Find the first queue that is not empty */
 	for(i = 0; i < vector_length(_queues); i ++)
 	{
@@ -429,6 +774,10 @@ uint32_t itc_equeue_take(itc_equeue_token_t token, itc_equeue_event_mask_t type_
 int itc_equeue_empty(itc_equeue_token_t token)
 {
 	if(token != _SCHED_TOKEN) ERROR_RETURN_LOG(int, "Cannot call this function from the event thread");
+
+	if(_lock_free)
+	    return NULL == _mpsc_ready_ring((1u << ITC_EQUEUE_EVENT_TYPE_COUNT) - 1);
+
 	size_t i;
 	for(i = 0; i < vector_length(_queues); i ++)
 	{
@@ -447,6 +796,9 @@ int itc_equeue_wait(itc_equeue_token_t token, const int* killed, itc_equeue_wait
 
 	LOG_DEBUG("The thread is going to be blocked until the queue have at least one event");
 
+	if(_lock_free)
+	    return _mpsc_wait(killed, interrupt);
+
 	struct timespec abstime;
 	struct timeval now;
 	gettimeofday(&now,NULL);
@@ -508,6 +860,12 @@ int itc_equeue_wait(itc_equeue_token_t token, const int* killed, itc_equeue_wait
 
 int itc_equeue_wait_interrupt()
 {
+	if(_lock_free)
+	{
+		__sync_fetch_and_add(&_take_seq, 1);
+		return os_futex_wake(&_take_seq, 1);
+	}
+
 	if((errno = pthread_mutex_lock(&_take_mutex)) != 0)
 	    LOG_WARNING_ERRNO("cannot acquire the reader mutex");
 
@@ -519,3 +877,54 @@ int itc_equeue_wait_interrupt()
 
 	return 0;
 }
+
+int itc_equeue_get_stat(itc_equeue_token_t token, itc_equeue_stat_t* buf)
+{
+	if(NULL == buf || token == _SCHED_TOKEN || token >= vector_length(_queues))
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	const _queue_t* queue = *VECTOR_GET(const _queue_t*, _queues, token);
+	if(NULL == queue) ERROR_RETURN_LOG(int, "Cannot get the queue for token %u", token);
+
+	buf->type = queue->type;
+
+	if(_lock_free)
+	{
+		const _mpsc_ring_t* ring = _rings[queue->type];
+		if(NULL == ring) ERROR_RETURN_LOG(int, "Cannot get the shared ring for token %u", token);
+		buf->shared = 1;
+		buf->size = ring->size;
+		buf->depth = ring->tail - ring->head;
+	}
+	else
+	{
+		buf->shared = 0;
+		buf->size = queue->size;
+		buf->depth = queue->rear - queue->front;
+	}
+
+	return 0;
+}
+
+int itc_equeue_set_lock_free(int enabled)
+{
+	int rc = 0;
+	if((errno = pthread_mutex_lock(&_global_mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the global mutex");
+
+	if(_next_token > 0 || _sched_token_called)
+	{
+		LOG_ERROR("Cannot change the event queue mode after any token has been created");
+		rc = ERROR_CODE(int);
+	}
+	else
+	{
+		_lock_free = (enabled != 0);
+		LOG_INFO("The event queue is now in %s mode", _lock_free ? "lock-free" : "locked");
+	}
+
+	if((errno = pthread_mutex_unlock(&_global_mutex)) != 0)
+	    LOG_WARNING_ERRNO("cannot release the global mutex");
+
+	return rc;
+}
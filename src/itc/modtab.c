@@ -83,6 +83,8 @@ static inline int _mod_free(itc_modtab_instance_t* node)
 
 	if(NULL != node->context) free(node->context);
 
+	if(NULL != node->eloop_cpus) free(node->eloop_cpus);
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wcast-qual"
 	free((void*)node->path);
@@ -152,6 +154,7 @@ static inline itc_modtab_instance_t* _mod_load(const itc_module_t* module, uint3
 	itc_modtab_instance_t* ret = (itc_modtab_instance_t*)malloc(sizeof(itc_modtab_instance_t));
 	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for new module instance");
 	ret->module = module;
+	ret->eloop_cpus = NULL;
 
 	/* Allocate the path buffer */
 	char* path_buffer = (char*)malloc(ITC_MODTAB_MAX_PATH);
@@ -247,6 +250,24 @@ static inline lang_prop_value_t _get_module_property(const char* symbol, const v
 
 	const itc_modtab_instance_t* node = (const itc_modtab_instance_t*)data;
 
+	if(strcmp(symbol, "event_loop_cpus") == 0)
+	{
+		if(NULL == node->eloop_cpus)
+		{
+			ret.type = LANG_PROP_TYPE_NONE;
+			return ret;
+		}
+
+		if(NULL == (ret.str = strdup(node->eloop_cpus)))
+		{
+			LOG_ERROR_ERRNO("Cannot allocate memory for the CPU list string");
+			return ret;
+		}
+
+		ret.type = LANG_PROP_TYPE_STRING;
+		return ret;
+	}
+
 	if(symbol[0])
 	{
 		if(node->module->get_property == NULL)
@@ -298,6 +319,23 @@ static inline int _set_module_property(const char* symbol, lang_prop_value_t val
 
 	const itc_modtab_instance_t* node  = (const itc_modtab_instance_t*)data;
 
+	/* The event loop CPU list is handled by the module table, since the module itself doesn't own the event loop thread */
+	if(strcmp(symbol, "event_loop_cpus") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_STRING) ERROR_RETURN_LOG(int, "Type mismatch");
+
+		char* cpus = strdup(value.str);
+		if(NULL == cpus) ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the CPU list string");
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wcast-qual"
+		itc_modtab_instance_t* mutable_node = (itc_modtab_instance_t*)node;
+#pragma GCC diagnostic pop
+		if(NULL != mutable_node->eloop_cpus) free(mutable_node->eloop_cpus);
+		mutable_node->eloop_cpus = cpus;
+
+		return 1;
+	}
+
 	if(node->module->set_property == NULL) return 0;
 
 	itc_module_property_value_t prop;
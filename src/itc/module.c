@@ -80,6 +80,7 @@ struct _itc_module_pipe_t {
 	size_t                     processed_header_size;  /*!< The header data that has been processed */
 	size_t                     expected_header_size;   /*!< The expected header size, which can be smaller than the actual header size, since there may be type conversions */
 	size_t                     actual_header_size;     /*!< The actual header size */
+	size_t                     bytes_written;          /*!< The number of body bytes has been written to the output pipe */
 	struct _itc_module_pipe_t* companion_next;         /*!< a companion is the loop linked list for all the pipes that shares resources */
 	struct _itc_module_pipe_t* companion_prev;         /*!< same as companion_next but is the reverse pointer */
 	uintpad_t                  __padding_pipe__[0];
@@ -278,6 +279,7 @@ int itc_module_pipe_allocate(itc_module_type_t type, uint32_t hint,
 		out->actual_header_size = param.input_header;
 		out->expected_header_size = param.output_header;
 		out->processed_header_size = 0;
+		out->bytes_written = 0;
 		out->pipe_flags = param.output_flags;
 		out->stat.accepted = 0;
 		out->stat.error = 0;
@@ -292,6 +294,7 @@ int itc_module_pipe_allocate(itc_module_type_t type, uint32_t hint,
 		in->stat.type = _PSTAT_TYPE_INPUT;
 		in->actual_header_size = in->expected_header_size = param.input_header;
 		in->processed_header_size = 0;
+		in->bytes_written = 0;
 		in->pipe_flags = param.input_flags;
 		in->stat.accepted = 0;
 		in->stat.error = 0;
@@ -538,10 +541,14 @@ size_t itc_module_pipe_read(void* buffer, size_t nbytes, itc_module_pipe_t* hand
  * @param mod the module instance we should use
  * @return the number of bytes has written
  **/
-static inline size_t _write_impl(const void* data, size_t nbytes, itc_module_pipe_t* handle, const itc_modtab_instance_t * mod)
+/**
+ * @brief fill zero to the unwritten typed header of the output pipe
+ * @param handle the output pipe
+ * @param mod the module instance we should use
+ * @return 1 if the header has been completely written, 0 if the header IO is still undergoing, or error code
+ **/
+static inline int _fill_header(itc_module_pipe_t* handle, const itc_modtab_instance_t* mod)
 {
-	if(handle->stat.type != _PSTAT_TYPE_OUTPUT) ERROR_RETURN_LOG(size_t, "Wrong pipe type");
-
 	size_t rc = 0;
 	size_t bytes_to_fill = handle->actual_header_size - handle->processed_header_size;
 	size_t filled_start = 0;
@@ -565,7 +572,7 @@ static inline size_t _write_impl(const void* data, size_t nbytes, itc_module_pip
 		if(rc == ERROR_CODE(size_t))
 		{
 			handle->stat.error = 1;
-			return rc;
+			return ERROR_CODE(int);
 		}
 
 		if(rc == 0) break;
@@ -574,8 +581,20 @@ static inline size_t _write_impl(const void* data, size_t nbytes, itc_module_pip
 		bytes_to_fill -= rc;
 	}
 
+	return bytes_to_fill == 0;
+}
+
+static inline size_t _write_impl(const void* data, size_t nbytes, itc_module_pipe_t* handle, const itc_modtab_instance_t * mod)
+{
+	if(handle->stat.type != _PSTAT_TYPE_OUTPUT) ERROR_RETURN_LOG(size_t, "Wrong pipe type");
+
+	size_t rc = 0;
+	int header_rc = _fill_header(handle, mod);
+
+	if(ERROR_CODE(int) == header_rc) return ERROR_CODE(size_t);
+
 	/* This means we don't have anything to write */
-	if(bytes_to_fill > 0)
+	if(header_rc == 0)
 	{
 		LOG_DEBUG("The header IO are still undergoing, we are not able to write any body data");
 		return 0;
@@ -586,6 +605,7 @@ static inline size_t _write_impl(const void* data, size_t nbytes, itc_module_pip
 	_INVOKE_MODULE(size_t, rc, mod, write, data, nbytes, handle->data);
 
 	if(rc == ERROR_CODE(size_t)) handle->stat.error = 1;
+	else handle->bytes_written += rc;
 
 	/* This pipe has been touched, which means it's not an empty pipe */
 	if(rc != ERROR_CODE(size_t) && rc > 0) handle->stat.o_touched = 1;
@@ -664,6 +684,17 @@ static inline int _rls_stream_close(void* handle)
 	return sched_rscope_stream_close((sched_rscope_stream_t*)handle);
 }
 
+/**
+ * @brief get the file range of a RLS stream
+ * @param handle the RLS stream
+ * @param range_buf the buffer used to return the range
+ * @return 1 if the range has been returned, 0 if the stream is not backed by a file, or error code
+ **/
+static inline int _rls_stream_fd_range(void* __restrict handle, runtime_api_scope_fd_range_t* __restrict range_buf)
+{
+	return sched_rscope_stream_get_fd_range((sched_rscope_stream_t*)handle, range_buf);
+}
+
 int itc_module_pipe_write_scope_token(runtime_api_scope_token_t token, const runtime_api_scope_token_data_request_t* data_req, itc_module_pipe_t* handle)
 {
 	sched_rscope_stream_t* stream = NULL;
@@ -676,7 +707,8 @@ int itc_module_pipe_write_scope_token(runtime_api_scope_token_t token, const run
 		.data_handle = stream,
 		.read = _rls_stream_read,
 		.eos  = _rls_stream_eos,
-		.close = _rls_stream_close
+		.close = _rls_stream_close,
+		.fd_range = _rls_stream_fd_range
 	};
 
 
@@ -852,6 +884,7 @@ int itc_module_pipe_accept(itc_module_type_t type, itc_module_pipe_param_t param
 	 * and the expected header size are the same */
 	in->actual_header_size = in->expected_header_size = param.input_header;
 	in->processed_header_size = 0;
+	in->bytes_written = 0;
 
 	out->companion_next = out->companion_prev = in;
 	out->pipe_flags = param.output_flags;
@@ -859,6 +892,7 @@ int itc_module_pipe_accept(itc_module_type_t type, itc_module_pipe_param_t param
 	/* Same as the argument for the input end */
 	out->actual_header_size = out->expected_header_size = param.output_header;
 	out->processed_header_size = 0;
+	out->bytes_written = 0;
 
 	in->stat.accepted = out->stat.accepted = 1;
 	in->stat.error = out->stat.error = 0;
@@ -1274,9 +1308,30 @@ int itc_module_pipe_cntl(itc_module_pipe_t* handle, uint32_t opcode, va_list ap)
 
 		int rc = 0;
 		if(mod->module->cntl == NULL) return 0;
+
+		/* The module specified call may pass the body data through the pipe, so the typed header should be processed first */
+		if(handle->actual_header_size > handle->processed_header_size)
+		{
+			if(handle->stat.type == _PSTAT_TYPE_OUTPUT && !handle->stat.s_hold)
+			    rc = _fill_header(handle, mod);
+			else if(handle->stat.type == _PSTAT_TYPE_INPUT)
+			    rc = _skip_header(handle, mod);
+
+			if(ERROR_CODE(int) == rc)
+			    ERROR_RETURN_LOG(int, "Cannot process the typed header");
+			rc = 0;
+		}
+
 		_INVOKE_MODULE(int, rc, mod, cntl, handle->data, RUNTIME_API_PIPE_CNTL_OPCODE_MOD_SPEC(opcode), ap);
 		if(rc == ERROR_CODE(int)) ERROR_RETURN_LOG(int, "Cannot finish cntl call");
 
+		/* A positive return value means the call has written data to the output pipe */
+		if(rc > 0)
+		{
+			if(handle->stat.type == _PSTAT_TYPE_OUTPUT) handle->stat.o_touched = 1;
+			rc = 0;
+		}
+
 		return rc;
 	}
 
@@ -1356,6 +1411,12 @@ int itc_module_is_pipe_shadow(const itc_module_pipe_t* handle)
 	return (handle->pipe_flags & RUNTIME_API_PIPE_SHADOW) != 0;
 }
 
+int itc_module_pipe_has_companion(const itc_module_pipe_t* handle)
+{
+	if(NULL == handle) ERROR_RETURN_LOG(int, "Invalid arguments");
+	return handle->companion_next != handle;
+}
+
 int itc_module_is_pipe_input(const itc_module_pipe_t* handle)
 {
 	if(NULL == handle) ERROR_RETURN_LOG(int, "Invalid arguments");
@@ -1406,6 +1467,7 @@ itc_module_pipe_t* itc_module_pipe_fork(itc_module_pipe_t* handle, runtime_api_p
 	ret->actual_header_size = source_handle->actual_header_size;
 	ret->expected_header_size = header_size;
 	ret->processed_header_size = 0;
+	ret->bytes_written = 0;
 
 	const itc_module_t* module = inst->module;
 	void* context = inst->context;
@@ -1470,3 +1532,16 @@ int itc_module_pipe_is_touched(const itc_module_pipe_t* handle)
 
 	return handle->stat.o_touched && !handle->stat.error;
 }
+
+size_t itc_module_pipe_bytes_written(const itc_module_pipe_t* handle)
+{
+	if(NULL == handle)
+	    ERROR_RETURN_LOG(size_t, "Invalid arguments");
+
+	if((handle->pipe_flags & RUNTIME_API_PIPE_SHADOW) > 0) return 0;
+
+	if(handle->stat.type != _PSTAT_TYPE_OUTPUT)
+	    ERROR_RETURN_LOG(size_t, "Wrong pipe types, expected output, got input");
+
+	return handle->bytes_written;
+}
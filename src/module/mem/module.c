@@ -11,7 +11,7 @@
 #include <errno.h>
 
 #include <itc/module_types.h>
-#include <module/test/module.h>
+#include <module/mem/api.h>
 
 #include <utils/log.h>
 #include <utils/static_assertion.h>
@@ -30,15 +30,27 @@ typedef enum {
 
 /**
  * @brief the struct used to represents a data page
+ * @details there are three kinds of pages: <br/>
+ *          1. The inline page, which is a page from the page memory pool and the data is right after the header <br/>
+ *          2. The external page, whose data is a page or a buffer donated by the servlet, the header is allocated from
+ *             the node pool and the memory is disposed by the free_func <br/>
+ *          3. The reference page, whose data is a part of another page which is moved from other pipe, the header is
+ *             allocated from the node pool as well. <br/>
+ *          The inline page and the external page may be referenced by the pages of other pipes, so they are reference counted
  **/
 typedef struct _buffer_page_t {
-	struct _buffer_page_t* next;  /*!< the next page in the mem buffer */
-	uint32_t size;                /*!< the actual data size in this page */
+	struct _buffer_page_t* next;      /*!< the next page in the mem buffer */
+	uint32_t size;                    /*!< the actual data size in this page */
+	uint32_t refcnt;                  /*!< the number of buffers which holds this page */
+	char*    data;                    /*!< the data section */
+	struct _buffer_page_t* target;    /*!< the page which owns the data, only used by the reference page */
+	module_mem_free_func_t free_func; /*!< the function used to dispose the external data, only used by the external page */
+	void*    free_data;               /*!< the additional data for the free_func */
 	uintpad_t __padding__[0];
-	char   data[0];               /*!< the data section */
+	char   inline_data[0];            /*!< the data section of an inline page */
 } _buffer_page_t;
-STATIC_ASSERTION_LAST(_buffer_page_t, data);
-STATIC_ASSERTION_SIZE(_buffer_page_t, data, 0);
+STATIC_ASSERTION_LAST(_buffer_page_t, inline_data);
+STATIC_ASSERTION_SIZE(_buffer_page_t, inline_data, 0);
 
 /**
  * @brief the actual data definition for a module handle
@@ -60,14 +72,78 @@ static uint32_t _pagesize;
  **/
 static uint32_t _pagedata_limit;
 
+/**
+ * @brief the pool for the headers of the external pages and the reference pages
+ **/
+static mempool_objpool_t* _node_pool;
+
+/**
+ * @brief the memory account for the pages and the donated memory held by the pipes
+ **/
+static mempool_account_t* _account;
+
+/**
+ * @brief the number of module instances which are using the node pool
+ **/
+static uint32_t _num_instances;
+
 static _buffer_page_t* __buffer_page_new(void)
 {
-	_buffer_page_t* ret = (_buffer_page_t*)mempool_page_alloc();
+	_buffer_page_t* ret = (_buffer_page_t*)mempool_page_alloc_account(_account);
 	if(NULL == ret) ERROR_PTR_RETURN_LOG("Cannot allocate memory for the new page");
 	ret->next = NULL;
 	ret->size = 0;
+	ret->refcnt = 1;
+	ret->data = ret->inline_data;
+	ret->target = NULL;
+	ret->free_func = NULL;
+	ret->free_data = NULL;
 	return ret;
 }
+
+/**
+ * @brief check if the page is an inline page, which means we can write the data to it
+ * @param page the page to check
+ * @return the check result
+ **/
+static inline int __buffer_page_is_inline(const _buffer_page_t* page)
+{
+	return page->target == NULL && page->free_func == NULL;
+}
+
+/**
+ * @brief release a page, the page is disposed when it's not used by any buffer
+ * @param page the page to release
+ * @return status code
+ **/
+static inline int __buffer_page_release(_buffer_page_t* page)
+{
+	if(__sync_sub_and_fetch(&page->refcnt, 1) > 0) return 0;
+
+	if(__buffer_page_is_inline(page))
+	    return mempool_page_dealloc_account(_account, page);
+
+	int rc = 0;
+
+	if(NULL != page->target && ERROR_CODE(int) == __buffer_page_release(page->target))
+	    rc = ERROR_CODE(int);
+
+	if(NULL != page->free_func)
+	{
+		mempool_account_uncharge(_account, page->size);
+		if(ERROR_CODE(int) == page->free_func(page->data, page->free_data))
+		{
+			LOG_ERROR("The free callback of the donated buffer returns an error");
+			rc = ERROR_CODE(int);
+		}
+	}
+
+	if(ERROR_CODE(int) == mempool_objpool_dealloc(_node_pool, page))
+	    rc = ERROR_CODE(int);
+
+	return rc;
+}
+
 static inline int __buffer_free(_buffer_page_t* page)
 {
 	int rc = 0;
@@ -75,12 +151,32 @@ static inline int __buffer_free(_buffer_page_t* page)
 	{
 		_buffer_page_t* tmp = page;
 		page = page->next;
-		if(ERROR_CODE(int) == mempool_page_dealloc(tmp))
+		if(ERROR_CODE(int) == __buffer_page_release(tmp))
 		    rc = ERROR_CODE(int);
 	}
 	return rc;
 }
 
+/**
+ * @brief allocate a header for the external page or the reference page
+ * @param data the data section
+ * @param size the size of the data
+ * @return the newly created page header, NULL on error
+ **/
+static inline _buffer_page_t* __buffer_node_new(char* data, uint32_t size)
+{
+	_buffer_page_t* ret = (_buffer_page_t*)mempool_objpool_alloc(_node_pool);
+	if(NULL == ret) ERROR_PTR_RETURN_LOG("Cannot allocate memory for the page header");
+	ret->next = NULL;
+	ret->size = size;
+	ret->refcnt = 1;
+	ret->data = data;
+	ret->target = NULL;
+	ret->free_func = NULL;
+	ret->free_data = NULL;
+	return ret;
+}
+
 static int _module_init(void* __restrict ctx, uint32_t argc, char const* __restrict const* __restrict argv)
 {
 	(void) ctx;
@@ -92,12 +188,42 @@ static int _module_init(void* __restrict ctx, uint32_t argc, char const* __restr
 	else LOG_DEBUG("The page size is %d", rc);
 	_pagesize = (uint32_t)rc;
 	_pagedata_limit = _pagesize - (uint32_t)sizeof(_buffer_page_t);
+
+	if(_num_instances ++ > 0) return 0;
+
+	if(NULL == (_account = mempool_account_new("pipe.mem")))
+	    ERROR_LOG_GOTO(ERR, "Cannot create the memory account for the memory pipe");
+
+	if(NULL == (_node_pool = mempool_objpool_new(sizeof(_buffer_page_t))))
+	    ERROR_LOG_GOTO(ERR, "Cannot create the memory pool for the page headers");
+
+	if(ERROR_CODE(int) == mempool_objpool_set_account(_node_pool, _account))
+	    ERROR_LOG_GOTO(ERR, "Cannot set the memory account for the page header pool");
+
 	return 0;
+ERR:
+	if(NULL != _node_pool) mempool_objpool_free(_node_pool);
+	if(NULL != _account) mempool_account_free(_account);
+	_node_pool = NULL;
+	_account = NULL;
+	_num_instances --;
+	return ERROR_CODE(int);
 }
 
 static int _module_cleanup(void* __restrict ctx)
 {
 	(void) ctx;
+
+	if(-- _num_instances == 0)
+	{
+		int rc = mempool_objpool_free(_node_pool);
+		if(ERROR_CODE(int) == mempool_account_free(_account))
+		    rc = ERROR_CODE(int);
+		_node_pool = NULL;
+		_account = NULL;
+		return rc;
+	}
+
 	return 0;
 }
 
@@ -219,6 +345,24 @@ static size_t _read(void* __restrict ctx, void* __restrict buffer, size_t nbytes
 	return ret;
 }
 
+/**
+ * @brief append a page to the end of the buffer, and move the write pointer to the end of the page
+ * @param handle the output handle
+ * @param page the page to append
+ * @return status code
+ **/
+static inline int __buffer_append(module_handle_t* handle, _buffer_page_t* page)
+{
+	if(NULL != handle->current_page->next)
+	    ERROR_RETURN_LOG(int, "Unexpected current page in a write pipe, code bug!");
+
+	handle->current_page->next = page;
+	handle->current_page = page;
+	handle->page_offset = page->size;
+
+	return 0;
+}
+
 static size_t _write(void* __restrict ctx, const void* __restrict buffer, size_t nbytes, void* __restrict pipe)
 {
 	(void) ctx;
@@ -233,6 +377,19 @@ static size_t _write(void* __restrict ctx, const void* __restrict buffer, size_t
 
 	for(;nbytes > 0;)
 	{
+		if(!__buffer_page_is_inline(handle->current_page))
+		{
+			LOG_DEBUG("The last page is not writable, append a new page");
+			_buffer_page_t* page = __buffer_page_new();
+			if(NULL == page)
+			    ERROR_RETURN_LOG(size_t, "Cannot create new page for the mempipe");
+			if(ERROR_CODE(int) == __buffer_append(handle, page))
+			{
+				__buffer_free(page);
+				return ERROR_CODE(size_t);
+			}
+		}
+
 		uint32_t size = _pagedata_limit - handle->page_offset;
 		if(nbytes < size) size = (uint32_t)nbytes;
 		memcpy(handle->current_page->data + handle->page_offset, b, size);
@@ -256,6 +413,175 @@ static size_t _write(void* __restrict ctx, const void* __restrict buffer, size_t
 	return ret;
 }
 
+/**
+ * @brief the free function for the donated page
+ * @param page the page
+ * @param data the additional data, not used
+ * @return status code
+ **/
+static int _donated_page_free(void* page, void* data)
+{
+	(void)data;
+	return mempool_page_dealloc(page);
+}
+
+/**
+ * @brief append the memory donated by the servlet to the output pipe
+ * @param handle the output handle
+ * @param buffer the donated memory
+ * @param size the size of the data
+ * @param free_func the function used to dispose the memory
+ * @param free_data the additional data for the free function
+ * @return the number of bytes has been written, or error code
+ **/
+static inline size_t _write_external(module_handle_t* handle, void* buffer, size_t size, module_mem_free_func_t free_func, void* free_data)
+{
+	if(handle->type != _OUTPUT)
+	    ERROR_RETURN_LOG(size_t, "Invalid type of pipe, cannot donate memory to a input pipe");
+
+	if(size > UINT32_MAX)
+	    ERROR_RETURN_LOG(size_t, "The donated buffer is too large");
+
+	_buffer_page_t* page = __buffer_node_new((char*)buffer, (uint32_t)size);
+	if(NULL == page)
+	    ERROR_RETURN_LOG(size_t, "Cannot create the page header for the donated memory");
+
+	if(ERROR_CODE(int) == __buffer_append(handle, page))
+	{
+		mempool_objpool_dealloc(_node_pool, page);
+		return ERROR_CODE(size_t);
+	}
+
+	/* Only set the free function after the page is appended, so that the caller keeps the ownership on failure */
+	page->free_func = free_func;
+	page->free_data = free_data;
+	mempool_account_charge(_account, size);
+
+	LOG_DEBUG("%zu bytes of donated memory has been appended to the pipe", size);
+
+	return size;
+}
+
+/**
+ * @brief move all the unread data of the input pipe to the output pipe
+ * @param handle the output handle
+ * @param source the input handle
+ * @return the number of bytes has been moved, or error code
+ **/
+static inline size_t _move(module_handle_t* handle, module_handle_t* source)
+{
+	if(handle->type != _OUTPUT || source->type != _INPUT)
+	    ERROR_RETURN_LOG(size_t, "Invalid type of pipe, the data can only be moved from the input pipe to the output pipe");
+
+	size_t ret = 0;
+
+	for(;source->current_page != NULL; source->current_page = source->current_page->next, source->page_offset = 0)
+	{
+		_buffer_page_t* page = source->current_page;
+		uint32_t size = page->size - source->page_offset;
+
+		if(size > 0)
+		{
+			_buffer_page_t* target = NULL != page->target ? page->target : page;
+			_buffer_page_t* ref = __buffer_node_new(page->data + source->page_offset, size);
+			if(NULL == ref)
+			    ERROR_RETURN_LOG(size_t, "Cannot create the reference page");
+
+			if(ERROR_CODE(int) == __buffer_append(handle, ref))
+			{
+				mempool_objpool_dealloc(_node_pool, ref);
+				return ERROR_CODE(size_t);
+			}
+
+			__sync_fetch_and_add(&target->refcnt, 1);
+			ref->target = target;
+
+			source->page_offset += size;
+			ret += size;
+		}
+
+		/* Keep the read pointer at the end of the last page */
+		if(NULL == page->next) break;
+	}
+
+	LOG_DEBUG("%zu bytes has been moved from the input pipe", ret);
+
+	return ret;
+}
+
+static int _cntl(void* __restrict ctx, void* __restrict pipe, uint32_t opcode, va_list va_args)
+{
+	(void) ctx;
+	module_handle_t* handle = (module_handle_t*)pipe;
+	size_t rc;
+
+	switch(opcode)
+	{
+		case MODULE_MEM_CNTL_WRITE_PAGE:
+		{
+			void* page = va_arg(va_args, void*);
+			size_t size = va_arg(va_args, size_t);
+			int* accepted = va_arg(va_args, int*);
+
+			if(NULL == page || NULL == accepted || size > _pagesize)
+			    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+			if(ERROR_CODE(size_t) == (rc = _write_external(handle, page, size, _donated_page_free, NULL)))
+			    ERROR_RETURN_LOG(int, "Cannot append the donated page to the pipe");
+
+			*accepted = 1;
+			break;
+		}
+		case MODULE_MEM_CNTL_WRITE_BUFFER:
+		{
+			void* buffer = va_arg(va_args, void*);
+			size_t size = va_arg(va_args, size_t);
+			module_mem_free_func_t free_func = va_arg(va_args, module_mem_free_func_t);
+			void* free_data = va_arg(va_args, void*);
+			int* accepted = va_arg(va_args, int*);
+
+			if(NULL == buffer || NULL == free_func || NULL == accepted)
+			    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+			if(ERROR_CODE(size_t) == (rc = _write_external(handle, buffer, size, free_func, free_data)))
+			    ERROR_RETURN_LOG(int, "Cannot append the donated buffer to the pipe");
+
+			*accepted = 1;
+			break;
+		}
+		case MODULE_MEM_CNTL_GET_BUFFER:
+		{
+			void** result = va_arg(va_args, void**);
+			if(NULL == result) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+			if(handle->type != _INPUT)
+			    ERROR_RETURN_LOG(int, "Invalid type of pipe, only the input pipe has movable data");
+
+			*result = handle;
+			return 0;
+		}
+		case MODULE_MEM_CNTL_MOVE:
+		{
+			module_handle_t* source = va_arg(va_args, module_handle_t*);
+			size_t* moved = va_arg(va_args, size_t*);
+
+			if(NULL == source || NULL == moved)
+			    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+			if(ERROR_CODE(size_t) == (rc = _move(handle, source)))
+			    ERROR_RETURN_LOG(int, "Cannot move the data from the input pipe");
+
+			*moved = rc;
+			break;
+		}
+		default:
+		    ERROR_RETURN_LOG(int, "Invalid opcode 0x%x", opcode);
+	}
+
+	/* The positive return value tells the pipe layer that the output pipe has been written */
+	return rc > 0;
+}
+
 static int _fork(void* __restrict ctx, void* __restrict dest, void* __restrict src, const void* __restrict args)
 {
 	(void) ctx;
@@ -311,5 +637,6 @@ itc_module_t module_mem_module_def = {
 	.has_unread_data = _has_unread_data,
 	.get_path = _get_path,
 	.get_internal_buf = _get_internal_buf,
-	.release_internal_buf = _release_internal_buf
+	.release_internal_buf = _release_internal_buf,
+	.cntl = _cntl
 };
@@ -563,6 +563,21 @@ static inline int _rscope_stream_ready_event(sched_rscope_stream_t* stream, runt
 	return sched_rscope_stream_get_event(stream, buf);
 }
 
+static inline int _arena_allocate(size_t size, void** resbuf)
+{
+	if(NULL == resbuf)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	sched_rscope_t* current = sched_step_current_scope();
+	if(NULL == current)
+	    ERROR_RETURN_LOG(int, "Cannot get the current scope");
+
+	if(NULL == (*resbuf = sched_rscope_arena_alloc(current, size)))
+	    ERROR_RETURN_LOG(int, "Cannot allocate memory from the request arena");
+
+	return 0;
+}
+
 static int _invoke(void* __restrict ctx, uint32_t opcode, va_list args)
 {
 	(void)ctx;
@@ -690,6 +705,12 @@ static int _invoke(void* __restrict ctx, uint32_t opcode, va_list args)
 			    return ERROR_CODE(int);
 			return 0;
 		}
+		case MODULE_PSSM_MODULE_OPCODE_ARENA_ALLOCATE:
+		{
+			size_t arena_size = va_arg(args, size_t);
+			void** result_buf = va_arg(args, void**);
+			return _arena_allocate(arena_size, result_buf);
+		}
 		default:
 		    ERROR_RETURN_LOG(int, "Invalid opcode 0x%x", opcode);
 	}
@@ -716,6 +737,7 @@ static uint32_t _get_opcode(void* __restrict ctx, const char* name)
 	if(strcmp(name, "scope_stream_eof") == 0) return MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_EOF;
 	if(strcmp(name, "scope_stream_read") == 0) return MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_READ;
 	if(strcmp(name, "scope_stream_ready_event") == 0) return MODULE_PSSM_MODULE_OPCODE_SCOPE_STREAM_READY_EVENT;
+	if(strcmp(name, "arena_allocate") == 0) return MODULE_PSSM_MODULE_OPCODE_ARENA_ALLOCATE;
 
 	ERROR_RETURN_LOG(uint32_t, "Invalid method name %s", name);
 }
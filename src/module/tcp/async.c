@@ -12,6 +12,10 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
 
 #include <barrier.h>
 
@@ -19,12 +23,24 @@
 #include <utils/log.h>
 #include <utils/thread.h>
 #include <utils/static_assertion.h>
+#include <utils/timewheel.h>
 #include <utils/mempool/page.h>
 #include <os/os.h>
 
+#ifdef __LINUX__
+#	include <sys/sendfile.h>
+#endif
+
 #include <itc/module_types.h>
 #include <module/tcp/async.h>
 
+#ifndef IOV_MAX
+/**
+ * @brief the fallback IO vector limit when sysconf can not tell, which is the value used by both Linux and BSD
+ **/
+#	define IOV_MAX 1024
+#endif
+
 
 /**
  * @brief the state of an async object
@@ -41,7 +57,7 @@
  *         2. _ST_WAIT_DATA: The async object is waiting for data source while the connection state is unknown
  *       However, after we allow the data source wait for the external resource gets ready,
  *       we should have the _ST_WAIT_DATA state can have a timeout as well. Thus we need to
- *       make it in the heap. So we combined two state into a new state called _ST_WAIT, which
+ *       make it in the timing wheel. So we combined two state into a new state called _ST_WAIT, which
  *       includes the both case.
  *       In the async handle there's one additional field to distinguish those types of waiting. wait_conn
  *
@@ -67,9 +83,8 @@ typedef enum {
 	_ST_FINISHED,  /*!< the async object is finished */
 	_NUM_OF_STATES /*!< the number of states */
 } _async_obj_state_t;
-/* We assume that _ST_WAIT_CONN is the first state in the st_list, because it should maintain a
- * binary heap on that, and we basically want to make sure all the data moves into this section
- * is the final destination. */
+/* We assume that _ST_WAIT_CONN is the first state in the st_list, because we basically want to make
+ * sure all the data moves into this section is the final destination. */
 STATIC_ASSERTION_EQ(_ST_WAIT, 0);
 
 /**
@@ -104,6 +119,7 @@ typedef struct {
 	int                                        async_magic;   /*!< The magic number, which should be 0 */
 	uint32_t                                   rdy_posted:1;  /*!< if the queue ready message is posted and in pending state */
 	uint32_t                                   wait_conn:1;   /*!< Indicates this connection is waiting for scoket but the data source is ready */
+	uint32_t                                   corked:1;      /*!< Indicates the socket is still corked */
 	uint32_t                                   index;         /*!< the index in the async state list */
 	time_t                                     kickout_ts;    /*!< The timestamp that the async object should be kicked out */
 	int                                        fd;            /*!< the coresponding fd */
@@ -161,12 +177,14 @@ struct _module_tcp_async_loop_t {
 	uint32_t     i_q_mutex:1;  /*!< if the q_mutex has been  initialized */
 	uint32_t     i_s_mutex:1;  /*!< if the s_mutex has been initialized */
 	uint32_t     i_s_cond:1;   /*!< if the s_cond has been initialized */
+	uint32_t     no_sendfile:1;/*!< if the sendfile system call is not supported for the sockets */
 
 	/* Data related fields */
 	uint32_t     capacity;     /*!< the max size of this async loop */
 	_async_obj_t* objects;     /*!< the object list, which is addressed by the conn_id */
 	uint32_t*    st_list;      /*!< the state list, which organize the conn_id in to group in which async object has same state */
 	uint32_t     limits[_NUM_OF_STATES]; /*!< the array manipuates the end indices of each state */
+	timewheel_t* timer;        /*!< the timing wheel for the async objects in the wait state, which is keyed by the conn_id */
 
 	/* File descriptors */
 	os_event_poll_t* poll;      /*!< The poll object */
@@ -191,6 +209,18 @@ struct _module_tcp_async_loop_t {
 	/* connection options */
 	time_t          ttl;       /*!< the maximum time for a connection be busy state */
 	time_t          data_ttl;  /*!< The maximum time for a data source in the wait state */
+	int             cork;      /*!< If the sockets are corked before the async write begins */
+
+	/* Gathered write */
+	module_tcp_async_write_iov_func_t     get_iov;  /*!< the callback exposes the pending buffers, NULL if the gathered write is disabled */
+	module_tcp_async_write_consume_func_t consume;  /*!< the callback consumes the written bytes */
+	struct iovec*   iov;       /*!< the IO vector buffer */
+	int             iov_max;   /*!< the capacity of the IO vector buffer */
+	module_tcp_async_write_file_func_t    get_file; /*!< the callback exposes the pending file range, NULL if sendfile is disabled */
+
+	/* Statistics, only modified by the loop thread */
+	module_tcp_async_loop_stat_t stat;  /*!< the statistics of this loop */
+
 	/* mocked system calls */
 	ssize_t (*write)(int fd, const void* ptr, size_t sz);  /*!< the mocked write system call, only used for testing purpose */
 };
@@ -275,40 +305,6 @@ static inline uint32_t _async_obj_state_end(const module_tcp_async_loop_t* loop,
 {
 	return loop->limits[st];
 }
-/**
- * @brief heapify: downward adjustment on a wait connection list
- * @param loop the async loop
- * @param idx the index of the target node
- * @return nothing
- **/
-static inline void _async_wait_conn_heapify(module_tcp_async_loop_t* loop, uint32_t idx)
-{
-	for(;idx < loop->limits[_ST_WAIT];)
-	{
-		uint32_t m_idx = idx;
-		if(idx * 2 + 1 < loop->limits[_ST_WAIT] &&
-		   loop->objects[loop->st_list[idx * 2 + 1]].kickout_ts < loop->objects[loop->st_list[m_idx]].kickout_ts)
-		    m_idx = idx * 2 + 1;
-		if(idx * 2 + 2 < loop->limits[_ST_WAIT] &&
-		   loop->objects[loop->st_list[idx * 2 + 2]].kickout_ts < loop->objects[loop->st_list[m_idx]].kickout_ts)
-		    m_idx = idx * 2 + 2;
-		if(m_idx == idx) return;
-		_swap(loop, m_idx, idx);
-		idx = m_idx;
-	}
-}
-/**
- * @brief decrease: upward adjustment on a wait connection list
- * @param loop the async loop
- * @param idx the index of the target node
- * @return nothing
- **/
-static inline void _async_wait_conn_decrease(module_tcp_async_loop_t* loop, uint32_t idx)
-{
-	for(;idx > 0 && loop->objects[loop->st_list[(idx - 1)/2]].kickout_ts > loop->objects[loop->st_list[idx]].kickout_ts; idx = (idx - 1) / 2)
-	    _swap(loop, idx, (idx - 1) / 2);
-}
-
 /**
  * @brief set the state of the async object
  * @param loop the async loop
@@ -355,20 +351,17 @@ static inline int  _async_obj_set_state(module_tcp_async_loop_t* loop, _async_ob
 			else
 			    async->kickout_ts = time(NULL) + (async->data_event.timeout > loop->data_ttl ? loop->data_ttl : async->data_event.timeout);
 
-			/* if this connection is being adding to the wait state, maintain the heap property */
-			_async_wait_conn_decrease(loop, async->index);
+			if(ERROR_CODE(int) == timewheel_arm(loop->timer, _async_obj_conn_id(loop, async), async->kickout_ts))
+			    ERROR_RETURN_LOG(int, "Cannot arm the timer for connection %"PRIu32, _async_obj_conn_id(loop, async));
 		}
 	}
 	else
 	{
 		if(cur_st == _ST_WAIT)
 		{
-			/* if this connection is in wait connection state, remove it from the heap */
-			uint32_t cur_idx = async->index;
-			_swap(loop, cur_idx, loop->limits[_ST_WAIT] - 1);
-			loop->limits[_ST_WAIT] --;
-			_async_wait_conn_heapify(loop, cur_idx);
-			cur_st ++;
+			/* if this connection is in wait connection state, stop its timer */
+			if(ERROR_CODE(int) == timewheel_cancel(loop->timer, _async_obj_conn_id(loop, async)))
+			    ERROR_RETURN_LOG(int, "Cannot cancel the timer for connection %"PRIu32, _async_obj_conn_id(loop, async));
 		}
 		/* move backward */
 		for(; cur_st < state; cur_st ++)
@@ -404,6 +397,226 @@ static inline _async_obj_t* _async_obj_get_from_index(module_tcp_async_loop_t* l
 
 	return ret;
 }
+/**
+ * @brief remove the cork of the socket, so that the pending partial frame is sent right away
+ * @param loop the async loop
+ * @param obj the async object
+ * @return nothing
+ **/
+static inline void _uncork(module_tcp_async_loop_t* loop, _async_obj_t* obj)
+{
+	if(!obj->corked) return;
+
+	obj->corked = 0;
+#ifdef TCP_CORK
+	/* The mocked write function doesn't use a real socket */
+	if(NULL != loop->write) return;
+
+	int val = 0;
+	loop->stat.write_calls ++;
+	if(setsockopt(obj->fd, IPPROTO_TCP, TCP_CORK, &val, sizeof(val)) < 0)
+	    LOG_WARNING_ERRNO("Cannot remove the cork of connection object %"PRIu32, _async_obj_conn_id(loop, obj));
+#else
+	(void)loop;
+#endif
+}
+
+/**
+ * @brief get the next state after a failed write
+ * @param loop the async loop
+ * @param obj the async object
+ * @return the new state for this object
+ **/
+static inline _async_obj_state_t _write_failed(module_tcp_async_loop_t* loop, _async_obj_t* obj)
+{
+	if(errno == EWOULDBLOCK || errno == EAGAIN)
+	{
+		LOG_DEBUG("connection object %"PRIu32" is busy, "
+		          "update the state to WAIT_FOR_CONNECTION",
+		          _async_obj_conn_id(loop, obj));
+
+		obj->wait_conn = 1;
+		return _ST_WAIT;
+	}
+
+	LOG_ERROR_ERRNO("connection object %"PRIu32" has a write failure, "
+	                "update the state to ERROR",
+	                _async_obj_conn_id(loop, obj));
+	return _ST_RAISING;
+}
+
+/**
+ * @brief write the IO vector to the socket
+ * @note if the write function is mocked, the buffers are written with the mocked function one by one
+ * @param loop the async loop
+ * @param fd the socket FD
+ * @param iov the IO vector
+ * @param iovcnt the number of entries in the IO vector
+ * @return the number of bytes has been written, -1 on error
+ **/
+static inline ssize_t _writev(module_tcp_async_loop_t* loop, int fd, const struct iovec* iov, int iovcnt)
+{
+	loop->stat.write_calls ++;
+
+	if(NULL == loop->write) return writev(fd, iov, iovcnt);
+
+	ssize_t ret = 0;
+	int i;
+	for(i = 0; i < iovcnt; i ++)
+	{
+		ssize_t rc = loop->write(fd, iov[i].iov_base, iov[i].iov_len);
+		if(rc <= 0) return ret > 0 ? ret : rc;
+		ret += rc;
+		if((size_t)rc < iov[i].iov_len) break;
+	}
+
+	return ret;
+}
+
+/**
+ * @brief gather the pending buffers and write them with a single writev call
+ * @details the unwritten bytes in the IO buffer goes first, since they are read from the data source before
+ *          the buffers exposed by the iov callback
+ * @param loop the async loop
+ * @param obj the async object
+ * @param result the new state for the object
+ * @return 1 if the gathered write has been performed, 0 if there's no buffer to gather
+ **/
+static inline int _gathered_io_ops(module_tcp_async_loop_t* loop, _async_obj_t* obj, _async_obj_state_t* result)
+{
+	uint32_t conn_id = _async_obj_conn_id(loop, obj);
+	int iovcnt = 0;
+	size_t buffered = obj->b_end - obj->b_begin;
+
+	if(buffered > 0)
+	{
+		loop->iov[0].iov_base = obj->io_buffer + obj->b_begin;
+		loop->iov[0].iov_len  = buffered;
+		iovcnt = 1;
+	}
+
+	int rc = loop->get_iov(conn_id, loop->iov + iovcnt, loop->iov_max - iovcnt, loop);
+	if(ERROR_CODE(int) == rc)
+	{
+		LOG_ERROR("the iov function returns an error code, "
+		          "set the async object %"PRIu32" state to ERROR", conn_id);
+		*result = _ST_RAISING;
+		return 1;
+	}
+
+	/* If the data source callback is the next, the IO buffer should be flushed first, because the data source
+	 * may be a file range which is sent without the IO buffer */
+	if(rc == 0 && (buffered == 0 || NULL == loop->get_file)) return 0;
+
+	ssize_t written = _writev(loop, obj->fd, loop->iov, iovcnt + rc);
+
+	if(-1 == written || written == 0)
+	{
+		*result = _write_failed(loop, obj);
+		return 1;
+	}
+
+	LOG_DEBUG("%zd bytes in %d buffers has been written to the connection object %"PRIu32, written, iovcnt + rc, conn_id);
+
+	size_t bytes = (size_t)written;
+	if(bytes >= buffered)
+	{
+		obj->b_begin = obj->b_end;
+		bytes -= buffered;
+	}
+	else
+	{
+		obj->b_begin += bytes;
+		bytes = 0;
+	}
+
+	if(bytes > 0 && ERROR_CODE(int) == loop->consume(conn_id, bytes, loop))
+	{
+		LOG_ERROR("the consume function returns an error code, "
+		          "set the async object %"PRIu32" state to ERROR", conn_id);
+		*result = _ST_RAISING;
+		return 1;
+	}
+
+	*result = _ST_READY;
+	return 1;
+}
+
+/**
+ * @brief send the pending file range with the sendfile system call
+ * @param loop the async loop
+ * @param obj the async object
+ * @param result the new state for the object
+ * @return 1 if the sendfile has been performed, 0 if there's no file range to send
+ **/
+static inline int _sendfile_io_ops(module_tcp_async_loop_t* loop, _async_obj_t* obj, _async_obj_state_t* result)
+{
+#ifdef __LINUX__
+	/* The mocked write function doesn't use a real socket */
+	if(NULL != loop->write || loop->no_sendfile) return 0;
+
+	uint32_t conn_id = _async_obj_conn_id(loop, obj);
+	int fd;
+	off_t offset;
+	size_t size;
+
+	int rc = loop->get_file(conn_id, &fd, &offset, &size, loop);
+	if(ERROR_CODE(int) == rc)
+	{
+		LOG_ERROR("the file function returns an error code, "
+		          "set the async object %"PRIu32" state to ERROR", conn_id);
+		*result = _ST_RAISING;
+		return 1;
+	}
+
+	if(rc == 0 || size == 0) return 0;
+
+	loop->stat.write_calls ++;
+	ssize_t written = sendfile(obj->fd, fd, &offset, size);
+
+	if(-1 == written && (errno == EINVAL || errno == ENOSYS))
+	{
+		LOG_NOTICE_ERRNO("The sendfile system call is not supported, falling back to the data source callback");
+		loop->no_sendfile = 1;
+		return 0;
+	}
+
+	if(-1 == written)
+	{
+		*result = _write_failed(loop, obj);
+		return 1;
+	}
+
+	if(0 == written)
+	{
+		LOG_ERROR("The file is shorter than the pending range, "
+		          "set the async object %"PRIu32" state to ERROR", conn_id);
+		*result = _ST_RAISING;
+		return 1;
+	}
+
+	LOG_DEBUG("%zd bytes has been sent from the file to the connection object %"PRIu32, written, conn_id);
+
+	loop->stat.sendfile_bytes += (uint64_t)written;
+
+	if(ERROR_CODE(int) == loop->consume(conn_id, (size_t)written, loop))
+	{
+		LOG_ERROR("the consume function returns an error code, "
+		          "set the async object %"PRIu32" state to ERROR", conn_id);
+		*result = _ST_RAISING;
+		return 1;
+	}
+
+	*result = _ST_READY;
+	return 1;
+#else
+	(void)loop;
+	(void)obj;
+	(void)result;
+	return 0;
+#endif
+}
+
 /**
  * @brief performe the IO operations
  * @param loop the async loop
@@ -414,6 +627,13 @@ static inline _async_obj_state_t _io_ops(module_tcp_async_loop_t* loop, _async_o
 {
 	if(obj->b_end == obj->b_begin) obj->b_begin = obj->b_end = 0;
 
+	_async_obj_state_t gathered_state;
+	if(NULL != loop->get_iov && _gathered_io_ops(loop, obj, &gathered_state))
+	    return gathered_state;
+
+	if(NULL != loop->get_file && obj->b_end == obj->b_begin && _sendfile_io_ops(loop, obj, &gathered_state))
+	    return gathered_state;
+
 	/* before we perform the actual data operation, we want to maximize the number of bytes passed to the system call */
 	if(obj->b_end < obj->b_size)
 	{
@@ -445,6 +665,8 @@ L_WAIT_DATA:
 			          "updating the state of async object to WAIT_FOR_DATA",
 			          _async_obj_conn_id(loop, obj));
 			obj->wait_conn = 0;
+			/* Do not hold the written bytes while we are waiting for the slow data source */
+			_uncork(loop, obj);
 			return _ST_WAIT;
 		}
 		else
@@ -469,29 +691,13 @@ L_WAIT_DATA:
 	}
 
 	/* call the system call */
+	loop->stat.write_calls ++;
 	ssize_t rc = loop->write == NULL ?
 	             write(obj->fd, obj->io_buffer + obj->b_begin, obj->b_end - obj->b_begin):
 	             loop->write(obj->fd, obj->io_buffer + obj->b_begin, obj->b_end - obj->b_begin);
 
 	if(-1 == rc || rc == 0)
-	{
-		if(errno == EWOULDBLOCK || errno == EAGAIN)
-		{
-			LOG_DEBUG("connection object %"PRIu32" is busy, "
-			          "update the state to WAIT_FOR_CONNECTION",
-			          _async_obj_conn_id(loop, obj));
-
-			obj->wait_conn = 1;
-			return _ST_WAIT;
-		}
-		else
-		{
-			LOG_ERROR_ERRNO("connection object %"PRIu32" has a write failure, "
-			                "update the state to ERROR",
-			                _async_obj_conn_id(loop, obj));
-			return _ST_RAISING;
-		}
-	}
+	    return _write_failed(loop, obj);
 	else
 	{
 		LOG_DEBUG("%zd bytes has been written to the connection object %"PRIu32, rc, _async_obj_conn_id(loop, obj));
@@ -674,6 +880,10 @@ static inline int _process_async_objs(module_tcp_async_loop_t* loop)
 
 		LOG_DEBUG("handling the async object in finished state for connection object %"PRIu32, conn_id);
 
+		/* The socket will be reused by the next request, so flush the last partial frame before we release it */
+		_uncork(loop, this);
+		loop->stat.finished ++;
+
 		//free(this->io_buffer);
 		if(ERROR_CODE(int) == mempool_page_dealloc(this->io_buffer))
 		    LOG_ERROR("Cannot deallocte the io buffer page");
@@ -793,6 +1003,7 @@ static inline int _process_queue_message(module_tcp_async_loop_t* loop)
 			async->data_event_magic = 1;
 
 			async->b_begin = async->b_end = 0;
+			async->corked = (loop->cork != 0);
 			/* We initialize the rdy_posted flag when the message is posted, no need to reinitialize at this point */
 
 			async->index = loop->limits[_NUM_OF_STATES - 1]++;
@@ -815,6 +1026,46 @@ static inline int _process_queue_message(module_tcp_async_loop_t* loop)
  * @todo how to kill the async loop properly
  * @return status cdoe
  **/
+/**
+ * @brief the callback used by the timing wheel, which handles the async object that has been waiting for too long
+ * @param conn_id the connection object id
+ * @param data the async loop
+ * @return status code
+ **/
+static int _async_obj_expire(uint32_t conn_id, void* data)
+{
+	module_tcp_async_loop_t* loop = (module_tcp_async_loop_t*)data;
+	_async_obj_t* async = loop->objects + conn_id;
+
+	if(async->wait_conn)
+	{
+		if(_async_obj_set_state(loop, async, _ST_RAISING) == ERROR_CODE(int))
+		    ERROR_RETURN_LOG(int, "Cannot set the timed out connection %"PRIu32" to %s state", conn_id, _async_obj_state_str[_ST_RAISING]);
+
+		if(_async_obj_del_poll(loop, async) == ERROR_CODE(int))
+		    ERROR_RETURN_LOG(int, "Cannot remove the async object from poll");
+	}
+	else if(async->data_end)
+	{
+		if(_async_obj_set_state(loop, async, _ST_RAISING) == ERROR_CODE(int))
+		    ERROR_RETURN_LOG(int, "Cannot set the timed out data source %"PRIu32" to %s state", conn_id, _async_obj_state_str[_ST_RAISING]);
+	}
+	else
+	{
+		/* Because if the async data source is still active, its possible that the timeout is
+		 * caused by the data source is working on other staff. In this case, we could wait
+		 * for it until the data source becomes inactive */
+		async->kickout_ts = time(NULL) + (async->data_event.timeout > loop->data_ttl ? loop->data_ttl : async->data_event.timeout);
+
+		if(ERROR_CODE(int) == timewheel_arm(loop->timer, conn_id, async->kickout_ts))
+		    ERROR_RETURN_LOG(int, "Cannot re-arm the timer for connection %"PRIu32, conn_id);
+	}
+
+	LOG_DEBUG("Timed out connection %"PRIu32" has been kicked out", conn_id);
+
+	return 0;
+}
+
 static inline int _handle_event(module_tcp_async_loop_t* loop)
 {
 	time_t now = time(NULL);
@@ -828,7 +1079,9 @@ static inline int _handle_event(module_tcp_async_loop_t* loop)
 	{
 		/* In this case, even though we do not have any connection becomes ready
 		 * the thread needs to wake up and kick out the timed out connections */
-		time_t min_ts = loop->objects[loop->st_list[0]].kickout_ts;
+		time_t min_ts;
+		if(timewheel_next_expire(loop->timer, &min_ts) != 1)
+		    ERROR_RETURN_LOG(int, "Cannot get the next timeout of the waiting async objects");
 		if(min_ts > now)
 		    timeout = ((int)(min_ts - now)) * 1000;
 		else
@@ -902,47 +1155,8 @@ static inline int _handle_event(module_tcp_async_loop_t* loop)
 	}
 
 	/* Kick out all the timed out connections, and put them to raising state */
-	for(;loop->limits[_ST_WAIT] > 0 && loop->objects[loop->st_list[0]].kickout_ts <= now;)
-	{
-		_async_obj_t* async = _async_obj_get_from_index(loop, 0);
-
-		if(async->wait_conn)
-		{
-			if(_async_obj_set_state(loop, async, _ST_RAISING) == ERROR_CODE(int))
-			{
-				LOG_WARNING("Cannot set the timed out connection %"PRIu32" to %s state",
-				            _async_obj_conn_id(loop, async),
-				            _async_obj_state_str[_ST_RAISING]);
-				continue;
-			}
-
-			if(_async_obj_del_poll(loop, async) == ERROR_CODE(int))
-			{
-				LOG_WARNING("Cannot remove the async object from poll");
-				continue;
-			}
-		}
-		else if(async->data_end)
-		{
-			if(_async_obj_set_state(loop, async, _ST_RAISING) == ERROR_CODE(int))
-			{
-				LOG_WARNING("Cannot set the timed out data source %"PRIu32" to %s state",
-				             _async_obj_conn_id(loop, async),
-				             _async_obj_state_str[_ST_RAISING]);
-				continue;
-			}
-		}
-		else
-		{
-			/* Because if the async data source is still active, its possible that the timeout is
-			 * caused by the data source is working on other staff. In this case, we could wait
-			 * for it until the data source becomes inactive */
-			async->kickout_ts = time(NULL) + (async->data_event.timeout > loop->data_ttl ? loop->data_ttl : async->data_event.timeout);
-
-			_async_wait_conn_heapify(loop, async->index);
-		}
-		LOG_DEBUG("Timed out connection %"PRIu32" has been kicked out", _async_obj_conn_id(loop, async));
-	}
+	if(ERROR_CODE(int) == timewheel_advance(loop->timer, now, _async_obj_expire, loop))
+	    LOG_WARNING("Cannot kick out the timed out connections");
 
 	/* Process all the async objects */
 	if(_process_async_objs(loop) == ERROR_CODE(int))
@@ -996,6 +1210,9 @@ module_tcp_async_loop_t* module_tcp_async_loop_new(uint32_t pool_size, uint32_t
 	if(NULL == (ret->st_list = (uint32_t*)malloc(sizeof(uint32_t) * ret->capacity)))
 	    ERROR_LOG_ERRNO_GOTO(ERR, "cannot allocate memory for the state list");
 
+	if(NULL == (ret->timer = timewheel_new(ret->capacity, time(NULL))))
+	    ERROR_LOG_GOTO(ERR, "cannot create the timing wheel for the wait state");
+
 	tmp = pool_size * _NUM_CONN_MSG_TYPS + 1;
 	size = 1;
 	for(;tmp > 1; tmp >>= 1,size <<= 1);
@@ -1051,6 +1268,7 @@ ERR:
 	{
 		if(ret->objects != NULL) free(ret->objects);
 		if(ret->st_list != NULL) free(ret->st_list);
+		if(ret->timer != NULL) timewheel_free(ret->timer);
 		if(ret->queue != NULL) free(ret->queue);
 		if(ret->poll != NULL) os_event_poll_free(ret->poll);
 		if(ret->event_fd > 0) close(ret->event_fd);
@@ -1155,6 +1373,59 @@ int module_tcp_async_write_register(module_tcp_async_loop_t* loop,
 	return _post_message(loop, _MT_CREATE, conn_id);
 }
 
+int module_tcp_async_loop_set_gather(module_tcp_async_loop_t* loop, module_tcp_async_write_iov_func_t get_iov, module_tcp_async_write_consume_func_t consume)
+{
+	if(NULL == loop || (NULL == get_iov) != (NULL == consume))
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if(NULL != get_iov && NULL == loop->iov)
+	{
+		long iov_max = sysconf(_SC_IOV_MAX);
+		if(iov_max <= 0) iov_max = IOV_MAX;
+		/* We need at least one more entry besides the IO buffer */
+		if(iov_max < 2) ERROR_RETURN_LOG(int, "The system doesn't allow gathered write");
+
+		if(NULL == (loop->iov = (struct iovec*)malloc(sizeof(struct iovec) * (size_t)iov_max)))
+		    ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the IO vector");
+
+		loop->iov_max = (int)iov_max;
+	}
+
+	loop->get_iov = get_iov;
+	loop->consume = consume;
+
+	return 0;
+}
+
+int module_tcp_async_loop_set_sendfile(module_tcp_async_loop_t* loop, module_tcp_async_write_file_func_t get_file)
+{
+	if(NULL == loop || (NULL != get_file && NULL == loop->consume))
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	loop->get_file = get_file;
+
+	return 0;
+}
+
+int module_tcp_async_loop_set_cork(module_tcp_async_loop_t* loop, int cork)
+{
+	if(NULL == loop) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	loop->cork = cork;
+
+	return 0;
+}
+
+int module_tcp_async_loop_get_stat(const module_tcp_async_loop_t* loop, module_tcp_async_loop_stat_t* buf)
+{
+	if(NULL == loop || NULL == buf) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	*buf = loop->stat;
+	buf->backend = os_event_poll_get_backend(loop->poll);
+
+	return 0;
+}
+
 int module_tcp_async_write_data_ends(module_tcp_async_loop_t* loop, uint32_t conn_id)
 {
 	if(NULL == loop || conn_id >= loop->capacity)
@@ -1222,7 +1493,10 @@ int module_tcp_async_loop_free(module_tcp_async_loop_t* loop)
 
 	if(NULL != loop->objects) free(loop->objects);
 	if(NULL != loop->st_list) free(loop->st_list);
+	if(NULL != loop->timer && ERROR_CODE(int) == timewheel_free(loop->timer))
+	    rc = ERROR_CODE(int);
 	if(NULL != loop->queue) free(loop->queue);
+	if(NULL != loop->iov) free(loop->iov);
 	if(NULL != loop->poll && ERROR_CODE(int) == os_event_poll_free(loop->poll))
 	    rc = ERROR_CODE(int);
 
@@ -13,6 +13,10 @@
 #include <inttypes.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 
 #include <barrier.h>
 #include <error.h>
@@ -25,6 +29,8 @@
 #include <itc/module_types.h>
 #include <itc/module.h>
 #include <itc/modtab.h>
+#include <itc/equeue.h>
+#include <itc/eloop.h>
 
 #include <module/tcp/module.h>
 #include <module/tcp/pool.h>
@@ -59,6 +65,7 @@ typedef struct {
 	void*                           user_space_data;        /*!< the user space data attached to this connection pool object */
 	uint32_t                        buffer_exposed:1;       /*!< Indicates if we have a buffer exposed */
 	uint32_t                        user_state_pending:1;   /*!< indicates if we have user space data pending to push */
+	uint32_t                        corked:1;               /*!< indicates if the socket is corked by the current response */
 	itc_module_state_dispose_func_t disp;                   /*!< the dispose function for the case the connection object must be killed */
 	uintpad_t __padding__[0];
 	char                            buffer[0];              /*!< the read buffer */
@@ -66,6 +73,14 @@ typedef struct {
 STATIC_ASSERTION_SIZE(_state_t, buffer, 0);
 STATIC_ASSERTION_LAST(_state_t, buffer);
 
+/**
+ * @brief the data source held by a data source page
+ **/
+typedef struct {
+	itc_module_data_source_t      data_source;  /*!< the data source */
+	runtime_api_scope_fd_range_t  range;        /*!< the file range taken from the data source, range.fd &lt; 0 if the data source is not a file range */
+} _async_source_t;
+
 /**
  * @brief the internal async write data buffer page
  **/
@@ -77,7 +92,7 @@ typedef struct _async_buf_page_t {
 	};
 	union {
 		char                      data[0];          /*!< the actual buffer */
-		itc_module_data_source_t  data_source[0];   /*!< the data source buffer, valid only if callback == (uintn32_t)~0u */
+		_async_source_t           source[0];        /*!< the data source buffer, valid only if callback == (uintn32_t)~0u */
 	};
 } __attribute__((packed)) _async_buf_page_t;
 STATIC_ASSERTION_LAST(_async_buf_page_t, data);
@@ -99,6 +114,11 @@ typedef struct {
 	int                release_mode;   /*!< the release mode */
 	_state_t*          release_data;   /*!< the data to release */
 	int                error;          /*!< if the handle is in an error state */
+	int                throttled;      /*!< if the queued bytes went beyond the high watermark and haven't dropped to the low watermark yet,
+	                                    *   the data sources written to the connection are only read by the async loop */
+	size_t             queued;         /*!< the number of bytes copied to the data pages which haven't been written to the socket */
+	size_t             high_watermark; /*!< the high watermark of the queued bytes, 0 means no limit */
+	size_t             low_watermark;  /*!< the low watermark of the queued bytes */
 	pthread_mutex_t*   mutex;          /*!< the async mutex used by this async handle */
 } _async_handle_t;
 
@@ -127,7 +147,7 @@ __thread struct {
 /**
  * @brief the context for a TCP module context
  **/
-typedef struct {
+typedef struct _module_context_t {
 	module_tcp_pool_configure_t pool_conf;            /*!< the TCP pool configuration */
 	int                         retry_interval;       /*!< When the TCP pool cannot be configured, how much time we want to sleep before retry */
 	int                         pool_initialized;     /*!< indicates if the pool has been initialized */
@@ -135,8 +155,19 @@ typedef struct {
 	int                         slave_mode;           /*!< The slave working mode, which means the module should not start the event loop */
 	int                         fork_id;              /*!< The id used to identify the TCP module instance that listen to the same port */
 	uint32_t                    async_buf_size;       /*!< The size of the async write buffer */
+	size_t                      mem_high_watermark;   /*!< The high watermark of the memory account, 0 means no limit */
+	size_t                      mem_low_watermark;    /*!< The low watermark of the memory account */
+	size_t                      async_high_watermark; /*!< The high watermark of the bytes queued for async write on each connection, 0 means no limit */
+	size_t                      async_low_watermark;  /*!< The low watermark of the bytes queued for async write on each connection */
+	size_t                      async_total_high_watermark; /*!< The high watermark of the bytes queued for async write on all the connections, 0 means no limit */
+	size_t                      async_total_low_watermark;  /*!< The low watermark of the bytes queued for async write on all the connections */
+	int                         cork;                 /*!< If we cork the socket during a response, so that the small writes are merged into full frames */
+	int                         sendfile;             /*!< If we send the file range of the data source with the sendfile system call */
+	uint64_t                    write_calls;          /*!< The number of write system calls made by the worker threads */
+	uint64_t                    responses;            /*!< The number of responses has been written */
 	module_tcp_pool_t*          conn_pool;            /*!< The TCP connection pool object */
 	module_tcp_async_loop_t*    async_loop;           /*!< The async loop for this TCP module instance */
+	const struct _module_context_t* master;           /*!< The master module context, NULL if this is the master */
 } _module_context_t;
 
 /**
@@ -150,9 +181,32 @@ static mempool_objpool_t* _async_handle_pool = NULL;
 /** @brief the memory pool used to allocate the async page object which represents a data source object */
 static mempool_objpool_t* _async_data_source_pool = NULL;
 
+/** @brief the memory account for the connection states and the async write buffers of all the instances */
+static mempool_account_t* _account = NULL;
+
+/**
+ * @brief the instance which configures the watermarks of the memory account
+ * @note the account is shared by all the instances, because the pages and the async object pools it counts are shared,
+ *       so the other instances are only allowed to set the same watermarks
+ **/
+static const _module_context_t* _account_owner = NULL;
+
 /** @brief the counter indicates how many instances is initialized */
 static uint32_t _instance_count = 0;
 
+/**
+ * @brief the bytes queued for async write by all the instances, the pools stop accepting new connections and the
+ *        data sources are no longer read by the worker threads while it's over the high watermark
+ * @note like the memory account, the watermarks are shared by all the instances, so the last configured one wins
+ **/
+static struct {
+	size_t   bytes;           /*!< the number of bytes queued */
+	size_t   high_watermark;  /*!< the high watermark, 0 means no limit */
+	size_t   low_watermark;   /*!< the low watermark */
+	uint32_t throttled;       /*!< the number of connections which are over the per-connection high watermark */
+	int      over;            /*!< if the queued bytes are over the high watermark and haven't dropped to the low watermark yet */
+} _async_queue;
+
 /**
  * @brief dispose a user defined state
  * @param state the state data
@@ -181,7 +235,7 @@ static int _dispose_state(void* data)
 	_state_t* state = (_state_t*)data;
 	int rc = _dispose_user_state(state);
 	//free(data);
-	if(ERROR_CODE(int) == mempool_page_dealloc(data))
+	if(ERROR_CODE(int) == mempool_page_dealloc_account(_account, data))
 	    rc = ERROR_CODE(int);
 	return rc;
 }
@@ -193,7 +247,7 @@ static int _dispose_state(void* data)
  **/
 static inline _async_buf_page_t* _async_buf_data_page_new(void)
 {
-	_async_buf_page_t* ret = (_async_buf_page_t*)mempool_page_alloc();
+	_async_buf_page_t* ret = (_async_buf_page_t*)mempool_page_alloc_account(_account);
 	if(NULL == ret)
 	    ERROR_PTR_RETURN_LOG("Cannot allocate memory for new async write page");
 	ret->next = NULL;
@@ -204,9 +258,10 @@ static inline _async_buf_page_t* _async_buf_data_page_new(void)
 /**
  * @brief create a new data source page for the given data source
  * @param data_source the data source we need to create the page for
+ * @param range the file range taken from the data source, range.fd &lt; 0 if there's no file range
  * @return the newly created page, NULL on error
  **/
-static inline _async_buf_page_t* _async_buf_data_source_page_new(const itc_module_data_source_t data_source)
+static inline _async_buf_page_t* _async_buf_data_source_page_new(const itc_module_data_source_t data_source, const runtime_api_scope_fd_range_t range)
 {
 	_async_buf_page_t* ret = (_async_buf_page_t*)mempool_objpool_alloc(_async_data_source_pool);
 	if(NULL == ret)
@@ -214,11 +269,78 @@ static inline _async_buf_page_t* _async_buf_data_source_page_new(const itc_modul
 
 	ret->next = NULL;
 	ret->callback = _DATA_SOURCE_CALLBACK;
-	*ret->data_source = data_source;
+	ret->source->data_source = data_source;
+	ret->source->range = range;
 
 	return ret;
 }
 
+/**
+ * @brief count the bytes copied to the data pages of the async handle
+ * @param handle the async handle
+ * @param nbytes the number of bytes
+ * @note the caller should hold the async handle mutex
+ * @return nothing
+ **/
+static inline void _async_queue_charge(_async_handle_t* handle, size_t nbytes)
+{
+	handle->queued += nbytes;
+	size_t total = __sync_add_and_fetch(&_async_queue.bytes, nbytes);
+
+	if(handle->high_watermark > 0 && !handle->throttled && handle->queued >= handle->high_watermark)
+	{
+		handle->throttled = 1;
+		__sync_fetch_and_add(&_async_queue.throttled, 1);
+	}
+
+	if(_async_queue.high_watermark > 0 && total >= _async_queue.high_watermark && __sync_bool_compare_and_swap(&_async_queue.over, 0, 1))
+	    LOG_NOTICE("%zu bytes are queued for async write, stop reading the data sources on the worker threads", total);
+}
+
+/**
+ * @brief count the bytes which has been written to the socket or discarded
+ * @param handle the async handle
+ * @param nbytes the number of bytes
+ * @note the caller should hold the async handle mutex
+ * @return nothing
+ **/
+static inline void _async_queue_uncharge(_async_handle_t* handle, size_t nbytes)
+{
+	handle->queued -= nbytes;
+	size_t total = __sync_sub_and_fetch(&_async_queue.bytes, nbytes);
+
+	if(handle->throttled && handle->queued <= handle->low_watermark)
+	{
+		handle->throttled = 0;
+		__sync_fetch_and_sub(&_async_queue.throttled, 1);
+	}
+
+	if(total <= _async_queue.low_watermark && __sync_bool_compare_and_swap(&_async_queue.over, 1, 0))
+	    LOG_NOTICE("The bytes queued for async write dropped to %zu, back to normal", total);
+}
+
+/**
+ * @brief the backpressure callback of the connection pool
+ * @return if the bytes queued for async write are over limit
+ **/
+static int _async_queue_over(void)
+{
+	return _async_queue.over;
+}
+
+/**
+ * @brief apply the watermarks of the bytes queued by all the instances
+ * @param context the module context
+ * @return nothing
+ **/
+static inline void _async_queue_set_watermark(const _module_context_t* context)
+{
+	_async_queue.high_watermark = context->async_total_high_watermark;
+	_async_queue.low_watermark = context->async_total_low_watermark;
+	if(_async_queue.low_watermark == 0 || _async_queue.low_watermark > _async_queue.high_watermark)
+	    _async_queue.low_watermark = _async_queue.high_watermark;
+}
+
 /**
  * @brief create a new async handle
  * @return the newly created async handle, NULL on error case
@@ -236,6 +358,12 @@ static inline _async_handle_t* _async_handle_new(_module_context_t* ctx)
 	ret->mutex = &_async_mutex.mutex;
 	ret->error = 0;
 	ret->conn_pool = ctx->conn_pool;
+	ret->throttled = 0;
+	ret->queued = 0;
+	ret->high_watermark = ctx->async_high_watermark;
+	ret->low_watermark = ctx->async_low_watermark;
+	if(ret->low_watermark == 0 || ret->low_watermark > ret->high_watermark)
+	    ret->low_watermark = ret->high_watermark;
 
 	/* Because this is thread local, so no race condition possible at this point */
 	if(_async_mutex.created == 0)
@@ -272,7 +400,7 @@ static inline int _async_buf_page_free(_async_buf_page_t* page)
 {
 	if(_async_buf_page_is_data_source(page))
 	{
-		int rc = page->data_source->close(page->data_source->data_handle);
+		int rc = page->source->data_source.close(page->source->data_source.data_handle);
 
 		if(ERROR_CODE(int) == rc)
 		    LOG_ERROR("Cannot close the data source object properly");
@@ -286,7 +414,7 @@ static inline int _async_buf_page_free(_async_buf_page_t* page)
 		return rc;
 	}
 	else
-	    return mempool_page_dealloc(page);
+	    return mempool_page_dealloc_account(_account, page);
 }
 
 /**
@@ -312,9 +440,31 @@ static inline size_t _async_handle_getdata(uint32_t conn, void* data, size_t siz
 
 	for(;handle->page_begin != NULL && size > 0;)
 	{
-		if(_async_buf_page_is_data_source(handle->page_begin))
+		if(_async_buf_page_is_data_source(handle->page_begin) && handle->page_begin->source->range.fd >= 0)
 		{
-			int eos_rc = handle->page_begin->data_source->eos(handle->page_begin->data_source->data_handle);
+			/* The loop can not send the file range with sendfile, so we have to read it */
+			if(handle->page_begin->source->range.size == 0)
+			    goto PAGE_EXHAUSTED;
+
+			size_t bytes_to_read = handle->page_begin->source->range.size;
+			if(bytes_to_read > size) bytes_to_read = size;
+
+			ssize_t bytes_read = pread(handle->page_begin->source->range.fd, buf, bytes_to_read, (off_t)handle->page_begin->source->range.offset);
+			if(bytes_read <= 0)
+			{
+				LOG_WARNING("The file range page will be ignored because the file can not be read");
+				goto PAGE_EXHAUSTED;
+			}
+
+			handle->page_begin->source->range.offset += (uint64_t)bytes_read;
+			handle->page_begin->source->range.size -= (size_t)bytes_read;
+			ret += (size_t)bytes_read;
+			size -= (size_t)bytes_read;
+			buf += bytes_read;
+		}
+		else if(_async_buf_page_is_data_source(handle->page_begin))
+		{
+			int eos_rc = handle->page_begin->source->data_source.eos(handle->page_begin->source->data_source.data_handle);
 
 			if(ERROR_CODE(int) == eos_rc)
 			{
@@ -330,7 +480,7 @@ static inline size_t _async_handle_getdata(uint32_t conn, void* data, size_t siz
 
 			itc_module_data_source_event_t event;
 
-			size_t bytes_read = handle->page_begin->data_source->read(handle->page_begin->data_source->data_handle, buf, size, &event);
+			size_t bytes_read = handle->page_begin->source->data_source.read(handle->page_begin->source->data_source.data_handle, buf, size, &event);
 			if(ERROR_CODE(size_t) == bytes_read || bytes_read > size)
 			{
 				LOG_WARNING("The data source page will be ignored because the read call returns an error");
@@ -383,6 +533,7 @@ static inline size_t _async_handle_getdata(uint32_t conn, void* data, size_t siz
 			if(bytes_to_read > size) bytes_to_read = (uint32_t)size;
 
 			memcpy(buf, handle->page_begin->data + handle->page_off, bytes_to_read);
+			_async_queue_uncharge(handle, bytes_to_read);
 
 			handle->page_off += bytes_to_read;
 			ret += bytes_to_read;
@@ -427,6 +578,181 @@ PAGE_EXHAUSTED:
 	return ret;
 }
 
+/**
+ * @brief the iov callback for the async handle, which exposes the pending data pages to the async loop
+ * @details the pages are only released by the async loop thread, and the writer only appends bytes to the last page,
+ *          so the exposed bytes are valid until they are consumed
+ * @param conn the connection id
+ * @param iov the IO vector buffer
+ * @param iovcnt the capacity of the IO vector buffer
+ * @param loop the async loop
+ * @return the number of entries has been filled or error code
+ **/
+static inline int _async_handle_getiov(uint32_t conn, struct iovec* iov, int iovcnt, module_tcp_async_loop_t* loop)
+{
+	_async_handle_t* handle = (_async_handle_t*)module_tcp_async_get_data_handle(loop, conn);
+
+	if(NULL == handle)
+	    ERROR_RETURN_LOG_ERRNO(int, "cannot get the data handle for connection object %"PRIu32, conn);
+
+	int ret = 0;
+
+	if((errno = pthread_mutex_lock(handle->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "cannot acquire the async handle mutex");
+
+	uint32_t offset = handle->page_off;
+	_async_buf_page_t* page;
+	for(page = handle->page_begin; page != NULL && ret < iovcnt && !_async_buf_page_is_data_source(page); page = page->next, offset = 0)
+	{
+		if(page->nbytes <= offset) continue;
+
+		iov[ret].iov_base = page->data + offset;
+		iov[ret].iov_len  = page->nbytes - offset;
+		ret ++;
+	}
+
+	if((errno = pthread_mutex_unlock(handle->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "cannot release the async handle mutex");
+
+	return ret;
+}
+
+/**
+ * @brief the consume callback for the async handle, which releases the data pages has been written by the async loop
+ * @param conn the connection id
+ * @param nbytes the number of bytes has been written
+ * @param loop the async loop
+ * @return status code
+ **/
+static inline int _async_handle_consume(uint32_t conn, size_t nbytes, module_tcp_async_loop_t* loop)
+{
+	_async_handle_t* handle = (_async_handle_t*)module_tcp_async_get_data_handle(loop, conn);
+
+	if(NULL == handle)
+	    ERROR_RETURN_LOG_ERRNO(int, "cannot get the data handle for connection object %"PRIu32, conn);
+
+	int rc = 0;
+
+	if((errno = pthread_mutex_lock(handle->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "cannot acquire the async handle mutex");
+
+	for(;nbytes > 0 && handle->page_begin != NULL;)
+	{
+		if(_async_buf_page_is_data_source(handle->page_begin))
+		{
+			/* Only the file range is able to be consumed, which is sent by the sendfile system call */
+			if(handle->page_begin->source->range.fd < 0) break;
+
+			size_t bytes_in_range = handle->page_begin->source->range.size;
+			if(bytes_in_range > nbytes) bytes_in_range = nbytes;
+
+			handle->page_begin->source->range.offset += bytes_in_range;
+			handle->page_begin->source->range.size -= bytes_in_range;
+			nbytes -= bytes_in_range;
+
+			if(handle->page_begin->source->range.size > 0) break;
+
+			/* The data source page can not be reused */
+			_async_buf_page_t* tmp = handle->page_begin;
+
+			handle->page_off = 0;
+			handle->page_begin = handle->page_begin->next;
+			if(ERROR_CODE(int) == _async_buf_page_free(tmp))
+			    LOG_WARNING("Cannot deallocate the async data source page");
+
+			if(handle->page_end == tmp) handle->page_end = NULL;
+			continue;
+		}
+
+		uint32_t bytes_to_consume = handle->page_begin->nbytes - handle->page_off;
+		if(bytes_to_consume > nbytes) bytes_to_consume = (uint32_t)nbytes;
+
+		handle->page_off += bytes_to_consume;
+		nbytes -= bytes_to_consume;
+		_async_queue_uncharge(handle, bytes_to_consume);
+
+		if(handle->page_off < handle->page_begin->nbytes) break;
+
+		/* The same as the exhausted page in the data callback, the last page is reused */
+		if(handle->page_begin->next != NULL)
+		{
+			_async_buf_page_t* tmp = handle->page_begin;
+
+			handle->page_off = 0;
+			handle->page_begin = handle->page_begin->next;
+			if(ERROR_CODE(int) == _async_buf_page_free(tmp))
+			    LOG_WARNING("Cannot deallocate the async buffer page");
+
+			if(handle->page_end == tmp) handle->page_end = NULL;
+		}
+		else
+		{
+			handle->page_off = 0;
+			handle->page_begin->nbytes = 0;
+		}
+	}
+
+	if(nbytes > 0)
+	{
+		LOG_ERROR("The async loop consumed more bytes than the pending bytes");
+		rc = ERROR_CODE(int);
+	}
+
+	if((errno = pthread_mutex_unlock(handle->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "cannot release the async handle mutex");
+
+	return rc;
+}
+
+/**
+ * @brief the file callback for the async handle, which exposes the file range of the pending data source page
+ * @param conn the connection id
+ * @param fd_buf the buffer used to return the file descriptor
+ * @param offset_buf the buffer used to return the offset
+ * @param size_buf the buffer used to return the size of the range
+ * @param loop the async loop
+ * @return 1 if the first pending data is a file range, 0 if not, or error code
+ **/
+static inline int _async_handle_getfile(uint32_t conn, int* fd_buf, off_t* offset_buf, size_t* size_buf, module_tcp_async_loop_t* loop)
+{
+	_async_handle_t* handle = (_async_handle_t*)module_tcp_async_get_data_handle(loop, conn);
+
+	if(NULL == handle)
+	    ERROR_RETURN_LOG_ERRNO(int, "cannot get the data handle for connection object %"PRIu32, conn);
+
+	int ret = 0;
+
+	if((errno = pthread_mutex_lock(handle->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "cannot acquire the async handle mutex");
+
+	/* The exhausted data pages before the data source page are not the last page, so they can not be reused */
+	for(;handle->page_begin != NULL && handle->page_begin->next != NULL &&
+	     !_async_buf_page_is_data_source(handle->page_begin) &&
+	     handle->page_begin->nbytes <= handle->page_off;)
+	{
+		_async_buf_page_t* tmp = handle->page_begin;
+
+		handle->page_off = 0;
+		handle->page_begin = handle->page_begin->next;
+		if(ERROR_CODE(int) == _async_buf_page_free(tmp))
+		    LOG_WARNING("Cannot deallocate the async buffer page");
+	}
+
+	if(handle->page_begin != NULL && _async_buf_page_is_data_source(handle->page_begin) &&
+	   handle->page_begin->source->range.fd >= 0)
+	{
+		*fd_buf = handle->page_begin->source->range.fd;
+		*offset_buf = (off_t)handle->page_begin->source->range.offset;
+		*size_buf = handle->page_begin->source->range.size;
+		ret = 1;
+	}
+
+	if((errno = pthread_mutex_unlock(handle->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "cannot release the async handle mutex");
+
+	return ret;
+}
+
 /**
  * @brief the callback function called when the async object is entering an error state
  * @param conn the connection id
@@ -440,8 +766,15 @@ static inline int _async_handle_onerror(uint32_t conn, module_tcp_async_loop_t*
 	if(NULL == handle)
 	    ERROR_RETURN_LOG(int, "cannot get the data handle for the connection object %"PRIu32, conn);
 
+	/* The writer checks the error state before it queues more bytes */
+	if((errno = pthread_mutex_lock(handle->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "cannot acquire the async handle mutex");
+
 	handle->error = 1;
 
+	if((errno = pthread_mutex_unlock(handle->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "cannot release the async handle mutex");
+
 	LOG_INFO("Connection object %"PRIu32" has been set to an error state", conn);
 
 	return 0;
@@ -503,6 +836,9 @@ static inline int _async_handle_dispose(uint32_t conn, module_tcp_async_loop_t*
 		}
 	}
 
+	/* The bytes haven't been written are discarded with the pages */
+	_async_queue_uncharge(handle, handle->queued);
+
 	_async_buf_page_t* tmp;
 	for(;handle->page_begin;)
 	{
@@ -562,11 +898,35 @@ static int _cleanup(void* __restrict ctx)
 		rc = ERROR_CODE(int);
 	}
 
-	_instance_count --;
+	if(_account_owner == context) _account_owner = NULL;
+
+	/* The account is disposed after all the async loops are gone, since the loop may still release the async buffers */
+	if(-- _instance_count == 0 && NULL != _account)
+	{
+		if(ERROR_CODE(int) == mempool_account_free(_account))
+		{
+			LOG_ERROR("Cannot dispose the memory account");
+			rc = ERROR_CODE(int);
+		}
+		_account = NULL;
+	}
+
 	return rc;
 }
 static inline int _init_connection_pool(_module_context_t* __restrict context)
 {
+	/* The forked module may be created before the master is fully configured, so we inherit the write options here */
+	if(!context->pool_initialized && NULL != context->master)
+	{
+		const _module_context_t* master = context->master;
+		context->sync_write_attempt = master->sync_write_attempt;
+		context->async_buf_size = master->async_buf_size;
+		context->cork = master->cork;
+		context->sendfile = master->sendfile;
+		context->async_high_watermark = master->async_high_watermark;
+		context->async_low_watermark = master->async_low_watermark;
+	}
+
 	if(!context->pool_initialized && module_tcp_pool_configure(context->conn_pool, &context->pool_conf) == ERROR_CODE(int))
 	{
 		LOG_ERROR("Cannot configure the connection pool, retry after %d seconds", context->retry_interval);
@@ -577,7 +937,14 @@ static inline int _init_connection_pool(_module_context_t* __restrict context)
 	}
 
 	if(!context->pool_initialized)
-	    LOG_DEBUG("TCP Connection pool has been successfully initinalized");
+	{
+		LOG_DEBUG("TCP Connection pool has been successfully initinalized");
+		if(context->mem_high_watermark > 0 &&
+		   ERROR_CODE(int) == mempool_account_set_watermark(_account, context->mem_high_watermark, context->mem_low_watermark))
+		    ERROR_RETURN_LOG(int, "Cannot set the watermark of the memory account");
+		if(context->async_total_high_watermark > 0)
+		    _async_queue_set_watermark(context);
+	}
 
 	context->pool_initialized = 1;
 	return 0;
@@ -593,9 +960,16 @@ static inline int _module_context_init(_module_context_t* ctx, _module_context_t
 		if(NULL == (_async_handle_pool = mempool_objpool_new(sizeof(_async_handle_t))))
 		    ERROR_RETURN_LOG(int, "Cannot create async handle object pool");
 
-		if(NULL == (_async_data_source_pool = mempool_objpool_new(sizeof(_async_buf_page_t) + sizeof(itc_module_data_source_t))))
+		if(NULL == (_async_data_source_pool = mempool_objpool_new(sizeof(_async_buf_page_t) + sizeof(_async_source_t))))
 		    ERROR_RETURN_LOG(int, "Cannot create async data source object pool");
 
+		if(NULL == (_account = mempool_account_new("pipe.tcp")))
+		    ERROR_RETURN_LOG(int, "Cannot create the memory account");
+
+		if(ERROR_CODE(int) == mempool_objpool_set_account(_async_handle_pool, _account) ||
+		   ERROR_CODE(int) == mempool_objpool_set_account(_async_data_source_pool, _account))
+		    ERROR_RETURN_LOG(int, "Cannot set the memory account for the async object pools");
+
 		int pagesize = getpagesize();
 		if(pagesize < 0) ERROR_RETURN_LOG_ERRNO(int, "Cannot get page size");
 
@@ -613,11 +987,22 @@ static inline int _module_context_init(_module_context_t* ctx, _module_context_t
 
 	ctx->async_loop = NULL;
 
+	ctx->pool_conf.account = _account;
+	ctx->pool_conf.backpressure = _async_queue_over;
+	ctx->mem_high_watermark = ctx->mem_low_watermark = 0;
+	ctx->async_high_watermark = ctx->async_low_watermark = 0;
+	ctx->async_total_high_watermark = ctx->async_total_low_watermark = 0;
+
+	ctx->cork = 0;
+	ctx->sendfile = 1;
+	ctx->write_calls = ctx->responses = 0;
+
 	if(NULL == master)
 	{
 		if(NULL == (ctx->conn_pool = module_tcp_pool_new()))
 		    ERROR_RETURN_LOG(int, "Cannot create TCP connection pool");
 		ctx->fork_id = 0;
+		ctx->master = NULL;
 	}
 	else
 	{
@@ -633,6 +1018,7 @@ static inline int _module_context_init(_module_context_t* ctx, _module_context_t
 
 		/* We need to inherit the slave mode configuration */
 		ctx->slave_mode = master->slave_mode;
+		ctx->master = master;
 	}
 
 	_instance_count ++;
@@ -655,6 +1041,8 @@ static int _init(void* __restrict ctx, uint32_t argc, char const* __restrict con
 	context->pool_conf.reuseaddr    = 0;
 	context->pool_conf.ipv6         = 0;
 	context->pool_conf.accept_retry_interval = 5;
+	context->pool_conf.nodelay      = 0;
+	context->pool_conf.reuseport    = 0;
 	context->pool_conf.dispose_data = _dispose_state;
 	context->slave_mode = 0;
 	context->retry_interval = 1;
@@ -741,7 +1129,7 @@ static int _accept(void* __restrict ctx, const void* __restrict args, void* __re
 	else
 	{
 		LOG_DEBUG("This connection don't state variable, allocating one");
-		if(NULL == (stat = in->state = out->state = (_state_t*)mempool_page_alloc()))
+		if(NULL == (stat = in->state = out->state = (_state_t*)mempool_page_alloc_account(_account)))
 		{
 			LOG_ERROR("cannot allocate memory for the handle state");
 			module_tcp_pool_connection_release(context->conn_pool, conn.idx, NULL, MODULE_TCP_POOL_RELEASE_MODE_WAIT_FOR_READ);
@@ -758,6 +1146,7 @@ static int _accept(void* __restrict ctx, const void* __restrict args, void* __re
 	in->has_more = 1;
 	stat->user_state_pending = 0;
 	stat->buffer_exposed = 0;
+	stat->corked = 0;
 	in->fd = out->fd = conn.fd;
 	in->idx = out->idx = conn.idx;
 	in->async_handle = out->async_handle = NULL;
@@ -900,6 +1289,46 @@ static int _release_internal_buf(void* __restrict ctx, void const* __restrict bu
 	return 0;
 }
 
+/**
+ * @brief set or remove the cork of the socket
+ * @param context the module context
+ * @param handle the pipe handle
+ * @param val 1 to set the cork, 0 to remove it
+ * @return nothing
+ **/
+static inline void _set_cork(_module_context_t* context, _handle_t* handle, int val)
+{
+#ifdef TCP_CORK
+	__sync_fetch_and_add(&context->write_calls, 1);
+	if(setsockopt(handle->fd, IPPROTO_TCP, TCP_CORK, &val, sizeof(val)) < 0)
+	    LOG_WARNING_ERRNO("Cannot change the cork of connection object %"PRIu32, handle->idx);
+	else
+	    handle->state->corked = (val != 0);
+#else
+	(void)context;
+	(void)handle;
+	(void)val;
+#endif
+}
+
+/**
+ * @brief write the data to the socket synchronously
+ * @note the socket is corked before the first byte of the response if the cork option is enabled
+ * @param context the module context
+ * @param handle the pipe handle
+ * @param data the data buffer
+ * @param nbytes the size of the data buffer
+ * @return the result of the write system call
+ **/
+static inline ssize_t _sync_write(_module_context_t* context, _handle_t* handle, const void* data, size_t nbytes)
+{
+	if(context->cork && !handle->state->corked)
+	    _set_cork(context, handle, 1);
+
+	__sync_fetch_and_add(&context->write_calls, 1);
+	return write(handle->fd, data, nbytes);
+}
+
 /**
  * @brief ensure the async loop is started
  * @param context the context we need to ensure
@@ -930,6 +1359,13 @@ static inline int _ensure_async_loop_init(_module_context_t* context)
 				rc = ERROR_CODE(int);
 				LOG_ERROR("Cannot initialize the async loop");
 			}
+			else if(ERROR_CODE(int) == module_tcp_async_loop_set_gather(context->async_loop, _async_handle_getiov, _async_handle_consume) ||
+			        ERROR_CODE(int) == module_tcp_async_loop_set_sendfile(context->async_loop, context->sendfile ? _async_handle_getfile : NULL) ||
+			        ERROR_CODE(int) == module_tcp_async_loop_set_cork(context->async_loop, context->cork))
+			{
+				rc = ERROR_CODE(int);
+				LOG_ERROR("Cannot configure the async loop");
+			}
 			else
 			    LOG_DEBUG("Async IO loop has been initialized!");
 		}
@@ -954,6 +1390,11 @@ static inline int _create_async_handle(_module_context_t* context, _handle_t* ha
 	if(NULL == (handle->async_handle = _async_handle_new(context)))
 	    ERROR_RETURN_LOG(int, "cannot create async handle for the async object");
 
+	/* From now on, the async loop owns the socket and it will remove the cork when the async write finishes */
+	if(context->cork && !handle->state->corked)
+	    _set_cork(context, handle, 1);
+	handle->state->corked = 0;
+
 	if(module_tcp_async_write_register(context->async_loop, handle->idx, handle->fd, context->async_buf_size,
 	                                   _async_handle_getdata, _async_handle_empty, _async_handle_dispose,
 	                                   _async_handle_onerror, handle->async_handle) == ERROR_CODE(int))
@@ -971,6 +1412,9 @@ static inline int _create_async_handle(_module_context_t* context, _handle_t* ha
  * @param handle the module handle
  * @param buf the data buffer to write
  * @param nbytes how many bytes to write
+ * @note  the worker thread is shared by all the requests, so this never waits for a throttled connection. The bytes are
+ *        queued anyway, because the callers retry the short writes, and the data sources written after them are handed
+ *        to the async loop without being read, see _write_callback
  * @return the number of bytes that has written actually, or error code
  **/
 static inline size_t _write_async_buf(_module_context_t* context, _handle_t* handle, const int8_t* buf, size_t nbytes)
@@ -982,6 +1426,10 @@ static inline size_t _write_async_buf(_module_context_t* context, _handle_t* han
 	if((errno = pthread_mutex_lock(handle->async_handle->mutex)) != 0)
 	    ERROR_RETURN_LOG(size_t, "cannot acquire the async object mutex for connection %"PRIu32, handle->idx);
 
+	/* The async loop has given up the connection, so the bytes will never be written */
+	if(handle->async_handle->error)
+	    ERROR_LOG_GOTO(ASYNC_ERR, "Connection object %"PRIu32" is in an error state", handle->idx);
+
 	for(;nbytes > 0;)
 	{
 		if(handle->async_handle->page_end == NULL ||
@@ -1001,6 +1449,7 @@ static inline size_t _write_async_buf(_module_context_t* context, _handle_t* han
 		memcpy(handle->async_handle->page_end->data + handle->async_handle->page_end->nbytes, buf, copy_size);
 
 		handle->async_handle->page_end->nbytes += copy_size;
+		_async_queue_charge(handle->async_handle, copy_size);
 		bytes_written += copy_size;
 		nbytes -= copy_size;
 		buf += copy_size;
@@ -1036,9 +1485,9 @@ static inline size_t _ensure_async_handle(_module_context_t* context, _handle_t*
 
 		ssize_t rc = 0;
 
-		if(context->sync_write_attempt)
+		if(context->sync_write_attempt && nbytes > 0)
 		{
-			rc = write(handle->fd, data, nbytes);
+			rc = _sync_write(context, handle, data, nbytes);
 			if(rc == -1)
 			{
 				if(errno != EAGAIN && errno != EWOULDBLOCK)
@@ -1089,7 +1538,21 @@ static int _write_callback(void* __restrict ctx, itc_module_data_source_t data_s
 		size_t sync_data_size = 0; /* How many bytes in the sync_data buffer */
 		const int8_t* sync_data = NULL; /* The pointer for the start address of buffer that haven't been written */
 
-		/* Actually we want to write the bytes synchronizely until the scoket is not able to accept more */
+		/* If the data source is backed by a file, the async loop is able to send it from the file directly,
+		 * so we take the file range and skip the sync write attempt, which reads the bytes to the user-space */
+		runtime_api_scope_fd_range_t range = { .fd = -1 };
+		if(context->sendfile && NULL != data_source.fd_range)
+		{
+			int range_rc = data_source.fd_range(data_source.data_handle, &range);
+			if(ERROR_CODE(int) == range_rc)
+			    ERROR_RETURN_LOG(int, "Cannot get the file range of the data source");
+			if(range_rc == 0) range.fd = -1;
+			else eos_rc = (range.size == 0);
+		}
+
+		/* Actually we want to write the bytes synchronizely until the scoket is not able to accept more.
+		 * Once the connection has bytes pending for async write, the data source is never read by the worker thread,
+		 * it's deferred to the async loop, which only reads it after the bytes queued before it have been written */
 		for(;handle->async_handle == NULL && eos_rc != 1;)
 		{
 			/* If we get here second time, it means we do not create the async handle last time, which means
@@ -1100,7 +1563,9 @@ static int _write_callback(void* __restrict ctx, itc_module_data_source_t data_s
 
 			int data_source_wait = 0;
 
-			if(context->sync_write_attempt)
+			/* While too many bytes are queued, the data source is handed to the async loop as it is, so that it's
+			 * only read when the socket is able to take more data */
+			if(context->sync_write_attempt && range.fd < 0 && !_async_queue.over)
 			{
 				LOG_DEBUG("The sync write attempt option is enabled, so try the sync write before we start async write process");
 				size_t sync_buf_size = context->async_buf_size;
@@ -1133,7 +1598,8 @@ static int _write_callback(void* __restrict ctx, itc_module_data_source_t data_s
 			 * sync write attempt, then we may want to try it as many time as possible.
 			 * So the force create option only needs to be turned on when the sync write attempt is off
 			 **/
-			size_t written = _ensure_async_handle(context, handle, sync_data, sync_data_size, data_source_wait || !context->sync_write_attempt);
+			size_t written = _ensure_async_handle(context, handle, sync_data, sync_data_size,
+			                                      data_source_wait || range.fd >= 0 || !context->sync_write_attempt || _async_queue.over);
 
 			if(ERROR_CODE(size_t) == written)
 			    ERROR_RETURN_LOG(int, "Cannot create async handle for the pipe");
@@ -1174,7 +1640,7 @@ static int _write_callback(void* __restrict ctx, itc_module_data_source_t data_s
 		if((errno = pthread_mutex_lock(handle->async_handle->mutex)) != 0)
 		    ERROR_RETURN_LOG(int, "cannot acquire the async object mutex for connection %"PRIu32, handle->idx);
 
-		_async_buf_page_t* page = _async_buf_data_source_page_new(data_source);
+		_async_buf_page_t* page = _async_buf_data_source_page_new(data_source, range);
 		if(NULL == page) ERROR_LOG_GOTO(ASYNC_ERR, "Cannot allocate data source page for the data source");
 
 		if(handle->async_handle->page_end != NULL) handle->async_handle->page_end->next = page;
@@ -1215,7 +1681,7 @@ ASYNC_RET:
 			const int8_t* bytes = sync_buf;
 			for(;nbytes > 0;)
 			{
-				ssize_t rc = write(handle->fd, bytes, nbytes);
+				ssize_t rc = _sync_write(context, handle, bytes, nbytes);
 				if(rc == 0) ERROR_RETURN_LOG(int, "Unexpected number of bytes writen, treat as an socket error");
 				else if(rc > 0)
 				{
@@ -1272,7 +1738,7 @@ static size_t _write(void* __restrict ctx, const void* __restrict data, size_t n
 		size_t bytes_written = 0;
 		for(;nbytes > 0;)
 		{
-			ssize_t rc = write(handle->fd, bytes, nbytes);
+			ssize_t rc = _sync_write(context, handle, bytes, nbytes);
 			if(rc == 0) ERROR_RETURN_LOG(size_t, "Unexpected number of bytes writen, treat as an socket error");
 			else if(rc > 0)
 			{
@@ -1299,6 +1765,8 @@ static int _dealloc(void* __restrict ctx, void* __restrict pipe, int error, int
 		LOG_DEBUG("Both side of the pipe has been deallocated, close the socket");
 		runtime_api_pipe_flags_t flags = itc_module_get_handle_flags(pipe);
 
+		__sync_fetch_and_add(&context->responses, 1);
+
 		if((flags & RUNTIME_API_PIPE_PERSIST) && !error)
 		{
 			int mode;
@@ -1326,6 +1794,9 @@ static int _dealloc(void* __restrict ctx, void* __restrict pipe, int error, int
 			if(handle->async_handle == NULL)
 			{
 				LOG_DEBUG("There's no undergoing async write op, release the connection directly");
+				/* The connection will be kept, so flush the last partial frame of the response */
+				if(handle->state->corked)
+				    _set_cork(context, handle, 0);
 				if(module_tcp_pool_connection_release(context->conn_pool, handle->idx, handle->state, mode) == ERROR_CODE(int))
 				    ERROR_RETURN_LOG(int, "cannot release the connection");
 			}
@@ -1441,6 +1912,42 @@ static itc_module_property_value_t _get_prop(void* __restrict ctx, const char* s
 	};
 	_module_context_t* context = (_module_context_t*)ctx;
 
+	/* The runtime statistics is per event loop, so the forked instances report their own pool */
+	if(strcmp(sym, "stats") == 0)
+	{
+		module_tcp_pool_stat_t stat;
+		if(!context->pool_initialized || ERROR_CODE(int) == module_tcp_pool_get_stat(context->conn_pool, &stat))
+		    return ret;
+
+		/* The syscalls of the async loop are counted as well, since it writes the rest of the responses */
+		module_tcp_async_loop_stat_t async_stat = {};
+		if(NULL != context->async_loop && ERROR_CODE(int) == module_tcp_async_loop_get_stat(context->async_loop, &async_stat))
+		    return ret;
+
+		uint64_t syscalls = context->write_calls + async_stat.write_calls;
+		uint64_t responses = context->responses;
+
+		size_t len = 640;
+		if(NULL == (ret.str = (char*)malloc(len)))
+		{
+			ret.type = ITC_MODULE_PROPERTY_TYPE_ERROR;
+			return ret;
+		}
+
+		snprintf(ret.str, len, "conn.capacity %"PRIu32"\nconn.inactive %"PRIu32"\nconn.active %"PRIu32"\n"
+		                       "conn.waiting %"PRIu32"\nconn.release_queue %"PRIu32"\nconn.paused %"PRIu32"\n"
+		                       "write.syscalls %"PRIu64"\nwrite.responses %"PRIu64"\nwrite.async_responses %"PRIu64"\n"
+		                       "write.syscalls_per_response_x100 %"PRIu64"\nwrite.sendfile_bytes %"PRIu64"\n"
+		                       "write.queued_bytes %zu\nwrite.throttled_conns %"PRIu32"\nwrite.paused %d\n",
+		                       stat.capacity, stat.inactive, stat.active, stat.waiting, stat.release_queue, stat.paused,
+		                       syscalls, responses, async_stat.finished,
+		                       responses > 0 ? syscalls * 100 / responses : 0, async_stat.sendfile_bytes,
+		                       _async_queue.bytes, _async_queue.throttled, _async_queue.over);
+
+		ret.type = ITC_MODULE_PROPERTY_TYPE_STRING;
+
+		return ret;
+	}
 
 	/* Also, any forked event loop do not have permission to access any of the config */
 	if(context->fork_id != 0)
@@ -1454,8 +1961,18 @@ static itc_module_property_value_t _get_prop(void* __restrict ctx, const char* s
 	else if(strcmp(sym, "backlog") == 0) return _make_num(context->pool_conf.tcp_backlog);
 	else if(strcmp(sym, "ipv6") == 0) return _make_num(context->pool_conf.ipv6);
 	else if(strcmp(sym, "reuseaddr") == 0) return _make_num((long long)context->pool_conf.reuseaddr);
+	else if(strcmp(sym, "reuseport") == 0) return _make_num((long long)context->pool_conf.reuseport);
 	else if(strcmp(sym, "async_buf_size") == 0) return _make_num((long long)context->async_buf_size);
 	else if(strcmp(sym, "accept_retry_interval") == 0) return _make_num((long long)context->pool_conf.accept_retry_interval);
+	else if(strcmp(sym, "nodelay") == 0) return _make_num(context->pool_conf.nodelay);
+	else if(strcmp(sym, "cork") == 0) return _make_num(context->cork);
+	else if(strcmp(sym, "sendfile") == 0) return _make_num(context->sendfile);
+	else if(strcmp(sym, "mem_high_watermark") == 0) return _make_num((long long)context->mem_high_watermark);
+	else if(strcmp(sym, "mem_low_watermark") == 0) return _make_num((long long)context->mem_low_watermark);
+	else if(strcmp(sym, "async_high_watermark") == 0) return _make_num((long long)context->async_high_watermark);
+	else if(strcmp(sym, "async_low_watermark") == 0) return _make_num((long long)context->async_low_watermark);
+	else if(strcmp(sym, "async_total_high_watermark") == 0) return _make_num((long long)context->async_total_high_watermark);
+	else if(strcmp(sym, "async_total_low_watermark") == 0) return _make_num((long long)context->async_total_low_watermark);
 	else if(strcmp(sym, "bindaddr") == 0) //*(const char**)data = context->pool_conf.bind_addr;
 	{
 		size_t len;
@@ -1473,16 +1990,94 @@ static itc_module_property_value_t _get_prop(void* __restrict ctx, const char* s
 	}
 	else if(strcmp(sym, "nforks") == 0)
 	    return _make_num((long long)module_tcp_pool_num_forks(context->conn_pool));
+	else if(strcmp(sym, "event_loops") == 0)
+	    return _make_num((long long)module_tcp_pool_num_forks(context->conn_pool) + 1);
 
 	return ret;
 }
 
+/**
+ * @brief fork the module instance until the port is served by the given number of event loops
+ * @details Each forked module instance owns its connection pool, async loop and event loop thread, and all of them
+ *          feed the same event queue. So the connections accepted from the port are sharded among the event loops
+ * @param context the master module context
+ * @param n the number of event loops
+ * @return status code
+ **/
+static inline int _set_event_loops(_module_context_t* context, int64_t n)
+{
+	if(NULL != context->master)
+	    ERROR_RETURN_LOG(int, "Cannot change the number of event loops from a forked TCP module");
+
+	/* The event loop threads are created for the module instances which exist when the loops are started */
+	int started = itc_eloop_started();
+	if(ERROR_CODE(int) == started)
+	    ERROR_RETURN_LOG(int, "Cannot check if the event loops have been started");
+	if(started)
+	    ERROR_RETURN_LOG(int, "Cannot change the number of event loops after the event loops have been started");
+
+	if(context->slave_mode)
+	    ERROR_RETURN_LOG(int, "Cannot start multiple event loops for a TCP module in slave mode");
+
+	int forks = module_tcp_pool_num_forks(context->conn_pool);
+	if(ERROR_CODE(int) == forks)
+	    ERROR_RETURN_LOG(int, "Cannot get the number of forks");
+
+	if(n < forks + 1)
+	    ERROR_RETURN_LOG(int, "Cannot reduce the number of event loops from %d to %"PRId64, forks + 1, n);
+
+	char path[128];
+	snprintf(path, sizeof(path), "%s.port_%u", module_tcp_module_def.mod_prefix, context->pool_conf.port);
+	char const* argv[] = {path};
+
+	for(;forks + 1 < n; forks ++)
+	    if(ERROR_CODE(int) == itc_modtab_insmod(&module_tcp_module_def, 1, argv))
+	        ERROR_RETURN_LOG(int, "Cannot fork the event loop %d for %s", forks + 1, path);
+
+	return 0;
+}
+
+/**
+ * @brief set the watermark of the memory account
+ * @note the memory account is shared by all the instances, so the first instance sets the watermark owns it, and
+ *       the other instances can only set the same value, otherwise they would overwrite each other's budget
+ * @param context the module context
+ * @param high if we are setting the high watermark
+ * @param value the new watermark
+ * @return status code
+ **/
+static inline int _set_mem_watermark(_module_context_t* context, int high, size_t value)
+{
+	if(NULL != _account_owner && _account_owner != context)
+	{
+		size_t current = high ? _account_owner->mem_high_watermark : _account_owner->mem_low_watermark;
+		if(current != value)
+		    ERROR_RETURN_LOG(int, "The memory account shared by all the TCP instances has been configured by port %u with a different %s watermark",
+		                     _account_owner->pool_conf.port, high ? "high" : "low");
+	}
+	else _account_owner = context;
+
+	if(high) context->mem_high_watermark = value;
+	else context->mem_low_watermark = value;
+
+	return 0;
+}
+
 static int _set_prop(void* __restrict ctx, const char* sym, itc_module_property_value_t value)
 {
 	_module_context_t* context = (_module_context_t*)ctx;
 
 	/* TODO: this is weird, because it sounds like different module actually shares the same configuration */
 	static char bindaddr_buffer[128];
+
+	/* The event loops can only be added from the master, so this should be rejected rather than ignored on a fork */
+	if(value.type == ITC_MODULE_PROPERTY_TYPE_INT && strcmp(sym, "event_loops") == 0)
+	{
+		if(ERROR_CODE(int) == _set_event_loops(context, value.num))
+		    ERROR_RETURN_LOG(int, "Cannot set the number of event loops");
+		return 1;
+	}
+
 	/* For a forked module, we don't allow any property change */
 	if(context->fork_id != 0) return 0;
 	if(value.type == ITC_MODULE_PROPERTY_TYPE_INT)
@@ -1495,7 +2090,32 @@ static int _set_prop(void* __restrict ctx, const char* sym, itc_module_property_
 		else if(strcmp(sym, "backlog") == 0) context->pool_conf.tcp_backlog = (int)value.num;
 		else if(strcmp(sym, "ipv6") == 0) context->pool_conf.ipv6 = (int)value.num;
 		else if(strcmp(sym, "reuseaddr") == 0) context->pool_conf.reuseaddr = (int)value.num;
+		else if(strcmp(sym, "reuseport") == 0) context->pool_conf.reuseport = (int)value.num;
 		else if(strcmp(sym, "accept_retry_interval") == 0) context->pool_conf.accept_retry_interval = (uint32_t)value.num;
+		else if(strcmp(sym, "nodelay") == 0) context->pool_conf.nodelay = (int)value.num;
+		else if(strcmp(sym, "cork") == 0)
+		{
+#ifdef TCP_CORK
+			context->cork = (int)value.num;
+#else
+			LOG_WARNING("TCP_CORK is not supported on this platform, ignore the cork option");
+#endif
+		}
+		else if(strcmp(sym, "sendfile") == 0) context->sendfile = (int)value.num;
+		else if(strcmp(sym, "mem_high_watermark") == 0 || strcmp(sym, "mem_low_watermark") == 0)
+		{
+			if(ERROR_CODE(int) == _set_mem_watermark(context, strcmp(sym, "mem_high_watermark") == 0, (size_t)value.num))
+			    ERROR_RETURN_LOG(int, "Cannot set the watermark of the memory account");
+		}
+		else if(strcmp(sym, "async_high_watermark") == 0) context->async_high_watermark = (size_t)value.num;
+		else if(strcmp(sym, "async_low_watermark") == 0) context->async_low_watermark = (size_t)value.num;
+		else if(strcmp(sym, "async_total_high_watermark") == 0 || strcmp(sym, "async_total_low_watermark") == 0)
+		{
+			if(strcmp(sym, "async_total_high_watermark") == 0) context->async_total_high_watermark = (size_t)value.num;
+			else context->async_total_low_watermark = (size_t)value.num;
+			/* Like the memory account, the watermarks are applied once the pool is initialized */
+			if(context->pool_initialized) _async_queue_set_watermark(context);
+		}
 		else if(strcmp(sym, "async_buf_size") == 0)
 		{
 			context->async_buf_size = (uint32_t)value.num;
@@ -11,6 +11,8 @@
 #include <string.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <pthread.h>
 
@@ -18,6 +20,7 @@
 #include <module/tcp/pool.h>
 #include <utils/log.h>
 #include <utils/bitmask.h>
+#include <utils/timewheel.h>
 #include <error.h>
 #include <arch/arch.h>
 #include <os/os.h>
@@ -54,6 +57,7 @@ typedef struct {
  **/
 typedef struct {
 	bitmask_t*               bitmask;  /*!< the bitmask, a id allocator */
+	timewheel_t*             timer;    /*!< the timing wheel for the idle timeout of the inactive connections, keyed by connection id */
 	uint32_t*                index;    /*!< the index array, use to indicates the index in the connection array */
 	_queue_message_t*        queue;    /*!< the release request queue, the reason we have this is because we
 	                                      should allow scheduler thread call the release function */
@@ -62,7 +66,8 @@ typedef struct {
 	uint32_t                 q_front;  /*!< the next queue message to process */
 	uint32_t                 q_rear;   /*!< the increment interger to identify the queue message */
 	union {
-		uint32_t             heap_limit;  /*!< range [0, heap_limit) in the connection array is used for the inactive heap */
+		uint32_t             heap_limit;  /*!< range [0, heap_limit) in the connection array is used for the inactive connections, which is not ordered,
+		                                       because the timeout is tracked by the timing wheel */
 		uint32_t             active_start;/*!< this is also the active start */
 	};
 	union {
@@ -86,13 +91,15 @@ struct _module_tcp_pool_t{
 	pthread_mutex_t             master_mutex; /*!< This mutex is used when the pool gets configured. It make sure that the master pool gets configured before forks */
 	pthread_cond_t              master_cond;  /*!< Used with master_mutex for event loop synchronization */
 	int                         num_forks;    /*!< How many forks module it have, master pool only */
-	module_tcp_pool_t*          master;       /*!< The master pool is the onwer of the socket, NULL if this pool is the master */
+	module_tcp_pool_t*          master;       /*!< The master pool is the onwer of the shared socket, NULL if this pool is the master */
 	module_tcp_pool_configure_t conf;         /*!< the module confiuration */
 	_conn_info_t                conn_info;    /*!< the connection info object */
 	struct sockaddr_in          saddr;        /*!< The socket addr */
 	struct sockaddr_in6         saddr6;       /*!< The ipv6 socket addr */
 	uint32_t                    loop_killed:1;/*!< indicates if the loop is gets killed */
 	uint32_t                    unaccepted_conn:1; /*!< Indicates if the socket has unaccepted connection (Caused by some reason, thus we can not accept them right away) */
+	uint32_t                    accept_paused:1;   /*!< Indicates if we stop accepting new connections because the memory is over limit */
+	uint32_t                    owns_socket:1;     /*!< Indicates if the listening socket is owned by this pool */
 	char                        addr_str_buf[INET6_ADDRSTRLEN];/*!< the buffer used to convert the network address to string */
 };
 
@@ -160,12 +167,15 @@ static inline int _init_conn_info(module_tcp_pool_t* pool, uint32_t capacity)
 	for(;tmp > 1; q_size <<= 1, tmp >>= 1);
 	if(q_size < capacity) q_size <<= 1;
 
-	if(pool->conn_info.bitmask != NULL || pool->conn_info.index != NULL || pool->conn_info.conn != NULL)
+	if(pool->conn_info.bitmask != NULL || pool->conn_info.index != NULL || pool->conn_info.conn != NULL || pool->conn_info.timer != NULL)
 	    ERROR_RETURN_LOG(int, "cannot reinitialize the connection info object");
 
 	if(NULL == (pool->conn_info.bitmask = bitmask_new(capacity)))
 	    ERROR_RETURN_LOG(int, "cannot create new bitmask for the connection pool");
 
+	if(NULL == (pool->conn_info.timer = timewheel_new(capacity, time(NULL))))
+	    ERROR_RETURN_LOG(int, "cannot create the timing wheel for the connection pool");
+
 	if(NULL == (pool->conn_info.index = (uint32_t*)malloc(capacity * sizeof(uint32_t))))
 	    ERROR_RETURN_LOG(int, "cannot allocate index array for the connection pool");
 
@@ -202,6 +212,8 @@ static inline int _finalize_conn_info(module_tcp_pool_t* pool)
 
 	if(NULL != pool->conn_info.bitmask) rc = bitmask_free(pool->conn_info.bitmask);
 
+	if(NULL != pool->conn_info.timer && ERROR_CODE(int) == timewheel_free(pool->conn_info.timer)) rc = ERROR_CODE(int);
+
 	if(NULL != pool->conn_info.index) free(pool->conn_info.index);
 
 	if(NULL != pool->conn_info.conn) free(pool->conn_info.conn);
@@ -212,6 +224,7 @@ static inline int _finalize_conn_info(module_tcp_pool_t* pool)
 
 	pool->conn_info.conn = NULL;
 	pool->conn_info.bitmask = NULL;
+	pool->conn_info.timer = NULL;
 	pool->conn_info.index = NULL;
 	pool->conn_info.queue = NULL;
 
@@ -309,7 +322,7 @@ int module_tcp_pool_free(module_tcp_pool_t* pool)
 
 	int rc = _finalize_conn_info(pool);
 
-	if(pool->socket_fd >= 0 && pool->master == NULL) close(pool->socket_fd);
+	if(pool->socket_fd >= 0 && pool->owns_socket) close(pool->socket_fd);
 
 	if(pool->event_fd >= 0) close(pool->event_fd);
 
@@ -335,6 +348,29 @@ int module_tcp_pool_num_forks(const module_tcp_pool_t* pool)
 	return pool->num_forks;
 }
 
+int module_tcp_pool_get_stat(const module_tcp_pool_t* pool, module_tcp_pool_stat_t* buf)
+{
+	if(NULL == pool || NULL == buf) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	/* We are not the event loop thread, so make sure we see a consistent snapshot of the ranges */
+	uint32_t heap_limit = pool->conn_info.heap_limit;
+	uint32_t active_limit = pool->conn_info.active_limit;
+	uint32_t wait_limit = pool->conn_info.wait_limit;
+
+	if(active_limit < heap_limit) active_limit = heap_limit;
+	if(wait_limit < active_limit) wait_limit = active_limit;
+
+	buf->capacity = pool->conf.size;
+	buf->inactive = heap_limit;
+	buf->active = active_limit - heap_limit;
+	buf->waiting = wait_limit - active_limit;
+	buf->release_queue = pool->conn_info.q_rear - pool->conn_info.q_front;
+	buf->paused = pool->accept_paused;
+	buf->listen_fd = pool->socket_fd;
+
+	return 0;
+}
+
 /**
  * @brief initialize the socket so that the connection pool will start listing to the socket
  * @param pool the target pool object
@@ -342,8 +378,18 @@ int module_tcp_pool_num_forks(const module_tcp_pool_t* pool)
  **/
 static inline int _init_socket(module_tcp_pool_t* pool)
 {
-	if(pool->master == NULL)
+	int shared = 1;
+#ifdef SO_REUSEPORT
+	/* In this case every pool has its own listening socket, and the kernel decides which one takes the new connection */
+	if(pool->conf.reuseport) shared = 0;
+#else
+	if(pool->conf.reuseport)
+	    LOG_WARNING("SO_REUSEPORT is not supported on this platform, the forked pools share the listening socket");
+#endif
+
+	if(pool->master == NULL || !shared)
 	{
+		pool->owns_socket = 1;
 		struct sockaddr* sockaddr;
 		socklen_t sockaddr_size;
 		if(!pool->conf.ipv6)
@@ -376,6 +422,12 @@ static inline int _init_socket(module_tcp_pool_t* pool)
 		   setsockopt(pool->socket_fd, SOL_SOCKET, SO_REUSEADDR, (char*)&pool->conf.reuseaddr, sizeof(pool->conf.reuseaddr)) < 0)
 		    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot set the reuseaddr option");
 
+#ifdef SO_REUSEPORT
+		int reuseport = 1;
+		if(!shared && setsockopt(pool->socket_fd, SOL_SOCKET, SO_REUSEPORT, &reuseport, sizeof(reuseport)) < 0)
+		    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot set the reuseport option");
+#endif
+
 		if(_set_nonblock(pool->socket_fd) == ERROR_CODE(int))
 		    ERROR_LOG_GOTO(ERR, "Cannot set the socket FD to non-blocking mode");
 
@@ -392,13 +444,14 @@ static inline int _init_socket(module_tcp_pool_t* pool)
 		else
 		    pool->saddr = pool->master->saddr;
 		pool->socket_fd = pool->master->socket_fd;
+		pool->owns_socket = 0;
 	}
 
 	os_event_desc_t event = {
 		.type = OS_EVENT_TYPE_KERNEL,
 		.kernel = {
 			.fd = pool->socket_fd,
-			.event = OS_EVENT_KERNEL_EVENT_CONNECT,
+			.event = shared ? OS_EVENT_KERNEL_EVENT_CONNECT_SHARED : OS_EVENT_KERNEL_EVENT_CONNECT,
 			.data = NULL
 		}
 	};
@@ -409,7 +462,7 @@ static inline int _init_socket(module_tcp_pool_t* pool)
 	LOG_DEBUG("TCP Socket has been initialized on %s:%"PRIu16, pool->conf.bind_addr, pool->conf.port);
 	return 0;
 ERR:
-	if(pool->socket_fd >= 0 && pool->master == NULL) close(pool->socket_fd);
+	if(pool->socket_fd >= 0 && pool->owns_socket) close(pool->socket_fd);
 	pool->socket_fd = ERROR_CODE(int);
 	return ERROR_CODE(int);
 }
@@ -507,39 +560,6 @@ static inline void _swap(module_tcp_pool_t* pool, uint32_t a, uint32_t b)
 	pool->conn_info.index[pool->conn_info.conn[a].id] = a;
 	pool->conn_info.index[pool->conn_info.conn[b].id] = b;
 }
-/**
- * @brief adjustment to keep the heap property in the heap
- * @param idx the index in the *connection list*
- * @param pool the connection pool instance object
- * @return nothing
- **/
-static inline void _heapify(module_tcp_pool_t* pool, uint32_t idx)
-{
-	for(;idx < pool->conn_info.heap_limit;)
-	{
-		uint32_t min_idx = idx;
-		if(idx * 2 + 1 < pool->conn_info.heap_limit && pool->conn_info.conn[idx * 2 + 1].ts < pool->conn_info.conn[min_idx].ts)
-		    min_idx = idx * 2 + 1;
-		if(idx * 2 + 2 < pool->conn_info.heap_limit && pool->conn_info.conn[idx * 2 + 2].ts < pool->conn_info.conn[min_idx].ts)
-		    min_idx = idx * 2 + 2;
-		if(idx == min_idx) break;
-		_swap(pool, idx, min_idx);
-		idx = min_idx;
-	}
-}
-
-/**
- * @brief upward adjustment for heap
- * @param idx the index in the *connectin list*
- * @param pool the connection pool instance object
- * @return nothing
- **/
-static inline void _decrease(module_tcp_pool_t* pool, uint32_t idx)
-{
-	for(;idx > 0 && pool->conn_info.conn[(idx - 1) / 2].ts > pool->conn_info.conn[idx].ts; idx = (idx - 1) / 2)
-	    _swap(pool, idx, (idx - 1) / 2);
-}
-
 //TODO: remodel this
 
 /**
@@ -556,11 +576,15 @@ static inline int _connection_close(module_tcp_pool_t* pool, uint32_t idx)
 	if(ERROR_CODE(int) == _release_connection_object(pool, idx))
 	    LOG_WARNING("Cannot release the connection object, memory or FD leaking is possible");
 
+	/* stop the idle timer, it's only armed when the connection is inactive */
+	if(ERROR_CODE(int) == timewheel_cancel(pool->conn_info.timer, pool->conn_info.conn[idx].id))
+	    LOG_WARNING("Cannot cancel the idle timer of connection object %"PRIu32, pool->conn_info.conn[idx].id);
+
 	/* free the index it occupied */
 	if(bitmask_dealloc(pool->conn_info.bitmask, pool->conn_info.conn[idx].id) == ERROR_CODE(int))
 	    LOG_WARNING("Cannot deallocate the used connection object index %"PRIu32, pool->conn_info.conn[idx].id);
 
-	/* If this index is in the range of inactive heap, remove it from the inactive heap first */
+	/* If this index is in the range of inactive list, remove it from the inactive list first */
 	if(idx < pool->conn_info.heap_limit)
 	{
 		pool->conn_info.conn[idx] = pool->conn_info.conn[--pool->conn_info.heap_limit];
@@ -577,8 +601,6 @@ static inline int _connection_close(module_tcp_pool_t* pool, uint32_t idx)
 		 * actually a place holder). If this is true, the data in the connection object is not defined, so
 		 * we just ignore it.
 		 *
-		 * It's Ok to perform heapify in this case, because the place hold is out of the range of heap.
-		 *
 		 * Here's an example for a bug senario if we do not check this:
 		 * 		Heap         [1,2,3]
 		 * 		Active       []
@@ -601,11 +623,10 @@ static inline int _connection_close(module_tcp_pool_t* pool, uint32_t idx)
 		 * in this place
 		 **/
 		if(pool->conn_info.heap_limit > idx) pool->conn_info.index[pool->conn_info.conn[idx].id] = idx;
-		_heapify(pool, idx);
 		idx = pool->conn_info.active_start;
 	}
 
-	/* At this point, we are able to assume that the index to delete is out of the range of inactive heap,
+	/* At this point, we are able to assume that the index to delete is out of the range of inactive list,
 	 * If this index is in the range of active list, remove it from the active list */
 	if(idx < pool->conn_info.active_limit)
 	{
@@ -624,7 +645,7 @@ static inline int _connection_close(module_tcp_pool_t* pool, uint32_t idx)
 	return 0;
 }
 /**
- * @brief activate means move the connection from inactive heap to wait list
+ * @brief activate means move the connection from inactive list to wait list
  * @param idx the index in the *connection list*
  * @param pool the connection pool instance object
  * @return status code
@@ -641,9 +662,11 @@ static inline int _connection_activate(module_tcp_pool_t* pool, uint32_t idx)
 	if(ERROR_CODE(int) == os_event_poll_del(pool->poll_obj, pool->conn_info.conn[idx].fd, 1))
 	    ERROR_RETURN_LOG(int, "Cannot remove the connection object %"PRIu32" from the poll object list", pool->conn_info.conn[idx].id);
 
-	/* Remove it from the inactive heap */
+	if(ERROR_CODE(int) == timewheel_cancel(pool->conn_info.timer, pool->conn_info.conn[idx].id))
+	    ERROR_RETURN_LOG(int, "Cannot cancel the idle timer of connection object %"PRIu32, pool->conn_info.conn[idx].id);
+
+	/* Remove it from the inactive list */
 	_swap(pool, idx, --pool->conn_info.heap_limit);
-	_heapify(pool, idx);
 
 	/* Swap it to the wait list */
 	_swap(pool, pool->conn_info.active_start, --pool->conn_info.active_limit);
@@ -684,7 +707,7 @@ static inline int _connection_checkin(module_tcp_pool_t* pool, uint32_t idx)
 	return 0;
 }
 /**
- * @brief deactivate means we move the connection from atcive list to inactive heap
+ * @brief deactivate means we move the connection from atcive list to inactive list
  * @param idx the index in the *connection list*
  * @param now the current timestamp
  * @param pool the connection pool instance object
@@ -726,9 +749,13 @@ static inline int _connection_deactivate(module_tcp_pool_t* pool, uint32_t idx,
 
 	pool->conn_info.conn[idx].ts = now;
 
-	_swap(pool, idx, pool->conn_info.active_start ++);
+	if(ERROR_CODE(int) == timewheel_arm(pool->conn_info.timer, pool->conn_info.conn[idx].id, now + pool->conf.ttl))
+	{
+		LOG_ERROR("Cannot arm the idle timer for the connection");
+		rc = ERROR_CODE(int);
+	}
 
-	_decrease(pool, pool->conn_info.heap_limit - 1);
+	_swap(pool, idx, pool->conn_info.active_start ++);
 
 	return rc;
 }
@@ -788,6 +815,23 @@ static inline int _accpet_request(module_tcp_pool_t* pool, time_t now)
 		return -1;
 	}
 
+	/* Leave the connections in the backlog until the memory or the pending writes drop to the low watermark,
+	 * and the poll wakes up every accept_retry_interval ms to check this again */
+	if(mempool_account_over_limit(pool->conf.account) || (NULL != pool->conf.backpressure && pool->conf.backpressure()))
+	{
+		if(!pool->accept_paused)
+		    LOG_WARNING("The memory usage or the pending writes are over limit, stop accepting new connections");
+		pool->accept_paused = 1;
+		pool->unaccepted_conn = 1;
+		return 0;
+	}
+
+	if(pool->accept_paused)
+	{
+		LOG_INFO("The memory usage and the pending writes are back to normal, resume accepting new connections");
+		pool->accept_paused = 0;
+	}
+
 	socklen_t addr_len = sizeof(struct sockaddr_in);
 	for(;-1 != (data_fd = accept(pool->socket_fd, (struct sockaddr*)&pool->saddr, &addr_len));)
 	{
@@ -804,6 +848,9 @@ static inline int _accpet_request(module_tcp_pool_t* pool, time_t now)
 			goto ERR;
 		}
 
+		if(pool->conf.nodelay && setsockopt(data_fd, IPPROTO_TCP, TCP_NODELAY, &pool->conf.nodelay, sizeof(pool->conf.nodelay)) < 0)
+		    LOG_WARNING_ERRNO("cannot set TCP_NODELAY on the incoming FD");
+
 		/* Make a new connection object */
 		pool->conn_info.conn[pool->conn_info.nconnections].ts = now;
 		pool->conn_info.conn[pool->conn_info.nconnections].fd = data_fd;
@@ -813,12 +860,14 @@ static inline int _accpet_request(module_tcp_pool_t* pool, time_t now)
 		pool->conn_info.wait_limit ++;
 
 		/* The new incoming request should not be in waiting list, because it may connect but no data
-		 * The sane way to handle this is adding it to heap and let next poll wake it up */
+		 * The sane way to handle this is adding it to the inactive list and let next poll wake it up */
 		_swap(pool, pool->conn_info.wait_limit - 1, pool->conn_info.wait_start ++);
 		_swap(pool, pool->conn_info.active_limit - 1, pool->conn_info.active_start ++);
-		_decrease(pool, pool->conn_info.heap_limit - 1);
 
-		/* Because it should be in the heap, so add it to poll queue */
+		if(ERROR_CODE(int) == timewheel_arm(pool->conn_info.timer, id, now + pool->conf.ttl))
+		    LOG_ERROR("Cannot arm the idle timer for the new connection");
+
+		/* Because it should be in the inactive list, so add it to poll queue */
 		os_event_desc_t event = {
 			.type = OS_EVENT_TYPE_KERNEL,
 			.kernel = {
@@ -965,20 +1014,40 @@ static inline int _queue_message_exec(module_tcp_pool_t* pool, time_t now)
 
 	return 0;
 }
+/**
+ * @brief the callback used by the timing wheel, which closes the connection that has been idle for too long
+ * @param id the connection object id
+ * @param data the connection pool instance object
+ * @return status code
+ **/
+static int _connection_expire(uint32_t id, void* data)
+{
+	module_tcp_pool_t* pool = (module_tcp_pool_t*)data;
+	uint32_t idx = pool->conn_info.index[id];
+
+	LOG_DEBUG("closing timed out connection %d", pool->conn_info.conn[idx].fd);
+
+	return _connection_close(pool, idx);
+}
+
 /**
  * @brief this function poll the event, and check out all the
- *        active connections and move them at the end of the heap
+ *        active connections and move them at the end of the inactive list
  **/
 static inline int _poll_event(module_tcp_pool_t* pool)
 {
 	/* Determine the max time for this poll call to wait */
 	time_t   now = time(NULL);
 	time_t   time_to_sleep = 0;
-	if(pool->conn_info.heap_limit > 0)
+	time_t   next_expire;
+	int      has_timer = timewheel_next_expire(pool->conn_info.timer, &next_expire);
+	if(ERROR_CODE(int) == has_timer)
+	    ERROR_RETURN_LOG(int, "Cannot get the next idle timeout");
+	if(has_timer)
 	{
 		time_to_sleep = pool->conf.min_timeout;
-		if(pool->conn_info.conn[0].ts + pool->conf.ttl >= now + time_to_sleep)
-		    time_to_sleep = pool->conn_info.conn[0].ts + pool->conf.ttl - now;
+		if(next_expire >= now + time_to_sleep)
+		    time_to_sleep = next_expire - now;
 	}
 
 	int timeout = (time_to_sleep > 0) ? (int)time_to_sleep * 1000 : -1;
@@ -1032,8 +1101,8 @@ static inline int _poll_event(module_tcp_pool_t* pool)
 	}
 
 	/* kick the timeout client out */
-	for(;pool->conn_info.heap_limit > 0 && pool->conn_info.conn[0].ts + pool->conf.ttl <= now; _connection_close(pool, 0))
-	    LOG_DEBUG("closing timed out connection %d", pool->conn_info.conn[0].fd);
+	if(ERROR_CODE(int) == timewheel_advance(pool->conn_info.timer, now, _connection_expire, pool))
+	    LOG_WARNING("Cannot close the timed out connections");
 
 	/* Process incoming request */
 	if(incoming)
@@ -1109,7 +1178,7 @@ static inline int _init_connection_release_message(module_tcp_pool_t* pool, _que
 	switch(mode)
 	{
 		case MODULE_TCP_POOL_RELEASE_MODE_WAIT_FOR_DATA:
-		    LOG_DEBUG("QM#%"PRIu32": deactivate the connection object %"PRIu32" from active list to inactive heap", pool->conn_info.q_rear, id);
+		    LOG_DEBUG("QM#%"PRIu32": deactivate the connection object %"PRIu32" from active list to inactive list", pool->conn_info.q_rear, id);
 		    msg->type = _QM_DEACTIVATE;
 		    msg->id   = id;
 		    msg->data = data;
@@ -71,10 +71,15 @@ static mempool_objpool_t** _small_buffer_pool;
  **/
 static size_t _page_size;
 
+/**
+ * @brief the memory account for the DRA objects and buffers
+ **/
+static mempool_account_t* _account;
+
 int module_tls_dra_init()
 {
-	if(NULL == (_dra_pool = mempool_objpool_new(sizeof(_dra_t))))
-	    ERROR_RETURN_LOG(int, "Cannot allocate memory pool for the DRA callback object");
+	if(NULL == (_account = mempool_account_new("pipe.tls.dra")))
+	    ERROR_RETURN_LOG(int, "Cannot create the memory account for the DRA objects");
 
 	_page_size = (size_t)getpagesize();
 
@@ -82,12 +87,23 @@ int module_tls_dra_init()
 	unsigned pool_count = 0, i;
 	for(;pool_size < _page_size; pool_size *= 2, pool_count ++);
 
+	if(NULL == (_dra_pool = mempool_objpool_new(sizeof(_dra_t))))
+	    ERROR_LOG_GOTO(ERR, "Cannot allocate memory pool for the DRA callback object");
+
+	if(ERROR_CODE(int) == mempool_objpool_set_account(_dra_pool, _account))
+	    ERROR_LOG_GOTO(ERR, "Cannot set the memory account for the DRA object pool");
+
 	if(NULL == (_small_buffer_pool = (mempool_objpool_t**)calloc(pool_count, sizeof(mempool_objpool_t*))))
 	    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the small buffer pools");
 
 	for(pool_size = 32, i = 0; pool_size < _page_size; pool_size *= 2, i ++)
-	    if(NULL == (_small_buffer_pool[i] = mempool_objpool_new((uint32_t)pool_size)))
-	        ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the small buffer pool with size %zu", pool_size);
+	{
+		if(NULL == (_small_buffer_pool[i] = mempool_objpool_new((uint32_t)pool_size)))
+		    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the small buffer pool with size %zu", pool_size);
+
+		if(ERROR_CODE(int) == mempool_objpool_set_account(_small_buffer_pool[i], _account))
+		    ERROR_LOG_GOTO(ERR, "Cannot set the memory account for the small buffer pool with size %zu", pool_size);
+	}
 
 	return 0;
 
@@ -107,6 +123,9 @@ ERR:
 		_dra_pool = NULL;
 	}
 
+	mempool_account_free(_account);
+	_account = NULL;
+
 	return ERROR_CODE(int);
 }
 
@@ -133,6 +152,12 @@ int module_tls_dra_finalize()
 		free(_small_buffer_pool);
 	}
 
+	if(NULL != _account && ERROR_CODE(int) == mempool_account_free(_account))
+	{
+		LOG_ERROR("Cannot dispose the memory account for the DRA objects");
+		rc = ERROR_CODE(int);
+	}
+
 	return rc;
 }
 
@@ -183,7 +208,7 @@ static inline _dra_t* _buffer_dra_new(module_tls_dra_param_t draparam, const voi
 
 	if(small_pool == NULL)
 	{
-		if(NULL == (ret->buffer_page = (int8_t*)mempool_page_alloc()))
+		if(NULL == (ret->buffer_page = (int8_t*)mempool_page_alloc_account(_account)))
 		    ERROR_LOG_GOTO(ERR, "Cannot allocate the buffer page");
 		ret->data_size = size;
 		if(ret->data_size > _page_size)
@@ -226,7 +251,7 @@ static inline _dra_t* _callback_dra_new(module_tls_dra_param_t draparam, itc_mod
 	ret->bio_ctx = draparam.bio;
 	ret->dra_counter = draparam.dra_counter;
 	ret->conn = draparam.conn;
-	if(NULL == (ret->buffer_page = (int8_t*)mempool_page_alloc()))
+	if(NULL == (ret->buffer_page = (int8_t*)mempool_page_alloc_account(_account)))
 	    ERROR_LOG_GOTO(ERR, "Cannot allocate the buffer page");
 
 	ret->callback = data_source;
@@ -264,7 +289,7 @@ static inline int _dra_free(_dra_t* dra)
 
 	if(NULL != dra->buffer_page)
 	{
-		if(NULL == pool && ERROR_CODE(int) == mempool_page_dealloc(dra->buffer_page))
+		if(NULL == pool && ERROR_CODE(int) == mempool_page_dealloc_account(_account, dra->buffer_page))
 		    rc = ERROR_CODE(int);
 
 		if(NULL != pool && ERROR_CODE(int) == mempool_objpool_dealloc(pool, dra->buffer_page))
@@ -38,6 +38,25 @@ struct _os_event_poll_t {
 	size_t         nuenv;               /*!< How many user defined events */
 };
 
+int os_event_set_backend(os_event_backend_t backend)
+{
+	if(backend != OS_EVENT_BACKEND_DEFAULT)
+	    ERROR_RETURN_LOG(int, "Only KQueue is supported on this platform");
+
+	return 0;
+}
+
+os_event_backend_t os_event_get_backend(void)
+{
+	return OS_EVENT_BACKEND_DEFAULT;
+}
+
+os_event_backend_t os_event_poll_get_backend(const os_event_poll_t* poll)
+{
+	(void)poll;
+	return OS_EVENT_BACKEND_DEFAULT;
+}
+
 os_event_poll_t* os_event_poll_new()
 {
 	os_event_poll_t* ret = (os_event_poll_t*)malloc(sizeof(*ret));
@@ -172,7 +191,8 @@ int os_event_poll_add(os_event_poll_t* poll, os_event_desc_t* desc)
 		data = desc->kernel.data;
 
 		if(desc->kernel.event == OS_EVENT_KERNEL_EVENT_IN ||
-		   desc->kernel.event == OS_EVENT_KERNEL_EVENT_CONNECT)
+		   desc->kernel.event == OS_EVENT_KERNEL_EVENT_CONNECT ||
+		   desc->kernel.event == OS_EVENT_KERNEL_EVENT_CONNECT_SHARED)
 		    flags = EVFILT_READ;
 		else if(desc->kernel.event == OS_EVENT_KERNEL_EVENT_OUT)
 		    flags = EVFILT_WRITE;
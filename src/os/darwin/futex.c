@@ -0,0 +1,97 @@
+/**
+ * Copyright (C) 2017-2018, Hao Hou
+ **/
+#include <constants.h>
+#ifdef __DARWIN__
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <error.h>
+
+#include <os/os.h>
+
+#include <utils/log.h>
+
+/**
+ * @brief The number of buckets we used to emulate the futex
+ **/
+#define _NBUCKETS 64
+
+/**
+ * @brief The wait bucket, all the words hashed to the same bucket shares the condition variable
+ **/
+typedef struct {
+	pthread_mutex_t mutex;   /*!< The mutex protects the bucket */
+	pthread_cond_t  cond;    /*!< The condition variable the waiters are parked on */
+} _bucket_t;
+
+static _bucket_t _buckets[_NBUCKETS] = {
+	[0 ... _NBUCKETS - 1] = {
+		.mutex = PTHREAD_MUTEX_INITIALIZER,
+		.cond  = PTHREAD_COND_INITIALIZER
+	}
+};
+
+static inline _bucket_t* _get_bucket(volatile uint32_t* addr)
+{
+	return _buckets + ((((uintptr_t)addr) >> 2) % _NBUCKETS);
+}
+
+int os_futex_wait(volatile uint32_t* addr, uint32_t expected, int timeout)
+{
+	if(NULL == addr) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_bucket_t* bucket = _get_bucket(addr);
+
+	if((errno = pthread_mutex_lock(&bucket->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the bucket mutex");
+
+	if(*addr == expected)
+	{
+		if(timeout < 0)
+		    errno = pthread_cond_wait(&bucket->cond, &bucket->mutex);
+		else
+		{
+			struct timeval now;
+			struct timespec abstime;
+			gettimeofday(&now, NULL);
+			uint64_t nsec = (uint64_t)now.tv_usec * 1000 + (uint64_t)(timeout % 1000) * 1000000;
+			abstime.tv_sec = now.tv_sec + timeout / 1000 + (time_t)(nsec / 1000000000);
+			abstime.tv_nsec = (long)(nsec % 1000000000);
+			errno = pthread_cond_timedwait(&bucket->cond, &bucket->mutex, &abstime);
+		}
+
+		if(errno != 0 && errno != ETIMEDOUT && errno != EINTR)
+		    LOG_WARNING_ERRNO("Cannot wait for the bucket condition variable");
+	}
+
+	if((errno = pthread_mutex_unlock(&bucket->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot release the bucket mutex");
+
+	return 0;
+}
+
+int os_futex_wake(volatile uint32_t* addr, uint32_t count)
+{
+	if(NULL == addr || count == 0) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_bucket_t* bucket = _get_bucket(addr);
+
+	if((errno = pthread_mutex_lock(&bucket->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the bucket mutex");
+
+	/* Since the bucket is shared by different words, we can not tell which waiter is parked
+	 * on this address, so we have to wake up all of them and let them recheck the condition */
+	if((errno = pthread_cond_broadcast(&bucket->cond)) != 0)
+	    LOG_WARNING_ERRNO("Cannot broadcast the bucket condition variable");
+
+	if((errno = pthread_mutex_unlock(&bucket->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot release the bucket mutex");
+
+	return 0;
+}
+
+#endif /* __DARWIN__ */
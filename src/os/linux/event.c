@@ -10,10 +10,12 @@
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <unistd.h>
+#include <poll.h>
 
 #include <error.h>
 
 #include <os/os.h>
+#include <os/linux/uring.h>
 
 #include <utils/log.h>
 
@@ -21,11 +23,46 @@
  * @brief The actual data structure of the poll object
  **/
 struct _os_event_poll_t {
-	int                  epoll_fd;        /*!< The actual epoll FD */
+	int                  epoll_fd;        /*!< The actual epoll FD, -1 if the poll object uses io_uring */
 	struct epoll_event*  event_buf;       /*!< The last event buffer */
 	size_t               event_buf_size;  /*!< The event buffer size */
+	os_event_uring_t*    uring;           /*!< The io_uring poll object, NULL if the poll object uses epoll */
 };
 
+/**
+ * @brief The backend used by the newly created poll objects
+ **/
+static os_event_backend_t _backend = OS_EVENT_BACKEND_DEFAULT;
+
+int os_event_set_backend(os_event_backend_t backend)
+{
+	switch(backend)
+	{
+		case OS_EVENT_BACKEND_DEFAULT:
+		    break;
+		case OS_EVENT_BACKEND_IO_URING:
+#if !OS_EVENT_IO_URING_ENABLED
+		    ERROR_RETURN_LOG(int, "The io_uring backend is not compiled");
+#endif
+		    break;
+		default:
+		    ERROR_RETURN_LOG(int, "Invalid backend");
+	}
+
+	_backend = backend;
+	return 0;
+}
+
+os_event_backend_t os_event_get_backend(void)
+{
+	return _backend;
+}
+
+os_event_backend_t os_event_poll_get_backend(const os_event_poll_t* poll)
+{
+	return NULL != poll && NULL != poll->uring ? OS_EVENT_BACKEND_IO_URING : OS_EVENT_BACKEND_DEFAULT;
+}
+
 os_event_poll_t* os_event_poll_new()
 {
 	os_event_poll_t* ret = (os_event_poll_t*)malloc(sizeof(*ret));
@@ -35,6 +72,17 @@ os_event_poll_t* os_event_poll_new()
 
 	ret->event_buf = NULL;
 	ret->event_buf_size = 0;
+	ret->uring = NULL;
+	ret->epoll_fd = -1;
+
+#if OS_EVENT_IO_URING_ENABLED
+	if(_backend == OS_EVENT_BACKEND_IO_URING)
+	{
+		if(NULL != (ret->uring = os_event_uring_new()))
+		    return ret;
+		LOG_NOTICE("Cannot create the io_uring poll object, fall back to epoll");
+	}
+#endif
 
 	if((ret->epoll_fd = epoll_create1(0)) < 0)
 	    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot create epoll FD for the poll object");
@@ -54,7 +102,12 @@ int os_event_poll_free(os_event_poll_t* poll)
 	 * so we can dipose the event buffer directly */
 	if(NULL != poll->event_buf) free(poll->event_buf);
 
-	if(close(poll->epoll_fd) < 0)
+#if OS_EVENT_IO_URING_ENABLED
+	if(NULL != poll->uring && ERROR_CODE(int) == os_event_uring_free(poll->uring))
+	    rc = ERROR_CODE(int);
+#endif
+
+	if(poll->epoll_fd >= 0 && close(poll->epoll_fd) < 0)
 	{
 		LOG_ERROR_ERRNO("Cannot close the epoll FD %d", poll->epoll_fd);
 		rc = ERROR_CODE(int);
@@ -73,6 +126,13 @@ static inline unsigned _get_epoll_flags(os_event_kernel_event_desc_t* kev)
 		case OS_EVENT_KERNEL_EVENT_CONNECT:
 		    epoll_flags = EPOLLIN | EPOLLET;
 		    break;
+		case OS_EVENT_KERNEL_EVENT_CONNECT_SHARED:
+		    epoll_flags = EPOLLIN | EPOLLET;
+#ifdef EPOLLEXCLUSIVE
+		    /* Avoid the thundering herd when all the poll objects are waiting for the same listening socket */
+		    epoll_flags |= EPOLLEXCLUSIVE;
+#endif
+		    break;
 		case OS_EVENT_KERNEL_EVENT_OUT:
 		    epoll_flags = EPOLLOUT | EPOLLET;
 		    break;
@@ -85,6 +145,32 @@ static inline unsigned _get_epoll_flags(os_event_kernel_event_desc_t* kev)
 	return epoll_flags;
 }
 
+#if OS_EVENT_IO_URING_ENABLED
+/**
+ * @brief get the poll event mask used by the io_uring poll request
+ * @note the io_uring poll request is edge-triggered by default, and we don't use the exclusive flag for the shared
+ *       listening socket, since it can not be used with the multishot poll request
+ * @param kev the kernel event
+ * @return the event mask or error code
+ **/
+static inline uint32_t _get_poll_events(os_event_kernel_event_desc_t* kev)
+{
+	switch(kev->event)
+	{
+		case OS_EVENT_KERNEL_EVENT_IN:
+		case OS_EVENT_KERNEL_EVENT_CONNECT:
+		case OS_EVENT_KERNEL_EVENT_CONNECT_SHARED:
+		    return POLLIN;
+		case OS_EVENT_KERNEL_EVENT_OUT:
+		    return POLLOUT;
+		case OS_EVENT_KERNEL_EVENT_BIDIR:
+		    return POLLIN | POLLOUT;
+		default:
+		    ERROR_RETURN_LOG(uint32_t, "Invalid kernel event type");
+	}
+}
+#endif
+
 int os_event_poll_modify(os_event_poll_t* poll, os_event_desc_t* desc)
 {
 	if(NULL == poll || NULL == desc)
@@ -93,11 +179,26 @@ int os_event_poll_modify(os_event_poll_t* poll, os_event_desc_t* desc)
 	if(desc->type != OS_EVENT_TYPE_KERNEL)
 	    ERROR_RETURN_LOG(int, "Only kernel event is allowed");
 
+#if OS_EVENT_IO_URING_ENABLED
+	if(NULL != poll->uring)
+	{
+		uint32_t events = _get_poll_events(&desc->kernel);
+		if(ERROR_CODE(uint32_t) == events)
+		    ERROR_RETURN_LOG(int, "Cannot determine the poll events");
+		return os_event_uring_modify(poll->uring, desc->kernel.fd, events, desc->kernel.data);
+	}
+#endif
+
 	unsigned epoll_flags = _get_epoll_flags(&desc->kernel);
 
 	if(ERROR_CODE(unsigned) == epoll_flags)
 	    ERROR_RETURN_LOG(int, "Cannot determine the epoll flags");
 
+#ifdef EPOLLEXCLUSIVE
+	/* The exclusive flag is only allowed when the FD is added */
+	epoll_flags &= ~(unsigned)EPOLLEXCLUSIVE;
+#endif
+
 	struct epoll_event event = {
 		.events = epoll_flags,
 		.data = {
@@ -145,6 +246,18 @@ int os_event_poll_add(os_event_poll_t* poll, os_event_desc_t* desc)
 		    ERROR_RETURN_LOG(int, "Invalid event type");
 	}
 
+#if OS_EVENT_IO_URING_ENABLED
+	if(NULL != poll->uring)
+	{
+		uint32_t events = desc->type == OS_EVENT_TYPE_KERNEL ? _get_poll_events(&desc->kernel) : POLLIN;
+		if(ERROR_CODE(uint32_t) == events)
+		    ERROR_LOG_GOTO(ERR, "Cannot determine the poll events");
+		if(ERROR_CODE(int) == os_event_uring_add(poll->uring, fd, events, data))
+		    ERROR_LOG_GOTO(ERR, "Cannot add target FD to the io_uring poll object");
+		return fd;
+	}
+#endif
+
 	struct epoll_event event = {
 		.events = epoll_flags,
 		.data = {
@@ -153,7 +266,19 @@ int os_event_poll_add(os_event_poll_t* poll, os_event_desc_t* desc)
 	};
 
 	if(epoll_ctl(poll->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
-	    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot add target FD to the epoll");
+	{
+#ifdef EPOLLEXCLUSIVE
+		/* The kernel before 4.5 doesn't support the exclusive flag, so we just wake up all the poll objects */
+		if(errno == EINVAL && (event.events & EPOLLEXCLUSIVE))
+		{
+			LOG_NOTICE("EPOLLEXCLUSIVE is not supported by the kernel, the shared socket wakes up all the poll objects");
+			event.events &= ~(unsigned)EPOLLEXCLUSIVE;
+			if(epoll_ctl(poll->epoll_fd, EPOLL_CTL_ADD, fd, &event) >= 0)
+			    return fd;
+		}
+#endif
+		ERROR_LOG_ERRNO_GOTO(ERR, "Cannot add target FD to the epoll");
+	}
 
 	return fd;
 ERR:
@@ -166,6 +291,11 @@ int os_event_poll_del(os_event_poll_t* poll, int fd, int read)
 	(void)read;
 	if(NULL == poll || fd < 0) ERROR_RETURN_LOG(int, "Invalid arguments");
 
+#if OS_EVENT_IO_URING_ENABLED
+	if(NULL != poll->uring)
+	    return os_event_uring_del(poll->uring, fd);
+#endif
+
 	if(epoll_ctl(poll->epoll_fd, EPOLL_CTL_DEL, fd, NULL) < 0)
 	    ERROR_RETURN_LOG_ERRNO(int, "Cannot delete the target FD from epoll");
 
@@ -177,6 +307,11 @@ int os_event_poll_wait(os_event_poll_t* poll, size_t max_events, int timeout)
 	if(NULL == poll || max_events == 0)
 	    ERROR_RETURN_LOG(int, "Invalid arguments");
 
+#if OS_EVENT_IO_URING_ENABLED
+	if(NULL != poll->uring)
+	    return os_event_uring_wait(poll->uring, max_events, timeout);
+#endif
+
 	if(max_events > poll->event_buf_size)
 	{
 		if(NULL != poll->event_buf) free(poll->event_buf);
@@ -200,6 +335,11 @@ int os_event_poll_wait(os_event_poll_t* poll, size_t max_events, int timeout)
 
 void* os_event_poll_take_result(os_event_poll_t* poll, size_t idx)
 {
+#if OS_EVENT_IO_URING_ENABLED
+	if(NULL != poll && NULL != poll->uring)
+	    return os_event_uring_take_result(poll->uring, idx);
+#endif
+
 	if(NULL == poll || idx > poll->event_buf_size)
 	    return NULL;
 
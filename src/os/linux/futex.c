@@ -0,0 +1,53 @@
+/**
+ * Copyright (C) 2017-2018, Hao Hou
+ **/
+#include <constants.h>
+#ifdef __LINUX__
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include <error.h>
+
+#include <os/os.h>
+
+#include <utils/log.h>
+
+int os_futex_wait(volatile uint32_t* addr, uint32_t expected, int timeout)
+{
+	if(NULL == addr) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	struct timespec ts, *pts = NULL;
+
+	if(timeout >= 0)
+	{
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
+		pts = &ts;
+	}
+
+	if(syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, pts, NULL, 0) < 0 &&
+	   errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot wait for the futex");
+
+	return 0;
+}
+
+int os_futex_wake(volatile uint32_t* addr, uint32_t count)
+{
+	if(NULL == addr || count == 0) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	int n = count > INT_MAX ? INT_MAX : (int)count;
+
+	if(syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0) < 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot wake up the futex");
+
+	return 0;
+}
+
+#endif /* __LINUX__ */
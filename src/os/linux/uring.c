@@ -0,0 +1,463 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+#include <constants.h>
+#if defined(__LINUX__) && OS_EVENT_IO_URING_ENABLED
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include <error.h>
+
+#include <os/os.h>
+#include <os/linux/uring.h>
+
+#include <utils/log.h>
+
+/**
+ * @brief A FD watched by the poll object
+ **/
+typedef struct _reg_t {
+	int             fd;        /*!< The FD */
+	uint32_t        events;    /*!< The poll event mask */
+	void*           data;      /*!< The data returned when the FD gets ready */
+	uint32_t        armed:1;   /*!< If there's a poll request for this FD in the kernel */
+	uint32_t        deleted:1; /*!< If the FD has been removed from the poll object */
+	unsigned        reported;  /*!< The sequence number of the last wait which reported this FD */
+	struct _reg_t*  next;      /*!< The next registration in the free list */
+} _reg_t;
+
+/**
+ * @brief A block of registrations, we allocate the registrations in blocks and never give them back until the poll object is disposed
+ **/
+typedef struct _reg_block_t {
+	struct _reg_block_t* next;                                     /*!< The next block */
+	_reg_t               regs[OS_EVENT_IO_URING_REG_BLOCK_SIZE];   /*!< The registrations */
+} _reg_block_t;
+
+/**
+ * @brief The actual data structure of the io_uring poll object
+ **/
+struct _os_event_uring_t {
+	int                  ring_fd;       /*!< The io_uring FD */
+	void*                sq_ring;       /*!< The mapped submission queue ring */
+	size_t               sq_ring_size;  /*!< The size of the submission queue ring mapping */
+	void*                cq_ring;       /*!< The mapped completion queue ring, may be the same as the submission queue ring */
+	size_t               cq_ring_size;  /*!< The size of the completion queue ring mapping */
+	struct io_uring_sqe* sqes;          /*!< The submission queue entries */
+	size_t               sqes_size;     /*!< The size of the submission queue entry mapping */
+	unsigned*            sq_head;       /*!< The head of the submission queue */
+	unsigned*            sq_tail;       /*!< The tail of the submission queue */
+	unsigned*            sq_array;      /*!< The submission queue index array */
+	unsigned             sq_mask;       /*!< The submission queue mask */
+	unsigned             sq_entries;    /*!< The number of submission queue entries */
+	unsigned*            cq_head;       /*!< The head of the completion queue */
+	unsigned*            cq_tail;       /*!< The tail of the completion queue */
+	unsigned             cq_mask;       /*!< The completion queue mask */
+	struct io_uring_cqe* cqes;          /*!< The completion queue entries */
+	unsigned             to_submit;     /*!< The number of queued requests that haven't been submitted */
+	unsigned             seq;           /*!< The sequence number of the current wait */
+	_reg_t**             fd_regs;       /*!< The registration of each FD */
+	size_t               fd_regs_cap;   /*!< The capacity of the FD registration table */
+	_reg_t*              free_regs;     /*!< The unused registrations */
+	_reg_block_t*        blocks;        /*!< The registration blocks */
+	void**               result;        /*!< The result buffer of the last wait */
+	size_t               result_size;   /*!< The size of the result buffer */
+};
+
+static inline int _enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t argsz)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+/**
+ * @brief submit all the queued requests to the kernel without waiting
+ * @param uring the poll object
+ * @return status code
+ **/
+static inline int _submit(os_event_uring_t* uring)
+{
+	while(uring->to_submit > 0)
+	{
+		int rc = _enter(uring->ring_fd, uring->to_submit, 0, 0, NULL, 0);
+		if(rc < 0)
+		{
+			if(errno == EINTR) continue;
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot submit the io_uring requests");
+		}
+		uring->to_submit -= (unsigned)rc;
+	}
+	return 0;
+}
+
+/**
+ * @brief get a new submission queue entry, if the queue is full, the queued requests are submitted first
+ * @param uring the poll object
+ * @return the entry or NULL on error
+ **/
+static inline struct io_uring_sqe* _get_sqe(os_event_uring_t* uring)
+{
+	unsigned tail = *uring->sq_tail;
+
+	if(tail - __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE) >= uring->sq_entries)
+	{
+		if(ERROR_CODE(int) == _submit(uring))
+		    ERROR_PTR_RETURN_LOG("Cannot flush the submission queue");
+		if(tail - __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE) >= uring->sq_entries)
+		    ERROR_PTR_RETURN_LOG("The submission queue is still full");
+	}
+
+	unsigned idx = tail & uring->sq_mask;
+	struct io_uring_sqe* ret = uring->sqes + idx;
+	memset(ret, 0, sizeof(*ret));
+	uring->sq_array[idx] = idx;
+
+	return ret;
+}
+
+/**
+ * @brief publish the entry returned by the last _get_sqe call
+ * @param uring the poll object
+ * @return nothing
+ **/
+static inline void _push_sqe(os_event_uring_t* uring)
+{
+	__atomic_store_n(uring->sq_tail, *uring->sq_tail + 1, __ATOMIC_RELEASE);
+	uring->to_submit ++;
+}
+
+static inline _reg_t* _reg_alloc(os_event_uring_t* uring)
+{
+	if(NULL == uring->free_regs)
+	{
+		_reg_block_t* block = (_reg_block_t*)malloc(sizeof(_reg_block_t));
+		if(NULL == block) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the registration block");
+
+		block->next = uring->blocks;
+		uring->blocks = block;
+
+		uint32_t i;
+		for(i = 0; i < OS_EVENT_IO_URING_REG_BLOCK_SIZE; i ++)
+		{
+			block->regs[i].next = uring->free_regs;
+			uring->free_regs = block->regs + i;
+		}
+	}
+
+	_reg_t* ret = uring->free_regs;
+	uring->free_regs = ret->next;
+
+	ret->armed = 0;
+	ret->deleted = 0;
+	ret->reported = uring->seq - 1;
+	ret->next = NULL;
+
+	return ret;
+}
+
+static inline void _reg_release(os_event_uring_t* uring, _reg_t* reg)
+{
+	reg->next = uring->free_regs;
+	uring->free_regs = reg;
+}
+
+/**
+ * @brief queue the multishot poll request for the registration
+ * @param uring the poll object
+ * @param reg the registration
+ * @return status code
+ **/
+static inline int _arm(os_event_uring_t* uring, _reg_t* reg)
+{
+	struct io_uring_sqe* sqe = _get_sqe(uring);
+	if(NULL == sqe) ERROR_RETURN_LOG(int, "Cannot get the submission queue entry");
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = reg->fd;
+	sqe->poll32_events = reg->events;
+	sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->user_data = (uint64_t)(uintptr_t)reg;
+
+	_push_sqe(uring);
+	reg->armed = 1;
+
+	return 0;
+}
+
+os_event_uring_t* os_event_uring_new(void)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	os_event_uring_t* ret = (os_event_uring_t*)calloc(1, sizeof(*ret));
+	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the io_uring poll object");
+
+	ret->sq_ring = ret->cq_ring = ret->sqes = MAP_FAILED;
+
+	if((ret->ring_fd = (int)syscall(__NR_io_uring_setup, OS_EVENT_IO_URING_QUEUE_DEPTH, &params)) < 0)
+	{
+		LOG_NOTICE_ERRNO("Cannot create the io_uring instance");
+		goto ERR;
+	}
+
+	/* We need multishot poll (Linux 5.13, which also introduces the resource tags) and the timeout argument of io_uring_enter */
+	if(!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_RSRC_TAGS))
+	{
+		LOG_NOTICE("The io_uring of this kernel doesn't support the features required by the poll object");
+		goto ERR;
+	}
+
+	ret->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ret->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(ret->cq_ring_size > ret->sq_ring_size) ret->sq_ring_size = ret->cq_ring_size;
+		ret->cq_ring_size = ret->sq_ring_size;
+	}
+
+	ret->sq_ring = mmap(NULL, ret->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ret->ring_fd, IORING_OFF_SQ_RING);
+	if(MAP_FAILED == ret->sq_ring) ERROR_LOG_ERRNO_GOTO(ERR, "Cannot map the submission queue ring");
+
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+	    ret->cq_ring = ret->sq_ring;
+	else if(MAP_FAILED == (ret->cq_ring = mmap(NULL, ret->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ret->ring_fd, IORING_OFF_CQ_RING)))
+	    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot map the completion queue ring");
+
+	ret->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ret->sqes = (struct io_uring_sqe*)mmap(NULL, ret->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ret->ring_fd, IORING_OFF_SQES);
+	if(MAP_FAILED == ret->sqes) ERROR_LOG_ERRNO_GOTO(ERR, "Cannot map the submission queue entries");
+
+	int8_t* sq = (int8_t*)ret->sq_ring;
+	int8_t* cq = (int8_t*)ret->cq_ring;
+
+	ret->sq_head = (unsigned*)(sq + params.sq_off.head);
+	ret->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+	ret->sq_array = (unsigned*)(sq + params.sq_off.array);
+	ret->sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+	ret->sq_entries = *(unsigned*)(sq + params.sq_off.ring_entries);
+	ret->cq_head = (unsigned*)(cq + params.cq_off.head);
+	ret->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+	ret->cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+	ret->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+	ret->seq = 1;
+
+	LOG_DEBUG("io_uring poll object has been created with %u submission queue entries", ret->sq_entries);
+
+	return ret;
+ERR:
+	os_event_uring_free(ret);
+	return NULL;
+}
+
+int os_event_uring_free(os_event_uring_t* uring)
+{
+	if(NULL == uring) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	int rc = 0;
+
+	if(MAP_FAILED != uring->sqes) munmap(uring->sqes, uring->sqes_size);
+	if(MAP_FAILED != uring->cq_ring && uring->cq_ring != uring->sq_ring) munmap(uring->cq_ring, uring->cq_ring_size);
+	if(MAP_FAILED != uring->sq_ring) munmap(uring->sq_ring, uring->sq_ring_size);
+
+	/* Closing the ring cancels all the poll requests, so we are able to dispose the registrations after this */
+	if(uring->ring_fd >= 0 && close(uring->ring_fd) < 0)
+	{
+		LOG_ERROR_ERRNO("Cannot close the io_uring FD %d", uring->ring_fd);
+		rc = ERROR_CODE(int);
+	}
+
+	for(;NULL != uring->blocks;)
+	{
+		_reg_block_t* block = uring->blocks;
+		uring->blocks = block->next;
+		free(block);
+	}
+
+	if(NULL != uring->fd_regs) free(uring->fd_regs);
+	if(NULL != uring->result) free(uring->result);
+
+	free(uring);
+
+	return rc;
+}
+
+int os_event_uring_add(os_event_uring_t* uring, int fd, uint32_t events, void* data)
+{
+	if(NULL == uring || fd < 0) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if((size_t)fd >= uring->fd_regs_cap)
+	{
+		size_t new_cap = uring->fd_regs_cap > 0 ? uring->fd_regs_cap : 1024;
+		for(;new_cap <= (size_t)fd; new_cap *= 2);
+
+		_reg_t** new_regs = (_reg_t**)realloc(uring->fd_regs, new_cap * sizeof(_reg_t*));
+		if(NULL == new_regs) ERROR_RETURN_LOG_ERRNO(int, "Cannot resize the FD registration table");
+
+		memset(new_regs + uring->fd_regs_cap, 0, (new_cap - uring->fd_regs_cap) * sizeof(_reg_t*));
+		uring->fd_regs = new_regs;
+		uring->fd_regs_cap = new_cap;
+	}
+
+	if(NULL != uring->fd_regs[fd])
+	    ERROR_RETURN_LOG(int, "The FD %d is already in the poll object", fd);
+
+	_reg_t* reg = _reg_alloc(uring);
+	if(NULL == reg) ERROR_RETURN_LOG(int, "Cannot allocate the registration");
+
+	reg->fd = fd;
+	reg->events = events;
+	reg->data = data;
+
+	if(ERROR_CODE(int) == _arm(uring, reg))
+	{
+		_reg_release(uring, reg);
+		ERROR_RETURN_LOG(int, "Cannot queue the poll request for FD %d", fd);
+	}
+
+	uring->fd_regs[fd] = reg;
+
+	return 0;
+}
+
+int os_event_uring_del(os_event_uring_t* uring, int fd)
+{
+	if(NULL == uring || fd < 0) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_reg_t* reg = (size_t)fd < uring->fd_regs_cap ? uring->fd_regs[fd] : NULL;
+
+	if(NULL == reg) ERROR_RETURN_LOG(int, "The FD %d is not in the poll object", fd);
+
+	uring->fd_regs[fd] = NULL;
+	reg->deleted = 1;
+
+	/* If the poll request has already terminated, nothing in the kernel references the registration */
+	if(!reg->armed)
+	{
+		_reg_release(uring, reg);
+		return 0;
+	}
+
+	/* Otherwise, the registration is released when the last completion of the poll request is reaped */
+	struct io_uring_sqe* sqe = _get_sqe(uring);
+	if(NULL == sqe) ERROR_RETURN_LOG(int, "Cannot get the submission queue entry");
+
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = (uint64_t)(uintptr_t)reg;
+	sqe->user_data = 0;
+
+	_push_sqe(uring);
+
+	return 0;
+}
+
+int os_event_uring_modify(os_event_uring_t* uring, int fd, uint32_t events, void* data)
+{
+	if(NULL == uring || fd < 0) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_reg_t* reg = (size_t)fd < uring->fd_regs_cap ? uring->fd_regs[fd] : NULL;
+
+	if(NULL != reg && reg->events == events)
+	{
+		reg->data = data;
+		return 0;
+	}
+
+	if(NULL != reg && ERROR_CODE(int) == os_event_uring_del(uring, fd))
+	    ERROR_RETURN_LOG(int, "Cannot remove the previous poll request for FD %d", fd);
+
+	return os_event_uring_add(uring, fd, events, data);
+}
+
+int os_event_uring_wait(os_event_uring_t* uring, size_t max_events, int timeout)
+{
+	if(NULL == uring || max_events == 0) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if(max_events > uring->result_size)
+	{
+		if(NULL != uring->result) free(uring->result);
+		uring->result_size = 0;
+		if(NULL == (uring->result = (void**)calloc(max_events, sizeof(void*))))
+		    ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate the result buffer");
+		uring->result_size = max_events;
+	}
+
+	unsigned head = *uring->cq_head;
+	unsigned min_complete = (timeout != 0 && head == __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE)) ? 1 : 0;
+
+	if(uring->to_submit > 0 || min_complete > 0)
+	{
+		struct __kernel_timespec ts = {
+			.tv_sec  = timeout / 1000,
+			.tv_nsec = (timeout % 1000) * 1000000
+		};
+		struct io_uring_getevents_arg arg = {
+			.ts = timeout > 0 ? (uint64_t)(uintptr_t)&ts : 0
+		};
+
+		unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG : 0;
+
+		int rc = _enter(uring->ring_fd, uring->to_submit, min_complete, flags, min_complete > 0 ? &arg : NULL, min_complete > 0 ? sizeof(arg) : 0);
+		if(rc < 0)
+		{
+			if(errno != EINTR && errno != ETIME)
+			    ERROR_RETURN_LOG_ERRNO(int, "Cannot finish io_uring_enter syscall");
+		}
+		else uring->to_submit -= (unsigned)rc;
+	}
+
+	unsigned tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+	int ret = 0;
+	unsigned seq = uring->seq ++;
+
+	for(;head != tail && (size_t)ret < max_events; head ++)
+	{
+		const struct io_uring_cqe* cqe = uring->cqes + (head & uring->cq_mask);
+		_reg_t* reg = (_reg_t*)(uintptr_t)cqe->user_data;
+
+		/* The completion of a poll remove request */
+		if(NULL == reg) continue;
+
+		if(!(cqe->flags & IORING_CQE_F_MORE)) reg->armed = 0;
+
+		if(reg->deleted)
+		{
+			if(!reg->armed) _reg_release(uring, reg);
+			continue;
+		}
+
+		if(cqe->res < 0)
+		    LOG_WARNING("The poll request for FD %d returns an error: %s", reg->fd, strerror(-cqe->res));
+		else if(!reg->armed && ERROR_CODE(int) == _arm(uring, reg))
+		    LOG_WARNING("Cannot rearm the poll request for FD %d", reg->fd);
+
+		/* The FD may be woken up multiple times before we reap the completions, but we only report it once */
+		if(reg->reported == seq) continue;
+		reg->reported = seq;
+
+		uring->result[ret ++] = reg->data;
+	}
+
+	__atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+
+	return ret;
+}
+
+void* os_event_uring_take_result(os_event_uring_t* uring, size_t idx)
+{
+	if(NULL == uring || idx >= uring->result_size)
+	    return NULL;
+
+	return uring->result[idx];
+}
+
+#endif /* __LINUX__ && OS_EVENT_IO_URING_ENABLED */
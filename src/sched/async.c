@@ -31,6 +31,7 @@
 
 #include <utils/log.h>
 #include <utils/thread.h>
+#include <utils/clock.h>
 #include <utils/mempool/objpool.h>
 
 #include <itc/module_types.h>
@@ -47,6 +48,7 @@
 #include <sched/service.h>
 #include <sched/task.h>
 #include <sched/async.h>
+#include <sched/trace.h>
 
 #include <lang/prop.h>
 
@@ -329,6 +331,8 @@ UNLOCK:
 		if(thread_data->task == NULL) continue;
 
 		LOG_DEBUG("Staring the async exec task");
+		int traced = sched_trace_sampled(thread_data->task->sched_task);
+		uint64_t trace_start = traced ? utils_clock_now_ns() : 0;
 		if(ERROR_CODE(int) == runtime_task_start(thread_data->task->exec_task))
 		{
 			thread_data->task->status_code = ERROR_CODE(int);;
@@ -336,6 +340,9 @@ UNLOCK:
 		}
 		else thread_data->task->status_code = 0;
 
+		if(traced && ERROR_CODE(int) == sched_trace_span(thread_data->task->sched_task, SCHED_TRACE_PHASE_ASYNC_EXEC, trace_start))
+		    LOG_WARNING("Cannot record the trace span");
+
 		if(thread_data->task->await_id == ERROR_CODE(uint32_t))
 		    thread_data->task->state = _STATE_DONE;
 
@@ -400,6 +407,12 @@ static inline int _set_prop(const char* symbol, lang_prop_value_t value, const v
 		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
 		_ctx.al_cap = (uint32_t)value.num;
 	}
+	else if(strcmp(symbol, "cpus") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_STRING) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(ERROR_CODE(int) == thread_set_affinity_policy(THREAD_TYPE_ASYNC, value.str))
+		    ERROR_RETURN_LOG(int, "Cannot set the CPU affinity policy for the async processing threads");
+	}
 	else
 	{
 		LOG_TRACE("Invalid property scheduler.async.%s", symbol);
@@ -436,6 +449,24 @@ static lang_prop_value_t _get_prop(const char* symbol, const void* param)
 		ret.type = LANG_PROP_TYPE_INTEGER;
 		ret.num = _ctx.al_cap;
 	}
+	else if(strcmp(symbol, "cpus") == 0)
+	{
+		const char* cpus = thread_get_affinity_policy(THREAD_TYPE_ASYNC);
+		if(NULL == cpus)
+		{
+			LOG_WARNING("Cannot get the CPU affinity policy");
+			ret.type = LANG_PROP_TYPE_ERROR;
+			return ret;
+		}
+
+		ret.type = LANG_PROP_TYPE_STRING;
+		if(NULL == (ret.str = strdup(cpus)))
+		{
+			LOG_WARNING_ERRNO("Cannot allocate memory for the CPU list string");
+			ret.type = LANG_PROP_TYPE_ERROR;
+			return ret;
+		}
+	}
 
 	return ret;
 }
@@ -457,7 +488,7 @@ int sched_async_init()
 
 int sched_async_finalize()
 {
-	return 0;
+	return thread_set_affinity_policy(THREAD_TYPE_ASYNC, NULL);
 }
 
 int sched_async_start()
@@ -656,12 +687,19 @@ int sched_async_task_post(sched_loop_t* loop, sched_task_t* task)
 
 	task->exec_task->async_handle = (runtime_api_async_handle_t*)handle;
 
+	int traced = sched_trace_sampled(task);
+	uint64_t trace_start = traced ? utils_clock_now_ns() : 0;
+
 	/* After that we need to call the async_setup function to get this initialized */
 #ifdef FULL_OPTIMIZATION
-	if(ERROR_CODE(int) == runtime_task_start_async_setup_fast(task->exec_task))
+	int setup_rc = runtime_task_start_async_setup_fast(task->exec_task);
 #else
-	if(ERROR_CODE(int) == runtime_task_start(task->exec_task))
+	int setup_rc = runtime_task_start(task->exec_task);
 #endif
+	if(traced && ERROR_CODE(int) == sched_trace_span(task, SCHED_TRACE_PHASE_ASYNC_SETUP, trace_start))
+	    LOG_WARNING("Cannot record the trace span");
+
+	if(ERROR_CODE(int) == setup_rc)
 	    ERROR_LOG_GOTO(ERR, "The async setup task returns an error code");
 
 	/* Ok it seems the task has been successfully setup, construct its continuation at this point */
@@ -750,6 +788,27 @@ ERR:
 	return ERROR_CODE(int);
 }
 
+int sched_async_get_stat(sched_async_stat_t* buf)
+{
+	if(NULL == buf) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	memset(buf, 0, sizeof(*buf));
+
+	if(!_ctx.init) return 0;
+
+	buf->queue_size = _ctx.q_cap;
+	buf->queue_depth = _ctx.q_rear - _ctx.q_front;
+	buf->nthreads = _ctx.nthreads;
+
+	uint32_t i;
+	if(NULL != _ctx.thread_data)
+	    for(i = 0; i < _ctx.nthreads; i ++)
+	        if(NULL != _ctx.thread_data[i].task)
+	            buf->busy_threads ++;
+
+	return 0;
+}
+
 int sched_async_handle_dispose(runtime_api_async_handle_t* handle)
 {
 	if(_ctx.q_pool == NULL) return 0;
@@ -13,6 +13,7 @@
 #include <string.h>
 #include <errno.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <fcntl.h>
@@ -25,9 +26,15 @@
 #include <utils/log.h>
 #include <utils/static_assertion.h>
 #include <utils/thread.h>
+#include <utils/histogram.h>
+#include <utils/mempool/page.h>
+#include <utils/mempool/objpool.h>
 
 #include <itc/module_types.h>
 #include <itc/module.h>
+#include <itc/modtab.h>
+#include <itc/equeue.h>
+#include <itc/eloop.h>
 
 #include <runtime/api.h>
 #include <runtime/pdt.h>
@@ -36,8 +43,12 @@
 #include <runtime/stab.h>
 #include <lang/prop.h>
 
+#include <sched/rscope.h>
 #include <sched/service.h>
 #include <sched/loop.h>
+#include <sched/task.h>
+#include <sched/async.h>
+#include <sched/prof.h>
 #include <sched/daemon.h>
 
 /**
@@ -55,6 +66,7 @@ typedef enum {
 	_DAEMON_PING,    /*!< Ping a daemon */
 	_DAEMON_STOP,    /*!< Stop current daemon */
 	_DAEMON_RELOAD,  /*!< Reload current daemon */
+	_DAEMON_STATS,   /*!< Query the runtime statistics of current daemon */
 	_DAEMON_OP_COUNT /*!< The number of deamon operations */
 } _daemon_op_t;
 
@@ -64,7 +76,8 @@ typedef enum {
 static const size_t _daemon_op_data_size[_DAEMON_OP_COUNT] = {
 	[_DAEMON_STOP] = 0,
 	[_DAEMON_PING] = 0,
-	[_DAEMON_RELOAD] = 0
+	[_DAEMON_RELOAD] = 0,
+	[_DAEMON_STATS] = 0
 };
 
 
@@ -116,6 +129,13 @@ static uint32_t _admin_gid = ERROR_CODE(uint32_t);
  **/
 static thread_t* _reload_thread = NULL;
 
+/**
+ * @brief Indicates if the reload thread has been started and haven't done yet
+ * @note This is set by the dispatcher before the reload thread is created, thus the
+ *       dispatcher can be sure the service won't be disposed while this is 0
+ **/
+static volatile int _reload_in_progress = 0;
+
 /**
  * @brief Check if the given name is a running daemon
  * @param lockfile The name of the lock file
@@ -309,6 +329,7 @@ static void* _reload_main(void* param)
 	    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot send the operation result ot client");
 	close(fd);
 	running = 0;
+	_reload_in_progress = 0;
 	return NULL;
 ERR:
 	if(switched_namespace)
@@ -318,9 +339,200 @@ ERR:
 	    LOG_ERROR_ERRNO("Cannot send the failure status code to client");
 	close(fd);
 	if(started) running = 0;
+	_reload_in_progress = 0;
 	return NULL;
 }
 
+/**
+ * @brief Write the per-node profiler data of the service which is currently running
+ * @param fp The output file
+ * @return status code
+ **/
+static inline int _write_profiler_stats(FILE* fp)
+{
+	/* The reload thread disposes the old service once the deployment is done. Since the reload thread is only
+	 * started by the dispatcher, no deployment can start before we are done if there's no one in progress */
+	if(_reload_in_progress) return 0;
+
+	const sched_service_t* service = sched_loop_get_service();
+	if(NULL == service) return 0;
+
+	sched_prof_t* prof = sched_service_get_profiler(service);
+	if(NULL == prof) return 0;
+
+	size_t num_nodes = sched_service_get_num_node(service);
+	if(ERROR_CODE(size_t) == num_nodes)
+	    ERROR_RETURN_LOG(int, "Cannot get the number of nodes in the service");
+
+	sched_prof_record_t* rec = (sched_prof_record_t*)malloc(sizeof(sched_prof_record_t));
+	if(NULL == rec) ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the profiler record");
+
+	sched_service_node_id_t i;
+	for(i = 0; i < num_nodes; i ++)
+	{
+		if(ERROR_CODE(int) == sched_prof_get_stat(prof, i, rec))
+		    ERROR_LOG_GOTO(ERR, "Cannot get the profiler data of node %u", i);
+
+		if(rec->count == 0) continue;
+
+		fprintf(fp, "profiler.node.%u.count %"PRIu64"\n", i, rec->count);
+		fprintf(fp, "profiler.node.%u.cpu_avg %"PRIu64"\n", i, rec->time / rec->count);
+		fprintf(fp, "profiler.node.%u.cpu_p50 %"PRIu64"\n", i, utils_histogram_percentile(&rec->cpu_hist, 50));
+		fprintf(fp, "profiler.node.%u.cpu_p99 %"PRIu64"\n", i, utils_histogram_percentile(&rec->cpu_hist, 99));
+		fprintf(fp, "profiler.node.%u.wall_avg %"PRIu64"\n", i, rec->wall_time / rec->count);
+		fprintf(fp, "profiler.node.%u.wall_p50 %"PRIu64"\n", i, utils_histogram_percentile(&rec->wall_hist, 50));
+		fprintf(fp, "profiler.node.%u.wall_p99 %"PRIu64"\n", i, utils_histogram_percentile(&rec->wall_hist, 99));
+		fprintf(fp, "profiler.node.%u.wall_max %"PRIu64"\n", i, rec->wall_hist.max);
+		fprintf(fp, "profiler.node.%u.queue_avg %"PRIu64"\n", i, rec->queue_hist.count == 0 ? 0 : rec->queue_time / rec->queue_hist.count);
+		fprintf(fp, "profiler.node.%u.queue_p50 %"PRIu64"\n", i, utils_histogram_percentile(&rec->queue_hist, 50));
+		fprintf(fp, "profiler.node.%u.queue_p99 %"PRIu64"\n", i, utils_histogram_percentile(&rec->queue_hist, 99));
+	}
+
+	free(rec);
+	return 0;
+ERR:
+	free(rec);
+	return ERROR_CODE(int);
+}
+
+/**
+ * @brief Write the statistics of all the module instances, which includes the event queue used by
+ *        the event loop of the instance and the "stats" property the module exposes
+ * @details The "stats" property is a string which has the same format as the stats output,
+ *          and each key is prefixed with the module path
+ * @param fp The output file
+ * @return status code
+ **/
+static inline int _write_module_stats(FILE* fp)
+{
+	itc_modtab_dir_iter_t iter;
+	if(ERROR_CODE(int) == itc_modtab_open_dir("", &iter))
+	    ERROR_RETURN_LOG(int, "Cannot open the module addressing table");
+
+	const itc_modtab_instance_t* inst;
+	while(NULL != (inst = itc_modtab_dir_iter_next(&iter)))
+	{
+		itc_equeue_token_t token = itc_eloop_get_token(inst->module_id);
+		itc_equeue_stat_t eq_stat;
+
+		if(ERROR_CODE(itc_equeue_token_t) != token && ERROR_CODE(int) != itc_equeue_get_stat(token, &eq_stat))
+		{
+			fprintf(fp, "%s.equeue.size %"PRIu32"\n", inst->path, eq_stat.size);
+			fprintf(fp, "%s.equeue.depth %"PRIu32"\n", inst->path, eq_stat.depth);
+			fprintf(fp, "%s.equeue.shared %u\n", inst->path, eq_stat.shared);
+		}
+
+		if(NULL == inst->module->get_property) continue;
+
+		itc_module_property_value_t value = inst->module->get_property(inst->context, "stats");
+		if(value.type != ITC_MODULE_PROPERTY_TYPE_STRING) continue;
+
+		const char* line, *end;
+		for(line = value.str; *line; line = *end ? end + 1 : end)
+		{
+			if(NULL == (end = strchr(line, '\n'))) end = line + strlen(line);
+			if(end > line) fprintf(fp, "%s.%.*s\n", inst->path, (int)(end - line), line);
+		}
+
+		free(value.str);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Write the statistics of a single memory account
+ * @param stat The snapshot of the memory account
+ * @param data The output file
+ * @return status code
+ **/
+static int _write_account_stat(const mempool_account_stat_t* stat, void* data)
+{
+	FILE* fp = (FILE*)data;
+
+	fprintf(fp, "mempool.account.%s.bytes %zu\n", stat->name, stat->bytes);
+	fprintf(fp, "mempool.account.%s.peak %zu\n", stat->name, stat->peak);
+	fprintf(fp, "mempool.account.%s.over_limit %d\n", stat->name, stat->over_limit);
+
+	return 0;
+}
+
+/**
+ * @brief Write the runtime statistics of the daemon
+ * @details Each line of the output is a key and an integer value seperated by a space,
+ *          and the key is a dot-seperated name
+ * @param fp The output file
+ * @return status code
+ **/
+static inline int _write_stats(FILE* fp)
+{
+	int rc;
+	uint32_t i;
+	sched_loop_stat_t loop_stat;
+	for(i = 0; 1 == (rc = sched_loop_get_stat(i, &loop_stat)); i ++)
+	{
+		fprintf(fp, "sched.worker.%"PRIu32".ring_size %"PRIu32"\n", i, loop_stat.ring_size);
+		fprintf(fp, "sched.worker.%"PRIu32".ring_used %"PRIu32"\n", i, loop_stat.ring_used);
+		fprintf(fp, "sched.worker.%"PRIu32".running_reqs %"PRIu32"\n", i, loop_stat.num_running_reqs);
+		fprintf(fp, "sched.worker.%"PRIu32".pending_reqs %"PRIu32"\n", i, loop_stat.pending_reqs);
+		fprintf(fp, "sched.worker.%"PRIu32".idle %"PRIu32"\n", i, loop_stat.idle);
+	}
+
+	if(ERROR_CODE(int) == rc)
+	    ERROR_RETURN_LOG(int, "Cannot get the scheduler loop statistics");
+
+	fprintf(fp, "sched.dispatcher.pending_events %"PRIu32"\n", sched_loop_num_pending_events());
+
+	sched_async_stat_t async_stat;
+	if(ERROR_CODE(int) == sched_async_get_stat(&async_stat))
+	    ERROR_RETURN_LOG(int, "Cannot get the async task processor statistics");
+
+	fprintf(fp, "sched.async.queue_size %"PRIu32"\n", async_stat.queue_size);
+	fprintf(fp, "sched.async.queue_depth %"PRIu32"\n", async_stat.queue_depth);
+	fprintf(fp, "sched.async.nthreads %"PRIu32"\n", async_stat.nthreads);
+	fprintf(fp, "sched.async.busy_threads %"PRIu32"\n", async_stat.busy_threads);
+
+	mempool_page_stat_t page_stat;
+	if(ERROR_CODE(int) == mempool_page_get_stat(&page_stat))
+	    ERROR_RETURN_LOG(int, "Cannot get the page allocator statistics");
+
+	fprintf(fp, "mempool.page.free %zu\n", page_stat.free_pages);
+	fprintf(fp, "mempool.page.max_free %zu\n", page_stat.max_free_pages);
+	fprintf(fp, "mempool.page.cached %zu\n", page_stat.cached_pages);
+	fprintf(fp, "mempool.page.thread_pools %zu\n", page_stat.num_thread_pools);
+	fprintf(fp, "mempool.page.arena %zu\n", page_stat.arena_pages);
+	fprintf(fp, "mempool.page.retired %zu\n", page_stat.retired_pages);
+
+	mempool_objpool_stat_t objpool_stat;
+	if(ERROR_CODE(int) == mempool_objpool_get_stat(&objpool_stat))
+	    ERROR_RETURN_LOG(int, "Cannot get the object pool statistics");
+
+	fprintf(fp, "mempool.objpool.pools %"PRIu32"\n", objpool_stat.num_pools);
+	fprintf(fp, "mempool.objpool.pages %"PRIu64"\n", objpool_stat.num_pages);
+	fprintf(fp, "mempool.objpool.depot_hits %"PRIu64"\n", objpool_stat.depot_hits);
+	fprintf(fp, "mempool.objpool.depot_misses %"PRIu64"\n", objpool_stat.depot_misses);
+
+	mempool_account_stat_t budget_stat;
+	if(ERROR_CODE(int) == mempool_account_get_stat(NULL, &budget_stat))
+	    ERROR_RETURN_LOG(int, "Cannot get the memory budget statistics");
+
+	fprintf(fp, "mempool.budget.bytes %zu\n", budget_stat.bytes);
+	fprintf(fp, "mempool.budget.peak %zu\n", budget_stat.peak);
+	fprintf(fp, "mempool.budget.high_watermark %zu\n", budget_stat.high_watermark);
+	fprintf(fp, "mempool.budget.over_limit %d\n", budget_stat.over_limit);
+
+	if(ERROR_CODE(int) == mempool_account_foreach(_write_account_stat, fp))
+	    ERROR_RETURN_LOG(int, "Cannot write the memory account statistics");
+
+	if(ERROR_CODE(int) == _write_module_stats(fp))
+	    ERROR_RETURN_LOG(int, "Cannot write the module statistics");
+
+	if(ERROR_CODE(int) == _write_profiler_stats(fp))
+	    ERROR_RETURN_LOG(int, "Cannot write the profiler data");
+
+	return 0;
+}
+
 int sched_daemon_read_control_sock()
 {
 	if(_sock_fd < 0 || !_is_dispatcher) return 0;
@@ -368,13 +580,38 @@ int sched_daemon_read_control_sock()
 		    if(write(client_fd, &status, sizeof(status)) < 0)
 		        ERROR_LOG_ERRNO_GOTO(ERR, "Cannot send the operation result ot client");
 		    break;
+		case _DAEMON_STATS:
+		{
+		    LOG_NOTICE("Got DAEMON_STATS Command");
+		    if(write(client_fd, &status, sizeof(status)) < 0)
+		        ERROR_LOG_ERRNO_GOTO(ERR, "Cannot send the operation result to client");
+		    int out_fd = dup(client_fd);
+		    if(out_fd < 0)
+		        ERROR_LOG_ERRNO_GOTO(ERR, "Cannot duplicate the client FD");
+		    FILE* out = fdopen(out_fd, "w");
+		    if(NULL == out)
+		    {
+			    close(out_fd);
+			    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot open the client FD as a file");
+		    }
+		    /* The status has been sent, so the client only sees a truncated result on failure */
+		    if(ERROR_CODE(int) == _write_stats(out))
+		        LOG_ERROR("Cannot write the runtime statistics to the client");
+		    if(fclose(out) != 0)
+		        LOG_WARNING_ERRNO("Cannot flush the runtime statistics to the client");
+		    break;
+		}
 		case _DAEMON_RELOAD:
 		    LOG_NOTICE("Not DAEMON_RELOAD Command");
 		    if(NULL != _reload_thread && ERROR_CODE(int) == thread_free(_reload_thread, NULL))
 		        ERROR_LOG_GOTO(ERR, "Cannot dispose the previously used reload thread");
 		    input_fd = client_fd;
+		    _reload_in_progress = 1;
 		    if(NULL == (_reload_thread = thread_new(_reload_main, &input_fd, THREAD_TYPE_GENERIC)))
-		        ERROR_LOG_GOTO(ERR, "Cannot create reload thread");
+		    {
+			    _reload_in_progress = 0;
+			    ERROR_LOG_GOTO(ERR, "Cannot create reload thread");
+		    }
 		    LOG_NOTICE("Starting reload process");
 		    goto RET;
 		default:
@@ -757,3 +994,57 @@ ERR:
 	return ERROR_CODE(int);
 }
 
+int sched_daemon_stats(const char* daemon_name, char** result)
+{
+	if(NULL == result) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	int fd = _simple_daemon_command(daemon_name, _DAEMON_STATS, 0, 1);
+	if(ERROR_CODE(int) == fd)
+	    return ERROR_CODE(int);
+
+	char* buf = NULL;
+	size_t size = 0, capacity = 4096;
+
+	int status;
+	if(read(fd, &status, sizeof(status)) < 0)
+	    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot read the response from the socket connection");
+
+	if(status < 0)
+	    ERROR_LOG_GOTO(ERR,  "The daemon returns an error");
+
+	if(NULL == (buf = (char*)malloc(capacity)))
+	    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the result buffer");
+
+	for(;;)
+	{
+		if(size + 1 >= capacity)
+		{
+			char* new_buf = (char*)realloc(buf, capacity * 2);
+			if(NULL == new_buf)
+			    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot resize the result buffer");
+			buf = new_buf;
+			capacity *= 2;
+		}
+
+		ssize_t rc = read(fd, buf + size, capacity - size - 1);
+		if(rc < 0)
+		{
+			if(errno == EINTR) continue;
+			ERROR_LOG_ERRNO_GOTO(ERR, "Cannot read the statistics from the socket connection");
+		}
+
+		if(rc == 0) break;
+
+		size += (size_t)rc;
+	}
+
+	buf[size] = 0;
+	*result = buf;
+	close(fd);
+
+	return 0;
+ERR:
+	if(NULL != buf) free(buf);
+	close(fd);
+	return ERROR_CODE(int);
+}
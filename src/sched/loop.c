@@ -12,8 +12,10 @@
 #include <error.h>
 #include <barrier.h>
 #include <arch/arch.h>
+#include <os/os.h>
 #include <utils/log.h>
 #include <utils/thread.h>
+#include <utils/mempool/account.h>
 
 /**
  * @brief the service for the loop
@@ -50,6 +52,27 @@ static uint32_t _queue_size = SCHED_LOOP_EVENT_QUEUE_SIZE;
  **/
 static uint32_t _round_robin_move_threshold = 0;
 
+/**
+ * @brief Indicates if the idle worker is allowed to steal pending requests from its busy peers
+ **/
+static uint32_t _work_stealing = 0;
+
+/**
+ * @brief How many times the idle worker spins on its event ring before it gets parked
+ **/
+static uint32_t _spin_budget = 2048;
+
+/**
+ * @brief The maximum number of events the dispatcher takes from the event queue and publishes at once
+ **/
+static uint32_t _dispatch_batch_size = SCHED_LOOP_MAX_DISPATCH_BATCH_SIZE;
+
+/**
+ * @brief Indicates if the ready task of a request is allowed to be handed over to an idle peer, so that
+ *        the independent branches of the request can run in parallel
+ **/
+static uint32_t _parallel_branches = 0;
+
 /**
  * @brief a scheduler loop context
  **/
@@ -61,11 +84,16 @@ struct _sched_loop_t {
 	uint32_t  front;                 /*!< the front pointer of the queue */
 	uint32_t  rear;                  /*!< the rear pointer of the queue */
 	uint32_t  size;                  /*!< the size of the queue */
-	pthread_mutex_t mutex;           /*!< the mutex used with the cond */
-	pthread_cond_t  cond;            /*!< the cond var that is used for the loop wait for new event */
+	uint32_t  wakeup_seq;            /*!< the futex word the worker parks on when it waits for the new event */
 	uint32_t   num_running_reqs;     /*!< How many requests are currently running by this worker */
 	uint32_t   pending_reqs_id_begin;/*!< The begining ID of the pending request */
 	uint32_t   pending_reqs_id_end;  /*!< The ending ID of the pending request */
+	uint32_t   idle;                 /*!< If the worker is currently parked and waiting for the new event */
+	uint32_t   staged;               /*!< The number of events the dispatcher has written after the rear pointer but not published yet,
+	                                  *   only the dispatcher can access this */
+	uint32_t   borrowed;             /*!< If the worker has been claimed by a peer to run the peer's task */
+	itc_equeue_token_t token;        /*!< The event queue token used to pass the offloaded tasks, only valid when parallel branches is enabled */
+	sched_rscope_table_t* rscope_table; /*!< The request local scope entry table owned by this worker */
 	uintpad_t __padding__[0];
 	itc_equeue_event_t events[0];    /*!< the actual event queue */
 };
@@ -112,6 +140,12 @@ static uint32_t _dispatcher_waiting = 0;
  **/
 static uint32_t _dispatcher_waiting_event = 0;
 
+/**
+ * @brief The pending list of the dispatcher, NULL if the dispatcher is not running
+ * @note Only the dispatcher thread can access the list
+ **/
+static const _pending_list_t* _dispatcher_pending_list = NULL;
+
 /**
  * @brief the mutex used by the dispatcher
  **/
@@ -149,6 +183,198 @@ static inline int _scheduler_saturated(sched_loop_t* scheduler)
 	return pending_reqs + running_reqs >= _max_worker_concurrency;
 }
 
+/**
+ * @brief Get how many slots of the event ring are used, including the events staged by the dispatcher
+ * @note This function should be only called from the dispatcher
+ * @param loop The target scheduler
+ * @return The number of used slots
+ **/
+static inline uint32_t _event_ring_used(const sched_loop_t* loop)
+{
+	return loop->rear + loop->staged - loop->front;
+}
+
+/**
+ * @brief Write an event to the event ring of the scheduler without publishing it
+ * @details The event isn't visible to the worker until _event_ring_publish is called. So that
+ *         the dispatcher can put a batch of events with only one store to the rear pointer and
+ *         at most one wake up of the worker
+ * @note This function should be only called from the dispatcher and the caller should make sure the ring isn't full
+ * @param loop The target scheduler
+ * @param event The event to write
+ * @return nothing
+ **/
+static inline void _event_ring_stage(sched_loop_t* loop, const itc_equeue_event_t* event)
+{
+	loop->events[(loop->rear + loop->staged) & (loop->size - 1)] = *event;
+	loop->staged ++;
+
+	if(event->type == ITC_EQUEUE_EVENT_TYPE_IO)
+	    arch_atomic_sw_increment_u32(&loop->pending_reqs_id_end);
+}
+
+/**
+ * @brief Pop the next event from the event ring of the given scheduler
+ * @note When the work stealing is enabled, the ring may have multiple consumers: the owner and
+ *       the idle peers. In this case the front pointer must be advanced with CAS. <br/>
+ *       A thief is only allowed to take IO events, because a task event refers the request state
+ *       which is owned by the scheduler task context of the target scheduler
+ * @param loop The scheduler that owns the event ring
+ * @param io_only If we only accept an IO event
+ * @param buf The buffer used to return the event
+ * @return If we have got an event
+ **/
+static inline int _event_pop(sched_loop_t* loop, int io_only, itc_equeue_event_t* buf)
+{
+	for(;;)
+	{
+		uint32_t front = loop->front;
+
+		BARRIER();
+
+		if(front == loop->rear) return 0;
+
+		*buf = loop->events[front & (loop->size - 1)];
+
+		if(io_only && buf->type != ITC_EQUEUE_EVENT_TYPE_IO) return 0;
+
+		BARRIER();
+
+		if(!_work_stealing)
+		{
+			arch_atomic_sw_increment_u32(&loop->front);
+			return 1;
+		}
+
+		/* If the CAS fails, the slot has been taken by others, so the data we have read might be
+		 * overridden by the dispatcher already, thus we need to start over */
+		if(__sync_bool_compare_and_swap(&loop->front, front, front + 1))
+		    return 1;
+	}
+}
+
+/**
+ * @brief Mark one pending request of the scheduler has been picked up
+ * @param loop The scheduler whose event ring the request comes from
+ * @return nothing
+ **/
+static inline void _pending_request_consumed(sched_loop_t* loop)
+{
+	if(!_work_stealing)
+	    arch_atomic_sw_increment_u32(&loop->pending_reqs_id_begin);
+	else
+	    __sync_fetch_and_add(&loop->pending_reqs_id_begin, 1);
+}
+
+/**
+ * @brief Try to steal a pending request from the busy peers of the scheduler
+ * @note We only steal the request which hasn't been started yet, since all the state of
+ *       a running request is owned by the scheduler task context of its worker. <br/>
+ *       Only the head of the victim's ring is examined, so the IO events queued behind a task event
+ *       can not be stolen until the owner pops the task event. Taking an event from the middle of the
+ *       ring would require a per-slot claim which is safe against the slot reuse by the dispatcher,
+ *       and the owner is running anyway when it has a task event queued, so it will reach the head soon.
+ * @param thief The scheduler that wants to steal
+ * @param buf The buffer for the stolen event
+ * @return The scheduler we have stolen from, NULL if nothing has been stolen
+ **/
+static inline sched_loop_t* _steal_event(sched_loop_t* thief, itc_equeue_event_t* buf)
+{
+	if(_scheduler_saturated(thief)) return NULL;
+
+	sched_loop_t* victim;
+	for(victim = thief->next == NULL ? _scheds : thief->next;
+	    victim != thief;
+	    victim = victim->next == NULL ? _scheds : victim->next)
+	{
+		/* An idle peer is going to pick up its event soon, so only steal from the busy ones */
+		if(victim->idle || victim->rear == victim->front) continue;
+
+		if(_event_pop(victim, 1, buf))
+		{
+			LOG_DEBUG("Scheduler %u: stole a pending request from scheduler %u", thief->thread_id, victim->thread_id);
+			return victim;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Wake up the worker if it's currently parked
+ * @note  The worker marks itself idle and then rechecks its event ring before it gets parked,
+ *        while we publish the event before we check the idle flag. Because both side have a full
+ *        barrier between the store and the load, at least one of us will see the other's update.
+ *        So we don't need any lock for this. <br/>
+ *        This function should be called after the new event has been published
+ * @param loop The target worker
+ * @return nothing
+ **/
+static inline void _worker_notify(sched_loop_t* loop)
+{
+	__sync_synchronize();
+
+	if(!loop->idle) return;
+
+	__sync_fetch_and_add(&loop->wakeup_seq, 1);
+
+	if(ERROR_CODE(int) == os_futex_wake(&loop->wakeup_seq, 1))
+	    LOG_WARNING("Cannot wake up the scheduler thread %u", loop->thread_id);
+}
+
+/**
+ * @brief Wake up an idle scheduler, so that it can steal the pending request from the busy one
+ * @param busy The busy scheduler that has pending requests
+ * @return nothing
+ **/
+static inline void _wake_idle_thief(const sched_loop_t* busy)
+{
+	sched_loop_t* thief;
+	for(thief = _scheds; thief != NULL; thief = thief->next)
+	    if(thief != busy && thief->idle && thief->rear == thief->front)
+	    {
+		    _worker_notify(thief);
+		    return;
+	    }
+}
+
+/**
+ * @brief Publish all the events that has been staged to the event ring
+ * @note This function should be only called from the dispatcher
+ * @param loop The target scheduler
+ * @return nothing
+ **/
+static inline void _event_ring_publish(sched_loop_t* loop)
+{
+	if(loop->staged == 0) return;
+
+	int was_empty = (loop->front == loop->rear);
+	uint32_t count = loop->staged;
+
+	/* Make sure all the event data is visible before the worker can see the new rear pointer */
+	BARRIER();
+	arch_atomic_sw_assignment_u32(&loop->rear, loop->rear + count);
+	loop->staged = 0;
+
+	/* The worker only needs to be waken up when it's parked */
+	_worker_notify(loop);
+
+	/* The worker can only take one request at a time, so the rest of the batch can be picked up by the idle peers */
+	if(_work_stealing && (!was_empty || count > 1))
+	    _wake_idle_thief(loop);
+}
+
+/**
+ * @brief Publish the staged events of all the schedulers
+ * @return nothing
+ **/
+static inline void _event_ring_publish_all(void)
+{
+	sched_loop_t* loop;
+	for(loop = _scheds; loop != NULL; loop = loop->next)
+	    _event_ring_publish(loop);
+}
+
 /**
  * @brief Create a new scheduler context
  * @param tid The thread id
@@ -165,20 +391,16 @@ static inline sched_loop_t* _context_new(uint32_t tid)
 	ret->front = ret->rear = 0;
 	ret->size = _queue_size;
 	ret->thread = NULL;
-
-	if((errno = pthread_mutex_init(&ret->mutex, NULL)) != 0) ERROR_LOG_ERRNO_GOTO(MUTEX_ERR, "Cannot initialize the shceduler local mutex");
-	if((errno = pthread_cond_init(&ret->cond, NULL)) != 0) ERROR_LOG_ERRNO_GOTO(COND_ERR, "Cannot initialize the scheduler local condvar");
+	ret->wakeup_seq = 0;
+	ret->idle = 0;
+	ret->borrowed = 0;
+	ret->token = ERROR_CODE(itc_equeue_token_t);
+	ret->rscope_table = NULL;
 
 	ret->next = _scheds;
 	_scheds = ret;
 
 	return ret;
-COND_ERR:
-	if((errno = pthread_mutex_destroy(&ret->mutex)) != 0)
-	    LOG_WARNING_ERRNO("Cannot dispose the pthread mutex");
-MUTEX_ERR:
-	free(ret);
-	return NULL;
 }
 
 /**
@@ -189,17 +411,6 @@ MUTEX_ERR:
 static inline int _context_free(sched_loop_t* ctx)
 {
 	int rc = 0;
-	if((errno = pthread_mutex_destroy(&ctx->mutex)) != 0)
-	{
-		LOG_ERROR_ERRNO("Cannot dispose the pthread mutex");
-		rc = ERROR_CODE(int);
-	}
-
-	if((errno = pthread_cond_destroy(&ctx->cond)) != 0)
-	{
-		LOG_ERROR_ERRNO("Cannot dispose the pthread condvar");
-		rc = ERROR_CODE(int);
-	}
 
 	uint32_t i;
 	for(i = ctx->front; i != ctx->rear; i ++)
@@ -243,6 +454,36 @@ static inline int _context_free(sched_loop_t* ctx)
 	return rc;
 }
 
+/**
+ * @brief Run the task handed over by a peer, and then send it back to its owner
+ * @param context The scheduler context
+ * @param task The task from the peer
+ * @return nothing
+ **/
+static inline void _run_offloaded_task(sched_loop_t* context, sched_task_t* task)
+{
+	sched_loop_t* owner = sched_task_get_loop(task);
+
+	if(ERROR_CODE(int) == sched_step_run_offloaded(task, owner->rscope_table))
+	    LOG_ERROR("Cannot run the task from scheduler %u", owner->thread_id);
+
+	itc_equeue_event_t event = {
+		.type = ITC_EQUEUE_EVENT_TYPE_TASK,
+		.task = {
+			.loop = owner,
+			.task = task,
+			.async_handle = NULL
+		}
+	};
+
+	/* Even if the task has failed, we still need to send it back, because only the owner can dispose it */
+	if(ERROR_CODE(int) == itc_equeue_put(context->token, event))
+	    LOG_ERROR("Cannot send the task back to scheduler %u", owner->thread_id);
+
+	BARRIER();
+	arch_atomic_sw_assignment_u32(&context->borrowed, 0);
+}
+
 /**
  * @brief The scheduler main function
  * @param data The scheduler context
@@ -263,6 +504,13 @@ static inline void* _sched_main(void* data)
 	if(ERROR_CODE(int) == sched_rscope_init_thread())
 	    ERROR_LOG_ERRNO_GOTO(KILLED, "Cannot initialize the thread locals for request local scope for thread %u", context->thread_id);
 
+	if(NULL == (context->rscope_table = sched_rscope_thread_table()))
+	    ERROR_LOG_GOTO(KILLED, "Cannot get the request local scope entry table for thread %u", context->thread_id);
+
+	if(_parallel_branches &&
+	   ERROR_CODE(itc_equeue_token_t) == (context->token = itc_equeue_module_token(ITC_MODULE_EVENT_QUEUE_SIZE, ITC_EQUEUE_EVENT_TYPE_TASK)))
+	    ERROR_LOG_GOTO(KILLED, "Cannot get the event queue token for scheduler thread %u", context->thread_id);
+
 	LOG_DEBUG("Scheduler %u: loop started", context->thread_id);
 
 	const sched_service_t* current_service = _service;
@@ -271,15 +519,17 @@ static inline void* _sched_main(void* data)
 
 	for(;!_killed;)
 	{
+		itc_equeue_event_t current;
+		sched_loop_t* source = NULL;
+
+		/* Before we get parked, spin for a while, because in a burst the next event is likely to
+		 * come soon, and a context switch is far more expensive than this */
+		uint32_t spin;
+		for(spin = 0; spin < _spin_budget && context->front == context->rear && !_killed; spin ++)
+		    arch_cpu_relax();
+
 		if(context->front == context->rear)
 		{
-			struct timespec abstime;
-			struct timeval now;
-			gettimeofday(&now,NULL);
-			abstime.tv_sec = now.tv_sec+1;
-			abstime.tv_nsec = 0;
-
-			if((errno = pthread_mutex_lock(&context->mutex)) != 0) LOG_WARNING_ERRNO("Cannot acquire the scheduler event mutex");
 			for(;;)
 			{
 				if(_deploying_service != NULL && current_service != _deploying_service)
@@ -294,44 +544,55 @@ static inline void* _sched_main(void* data)
 					if(old_service_refcnt == 0)
 					{
 						LOG_DEBUG("The old service isn't in use, mark the deployment as finished");
-						uint32_t current;
+						uint32_t current_count;
 						do {
-							current = _deployed_count;
-						} while(!__sync_bool_compare_and_swap(&_deployed_count, current, current + 1));
+							current_count = _deployed_count;
+						} while(!__sync_bool_compare_and_swap(&_deployed_count, current_count, current_count + 1));
 						LOG_NOTICE("Deployment process compelted for scheduler #%u", context->thread_id);
 					}
 				}
 				if(context->rear != context->front) break;
-				if((errno = pthread_cond_timedwait(&context->cond, &context->mutex, &abstime)) != 0 && errno != ETIMEDOUT && errno != EINTR)
-				    LOG_WARNING_ERRNO("Cannot finish pthread_cond_timedwait");
-				if(_killed)
+
+				/* Read the sequence number and mark ourselves idle before we try to steal, so that
+				 * a peer which publishes a pending request after our steal attempt either sees the idle
+				 * flag and wakes us up, or has published it before we scan, and any notification after
+				 * this point will make the futex wait return immediately */
+				uint32_t seq = context->wakeup_seq;
+				arch_atomic_sw_assignment_u32(&context->idle, 1);
+				__sync_synchronize();
+
+				if(_work_stealing && NULL != (source = _steal_event(context, &current)))
 				{
-					if((errno = pthread_mutex_unlock(&context->mutex)) != 0)
-					    LOG_WARNING_ERRNO("Cannot release the scheduler event mutex");
-					goto KILLED;
+					arch_atomic_sw_assignment_u32(&context->idle, 0);
+					break;
 				}
-				abstime.tv_sec ++;
+
+				if(context->rear == context->front && !_killed &&
+				   ERROR_CODE(int) == os_futex_wait(&context->wakeup_seq, seq, 1000))
+				    LOG_WARNING("Cannot wait for the new event");
+
+				BARRIER();
+				arch_atomic_sw_assignment_u32(&context->idle, 0);
+				if(_killed) goto KILLED;
 			}
+		}
 
-			if((errno = pthread_mutex_unlock(&context->mutex)) != 0) LOG_WARNING_ERRNO("Cannot release the scheduler event mutex");
+		if(NULL == source)
+		{
+			/* When the work stealing is enabled, it's possible the event has been stolen by others */
+			if(!_event_pop(context, 0, &current)) continue;
+			source = context;
 		}
 
 		LOG_TRACE("Scheduler Thread %u: new event acquired", context->thread_id);
 
-		uint32_t position = context->front & (context->size - 1);
-		itc_equeue_event_t current = context->events[position];
-
-		BARRIER();
-
-		arch_atomic_sw_increment_u32(&context->front);
-
 		BARRIER();
 
 		/* At this point, we have at least one empty slot for the next event, so we need to
 		 * check if the dispatcher is waiting for event, then we need to activate the pending
 		 * task resolve callback when the scheduler queue is previously full */
 		if(_dispatcher_waiting_event &&
-		   (context->rear - context->front == context->size - 1) &&
+		   (source->rear - source->front == source->size - 1) &&
 		   ERROR_CODE(int) == itc_equeue_wait_interrupt())
 		    LOG_WARNING("Cannot invoke the wait interrupt callback");
 
@@ -361,10 +622,10 @@ static inline void* _sched_main(void* data)
 
 			    BARRIER();
 
-			    arch_atomic_sw_increment_u32(&context->pending_reqs_id_begin);
+			    _pending_request_consumed(source);
 
 
-			    if(sched_task_new_request(stc, current_service, current.io.in, current.io.out) == ERROR_CODE(sched_task_request_t))
+			    if(sched_task_new_request(stc, current_service, current.io.in, current.io.out, current.io.ts) == ERROR_CODE(sched_task_request_t))
 			        LOG_ERROR("Cannot add the incoming request to scheduler");
 
 			    uint32_t concurrency = sched_task_num_concurrent_requests(stc);
@@ -378,6 +639,11 @@ static inline void* _sched_main(void* data)
 			    arch_atomic_sw_assignment_u32(&context->num_running_reqs, concurrency);
 			    break;
 			case ITC_EQUEUE_EVENT_TYPE_TASK:
+			    if(sched_task_get_loop(current.task.task) != context)
+			    {
+				    _run_offloaded_task(context, current.task.task);
+				    break;
+			    }
 			    if(old_service_refcnt > 0 && current.task.task->service != current_service)
 			        old_service = 1;
 			    if(sched_task_async_completed(current.task.task) == ERROR_CODE(int))
@@ -490,32 +756,13 @@ static itc_equeue_event_mask_t _interrupt_handler(void* pl)
 		}
 
 		/* If the event queue is current full, we just keep it */
-		if(target_loop == NULL || target_loop->rear - target_loop->front >= target_loop->size)
+		if(target_loop == NULL || _event_ring_used(target_loop) >= target_loop->size)
 		{
 			prev_event = this_event;
 			continue;
 		}
 
-		target_loop->events[target_loop->rear  & (target_loop->size - 1)] = this_event->event;
-
-		if(this_event->event.type == ITC_EQUEUE_EVENT_TYPE_IO)
-		    arch_atomic_sw_increment_u32(&target_loop->pending_reqs_id_end);
-
-		uint32_t needs_notify = (target_loop->rear == target_loop->front);
-		BARRIER();
-		arch_atomic_sw_increment_u32(&target_loop->rear);
-		BARRIER();
-		if(needs_notify)
-		{
-			if((errno = pthread_mutex_lock(&target_loop->mutex)) != 0)
-			    LOG_WARNING_ERRNO("Cannot acquire the thread local mutex");
-
-			if((errno = pthread_cond_signal(&target_loop->cond)) != 0)
-			    LOG_WARNING_ERRNO("Cannot notify new incoming event for the target_loop thread %u", target_loop->thread_id);
-
-			if((errno = pthread_mutex_unlock(&target_loop->mutex)) != 0)
-			    LOG_WARNING_ERRNO("Cannot release the thread local mutex");
-		}
+		_event_ring_stage(target_loop, &this_event->event);
 
 		/* Finally we remove the event from the list */
 		if(NULL != prev_event) prev_event->next = next_event;
@@ -525,6 +772,8 @@ static itc_equeue_event_mask_t _interrupt_handler(void* pl)
 		pending_list->size --;
 	}
 
+	_event_ring_publish_all();
+
 	/* Step2: We should decide the event mask for the next wait iteration */
 	if(_scheds != NULL)
 	{
@@ -569,6 +818,8 @@ static inline int _dispatcher_main(void)
 
 	_pending_list_t pending_list = {};
 
+	_dispatcher_pending_list = &pending_list;
+
 	for(;!_killed;)
 	{
 		itc_equeue_wait_interrupt_t ir = {
@@ -594,10 +845,10 @@ static inline int _dispatcher_main(void)
 
 		if(_killed) break;
 
-		itc_equeue_event_t events[32];
+		itc_equeue_event_t events[SCHED_LOOP_MAX_DISPATCH_BATCH_SIZE];
 		uint32_t n_events, i;
 
-		if((n_events = itc_equeue_take(sched_token, _last_mask, events, sizeof(events) / sizeof(events[0]))) == ERROR_CODE(uint32_t))
+		if((n_events = itc_equeue_take(sched_token, _last_mask, events, _dispatch_batch_size)) == ERROR_CODE(uint32_t))
 		{
 			LOG_ERROR("Cannot take next event from the event queue");
 			continue;
@@ -631,17 +882,17 @@ static inline int _dispatcher_main(void)
 					first = 1;
 					scheduler = round_robin_start;
 					for(;(first || scheduler != round_robin_start) &&
-					     (scheduler->rear - scheduler->front >= scheduler->size ||
+					     (_event_ring_used(scheduler) >= scheduler->size ||
 					     _scheduler_saturated(scheduler));
 					     scheduler = scheduler->next == NULL ? _scheds : scheduler->next)
 					    first = 0;
-					if(scheduler->rear - scheduler->front < _round_robin_move_threshold)
+					if(_event_ring_used(scheduler) < _round_robin_move_threshold)
 					    round_robin_start = scheduler;
 					else
 					    round_robin_start = scheduler->next == NULL ? _scheds : scheduler->next;
 				}
 
-				if((scheduler->rear - scheduler->front >= scheduler->size ||
+				if((_event_ring_used(scheduler) >= scheduler->size ||
 				    (event.type == ITC_EQUEUE_EVENT_TYPE_IO && _scheduler_saturated(scheduler))))
 				{
 					if(pending_list.size < SCHED_LOOP_MAX_PENDING_TASKS)
@@ -672,6 +923,8 @@ static inline int _dispatcher_main(void)
 				break;
 
 SCHED_WAIT:
+				/* The worker can't drain the events we haven't published, so we must publish them before we wait */
+				_event_ring_publish_all();
 				{
 					int need_lock = !_dispatcher_waiting;
 					arch_atomic_sw_assignment_u32(&_dispatcher_waiting, 1);
@@ -679,7 +932,7 @@ SCHED_WAIT:
 					    LOG_WARNING_ERRNO("Cannot acquire the dispatcher mutex");
 				}
 
-				if(scheduler->rear - scheduler->front >= scheduler->size ||
+				if(_event_ring_used(scheduler) >= scheduler->size ||
 				   (event.type == ITC_EQUEUE_EVENT_TYPE_IO && _scheduler_saturated(scheduler)))
 				{
 					if((errno = pthread_cond_timedwait(&_dispatcher_cond, &_dispatcher_mutex, &abstime)) != 0 && errno != ETIMEDOUT && errno != EINTR)
@@ -707,33 +960,17 @@ EXIT_LOOP:
 
 			LOG_DEBUG("Round robin dispatcher picked up thread %u", scheduler->thread_id);
 
-			uint32_t p = scheduler->rear & (scheduler->size - 1);
-			memcpy(scheduler->events + p, &event, sizeof(event));
-
-			if(event.type == ITC_EQUEUE_EVENT_TYPE_IO)
-			    arch_atomic_sw_increment_u32(&scheduler->pending_reqs_id_end);
-
-			BARRIER();
-			/* We only needs notify the worker when all the dispatching are done with this one */
-			int needs_notify = scheduler->front == scheduler->rear;
-			arch_atomic_sw_increment_u32(&scheduler->rear);
-
-			if(needs_notify)
-			{
-				if((errno = pthread_mutex_lock(&scheduler->mutex)) != 0)
-				    LOG_WARNING_ERRNO("Cannot acquire the thread local mutex");
-
-				if((errno = pthread_cond_signal(&scheduler->cond)) != 0)
-				    LOG_WARNING_ERRNO("Cannot notify new incoming event for the scheduler thread %u", scheduler->thread_id);
-
-				if((errno = pthread_mutex_unlock(&scheduler->mutex)) != 0)
-				    LOG_WARNING_ERRNO("Cannot release the thread local mutex");
-			}
+			_event_ring_stage(scheduler, &event);
 NEXT_ITER:
 			(void)0;
 		}
+
+		/* Publish the share of each worker with one store and at most one wake up */
+		_event_ring_publish_all();
 	}
 
+	_dispatcher_pending_list = NULL;
+
 	/* Let's cleanup all the unprocessed pending event at this point */
 	for(;pending_list.list != NULL;)
 	{
@@ -867,9 +1104,67 @@ int sched_loop_kill(int no_error)
 	LOG_INFO("Service gets killed!");
 
 	_killed = 1;
+
+	sched_loop_t* loop;
+	for(loop = _scheds; loop != NULL; loop = loop->next)
+	    _worker_notify(loop);
+
+	return 0;
+}
+
+sched_loop_t* sched_loop_acquire_idle_peer(sched_loop_t* loop)
+{
+	if(!_parallel_branches || NULL == loop) return NULL;
+
+	sched_loop_t* peer;
+	for(peer = loop->next == NULL ? _scheds : loop->next;
+	    peer != loop;
+	    peer = peer->next == NULL ? _scheds : peer->next)
+	{
+		/* Only the peer which doesn't have anything to do is considered, otherwise we make it slower */
+		if(peer->token == ERROR_CODE(itc_equeue_token_t) || peer->borrowed ||
+		   peer->num_running_reqs > 0 || peer->rear != peer->front)
+		    continue;
+
+		if(__sync_bool_compare_and_swap(&peer->borrowed, 0, 1))
+		{
+			LOG_DEBUG("Scheduler %u: claimed the idle peer %u", loop->thread_id, peer->thread_id);
+			return peer;
+		}
+	}
+
+	return NULL;
+}
+
+int sched_loop_release_peer(sched_loop_t* peer)
+{
+	if(NULL == peer) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	arch_atomic_sw_assignment_u32(&peer->borrowed, 0);
+
 	return 0;
 }
 
+int sched_loop_offload_task(sched_loop_t* peer, sched_task_t* task)
+{
+	if(NULL == peer || NULL == task) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	sched_loop_t* owner = sched_task_get_loop(task);
+	if(NULL == owner || owner == peer || owner->token == ERROR_CODE(itc_equeue_token_t))
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	itc_equeue_event_t event = {
+		.type = ITC_EQUEUE_EVENT_TYPE_TASK,
+		.task = {
+			.loop = peer,
+			.task = task,
+			.async_handle = NULL
+		}
+	};
+
+	return itc_equeue_put(owner->token, event);
+}
+
 int sched_loop_set_nthreads(uint32_t n)
 {
 	if(NULL != _scheds)
@@ -930,6 +1225,58 @@ static inline int _set_prop(const char* symbol, lang_prop_value_t value, const v
 		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
 		_round_robin_move_threshold = (uint32_t)value.num;
 	}
+	else if(strcmp(symbol, "spin_budget") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		_spin_budget = (uint32_t)value.num;
+	}
+	else if(strcmp(symbol, "cpus") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_STRING) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(ERROR_CODE(int) == thread_set_affinity_policy(THREAD_TYPE_WORKER, value.str))
+		    ERROR_RETURN_LOG(int, "Cannot set the CPU affinity policy for the worker threads");
+	}
+	else if(strcmp(symbol, "dispatch_batch_size") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(value.num <= 0 || value.num > SCHED_LOOP_MAX_DISPATCH_BATCH_SIZE)
+		    ERROR_RETURN_LOG(int, "The dispatch batch size must be in range [1, %u]", SCHED_LOOP_MAX_DISPATCH_BATCH_SIZE);
+		_dispatch_batch_size = (uint32_t)value.num;
+	}
+	else if(strcmp(symbol, "work_stealing") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(NULL != _scheds) ERROR_RETURN_LOG(int, "Cannot change the work stealing mode after the loop started");
+		_work_stealing = (value.num != 0);
+	}
+	else if(strcmp(symbol, "chain_handoff") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(ERROR_CODE(int) == sched_service_set_chain_handoff(value.num != 0))
+		    ERROR_RETURN_LOG(int, "Cannot change the chain handoff mode");
+	}
+	else if(strcmp(symbol, "parallel_branches") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(NULL != _scheds) ERROR_RETURN_LOG(int, "Cannot change the parallel branches mode after the loop started");
+		/* The peer needs to access the request local scope of the task owner */
+		if(ERROR_CODE(int) == sched_rscope_set_shared(value.num != 0))
+		    ERROR_RETURN_LOG(int, "Cannot change the sharing mode of the request local scope");
+		_parallel_branches = (value.num != 0);
+	}
+	else if(strcmp(symbol, "request_deadline") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(value.num < 0) ERROR_RETURN_LOG(int, "Invalid request deadline");
+		if(ERROR_CODE(int) == sched_service_set_request_deadline((uint32_t)value.num))
+		    ERROR_RETURN_LOG(int, "Cannot change the request deadline");
+	}
+	else if(strcmp(symbol, "deadline_response") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_STRING) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(ERROR_CODE(int) == sched_service_set_deadline_response(value.str[0] == 0 ? NULL : value.str))
+		    ERROR_RETURN_LOG(int, "Cannot change the deadline response");
+	}
 	else
 	{
 		LOG_WARNING("Unrecognized symbol name %s", symbol);
@@ -989,6 +1336,126 @@ static lang_prop_value_t _get_prop(const char* symbol, const void* param)
 		ret.type = LANG_PROP_TYPE_INTEGER;
 		ret.num = _round_robin_move_threshold;
 	}
+	else if(strcmp(symbol, "spin_budget") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = _spin_budget;
+	}
+	else if(strcmp(symbol, "work_stealing") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = _work_stealing;
+	}
+	else if(strcmp(symbol, "dispatch_batch_size") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = _dispatch_batch_size;
+	}
+	else if(strcmp(symbol, "chain_handoff") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = sched_service_get_chain_handoff();
+	}
+	else if(strcmp(symbol, "parallel_branches") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = _parallel_branches;
+	}
+	else if(strcmp(symbol, "request_deadline") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = sched_service_get_request_deadline();
+	}
+	else if(strcmp(symbol, "deadline_response") == 0)
+	{
+		const char* response = sched_service_get_deadline_response();
+		ret.type = LANG_PROP_TYPE_STRING;
+		if(NULL == (ret.str = strdup(NULL == response ? "" : response)))
+		{
+			LOG_WARNING_ERRNO("Cannot allocate memory for the deadline response string");
+			ret.type = LANG_PROP_TYPE_ERROR;
+			return ret;
+		}
+	}
+	else if(strcmp(symbol, "cpus") == 0)
+	{
+		const char* cpus = thread_get_affinity_policy(THREAD_TYPE_WORKER);
+		if(NULL == cpus)
+		{
+			LOG_WARNING("Cannot get the CPU affinity policy");
+			ret.type = LANG_PROP_TYPE_ERROR;
+			return ret;
+		}
+
+		ret.type = LANG_PROP_TYPE_STRING;
+		if(NULL == (ret.str = strdup(cpus)))
+		{
+			LOG_WARNING_ERRNO("Cannot allocate memory for the CPU list string");
+			ret.type = LANG_PROP_TYPE_ERROR;
+			return ret;
+		}
+	}
+
+	return ret;
+}
+
+/**
+ * @brief the high watermark of the global memory budget, 0 means no limit
+ **/
+static size_t _memory_budget = 0;
+
+/**
+ * @brief the low watermark of the global memory budget
+ **/
+static size_t _memory_budget_low = 0;
+
+static inline int _set_memory_prop(const char* symbol, lang_prop_value_t value, const void* data)
+{
+	(void) data;
+	if(NULL == symbol || LANG_PROP_TYPE_ERROR == value.type || LANG_PROP_TYPE_NONE == value.type)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+	if(strcmp(symbol, "budget") == 0 || strcmp(symbol, "budget_low") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(value.num < 0) ERROR_RETURN_LOG(int, "Invalid memory budget");
+		if(strcmp(symbol, "budget") == 0)
+		    _memory_budget = (size_t)value.num;
+		else
+		    _memory_budget_low = (size_t)value.num;
+		if(ERROR_CODE(int) == mempool_account_set_watermark(NULL, _memory_budget, _memory_budget_low))
+		    ERROR_RETURN_LOG(int, "Cannot change the memory budget");
+	}
+	else
+	{
+		LOG_WARNING("Unrecognized symbol name %s", symbol);
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief get the property of the memory budget
+ * @param symbol The symbol to get
+ * @param param The param
+ * @return the result
+ **/
+static lang_prop_value_t _get_memory_prop(const char* symbol, const void* param)
+{
+	(void)param;
+	lang_prop_value_t ret = {
+		.type = LANG_PROP_TYPE_NONE
+	};
+	if(strcmp(symbol, "budget") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = (int64_t)_memory_budget;
+	}
+	else if(strcmp(symbol, "budget_low") == 0)
+	{
+		ret.type = LANG_PROP_TYPE_INTEGER;
+		ret.num = (int64_t)_memory_budget_low;
+	}
 
 	return ret;
 }
@@ -1005,12 +1472,60 @@ int sched_loop_init()
 	if(ERROR_CODE(int) == lang_prop_register_callback(&cb))
 	    ERROR_RETURN_LOG(int, "Cannot register callback for the runtime prop callback");
 
+	lang_prop_callback_t memory_cb = {
+		.param = NULL,
+		.get   = _get_memory_prop,
+		.set   = _set_memory_prop,
+		.symbol_prefix = "scheduler.memory"
+	};
+
+	if(ERROR_CODE(int) == lang_prop_register_callback(&memory_cb))
+	    ERROR_RETURN_LOG(int, "Cannot register callback for the memory budget prop callback");
+
 	return 0;
 }
 
 int sched_loop_finalize()
 {
-	return 0;
+	return thread_set_affinity_policy(THREAD_TYPE_WORKER, NULL);
+}
+
+int sched_loop_get_stat(uint32_t index, sched_loop_stat_t* buf)
+{
+	if(NULL == buf) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	const sched_loop_t* loop;
+	for(loop = _scheds; loop != NULL && loop->thread_id != index; loop = loop->next);
+
+	if(NULL == loop) return 0;
+
+	buf->thread_id = loop->thread_id;
+	buf->ring_size = loop->size;
+	buf->ring_used = loop->rear - loop->front;
+	buf->num_running_reqs = loop->num_running_reqs;
+	buf->pending_reqs = loop->pending_reqs_id_end - loop->pending_reqs_id_begin;
+	buf->idle = loop->idle;
+
+	return 1;
+}
+
+uint32_t sched_loop_get_id(const sched_loop_t* loop)
+{
+	if(NULL == loop) ERROR_RETURN_LOG(uint32_t, "Invalid arguments");
+
+	return loop->thread_id;
+}
+
+uint32_t sched_loop_num_pending_events(void)
+{
+	if(NULL == _dispatcher_pending_list) return 0;
+
+	return _dispatcher_pending_list->size;
+}
+
+const sched_service_t* sched_loop_get_service(void)
+{
+	return _service;
 }
 
 int sched_loop_deploy_service_object(sched_service_t* service)
@@ -1021,6 +1536,11 @@ int sched_loop_deploy_service_object(sched_service_t* service)
 
 	_deploying_service = service;
 
+	/* Let the parked workers switch to the new service graph right away */
+	sched_loop_t* loop;
+	for(loop = _scheds; loop != NULL; loop = loop->next)
+	    _worker_notify(loop);
+
 	return 0;
 }
 
@@ -31,33 +31,43 @@
 #include <utils/string.h>
 #include <utils/static_assertion.h>
 #include <utils/thread.h>
-
-/**
- * @brief the time accumulator
- **/
-typedef struct {
-	uint64_t total_time;   /*!< the total time elapsed on this node in ns */
-	uint64_t exec_count;   /*!< the number of executions during the time */
-} _accu_t;
+#include <utils/clock.h>
+#include <utils/histogram.h>
 
 /**
  * @brief the profiler array
+ * @note each node has a record which accumulates the data since last flush
  **/
 typedef struct {
-	sched_service_node_id_t cur_node; /*!< the current node that is being measured */
-	struct timespec start_time;       /*!< the timestamp when the timer started */
+	uint32_t                tid;         /*!< the thread id which owns this array */
+	sched_service_node_id_t cur_node;    /*!< the current node that is being measured */
+	uint64_t                num_execs;   /*!< the number of executions since last flush */
+	uint64_t                start_wall;  /*!< the monotonic timestamp when the timer started */
+	struct timespec         start_cpu;   /*!< the thread CPU time when the timer started */
 	uintpad_t __padding__[0];
-	_accu_t  data[0];                 /*!< the actual array */
+	sched_prof_record_t     data[0];     /*!< the actual array */
 } _prof_array_t;
 STATIC_ASSERTION_SIZE(_prof_array_t, data, 0);
 STATIC_ASSERTION_LAST(_prof_array_t, data);
 
+/**
+ * @brief the records of all the threads since the profiler is created, which is updated on each flush
+ **/
+typedef struct {
+	pthread_mutex_t         mutex;       /*!< the mutex protects the records */
+	uintpad_t __padding__[0];
+	sched_prof_record_t     data[0];     /*!< the records for each node */
+} _prof_total_t;
+STATIC_ASSERTION_SIZE(_prof_total_t, data, 0);
+STATIC_ASSERTION_LAST(_prof_total_t, data);
+
 /**
  * @brief the actual data structure for a profiler
  **/
 struct _sched_prof_t {
 	sched_service_node_id_t serv_size;   /*!< the size of the service graph */
 	thread_pset_t*          thread_data; /*!< the thread data */
+	_prof_total_t*          total;       /*!< the total records */
 };
 
 /**
@@ -70,6 +80,11 @@ static uint32_t _prof_enabled = 0;
  **/
 static FILE* _prof_output;
 
+/**
+ * @brief the number of executions a thread collects before it flushes the data
+ **/
+static uint32_t _flush_interval = 10000;
+
 /**
  * @brief create a new profiler array with n slots
  * @param tid the thread id
@@ -78,20 +93,109 @@ static FILE* _prof_output;
  **/
 static inline void* _prof_array_new(uint32_t tid, const void* caller)
 {
-	(void)tid;
 	const sched_prof_t* prof = (const sched_prof_t*)caller;
 
-	size_t size = sizeof(_prof_array_t) + sizeof(_accu_t) * prof->serv_size;
+	size_t size = sizeof(_prof_array_t) + sizeof(sched_prof_record_t) * prof->serv_size;
 
 	_prof_array_t* ret = (_prof_array_t*)calloc(1, size);
 
-	ret->cur_node = ERROR_CODE(sched_service_node_id_t);
-
 	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allcoate memory for the profiler array");
 
+	ret->tid = tid;
+	ret->cur_node = ERROR_CODE(sched_service_node_id_t);
+
 	return ret;
 }
 
+/**
+ * @brief add the data collected by the profiler array to the total records
+ * @param prof the profiler
+ * @param arr the profiler array
+ * @return nothing
+ **/
+static inline void _prof_array_merge_total(const sched_prof_t* prof, const _prof_array_t* arr)
+{
+	sched_service_node_id_t i;
+
+	if((errno = pthread_mutex_lock(&prof->total->mutex)) != 0)
+	{
+		LOG_WARNING_ERRNO("Cannot acquire the profiler total mutex");
+		return;
+	}
+
+	for(i = 0; i < prof->serv_size; i ++)
+	{
+		const sched_prof_record_t* rec = arr->data + i;
+		sched_prof_record_t* total = prof->total->data + i;
+		if(rec->count == 0) continue;
+		total->count += rec->count;
+		total->time += rec->time;
+		total->wall_time += rec->wall_time;
+		total->queue_time += rec->queue_time;
+		utils_histogram_merge(&total->cpu_hist, &rec->cpu_hist);
+		utils_histogram_merge(&total->wall_hist, &rec->wall_hist);
+		utils_histogram_merge(&total->queue_hist, &rec->queue_hist);
+	}
+
+	if((errno = pthread_mutex_unlock(&prof->total->mutex)) != 0)
+	    LOG_WARNING_ERRNO("Cannot release the profiler total mutex");
+}
+
+/**
+ * @brief write the data collected by the profiler array to the output and reset the array
+ * @param prof the profiler
+ * @param arr the profiler array
+ * @return nothing
+ **/
+static inline void _prof_array_flush(const sched_prof_t* prof, _prof_array_t* arr)
+{
+	sched_service_node_id_t i, size = prof->serv_size;
+
+	_prof_array_merge_total(prof, arr);
+
+	if(_prof_output == NULL)
+	{
+		for(i = 0; i < size; i ++)
+		{
+			const sched_prof_record_t* rec = arr->data + i;
+			if(rec->count == 0) continue;
+			LOG_NOTICE("Profiler: Thread=%u\tNode=%u\tCount=%"PRIu64"\t"
+			           "CPU=<avg %"PRIu64", p50 %"PRIu64", p99 %"PRIu64">\t"
+			           "Wall=<avg %"PRIu64", p50 %"PRIu64", p99 %"PRIu64", max %"PRIu64">\t"
+			           "Queue=<avg %"PRIu64", p50 %"PRIu64", p99 %"PRIu64">",
+			           arr->tid, i, rec->count,
+			           rec->time / rec->count,
+			           utils_histogram_percentile(&rec->cpu_hist, 50),
+			           utils_histogram_percentile(&rec->cpu_hist, 99),
+			           rec->wall_time / rec->count,
+			           utils_histogram_percentile(&rec->wall_hist, 50),
+			           utils_histogram_percentile(&rec->wall_hist, 99),
+			           rec->wall_hist.max,
+			           rec->queue_hist.count == 0 ? 0 : rec->queue_time / rec->queue_hist.count,
+			           utils_histogram_percentile(&rec->queue_hist, 50),
+			           utils_histogram_percentile(&rec->queue_hist, 99));
+		}
+	}
+	else
+	{
+		flockfile(_prof_output);
+		for(i = 0; i < size; i ++)
+		{
+			sched_prof_record_t* rec = arr->data + i;
+			if(rec->count == 0) continue;
+			rec->thread = arr->tid;
+			rec->node = i;
+			if(fwrite(rec, sizeof(sched_prof_record_t), 1, _prof_output) != 1)
+			    LOG_WARNING_ERRNO("Cannot write the profiler record");
+		}
+		fflush(_prof_output);
+		funlockfile(_prof_output);
+	}
+
+	memset(arr->data, 0, sizeof(sched_prof_record_t) * size);
+	arr->num_execs = 0;
+}
+
 /**
  * @brief dispose a profiler array
  * @param arr the array to dispose
@@ -100,7 +204,11 @@ static inline void* _prof_array_new(uint32_t tid, const void* caller)
  **/
 static inline int _prof_array_free(void* arr, const void* caller)
 {
-	(void)caller;
+	const sched_prof_t* prof = (const sched_prof_t*)caller;
+
+	/* Do not lose the data collected after the last flush */
+	if(((_prof_array_t*)arr)->num_execs > 0)
+	    _prof_array_flush(prof, (_prof_array_t*)arr);
 
 	free(arr);
 	return 0;
@@ -124,17 +232,25 @@ int sched_prof_new(const sched_service_t* service, sched_prof_t** result)
 	    ERROR_RETURN_LOG(int, "Cannot get the size of the service");
 
 	sched_prof_t* ret = NULL;
+	int mutex_init = 0;
 	ret = (sched_prof_t*)malloc(sizeof(sched_prof_t));
-	ret->thread_data = NULL;
 
 	if(NULL == ret) ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the profiler");
+	ret->thread_data = NULL;
 	ret->serv_size = serv_size;
+	if(NULL == (ret->total = (_prof_total_t*)calloc(1, sizeof(_prof_total_t) + sizeof(sched_prof_record_t) * serv_size)))
+	    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the profiler total records");
+	if((errno = pthread_mutex_init(&ret->total->mutex, NULL)) != 0)
+	    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot initialize the profiler total mutex");
+	mutex_init = 1;
 	if(NULL == (ret->thread_data = thread_pset_new(SCHED_PROF_INIT_THREAD_CAPACITY, _prof_array_new, _prof_array_free, ret)))
 	    ERROR_LOG_GOTO(ERR, "Cannot create thread data array");
 	*result = ret;
 	return 0;
 ERR:
 	if(ret->thread_data != NULL) thread_pset_free(ret->thread_data);
+	if(mutex_init) pthread_mutex_destroy(&ret->total->mutex);
+	if(NULL != ret->total) free(ret->total);
 	free(ret);
 	return ERROR_CODE(int);
 }
@@ -145,12 +261,18 @@ int sched_prof_free(sched_prof_t* prof)
 
 	int rc = 0;
 	rc = thread_pset_free(prof->thread_data);
+	if((errno = pthread_mutex_destroy(&prof->total->mutex)) != 0)
+	{
+		LOG_ERROR_ERRNO("Cannot dispose the profiler total mutex");
+		rc = ERROR_CODE(int);
+	}
+	free(prof->total);
 	free(prof);
 
 	return rc;
 }
 
-int sched_prof_start_timer(sched_prof_t* prof, sched_service_node_id_t node)
+int sched_prof_start_timer(sched_prof_t* prof, sched_service_node_id_t node, uint64_t ready_time)
 {
 	if(NULL == prof || ERROR_CODE(sched_service_node_id_t) == node || node >= prof->serv_size)
 	    ERROR_RETURN_LOG(int, "Invalid arguments");
@@ -162,10 +284,19 @@ int sched_prof_start_timer(sched_prof_t* prof, sched_service_node_id_t node)
 	if(acc->cur_node != ERROR_CODE(sched_service_node_id_t))
 	    ERROR_RETURN_LOG(int, "Previous profiler session is not closed yet");
 
-	acc->cur_node = node;
-	if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &acc->start_time) < 0)
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &acc->start_cpu) < 0)
 	    ERROR_RETURN_LOG_ERRNO(int, "Cannot get the start timestamp");
 
+	acc->cur_node = node;
+	acc->start_wall = utils_clock_now_ns();
+
+	if(ready_time > 0 && ready_time <= acc->start_wall)
+	{
+		sched_prof_record_t* rec = acc->data + node;
+		rec->queue_time += acc->start_wall - ready_time;
+		utils_histogram_record(&rec->queue_hist, acc->start_wall - ready_time);
+	}
+
 	return 0;
 }
 
@@ -179,24 +310,31 @@ int sched_prof_stop_timer(sched_prof_t* prof)
 	if(acc->cur_node == ERROR_CODE(sched_service_node_id_t))
 	    ERROR_RETURN_LOG(int, "Timer is not started yet");
 
-	_accu_t* cell = acc->data + acc->cur_node;
+	sched_prof_record_t* rec = acc->data + acc->cur_node;
 
 	acc->cur_node = ERROR_CODE(sched_service_node_id_t);
 
+	uint64_t wall = utils_clock_now_ns() - acc->start_wall;
+
 	struct timespec end_time;
-	if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end_time) < 0)
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end_time) < 0)
 	    ERROR_RETURN_LOG_ERRNO(int, "Cannot get the end timestamp");
 
+	uint64_t time = ((uint64_t)(end_time.tv_sec - acc->start_cpu.tv_sec) * 1000000000ull);
 
-	uint64_t time = ((uint64_t)(end_time.tv_sec - acc->start_time.tv_sec) * 1000000000ull);
-
-	if(end_time.tv_nsec > acc->start_time.tv_nsec)
-	    time += (uint64_t)(end_time.tv_nsec - acc->start_time.tv_nsec);
+	if(end_time.tv_nsec > acc->start_cpu.tv_nsec)
+	    time += (uint64_t)(end_time.tv_nsec - acc->start_cpu.tv_nsec);
 	else
-	    time -= (uint64_t)(acc->start_time.tv_nsec - end_time.tv_nsec);
+	    time -= (uint64_t)(acc->start_cpu.tv_nsec - end_time.tv_nsec);
+
+	rec->count ++;
+	rec->time += time;
+	rec->wall_time += wall;
+	utils_histogram_record(&rec->cpu_hist, time);
+	utils_histogram_record(&rec->wall_hist, wall);
 
-	cell->exec_count ++;
-	cell->total_time += time;
+	if(++ acc->num_execs >= _flush_interval)
+	    _prof_array_flush(prof, acc);
 
 	return 0;
 }
@@ -209,33 +347,26 @@ int sched_prof_flush(sched_prof_t* prof)
 	if(NULL == acc)
 	    ERROR_RETURN_LOG(int, "Cannot get the profiler instance for this thread");
 
-	sched_service_node_id_t size = prof->serv_size, i;
+	_prof_array_flush(prof, acc);
 
-	if(_prof_output == NULL)
-	{
-		for(i = 0; i < size; i ++)
-		    LOG_NOTICE("Profiler: Thread=%u\tNode=%u\tCount=%"PRIu64"\tTime=%"PRIu64">\tAverage %lf",
-		                thread_get_id(), i, acc->data[i].exec_count, acc->data[i].total_time,
-		                ((double)acc->data[i].total_time) / (double)acc->data[i].exec_count);
-	}
-	else
-	{
-		flockfile(_prof_output);
-		for(i = 0; i < size; i ++)
-		{
-			sched_prof_record_t item = {
-				.thread = thread_get_id(),
-				.count  = acc->data[i].exec_count,
-				.time   = acc->data[i].total_time,
-				.node   = i
-			};
-			fwrite(&item, sizeof(sched_prof_record_t), 1, _prof_output);
-		}
-		fflush(_prof_output);
-		funlockfile(_prof_output);
-	}
+	return 0;
+}
+
+int sched_prof_get_stat(sched_prof_t* prof, sched_service_node_id_t node, sched_prof_record_t* buf)
+{
+	if(NULL == prof || NULL == buf || node >= prof->serv_size)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if((errno = pthread_mutex_lock(&prof->total->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the profiler total mutex");
 
-	memset(acc->data, 0, sizeof(_accu_t) * size);
+	*buf = prof->total->data[node];
+
+	if((errno = pthread_mutex_unlock(&prof->total->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot release the profiler total mutex");
+
+	buf->thread = ERROR_CODE(uint32_t);
+	buf->node = node;
 
 	return 0;
 }
@@ -263,6 +394,7 @@ static inline int _set_prop(const char* symbol, lang_prop_value_t value, const v
 			{
 				LOG_TRACE("Outputing profiler data to log");
 				fclose(_prof_output);
+				_prof_output = NULL;
 			}
 		}
 		else
@@ -272,6 +404,12 @@ static inline int _set_prop(const char* symbol, lang_prop_value_t value, const v
 			if(NULL == _prof_output) ERROR_RETURN_LOG(int, "Cannot open the output file");
 		}
 	}
+	else if(strcmp(symbol, "flush_interval") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(value.num <= 0) ERROR_RETURN_LOG(int, "Invalid flush interval");
+		_flush_interval = (uint32_t)value.num;
+	}
 	else
 	{
 		LOG_WARNING("Unrecognized symbol name %s", symbol);
@@ -299,6 +437,7 @@ int sched_prof_init()
 int sched_prof_finalize()
 {
 	if(NULL != _prof_output) fclose(_prof_output);
+	_prof_output = NULL;
 
 	return 0;
 }
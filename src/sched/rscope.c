@@ -7,22 +7,40 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <pthread.h>
+#include <unistd.h>
 
 #include <error.h>
+#include <arch/arch.h>
 #include <utils/log.h>
 #include <utils/mempool/objpool.h>
+#include <utils/mempool/page.h>
 
-#include <runtime/api.h>
-#include <sched/rscope.h>
+#include <plumber.h>
 
 #define _NULL_ENTRY ERROR_CODE(runtime_api_scope_token_t)
 
+/**
+ * @brief the header of a memory block owned by the request arena
+ * @note the block is either a page from the page memory pool or a large block allocated by malloc
+ **/
+typedef struct _arena_block_t {
+	struct _arena_block_t* next;    /*!< the next block in the list */
+	mempool_account_t*     account; /*!< the memory account of the node which allocates the block */
+	size_t                 size;    /*!< the size of the block, only used by the large block */
+	char                   mem[0] __attribute__((aligned(SCHED_RSCOPE_ARENA_ALIGNMENT))); /*!< the memory of the block */
+} _arena_block_t;
+STATIC_ASSERTION_EQ_ID(arena_block_header_aligned, sizeof(_arena_block_t) % SCHED_RSCOPE_ARENA_ALIGNMENT, 0);
+
 /**
  * @brief the actual data type for the request local scope
  **/
 struct _sched_rscope_t {
 	uint64_t                  id;       /*!< the identifier for current scope */
 	runtime_api_scope_token_t head;     /*!< the head of the linked list */
+	uint32_t                  arena_lock;  /*!< the spin lock protects the arena, only used when the tables are shared */
+	size_t                    arena_used;  /*!< the number of bytes used in the current arena page */
+	_arena_block_t*           arena_pages; /*!< the pages of the arena, the first one is the current page */
+	_arena_block_t*           arena_large; /*!< the large blocks which doesn't fit in a page */
 };
 
 /**
@@ -55,18 +73,35 @@ struct _sched_rscope_stream_t {
 };
 
 /**
- * @brief this is the actual thread local data storage for each scheduler loop
+ * @brief this is the actual entry table, each scheduler loop owns one
  * @note We distinuish the concept of cached and unused. When the entry is assigned to one request, it will be in use
  *       however, once the entry is deallocated, the entry will be added to the cached list and will be in cached state
  *       rather than unused.
  *       The only case we have unused entry is after memory is allocated and the entry is either in use or cached. <br/>
  **/
-static __thread struct {
+struct _sched_rscope_table_t {
+	uint32_t                  lock;       /*!< the spin lock protects the table, only used when the tables are shared */
 	uint32_t                  capacity;   /*!< how many items in the table */
 	runtime_api_scope_token_t cached;     /*!< the head of cached unused token list */
 	runtime_api_scope_token_t unused;     /*!< the range [unused, capacity) is the unused list */
 	_entry_t*                 data;       /*!< the actual entry table */
-} _entry_table;
+};
+
+/**
+ * @brief the entry table owned by current thread
+ **/
+static __thread sched_rscope_table_t _local_table;
+
+/**
+ * @brief the entry table current thread is working on, normally this is the thread's own table, but
+ *        a scheduler thread which runs the task for its peer borrows the peer's table
+ **/
+static __thread sched_rscope_table_t* _entry_table;
+
+/**
+ * @brief indicates if the entry tables may be accessed by other threads
+ **/
+static int _shared = 0;
 
 /**
  * @brief the memory pool that is used to allocate the request local scope object
@@ -83,6 +118,16 @@ static mempool_objpool_t* _entity_pool;
  **/
 static mempool_objpool_t* _stream_pool;
 
+/**
+ * @brief the size of the page used by the request arena
+ **/
+static size_t _arena_page_size;
+
+/**
+ * @brief the memory account for the scope objects, and the arena memory which is not allocated by a node
+ **/
+static mempool_account_t* _account;
+
 int sched_rscope_init()
 {
 	if(NULL == (_rscope_pool = mempool_objpool_new(sizeof(sched_rscope_t))))
@@ -94,6 +139,16 @@ int sched_rscope_init()
 	if(NULL == (_entity_pool = mempool_objpool_new(sizeof(_scope_entity_t))))
 	    ERROR_RETURN_LOG(int, "Cannot allocate scope entity object pool");
 
+	if(NULL == (_account = mempool_account_new("sched.rscope")))
+	    ERROR_RETURN_LOG(int, "Cannot create the memory account for the request local scope");
+
+	if(ERROR_CODE(int) == mempool_objpool_set_account(_rscope_pool, _account) ||
+	   ERROR_CODE(int) == mempool_objpool_set_account(_stream_pool, _account) ||
+	   ERROR_CODE(int) == mempool_objpool_set_account(_entity_pool, _account))
+	    ERROR_RETURN_LOG(int, "Cannot set the memory account for the request local scope object pools");
+
+	_arena_page_size = (size_t)getpagesize();
+
 	return 0;
 }
 
@@ -118,6 +173,12 @@ int sched_rscope_finalize()
 		LOG_ERROR("Cannot dispose the object pool for scope entities");
 	}
 
+	if(NULL != _account && ERROR_CODE(int) == mempool_account_free(_account))
+	{
+		rc = ERROR_CODE(int);
+		LOG_ERROR("Cannot dispose the memory account for the request local scope");
+	}
+
 	return rc;
 }
 
@@ -156,14 +217,17 @@ static inline int _dispose_scope_entity(_scope_entity_t* entity)
 
 int sched_rscope_init_thread()
 {
-	_entry_table.capacity = SCHED_RSCOPE_ENTRY_TABLE_INIT_SIZE;
-	_entry_table.cached   = _NULL_ENTRY;
-	_entry_table.unused   = 0;
-	_entry_table.data     = (_entry_t*)malloc(sizeof(_entry_table.data[0]) * _entry_table.capacity);
+	_local_table.lock     = 0;
+	_local_table.capacity = SCHED_RSCOPE_ENTRY_TABLE_INIT_SIZE;
+	_local_table.cached   = _NULL_ENTRY;
+	_local_table.unused   = 0;
+	_local_table.data     = (_entry_t*)malloc(sizeof(_local_table.data[0]) * _local_table.capacity);
 
-	if(NULL == _entry_table.data)
+	if(NULL == _local_table.data)
 	    ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the scope entry table");
 
+	_entry_table = &_local_table;
+
 	return 0;
 }
 
@@ -171,64 +235,124 @@ int sched_rscope_finalize_thread()
 {
 	int rc = 0;
 
-	if(NULL != _entry_table.data)
+	if(NULL != _local_table.data)
 	{
 		runtime_api_scope_token_t i;
-		for(i = 0; i < _entry_table.unused; i ++)
-		    if(_entry_table.data[i].data != NULL && ERROR_CODE(int) == _dispose_scope_entity(_entry_table.data[i].data))
+		for(i = 0; i < _local_table.unused; i ++)
+		    if(_local_table.data[i].data != NULL && ERROR_CODE(int) == _dispose_scope_entity(_local_table.data[i].data))
 		        rc = ERROR_CODE(int);
-		free(_entry_table.data);
+		free(_local_table.data);
+		_local_table.data = NULL;
 	}
 
+	_entry_table = NULL;
+
 	return rc;
 }
 
+int sched_rscope_set_shared(int shared)
+{
+	_shared = (shared != 0);
+	return 0;
+}
+
+sched_rscope_table_t* sched_rscope_thread_table()
+{
+	if(NULL == _local_table.data)
+	    ERROR_PTR_RETURN_LOG("The entry table of current thread is not initialized");
+
+	return &_local_table;
+}
+
+sched_rscope_table_t* sched_rscope_switch_table(sched_rscope_table_t* table)
+{
+	if(NULL == table)
+	    ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	if(table != &_local_table && !_shared)
+	    ERROR_PTR_RETURN_LOG("Cannot borrow the entry table of other thread, because the tables are not shared");
+
+	sched_rscope_table_t* ret = _entry_table;
+	_entry_table = table;
+
+	return ret;
+}
+
+/**
+ * @brief acquire the entry table current thread is working on
+ * @note  Only the table which may be borrowed by others needs the lock, otherwise the
+ *        table is only accessed by its owner thread
+ * @return the table
+ **/
+static inline sched_rscope_table_t* _table_lock(void)
+{
+	sched_rscope_table_t* ret = _entry_table;
+
+	if(_shared)
+	    while(!__sync_bool_compare_and_swap(&ret->lock, 0, 1))
+	        arch_cpu_relax();
+
+	return ret;
+}
+
+/**
+ * @brief release the entry table acquired by _table_lock
+ * @param table the table to release
+ * @return nothing
+ **/
+static inline void _table_unlock(sched_rscope_table_t* table)
+{
+	if(_shared)
+	    __sync_lock_release(&table->lock);
+}
+
 /**
  * @brief allocate a new entry object from the entry table
+ * @param table the entry table, the caller should hold the table lock
  * @return the entry table that has been allocated, or error code
  **/
-static inline runtime_api_scope_token_t _entry_alloc(void)
+static inline runtime_api_scope_token_t _entry_alloc(sched_rscope_table_t* table)
 {
 	runtime_api_scope_token_t ret = _NULL_ENTRY;
 
 	/* First, we need to check if there's an cached entry */
-	if(_entry_table.cached != _NULL_ENTRY)
+	if(table->cached != _NULL_ENTRY)
 	{
-		ret = _entry_table.cached;
-		_entry_table.cached = _entry_table.data[ret].next;
+		ret = table->cached;
+		table->cached = table->data[ret].next;
 
-		if(NULL == (_entry_table.data[ret].data = mempool_objpool_alloc(_entity_pool)))
+		if(NULL == (table->data[ret].data = mempool_objpool_alloc(_entity_pool)))
 		    ERROR_RETURN_LOG_ERRNO(runtime_api_scope_token_t, "Cannot allocate memory for the entity data pool");
 		else
-		    memset(_entry_table.data[ret].data, 0, sizeof(*_entry_table.data[ret].data));
+		    memset(table->data[ret].data, 0, sizeof(*table->data[ret].data));
 
 		return ret;
 	}
 
 	/* Then we must have at least one unused entry, otherwise we fail */
-	if(_entry_table.unused >= _entry_table.capacity)
+	if(table->unused >= table->capacity)
 	{
-		if(_entry_table.capacity * 2 > SCHED_RSCOPE_ENTRY_TABLE_SIZE_LIMIT)
+		if(table->capacity * 2 > SCHED_RSCOPE_ENTRY_TABLE_SIZE_LIMIT)
 		    ERROR_RETURN_LOG(runtime_api_scope_token_t,
 		                     "The entry table size reach the limit "
 		                     "(SCHED_RSCOPE_ENTRY_TABLE_SIZE_LIMIT), which is %u",
 		                     SCHED_RSCOPE_ENTRY_TABLE_SIZE_LIMIT);
-		LOG_DEBUG("Request local scope entry table needs to be resized to %u", _entry_table.capacity * 2);
-		_entry_t* new_table = (_entry_t*)realloc(_entry_table.data, sizeof(_entry_table.data[0]) * _entry_table.capacity * 2);
+		LOG_DEBUG("Request local scope entry table needs to be resized to %u", table->capacity * 2);
+		_entry_t* new_table = (_entry_t*)realloc(table->data, sizeof(table->data[0]) * table->capacity * 2);
 		if(NULL == new_table)
 		    ERROR_RETURN_LOG_ERRNO(runtime_api_scope_token_t, "Cannot resize the entry table");
-		_entry_table.data = new_table;
-		_entry_table.capacity *= 2;
+		table->data = new_table;
+		table->capacity *= 2;
 	}
 
-	ret = _entry_table.unused;
-	if(NULL == (_entry_table.data[ret].data = mempool_objpool_alloc(_entity_pool)))
+	ret = table->unused;
+	if(NULL == (table->data[ret].data = mempool_objpool_alloc(_entity_pool)))
 	    ERROR_RETURN_LOG_ERRNO(runtime_api_scope_token_t, "Cannot allocate memory for the entity data pool");
 	else
-	    memset(_entry_table.data[ret].data, 0, sizeof(*_entry_table.data[ret].data));
+	    memset(table->data[ret].data, 0, sizeof(*table->data[ret].data));
 
-	_entry_table.data[ret].next = _NULL_ENTRY;
-	_entry_table.unused ++;
+	table->data[ret].next = _NULL_ENTRY;
+	table->unused ++;
 
 	return ret;
 }
@@ -244,6 +368,10 @@ sched_rscope_t* sched_rscope_new()
 
 	ret->head = _NULL_ENTRY;
 	ret->id   = next_scope_id ++;
+	ret->arena_lock = 0;
+	ret->arena_used = 0;
+	ret->arena_pages = NULL;
+	ret->arena_large = NULL;
 
 	LOG_DEBUG("Request local scope %"PRIu64" has been created", ret->id);
 
@@ -260,15 +388,38 @@ int sched_rscope_free(sched_rscope_t* scope)
 	for(tok = scope->head; tok != _NULL_ENTRY;)
 	{
 		runtime_api_scope_token_t cur_tok = tok;
-		_entry_t* entry = _entry_table.data + tok;
-		tok = _entry_table.data[tok].next;
-		if(ERROR_CODE(int) == _dispose_scope_entity(entry->data))
-		    rc = ERROR_CODE(int);
+		sched_rscope_table_t* table = _table_lock();
+		_entry_t* entry = table->data + tok;
+		_scope_entity_t* data = entry->data;
+		tok = entry->next;
 
-		entry->next = _entry_table.cached;
+		entry->next = table->cached;
 		entry->data = NULL;
-		_entry_table.cached = cur_tok;
+		table->cached = cur_tok;
+		_table_unlock(table);
+
+		/* The free callback may take some time, so we shouldn't hold the table lock for this */
+		if(ERROR_CODE(int) == _dispose_scope_entity(data))
+		    rc = ERROR_CODE(int);
+	}
+
+	/* All the memory allocated from the arena is released at once */
+	for(;NULL != scope->arena_pages;)
+	{
+		_arena_block_t* page = scope->arena_pages;
+		scope->arena_pages = page->next;
+		if(ERROR_CODE(int) == mempool_page_dealloc_account(page->account, page))
+		    rc = ERROR_CODE(int);
 	}
+
+	for(;NULL != scope->arena_large;)
+	{
+		_arena_block_t* block = scope->arena_large;
+		scope->arena_large = block->next;
+		mempool_account_uncharge(block->account, block->size);
+		free(block);
+	}
+
 #ifdef LOG_ERROR_ENABLED
 	uint64_t scope_id = scope->id;
 #endif
@@ -284,24 +435,92 @@ int sched_rscope_free(sched_rscope_t* scope)
 	return rc;
 }
 
+void* sched_rscope_arena_alloc(sched_rscope_t* scope, size_t size)
+{
+	if(NULL == scope || 0 == size)
+	    ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	/* Make sure neither the alignment nor the large block header can wrap the size around */
+	if(size > SIZE_MAX - SCHED_RSCOPE_ARENA_ALIGNMENT - sizeof(_arena_block_t))
+	    ERROR_PTR_RETURN_LOG("The allocation is too large");
+
+	size = (size + SCHED_RSCOPE_ARENA_ALIGNMENT - 1) & ~(size_t)(SCHED_RSCOPE_ARENA_ALIGNMENT - 1);
+
+	void* ret = NULL;
+
+	/* The memory is charged to the node which asks for it */
+	mempool_account_t* account = sched_step_current_account();
+	if(NULL == account) account = _account;
+
+	if(_shared)
+	    while(!__sync_bool_compare_and_swap(&scope->arena_lock, 0, 1))
+	        arch_cpu_relax();
+
+	if(size > _arena_page_size - sizeof(_arena_block_t))
+	{
+		LOG_DEBUG("The allocation is larger than an arena page, allocate a large block for it");
+		_arena_block_t* block = (_arena_block_t*)malloc(sizeof(_arena_block_t) + size);
+		if(NULL == block)
+		    ERROR_LOG_ERRNO_GOTO(RET, "Cannot allocate memory for the large block");
+
+		block->next = scope->arena_large;
+		block->account = account;
+		block->size = sizeof(_arena_block_t) + size;
+		scope->arena_large = block;
+		mempool_account_charge(account, block->size);
+		ret = block->mem;
+		goto RET;
+	}
+
+	if(NULL == scope->arena_pages || _arena_page_size - scope->arena_used < size)
+	{
+		LOG_DEBUG("The current arena page has been used up, allocate a new page");
+		_arena_block_t* page = (_arena_block_t*)mempool_page_alloc_account(account);
+		if(NULL == page)
+		    ERROR_LOG_GOTO(RET, "Cannot allocate new page for the request arena");
+
+		page->next = scope->arena_pages;
+		page->account = account;
+		page->size = _arena_page_size;
+		scope->arena_pages = page;
+		scope->arena_used = sizeof(_arena_block_t);
+	}
+
+	ret = ((char*)scope->arena_pages) + scope->arena_used;
+	scope->arena_used += size;
+
+RET:
+	if(_shared)
+	    __sync_lock_release(&scope->arena_lock);
+
+	return ret;
+}
+
 runtime_api_scope_token_t sched_rscope_add(sched_rscope_t* scope, const runtime_api_scope_entity_t* pointer)
 {
 	if(NULL == scope || NULL == pointer || NULL == pointer->data || NULL == pointer->free_func)
 	    ERROR_RETURN_LOG(runtime_api_scope_token_t, "Invalid arguments");
 
-	runtime_api_scope_token_t ret = _entry_alloc();
+	sched_rscope_table_t* table = _table_lock();
+
+	runtime_api_scope_token_t ret = _entry_alloc(table);
 	if(_NULL_ENTRY == ret)
-	    ERROR_RETURN_LOG(runtime_api_scope_token_t, "Cannot allocate new entry for the pointer");
+	{
+		_table_unlock(table);
+		ERROR_RETURN_LOG(runtime_api_scope_token_t, "Cannot allocate new entry for the pointer");
+	}
 
 	LOG_DEBUG("The pointer has new entry token %u", ret);
 
-	_entry_t* entry = _entry_table.data + ret;
+	_entry_t* entry = table->data + ret;
 	entry->data->entity = *pointer;
 	entry->data->refcnt = 1;
 	entry->next = scope->head;
 	entry->scope_id = scope->id;
 	scope->head = ret;
 
+	_table_unlock(table);
+
 	LOG_DEBUG("Request local scope entry %u has been used for request local scope %"PRIu64, ret, scope->id);
 
 	return ret;
@@ -309,18 +528,24 @@ runtime_api_scope_token_t sched_rscope_add(sched_rscope_t* scope, const runtime_
 
 int sched_rscope_copy(sched_rscope_t* scope, runtime_api_scope_token_t token, sched_rscope_copy_result_t* result)
 {
-	if(NULL == scope || _NULL_ENTRY == token || token >= _entry_table.capacity || NULL == result)
+	if(NULL == scope || _NULL_ENTRY == token || NULL == result)
 	    ERROR_RETURN_LOG(int, "Invalid arguments");
 
-	const _entry_t* source = _entry_table.data + token;
+	/* The entity object won't move when the table gets resized, so we only need the lock to find it */
+	sched_rscope_table_t* table = _table_lock();
+	const _scope_entity_t* source = token < table->capacity ? table->data[token].data : NULL;
+	_table_unlock(table);
+
+	if(NULL == source)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
 
-	if(NULL == source->data->entity.copy_func)
+	if(NULL == source->entity.copy_func)
 	    ERROR_RETURN_LOG(int, "This entry doesn't support copy");
 
-	runtime_api_scope_entity_t target = source->data->entity;
+	runtime_api_scope_entity_t target = source->entity;
 	target.data = NULL;
 
-	if(NULL == (target.data = source->data->entity.copy_func(source->data->entity.data)))
+	if(NULL == (target.data = source->entity.copy_func(source->entity.data)))
 	    ERROR_RETURN_LOG(int, "Cannot copy the data");
 
 	if(_NULL_ENTRY == (result->token = sched_rscope_add(scope, &target)))
@@ -339,25 +564,37 @@ ERR:
 
 const void* sched_rscope_get(const sched_rscope_t* scope, runtime_api_scope_token_t token)
 {
-	if(NULL == scope || _NULL_ENTRY == token || token >= _entry_table.capacity)
+	if(NULL == scope || _NULL_ENTRY == token)
 	    ERROR_PTR_RETURN_LOG("Invalid arguments");
 
-	if(_entry_table.data[token].data->entity.data == NULL ||
-	   _entry_table.data[token].scope_id != scope->id)
+	sched_rscope_table_t* table = _table_lock();
+
+	const void* ret = NULL;
+	if(token < table->capacity && table->data[token].data != NULL && table->data[token].scope_id == scope->id)
+	    ret = table->data[token].data->entity.data;
+
+	_table_unlock(table);
+
+	if(NULL == ret)
 	    ERROR_PTR_RETURN_LOG("Invalid token id, %u does not belong to scope %"PRIu64, token, scope->id);
 
-	return _entry_table.data[token].data->entity.data;
+	return ret;
 }
 
 sched_rscope_stream_t* sched_rscope_stream_open(runtime_api_scope_token_t token)
 {
-	if(_NULL_ENTRY == token || token >= _entry_table.capacity || _entry_table.data[token].data == NULL)
+	if(_NULL_ENTRY == token)
 	    ERROR_PTR_RETURN_LOG("Invalid arguments");
 
-	const _entry_t* target = _entry_table.data + token;
+	sched_rscope_table_t* table = _table_lock();
+	_scope_entity_t* entity = token < table->capacity ? table->data[token].data : NULL;
+	_table_unlock(table);
+
+	if(NULL == entity)
+	    ERROR_PTR_RETURN_LOG("Invalid arguments");
 
-	if(target->data->entity.open_func == NULL || target->data->entity.close_func == NULL ||
-	   target->data->entity.read_func == NULL || target->data->entity.eos_func == NULL)
+	if(entity->entity.open_func == NULL || entity->entity.close_func == NULL ||
+	   entity->entity.read_func == NULL || entity->entity.eos_func == NULL)
 	    ERROR_PTR_RETURN_LOG("The byte stream interface is not fully supported by the RLS entity %u",
 	    token);
 
@@ -366,9 +603,9 @@ sched_rscope_stream_t* sched_rscope_stream_open(runtime_api_scope_token_t token)
 	if(NULL == ret)
 	    ERROR_PTR_RETURN_LOG("Cannot allocate memory for the stream handle object for RLS token %u" , token);
 
-	ret->entity = target->data;
+	ret->entity = entity;
 	ret->token = token;
-	if(NULL == (ret->handle = target->data->entity.open_func(target->data->entity.data)))
+	if(NULL == (ret->handle = entity->entity.open_func(entity->entity.data)))
 	    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot open the RLS token as a byte stream, RLS token: %u", token);
 
 	LOG_DEBUG("RLS token %u has been successfully opened as a byte stream", token);
@@ -456,3 +693,15 @@ int sched_rscope_stream_get_event(sched_rscope_stream_t* stream, runtime_api_sco
 	return ent->entity.event_func(stream->handle, buf);
 }
 
+int sched_rscope_stream_get_fd_range(sched_rscope_stream_t* stream, runtime_api_scope_fd_range_t* buf)
+{
+	if(NULL == stream || NULL == buf)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_scope_entity_t* ent = stream->entity;
+
+	if(ent->entity.fd_func == NULL)
+	    return 0;
+
+	return ent->entity.fd_func(stream->handle, buf);
+}
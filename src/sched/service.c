@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <stdio.h>
 
 #include <error.h>
 #include <itc/module_types.h>
@@ -49,8 +50,11 @@ typedef struct {
 	const void* args;                           /*!< the argument for this node */
 	char**   pipe_type;                         /*!< the concrete type of the pipe */
 	size_t*  pipe_header_size;                  /*!< the size of pipe header */
+	uint32_t chained:1;                         /*!< if this node is the only downstream of its only upstream node */
 	runtime_task_flags_t flags;                 /*!< the additional task flags */
 	sched_service_pipe_descriptor_t* outgoing;  /*!< outgoing list */
+	sched_service_edge_plan_t* plan;            /*!< the precompiled execution plan for the outgoing list */
+	mempool_account_t* account;                 /*!< the memory account for the request memory allocated by this node */
 	uintpad_t __padding__[0];
 	sched_service_pipe_descriptor_t incoming[0];/*!< the incoming list */
 } _node_t;
@@ -74,6 +78,9 @@ struct _sched_service_t {
 	sched_cnode_info_t*   c_nodes;        /*!< the critical node */
 	size_t node_count;                    /*!< how many nodes in this service */
 	sched_prof_t*         profiler;       /*!< the profiler for this service */
+	uint64_t              deadline;       /*!< the time limit of a request in nanoseconds, 0 if the request doesn't have a deadline */
+	char*                 deadline_response;      /*!< the data written to the output when the request is rejected because of the deadline */
+	size_t                deadline_response_size; /*!< the size of the deadline response */
 	uintpad_t __padding__[0];
 	_node_t*  nodes[0];                   /*!< the node list */
 };
@@ -107,6 +114,9 @@ static inline sched_service_t* _create_service(size_t num_nodes)
 	ret->node_count = num_nodes;
 	memset(ret->nodes, 0, size - sizeof(sched_service_t));
 	ret->c_nodes = NULL;
+	ret->deadline = 0;
+	ret->deadline_response = NULL;
+	ret->deadline_response_size = 0;
 	return ret;
 }
 
@@ -126,6 +136,9 @@ static inline _node_t* _create_node(runtime_stab_entry_t servlet, runtime_task_f
 	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for service node");
 
 	ret->outgoing = ret->incoming + incoming_count;
+	ret->plan = NULL;
+	ret->account = NULL;
+	ret->chained = 0;
 	ret->incoming_count = ret->outgoing_count = 0;
 	ret->servlet_id = servlet;
 	ret->flags = flags;
@@ -191,11 +204,118 @@ static inline int _dispose_node(_node_t* node)
 	if(NULL != node->pipe_header_size)
 	    free(node->pipe_header_size);
 
+	if(NULL != node->plan)
+	    free(node->plan);
+
+	if(NULL != node->account && ERROR_CODE(int) == mempool_account_free(node->account))
+	    LOG_WARNING("Cannot dispose the memory account of the node");
+
 	free(node);
 
 	return 0;
 }
 
+/**
+ * @brief if we need to mark the linear chains in the service graph, so that the scheduler hands the downstream of a chain
+ *        to the worker right after the upstream
+ **/
+static int _chain_handoff = 1;
+
+/**
+ * @brief the request deadline in milliseconds for the services created afterwards, 0 means no deadline
+ **/
+static uint32_t _request_deadline = 0;
+
+/**
+ * @brief the response for the rejected request for the services created afterwards
+ **/
+static char* _deadline_response = NULL;
+
+/**
+ * @brief build the execution plan for all the outgoing pipes of the node
+ * @note this should be called after the type checker is done, because we need the pipe header size
+ * @param service the service
+ * @param nid the node id
+ * @return status code
+ **/
+static inline int _build_node_plan(const sched_service_t* service, sched_service_node_id_t nid)
+{
+	_node_t* node = service->nodes[nid];
+	uint32_t i;
+
+	if(node->outgoing_count == 0) return 0;
+
+	if(NULL == (node->plan = (sched_service_edge_plan_t*)malloc(sizeof(node->plan[0]) * node->outgoing_count)))
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the execution plan of node %u", nid);
+
+	for(i = 0; i < node->outgoing_count; i ++)
+	{
+		const sched_service_pipe_descriptor_t* desc = node->outgoing + i;
+		sched_service_edge_plan_t* plan = node->plan + i;
+		const _node_t* dest = service->nodes[desc->destination_node_id];
+
+		runtime_api_pipe_flags_t out_flags = runtime_stab_get_pipe_flags(node->servlet_id, desc->source_pipe_desc);
+		if(ERROR_CODE(runtime_api_pipe_flags_t) == out_flags)
+		    ERROR_RETURN_LOG(int, "Cannot get output pipe flags");
+
+		runtime_api_pipe_flags_t in_flags = runtime_stab_get_pipe_flags(dest->servlet_id, desc->destination_pipe_desc);
+		if(ERROR_CODE(runtime_api_pipe_flags_t) == in_flags)
+		    ERROR_RETURN_LOG(int, "Cannot get input pipe flags");
+
+		plan->desc = *desc;
+		plan->param.output_flags  = out_flags;
+		plan->param.output_header = node->pipe_header_size[desc->source_pipe_desc];
+		plan->param.input_flags   = in_flags;
+		plan->param.input_header  = dest->pipe_header_size[desc->destination_pipe_desc];
+		plan->param.args = NULL;
+		plan->downstream_slot = desc->destination_node_id;
+		plan->downstream_inputs = dest->incoming_count;
+
+		if(out_flags & RUNTIME_API_PIPE_SHADOW)
+		{
+			plan->shadow_target = RUNTIME_API_PIPE_GET_TARGET(out_flags);
+			plan->shadow_flags = in_flags | RUNTIME_API_PIPE_SHADOW | plan->shadow_target | (out_flags & RUNTIME_API_PIPE_DISABLED);
+		}
+		else
+		{
+			plan->shadow_target = ERROR_CODE(runtime_api_pipe_id_t);
+			plan->shadow_flags = 0;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief find all the linear chains in the service graph and mark the downstream nodes
+ * @details a node is chained with its upstream if its only input comes from the upstream, and the
+ *          pipe is the only output of the upstream. In this case, the node becomes ready exactly when
+ *          the upstream is about to run, so the worker can run it directly after the upstream instead of
+ *          putting it to the ready queue. The pipe between the two nodes is allocated as usual.
+ * @note this should be called after the execution plan is built
+ * @param service the service
+ * @return nothing
+ **/
+static inline void _mark_chains(const sched_service_t* service)
+{
+	uint32_t i, ret = 0;
+	for(i = 0; i < service->node_count; i ++)
+	{
+		const _node_t* node = service->nodes[i];
+		if(node->outgoing_count != 1 || node->plan[0].shadow_target != ERROR_CODE(runtime_api_pipe_id_t))
+		    continue;
+
+		sched_service_node_id_t next = node->outgoing[0].destination_node_id;
+		if(next == service->input_node || service->nodes[next]->incoming_count != 1)
+		    continue;
+
+		service->nodes[next]->chained = 1;
+		ret ++;
+	}
+
+	LOG_DEBUG("%u nodes in the service graph has been chained with its upstream", ret);
+}
+
 /**
  * @brief validate the node ID
  * @param buffer the service buffer
@@ -525,6 +645,11 @@ sched_service_t* sched_service_from_buffer(const sched_service_buffer_t* buffer)
 		if(NULL == node) ERROR_LOG_ERRNO_GOTO(ERR, "Cannot read the node table in the service buffer");
 		if(NULL == (ret->nodes[i] = _create_node(node->servlet_id, node->flags, incoming_count[i], outgoing_count[i], (buffer->reuse_servlet != 0))))
 		    ERROR_LOG_GOTO(ERR, "Cannot create node in the service def");
+
+		char account_name[32];
+		snprintf(account_name, sizeof(account_name), "sched.node.%u", i);
+		if(NULL == (ret->nodes[i]->account = mempool_account_new(account_name)))
+		    ERROR_LOG_GOTO(ERR, "Cannot create the memory account for node %u", i);
 	}
 
 	for(i = 0; i < vector_length(buffer->pipes); i ++)
@@ -581,6 +706,21 @@ sched_service_t* sched_service_from_buffer(const sched_service_buffer_t* buffer)
 	if(ERROR_CODE(int) == sched_type_check(ret))
 	    ERROR_LOG_GOTO(ERR, "Service type checker failed");
 
+	/* At this point, nothing about the pipes will be changed, so we can compile the execution plan */
+	for(i = 0; i < num_nodes; i ++)
+	    if(ERROR_CODE(int) == _build_node_plan(ret, i))
+	        ERROR_LOG_GOTO(ERR, "Cannot build the execution plan for node %u", i);
+
+	if(_chain_handoff) _mark_chains(ret);
+
+	if(NULL != _deadline_response)
+	{
+		if(NULL == (ret->deadline_response = strdup(_deadline_response)))
+		    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot copy the deadline response");
+		ret->deadline_response_size = strlen(_deadline_response);
+	}
+	ret->deadline = (uint64_t)_request_deadline * 1000000ull;
+
 	return ret;
 ERR:
 	if(ret != NULL)
@@ -589,6 +729,7 @@ ERR:
 		    if(ret->nodes[i] != NULL)
 		        _dispose_node(ret->nodes[i]);
 		if(ret->c_nodes != NULL) sched_cnode_info_free(ret->c_nodes);
+		if(ret->deadline_response != NULL) free(ret->deadline_response);
 		free(ret);
 	}
 	if(incoming_count != NULL) free(incoming_count);
@@ -615,6 +756,8 @@ int sched_service_free(sched_service_t* service)
 	    rc = ERROR_CODE(int);
 #endif
 
+	if(NULL != service->deadline_response) free(service->deadline_response);
+
 	free(service);
 	return rc;
 }
@@ -656,6 +799,82 @@ const sched_service_pipe_descriptor_t* sched_service_get_outgoing_pipes(const sc
 	return node->outgoing;
 }
 
+const sched_service_edge_plan_t* sched_service_get_outgoing_plan(const sched_service_t* service, sched_service_node_id_t nid, uint32_t* nresult)
+{
+	if(NULL == service || nid == ERROR_CODE(sched_service_node_id_t) || nid >= service->node_count || NULL == nresult)
+	    ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	const _node_t* node = service->nodes[nid];
+	*nresult = node->outgoing_count;
+
+	/* For the node without any outgoing pipe, we do not allocate the plan, but it's not an error */
+	static const sched_service_edge_plan_t empty[0];
+	return node->plan == NULL ? empty : node->plan;
+}
+
+int sched_service_node_chained(const sched_service_t* service, sched_service_node_id_t nid)
+{
+	if(NULL == service || nid == ERROR_CODE(sched_service_node_id_t) || nid >= service->node_count)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	return service->nodes[nid]->chained;
+}
+
+int sched_service_set_chain_handoff(int enabled)
+{
+	_chain_handoff = (enabled != 0);
+	return 0;
+}
+
+int sched_service_get_chain_handoff(void)
+{
+	return _chain_handoff;
+}
+
+int sched_service_set_request_deadline(uint32_t ms)
+{
+	_request_deadline = ms;
+	return 0;
+}
+
+uint32_t sched_service_get_request_deadline(void)
+{
+	return _request_deadline;
+}
+
+int sched_service_set_deadline_response(const char* response)
+{
+	char* new_response = NULL;
+
+	if(NULL != response && NULL == (new_response = strdup(response)))
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot copy the deadline response");
+
+	if(NULL != _deadline_response) free(_deadline_response);
+	_deadline_response = new_response;
+
+	return 0;
+}
+
+const char* sched_service_get_deadline_response(void)
+{
+	return _deadline_response;
+}
+
+uint64_t sched_service_deadline(const sched_service_t* service)
+{
+	if(NULL == service) ERROR_RETURN_LOG(uint64_t, "Invalid arguments");
+
+	return service->deadline;
+}
+
+const char* sched_service_deadline_response(const sched_service_t* service, size_t* size)
+{
+	if(NULL == service || NULL == size) ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	*size = service->deadline_response_size;
+	return service->deadline_response;
+}
+
 char const* const* sched_service_get_node_args(const sched_service_t* service, sched_service_node_id_t nid, uint32_t* argc)
 {
 	if(NULL == service || nid == ERROR_CODE(sched_service_node_id_t) || nid >= service->node_count || NULL == argc)
@@ -665,6 +884,14 @@ char const* const* sched_service_get_node_args(const sched_service_t* service, s
 	return runtime_stab_get_init_arg(node->servlet_id, argc);
 }
 
+mempool_account_t* sched_service_get_node_account(const sched_service_t* service, sched_service_node_id_t nid)
+{
+	if(NULL == service || nid == ERROR_CODE(sched_service_node_id_t) || nid >= service->node_count)
+	    ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	return service->nodes[nid]->account;
+}
+
 runtime_api_pipe_flags_t sched_service_get_pipe_flags(const sched_service_t* service, sched_service_node_id_t nid, runtime_api_pipe_id_t pid)
 {
 	if(NULL == service || nid == ERROR_CODE(sched_service_node_id_t) || nid >= service->node_count)
@@ -703,13 +930,13 @@ const sched_cnode_info_t* sched_service_get_cnode_info(const sched_service_t* se
 	return service->c_nodes;
 }
 
-int sched_service_profiler_timer_start(const sched_service_t* service, sched_service_node_id_t node)
+int sched_service_profiler_timer_start(const sched_service_t* service, sched_service_node_id_t node, uint64_t ready_time)
 {
 	if(NULL == service || node == ERROR_CODE(sched_service_node_id_t)) ERROR_RETURN_LOG(int, "Invlaid arguments");
 
 	if(service->profiler == NULL) return 0;
 
-	return sched_prof_start_timer(service->profiler, node);
+	return sched_prof_start_timer(service->profiler, node, ready_time);
 }
 
 int sched_service_profiler_timer_stop(const sched_service_t* service)
@@ -730,6 +957,13 @@ int sched_service_profiler_flush(const sched_service_t* service)
 	return sched_prof_flush(service->profiler);
 }
 
+sched_prof_t* sched_service_get_profiler(const sched_service_t* service)
+{
+	if(NULL == service) ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	return service->profiler;
+}
+
 int sched_service_get_pipe_type(const sched_service_t* service, sched_service_node_id_t node, runtime_api_pipe_id_t pid, char const* * result)
 {
 	if(NULL == service || ERROR_CODE(sched_service_node_id_t) == node ||
@@ -4,15 +4,26 @@
 
 #include <plumber.h>
 #include <utils/log.h>
+#include <utils/clock.h>
 #include <error.h>
 
 static __thread sched_rscope_t* _current_request_scope = NULL;
 
+/**
+ * @brief the memory account of the node which is currently running
+ **/
+static __thread mempool_account_t* _current_account = NULL;
+
 sched_rscope_t* sched_step_current_scope()
 {
 	return _current_request_scope;
 }
 
+mempool_account_t* sched_step_current_account()
+{
+	return _current_account;
+}
+
 __attribute__((used)) static inline int _run_task_fast(runtime_task_t* task)
 {
 	if(task->flags & RUNTIME_TASK_FLAG_ACTION_ASYNC)
@@ -20,13 +31,162 @@ __attribute__((used)) static inline int _run_task_fast(runtime_task_t* task)
 	return runtime_task_start_exec_fast(task);
 }
 
+/**
+ * @brief Touch the null signal pipe if the task doesn't produce any output
+ * @param task The task that has been executed
+ * @param plan The outgoing plan of the task's node
+ * @param size The number of edges in the plan
+ * @return status code
+ **/
+static inline int _signal_null(const sched_task_t* task, const sched_service_edge_plan_t* plan, uint32_t size)
+{
+	runtime_api_pipe_id_t null_pid = RUNTIME_API_PIPE_TO_PID(task->exec_task->servlet->sig_null);
+
+	if(task->exec_task->pipes[null_pid] == NULL) return 0;
+
+	uint32_t i;
+	for(i = 0; i < size; i ++)
+	{
+		int touched = 0;
+		if(plan[i].desc.source_pipe_desc != task->exec_task->servlet->sig_null &&
+		   plan[i].desc.source_pipe_desc != task->exec_task->servlet->sig_error &&
+		   ERROR_CODE(int) == (touched = itc_module_pipe_is_touched(task->exec_task->pipes[RUNTIME_API_PIPE_TO_PID(plan[i].desc.source_pipe_desc)])))
+		    ERROR_RETURN_LOG(int, "Cannot check if the pipe has been touched");
+		if(touched) return 0;
+	}
+
+	LOG_DEBUG("The servlet produces zero output, set the __null__ signal");
+	size_t rc;
+	for(;0 == (rc = itc_module_pipe_write("", 1, task->exec_task->pipes[null_pid])););
+	if(ERROR_CODE(size_t) == rc) ERROR_RETURN_LOG(int, "Cannot touch the null signal pipe");
+
+	return 0;
+}
+
+/**
+ * @brief Mark all the outputs of the failed task unreliable and touch the error signal pipe
+ * @param task The failed task
+ * @param plan The outgoing plan of the task's node
+ * @param size The number of edges in the plan
+ * @return status code
+ **/
+static inline int _signal_error(const sched_task_t* task, const sched_service_edge_plan_t* plan, uint32_t size)
+{
+	uint32_t i;
+	/* First, the error code means all the output is not reliable */
+	for(i = 0; i < size; i ++)
+	{
+		if(plan[i].desc.source_pipe_desc != task->exec_task->servlet->sig_null &&
+		   plan[i].desc.source_pipe_desc != task->exec_task->servlet->sig_error &&
+		   ERROR_CODE(int) == itc_module_pipe_set_error(task->exec_task->pipes[RUNTIME_API_PIPE_TO_PID(plan[i].desc.source_pipe_desc)]))
+		    ERROR_RETURN_LOG(int, "Cannot set the error state to all the output pipes");
+	}
+
+	/* Then we need to touch the error pipe */
+	runtime_api_pipe_id_t error_pid = RUNTIME_API_PIPE_TO_PID(task->exec_task->servlet->sig_error);
+	if(task->exec_task->pipes[error_pid] != NULL)
+	{
+		size_t rc;
+		for(;0 == (rc = itc_module_pipe_write("", 1, task->exec_task->pipes[error_pid])););
+		if(ERROR_CODE(size_t) == rc) ERROR_RETURN_LOG(int, "Cannot touch the error signal pipe");
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Check if the task can be handed over to a peer scheduler
+ * @details Only the sync task which doesn't touch the module pipes can be executed by other thread,
+ *          because the module pipes are bound to the thread which accepts the request. And it only
+ *          makes sense when the request has other ready tasks to run on the owner. <br/>
+ *          The task with shadow or forked pipes can't be handed over either, because the pipes share
+ *          the companion list with the pipes of other tasks of the same request, which may be running on
+ *          the owner at the same time, and the companion list isn't thread-safe
+ * @param task The task to check
+ * @param plan The outgoing plan of the task's node
+ * @param size The number of edges in the plan
+ * @return the check result
+ **/
+static inline int _offloadable(sched_task_t* task, const sched_service_edge_plan_t* plan, uint32_t size)
+{
+	uint32_t siblings = sched_task_num_ready_siblings(task);
+	if(0 == siblings || ERROR_CODE(uint32_t) == siblings)
+	    return 0;
+
+	if(task->node == sched_service_get_input_node(task->service) ||
+	   task->node == sched_service_get_output_node(task->service))
+	    return 0;
+
+	uint32_t i;
+	for(i = 0; i < size; i ++)
+	    if(plan[i].shadow_target != ERROR_CODE(runtime_api_pipe_id_t))
+	        return 0;
+
+	/* All the upstream tasks have been disposed at this point, so the input pipe which still has a companion
+	 * must be the one sharing data with its forks */
+	for(i = 0; i < task->exec_task->npipes; i ++)
+	    if(NULL != task->exec_task->pipes[i] && 0 != itc_module_pipe_has_companion(task->exec_task->pipes[i]))
+	        return 0;
+
+	return 1;
+}
+
+int sched_step_run_offloaded(sched_task_t* task, sched_rscope_table_t* table)
+{
+	uint32_t size;
+	const sched_service_edge_plan_t* plan;
+
+	if(NULL == task || NULL == table)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if(NULL == (plan = sched_service_get_outgoing_plan(task->service, task->node, &size)))
+	    ERROR_RETURN_LOG(int, "Cannot get the execution plan of the outgoing pipes");
+
+	/* The RLS tokens of the request are allocated from the entry table of the owner */
+	sched_rscope_table_t* prev_table = sched_rscope_switch_table(table);
+	if(NULL == prev_table)
+	{
+		LOG_ERROR("Cannot switch to the request local scope entry table of the task owner");
+		return _signal_error(task, plan, size);
+	}
+
+	int rc = 0;
+	int traced = sched_trace_sampled(task);
+	uint64_t trace_start = traced ? utils_clock_now_ns() : 0;
+
+#ifdef ENABLE_PROFILER
+	if(sched_service_profiler_timer_start(task->service, task->node, sched_task_ready_time(task)) == ERROR_CODE(int))
+	    LOG_WARNING("Cannot start the profiler");
+#endif
+	_current_request_scope = task->scope;
+	_current_account = sched_service_get_node_account(task->service, task->node);
+	if(runtime_task_start(task->exec_task) == ERROR_CODE(int))
+	{
+		LOG_ERROR("Task failed");
+		rc = _signal_error(task, plan, size);
+	}
+	else rc = _signal_null(task, plan, size);
+#ifdef ENABLE_PROFILER
+	if(sched_service_profiler_timer_stop(task->service) == ERROR_CODE(int))
+	    LOG_WARNING("Cannot stop the profiler");
+#endif
+	if(traced && ERROR_CODE(int) == sched_trace_span(task, SCHED_TRACE_PHASE_EXEC, trace_start))
+	    LOG_WARNING("Cannot record the trace span");
+
+	if(NULL == sched_rscope_switch_table(prev_table))
+	    LOG_ERROR("Cannot switch back to the request local scope entry table");
+
+	return rc;
+}
+
 int sched_step_next(sched_task_context_t* stc, itc_module_type_t type)
 {
 	sched_task_t* task = NULL;
 	uint32_t size, i;
-	const sched_service_pipe_descriptor_t* result;
+	const sched_service_edge_plan_t* plan;
 	itc_module_pipe_t *pipes[2];
 	int async_post_rc;
+	sched_loop_t* peer = NULL;
 
 	task = sched_task_next_ready_task(stc);
 
@@ -38,105 +198,91 @@ START_OVER:
 		return 0;
 	}
 
-	if(NULL == (result = sched_service_get_outgoing_pipes(task->service, task->node, &size)))
-	    ERROR_LOG_GOTO(LERR, "Cannot get outgoing pipes");
+	if(NULL == (plan = sched_service_get_outgoing_plan(task->service, task->node, &size)))
+	    ERROR_LOG_GOTO(LERR, "Cannot get the execution plan of the outgoing pipes");
+
+	/* The task comes back from the peer scheduler has been executed, so we only need to notify the downstream */
+	int offloaded = (sched_task_offloaded(task) > 0);
 
 	/* We should initialize the pipes only for the sync request and the async init */
-	int pipe_init = (!runtime_task_is_async(task->exec_task)) || !(task->exec_task->flags & (RUNTIME_TASK_FLAG_ACTION_UNLOAD | RUNTIME_TASK_FLAG_ACTION_EXEC));
+	int pipe_init = !offloaded && ((!runtime_task_is_async(task->exec_task)) || !(task->exec_task->flags & (RUNTIME_TASK_FLAG_ACTION_UNLOAD | RUNTIME_TASK_FLAG_ACTION_EXEC)));
 	int async_init = pipe_init && runtime_task_is_async(task->exec_task);
 
+	/* If there's an idle peer, the independent sync task can be executed by the peer, and joined back
+	 * just like the async task */
+	if(pipe_init && !async_init && _offloadable(task, plan, size))
+	    peer = sched_loop_acquire_idle_peer(sched_task_get_loop(task));
+
 	for(i = 0; i < size; i ++)
 	{
+		const sched_service_pipe_descriptor_t* desc = &plan[i].desc;
 		if(pipe_init)
 		{
-			runtime_api_pipe_flags_t out_flags = 0, in_flags = 0;
-
-			out_flags = sched_service_get_pipe_flags(task->service, result[i].source_node_id, result[i].source_pipe_desc);
-			if(ERROR_CODE(runtime_api_pipe_flags_t) == out_flags)
-			    ERROR_LOG_GOTO(LERR, "Cannot get output pipe flags");
-
-			in_flags = sched_service_get_pipe_flags(task->service, result[i].destination_node_id, result[i].destination_pipe_desc);
-			if(ERROR_CODE(runtime_api_pipe_flags_t) == in_flags)
-			    ERROR_LOG_GOTO(LERR, "Cannot get input pipe flags");
-
-			size_t input_header_size, output_header_size;
-
-			if(ERROR_CODE(size_t) == (output_header_size = sched_service_get_pipe_type_size(task->service,
-			                                                                                result[i].source_node_id,
-			                                                                                result[i].source_pipe_desc)))
-			    ERROR_LOG_GOTO(LERR, "Cannot get the size of output header size");
-
-			if(ERROR_CODE(size_t) == (input_header_size = sched_service_get_pipe_type_size(task->service,
-			                                                                               result[i].destination_node_id,
-			                                                                               result[i].destination_pipe_desc)))
-			    ERROR_LOG_GOTO(LERR, "Cannot get the size of output header size");
-
-			itc_module_pipe_param_t param = {
-				.output_flags  = out_flags,
-				.output_header = output_header_size,
-				.input_flags   = in_flags,
-				.input_header  = input_header_size,
-				.args = NULL
-			};
-
-			if(out_flags & RUNTIME_API_PIPE_SHADOW)
+			if(plan[i].shadow_target != ERROR_CODE(runtime_api_pipe_id_t))
 			{
-				runtime_api_pipe_id_t target_pid = RUNTIME_API_PIPE_GET_TARGET(out_flags);
-				runtime_api_pipe_flags_t disabled = (out_flags & RUNTIME_API_PIPE_DISABLED);
 				pipes[0] = NULL;
-				pipes[1] = itc_module_pipe_fork(task->exec_task->pipes[target_pid], in_flags | RUNTIME_API_PIPE_SHADOW | target_pid | disabled, input_header_size, NULL);
+				pipes[1] = itc_module_pipe_fork(task->exec_task->pipes[plan[i].shadow_target], plan[i].shadow_flags, plan[i].param.input_header, NULL);
 
-				if(ERROR_CODE(int) == sched_task_output_shadow(task, result[i].source_pipe_desc, pipes[1]))
+				if(ERROR_CODE(int) == sched_task_output_shadow(task, desc->source_pipe_desc, pipes[1]))
 				    ERROR_LOG_GOTO(LERR, "Cannot add the forked pipe as shadow");
 			}
-			else if(itc_module_pipe_allocate(type, 0, param, pipes + 0, pipes + 1) < 0)
+			else if(itc_module_pipe_allocate(type, 0, plan[i].param, pipes + 0, pipes + 1) < 0)
 			    ERROR_LOG_GOTO(LERR, "Cannot allocate pipe from <NID = %d, PID = %d> -> <NID = %d, PID = %d>",
-			                         result[i].source_node_id, result[i].source_pipe_desc,
-			                         result[i].destination_node_id, result[i].destination_pipe_desc);
+			                         desc->source_node_id, desc->source_pipe_desc,
+			                         desc->destination_node_id, desc->destination_pipe_desc);
 
-			if(pipes[0] != NULL && sched_task_output_pipe(task, result[i].source_pipe_desc, pipes[0]) == ERROR_CODE(int))
+			if(pipes[0] != NULL && sched_task_output_pipe(task, desc->source_pipe_desc, pipes[0]) == ERROR_CODE(int))
 			    ERROR_LOG_GOTO(LERR, "Cannot assign output pipe to the task");
 
-			if(sched_task_input_pipe(stc, task->service, task->request, result[i].destination_node_id, result[i].destination_pipe_desc, pipes[1], async_init) == ERROR_CODE(int))
+			if(sched_task_input_pipe_planned(task, plan + i, pipes[1], async_init || NULL != peer) == ERROR_CODE(int))
 			    ERROR_LOG_GOTO(LERR, "Cannot assign the input pipe to the downstream task");
 		}
-		else if(ERROR_CODE(int) == sched_task_input_pipe(stc, task->service, task->request, result[i].destination_node_id, result[i].destination_pipe_desc, NULL, 1))
+		else if(ERROR_CODE(int) == sched_task_input_pipe_planned(task, plan + i, NULL, 1))
 		    ERROR_LOG_GOTO(LERR, "Cannot set the async task pipe to ready state");
 	}
 
+	if(offloaded) goto CLEANUP;
+
+	if(NULL != peer)
+	{
+		if(ERROR_CODE(int) != sched_task_offload(task, peer))
+		{
+			/* In this case, we must not dispose the task, because it's in the pending list */
+			goto RETURN;
+		}
+
+		LOG_WARNING("Cannot hand over the task to the peer scheduler, run it locally");
+		if(ERROR_CODE(int) == sched_loop_release_peer(peer))
+		    LOG_WARNING("Cannot release the peer scheduler");
+	}
+
 	if(!async_init)
 	{
+		int traced = sched_trace_sampled(task);
+		uint64_t trace_start = traced ? utils_clock_now_ns() : 0;
 
 #ifdef ENABLE_PROFILER
-		static __thread int counter = 0;
-
-		if(sched_service_profiler_timer_start(task->service, task->node) == ERROR_CODE(int))
+		if(sched_service_profiler_timer_start(task->service, task->node, sched_task_ready_time(task)) == ERROR_CODE(int))
 		    LOG_WARNING("Cannot start the profiler");
-		counter ++;
 #endif
 		_current_request_scope = task->scope;
+		_current_account = sched_service_get_node_account(task->service, task->node);
 		/* TODO: what should we do for the async task ? */
 #ifdef FULL_OPTIMIZATION
-		if(_run_task_fast(task->exec_task) == ERROR_CODE(int))
+		int exec_rc = _run_task_fast(task->exec_task);
 #else
-		if(runtime_task_start(task->exec_task) == ERROR_CODE(int))
+		int exec_rc = runtime_task_start(task->exec_task);
 #endif
-		{
-#ifdef ENABLE_PROFILER
-			if(sched_service_profiler_timer_stop(task->service) == ERROR_CODE(int))
-			    LOG_WARNING("Cannot stop the profiler");
-#endif
-			ERROR_LOG_GOTO(TASK_FAILED, "Task failed");
-		}
 #ifdef ENABLE_PROFILER
 		if(sched_service_profiler_timer_stop(task->service) == ERROR_CODE(int))
 		    LOG_WARNING("Cannot stop the profiler");
-		if(counter > 10000)
-		{
-			sched_service_profiler_flush(task->service);
-			counter = 0;
-		}
 #endif
+		/* If the pipes are not initialized here, this is the async cleanup */
+		if(traced && ERROR_CODE(int) == sched_trace_span(task, pipe_init ? SCHED_TRACE_PHASE_EXEC : SCHED_TRACE_PHASE_ASYNC_CLEANUP, trace_start))
+		    LOG_WARNING("Cannot record the trace span");
+
+		if(exec_rc == ERROR_CODE(int))
+		    ERROR_LOG_GOTO(TASK_FAILED, "Task failed");
 		if(pipe_init == 0)
 		{
 			/* If the pipe_init flag is 0, the only possible case is we are processing
@@ -149,33 +295,14 @@ START_OVER:
 			if(ERROR_CODE(int) == task_rc)
 			    ERROR_LOG_GOTO(TASK_FAILED, "The async task status is failed");
 		}
-		runtime_api_pipe_id_t null_pid = RUNTIME_API_PIPE_TO_PID(task->exec_task->servlet->sig_null);
-
-		if(task->exec_task->pipes[null_pid] != NULL)
-		{
-			for(i = 0; i < size; i ++)
-			{
-				int touched = 0;
-				if(result[i].source_pipe_desc != task->exec_task->servlet->sig_null &&
-				   result[i].source_pipe_desc != task->exec_task->servlet->sig_error &&
-				   ERROR_CODE(int) == (touched = itc_module_pipe_is_touched(task->exec_task->pipes[RUNTIME_API_PIPE_TO_PID(result[i].source_pipe_desc)])))
-				    ERROR_LOG_GOTO(LERR, "Cannot check if the pipe has been touched");
-				if(touched) break;
-			}
-			if(i == size)
-			{
-				LOG_DEBUG("The servlet produces zero output, set the __null__ signal");
-				size_t rc;
-				for(;0 == (rc = itc_module_pipe_write("", 1, task->exec_task->pipes[null_pid])););
-				if(ERROR_CODE(size_t) == rc) ERROR_LOG_GOTO(LERR, "Cannot touch the null signal pipe");
-			}
-		}
+		if(ERROR_CODE(int) == _signal_null(task, plan, size))
+		    ERROR_LOG_GOTO(LERR, "Cannot set the null signal");
 	}
 	else if(ERROR_CODE(int) == (async_post_rc = sched_task_launch_async(task)))
 	{
 		/* In this case, we cannot start the async task, so we need notify the downstream right now */
 		for(i = 0; i < size; i ++)
-		    sched_task_input_pipe(stc, task->service, task->request, result[i].destination_node_id, result[i].destination_pipe_desc, NULL, 1);
+		    sched_task_input_pipe_planned(task, plan + i, NULL, 1);
 
 		ERROR_LOG_GOTO(TASK_FAILED, "Cannot launch the async task");
 	}
@@ -197,27 +324,16 @@ START_OVER:
 
 	goto CLEANUP;
 TASK_FAILED:
-
-	/* First, the error code means all the output is not reliable */
-	for(i = 0; i < size; i ++)
-	{
-		if(result[i].source_pipe_desc != task->exec_task->servlet->sig_null &&
-		   result[i].source_pipe_desc != task->exec_task->servlet->sig_error &&
-		   ERROR_CODE(int) == itc_module_pipe_set_error(task->exec_task->pipes[RUNTIME_API_PIPE_TO_PID(result[i].source_pipe_desc)]))
-		    ERROR_LOG_GOTO(LERR, "Cannot set the error state to all the output pipes");
-	}
-
-	/* Then we need to touch the error pipe */
-	runtime_api_pipe_id_t error_pid = RUNTIME_API_PIPE_TO_PID(task->exec_task->servlet->sig_error);
-	if(task->exec_task->pipes[error_pid] != NULL)
-	{
-		size_t rc;
-		for(;0 == (rc = itc_module_pipe_write("", 1, task->exec_task->pipes[error_pid])););
-		if(ERROR_CODE(size_t) == rc) ERROR_LOG_GOTO(LERR, "Cannot touch the error signal pipe");
-	}
+	if(ERROR_CODE(int) == _signal_error(task, plan, size))
+	    ERROR_LOG_GOTO(LERR, "Cannot set the error signal");
 
 	/* At this point, we are good to go */
 CLEANUP:
+	/* If we failed to hand over the task, the downstream pipes are assigned but not ready yet */
+	if(NULL != peer)
+	    for(i = 0; i < size; i ++)
+	        sched_task_input_pipe_planned(task, plan + i, NULL, 1);
+
 	if(sched_task_free(task) == ERROR_CODE(int)) LOG_WARNING("Cannot dispose task");
 
 RETURN:
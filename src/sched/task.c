@@ -13,6 +13,17 @@
 #include <utils/log.h>
 #include <utils/mempool/objpool.h>
 #include <utils/string.h>
+#include <utils/clock.h>
+
+/**
+ * @brief the state of a task slot
+ **/
+typedef enum {
+	_SLOT_UNUSED,    /*!< the slot doesn't have a task */
+	_SLOT_PENDING,   /*!< the task is waiting for its inputs, which means it's in the task table */
+	_SLOT_DETACHED,  /*!< the task has been removed from the task table, which means it's either ready, running or waiting for the async task */
+	_SLOT_OFFLOADED  /*!< the task has been handed over to a peer scheduler, it's either running on the peer or waiting for the downstream notification */
+} _slot_state_t;
 
 /**
  * @brief the task table entry
@@ -22,38 +33,67 @@ typedef struct _task_entry_t{
 	uint32_t              num_required_inputs;   /*!< how many inputs this task required */
 	uint32_t              num_cancelled_inputs;  /*!< how many inputs has already been cancelled so far */
 	uint32_t              num_awaiting_inputs;   /*!< how many inputs that is still in awaiting state, which means either unassigned or not ready */
+	_slot_state_t         state;                 /*!< the state of this task slot */
+#ifdef ENABLE_PROFILER
+	uint64_t              ready_time;            /*!< the monotonic time when the task gets into the ready queue or the async completion queue */
+#endif
 	struct _task_entry_t* prev;                  /*!< the previous item in the list */
 	struct _task_entry_t* next;                  /*!< the previous item in the list */
 } _task_entry_t;
 STATIC_ASSERTION_FIRST(_task_entry_t, task);
 
+/**
+ * @brief the request entry
+ * @details each request has one contiguous block of task slots, which is indexed by the node id.
+ *          So that we don't need any hash table for looking for the task of a node. And all the
+ *          tasks of a request are disposed in one step when the request is done
+ **/
 typedef struct _request_entry_t {
 	sched_task_request_t request_id; /*!< the request id for this request */
 	uint32_t num_pending_tasks;      /*!< the number of pending tasks has been created for this request */
+	uint32_t num_ready_tasks;        /*!< the number of tasks of this request that are currently in the ready queue */
+	uint32_t num_slots;              /*!< the number of task slots, which is the number of nodes in the service */
+	uint32_t pool_level;             /*!< the level of the memory pool this entry is allocated from, ERROR_CODE(uint32_t) if it's not allocated from the pool */
+	uint32_t rejected:1;             /*!< if the request has been rejected because it can not meet its deadline */
+	uint32_t responded:1;            /*!< if the deadline response has been written to the output */
+	uint64_t deadline;               /*!< the monotonic time in nanoseconds by which the request should be done, UINT64_MAX if it doesn't have a deadline */
+	uint64_t start;                  /*!< the monotonic time in nanoseconds when the input task starts, 0 if it's not started or the request doesn't have a deadline */
+	const sched_service_t* service;  /*!< the service this request runs on */
 	sched_rscope_t* scope;           /*!< the request local scope */
 	struct _request_entry_t* next;   /*!< the next pointer for the request hash table */
+	uintpad_t __padding__[0];
+	_task_entry_t tasks[0];          /*!< the task slots, indexed by the node id */
 } _request_entry_t;
+STATIC_ASSERTION_LAST(_request_entry_t, tasks);
+STATIC_ASSERTION_SIZE(_request_entry_t, tasks, 0);
+
+/**
+ * @brief the number of request memory pools, the pool of level N holds the request entry with 2^N task slots
+ * @note the request with more slots than the largest pool is allocated by malloc directly, since
+ *       the object pool only handles the object which fits in a page
+ **/
+#define _REQUEST_POOL_LEVELS 6
 
 /**
  * @brief The context used by a task table
  **/
 struct _sched_task_context_t {
 	sched_loop_t*         thread_handle;        /*!< The thread handle which creates this scheduler task context */
-	_task_entry_t**       task_table;           /*!< The hash table used to organize tasks */
 	_request_entry_t**    request_table;        /*!< The requet information table, maps the request id to the request entry */
 	_task_entry_t*        queue_head;           /*!< The ready queue head */
 	_task_entry_t*        queue_tail;           /*!< The ready queue tail */
+	_task_entry_t*        chained;              /*!< The task chained with the task currently running, which is handed to the worker
+	                                             *   as the next task directly instead of going through the ready queue */
 	_task_entry_t*        async_pending;        /*!< The pending async task list */
 	_task_entry_t*        async_completed_head; /*!< The head of completed async task queue */
 	_task_entry_t*        async_completed_tail; /*!< The tail of completed async task queue */
 	uint32_t              queue_size;           /*!< The size of the queue */
 	uint32_t              num_reqs;             /*!< The number of request is going on */
+	uint64_t              exec_estimate;        /*!< The moving average of the execution time of the request with a deadline in nanoseconds */
 };
 
-/** @brief the memory pool used for the task entry */
-static mempool_objpool_t* _task_pool = NULL;
-/** @brief the memory pool used for the request entrt */
-static mempool_objpool_t* _request_pool = NULL;
+/** @brief the memory pools used for the request entry and its task slots */
+static mempool_objpool_t* _request_pool[_REQUEST_POOL_LEVELS];
 
 /**
  * @brief enqlueue a task to the async completed task queue
@@ -62,6 +102,9 @@ static mempool_objpool_t* _request_pool = NULL;
  **/
 static inline void _async_comp_enqueue(sched_task_context_t* ctx, _task_entry_t* task)
 {
+#ifdef ENABLE_PROFILER
+	task->ready_time = utils_clock_now_ns();
+#endif
 	if(NULL != ctx->async_completed_tail) ctx->async_completed_tail->next = task;
 	else ctx->async_completed_head = task;
 	ctx->async_completed_tail = task;
@@ -114,18 +157,98 @@ static inline void _async_pending_remove(sched_task_context_t* ctx, _task_entry_
 	if(NULL != task->next) task->next->prev = task->prev;
 }
 
+/**
+ * @brief get the request entry that owns the task slot
+ * @param task the task
+ * @return the request entry
+ **/
+static inline _request_entry_t* _task_request(_task_entry_t* task)
+{
+	return (_request_entry_t*)(((char*)(task - task->task.node)) - offsetof(_request_entry_t, tasks));
+}
+
 /**
  * @brief enqueue a task to the ready quee
+ * @note the ready queue is ordered by the deadline of the request, the task of the request which has the earliest
+ *       deadline runs first. The tasks with the same deadline are in FIFO order, so if none of the request has
+ *       a deadline, the queue is just a FIFO queue
  * @param task the task to insert
  * @param ctx The scheduler context
  * @return nothing
  **/
 static inline void _enqueue(sched_task_context_t* ctx, _task_entry_t* task)
 {
-	if(NULL != ctx->queue_tail) ctx->queue_tail->next = task;
-	else ctx->queue_head = task;
-	ctx->queue_tail = task;
+	_request_entry_t* req = _task_request(task);
+	req->num_ready_tasks ++;
 	ctx->queue_size ++;
+#ifdef ENABLE_PROFILER
+	task->ready_time = utils_clock_now_ns();
+#endif
+
+	if(NULL == ctx->queue_tail || _task_request(ctx->queue_tail)->deadline <= req->deadline)
+	{
+		task->next = NULL;
+		if(NULL != ctx->queue_tail) ctx->queue_tail->next = task;
+		else ctx->queue_head = task;
+		ctx->queue_tail = task;
+		return;
+	}
+
+	_task_entry_t** ptr;
+	for(ptr = &ctx->queue_head; _task_request(*ptr)->deadline <= req->deadline; ptr = &(*ptr)->next);
+
+	task->next = *ptr;
+	*ptr = task;
+}
+
+/**
+ * @brief hand the task chained with the running task to the worker as the next task
+ * @details the chained task becomes ready when its only upstream is about to run, so we keep it aside and
+ *          it runs right after the upstream, without being inserted to the ready queue
+ * @param task the chained task
+ * @param ctx The scheduler context
+ * @return nothing
+ **/
+static inline void _handoff_chained(sched_task_context_t* ctx, _task_entry_t* task)
+{
+	if(NULL != ctx->chained)
+	{
+		/* The previous chained task hasn't been picked up yet, which happens only if the upstream is cancelled */
+		_enqueue(ctx, task);
+		return;
+	}
+
+	_task_request(task)->num_ready_tasks ++;
+#ifdef ENABLE_PROFILER
+	task->ready_time = utils_clock_now_ns();
+#endif
+	task->next = NULL;
+	ctx->chained = task;
+}
+
+/**
+ * @brief take the chained task which has been handed to the worker
+ * @note if a request with an earlier deadline has become ready in the meantime, the chained task goes to the
+ *       ready queue, so that the queue stays in the earliest-deadline-first order
+ * @param ctx The scheduler context
+ * @return the chained task, NULL if there's no chained task or it has been put into the ready queue
+ **/
+static inline _task_entry_t* _take_chained(sched_task_context_t* ctx)
+{
+	_task_entry_t* ret = ctx->chained;
+	if(NULL == ret) return NULL;
+
+	ctx->chained = NULL;
+	_request_entry_t* req = _task_request(ret);
+	req->num_ready_tasks --;
+
+	if(NULL != ctx->queue_head && _task_request(ctx->queue_head)->deadline < req->deadline)
+	{
+		_enqueue(ctx, ret);
+		return NULL;
+	}
+
+	return ret;
 }
 
 /**
@@ -140,35 +263,70 @@ static inline _task_entry_t* _dequeue(sched_task_context_t* ctx)
 	if(NULL == (ctx->queue_head = ctx->queue_head->next))
 	    ctx->queue_tail = NULL;
 	ctx->queue_size --;
+	_task_request(ret)->num_ready_tasks --;
 	return ret;
 }
 
 /**
  * @brief create a new request entry object for the given request id
  * @param request the given request id
+ * @param service the service this request runs on
  * @return the newly created request, NULL on error case
  **/
-static inline _request_entry_t* _request_entry_new(sched_task_request_t request)
+static inline _request_entry_t* _request_entry_new(sched_task_request_t request, const sched_service_t* service, uint64_t arrival)
 {
-	LOG_DEBUG("New request entry has been created");
-	_request_entry_t* ret = (_request_entry_t*)mempool_objpool_alloc(_request_pool);
+	size_t num_nodes = sched_service_get_num_node(service);
+	if(ERROR_CODE(size_t) == num_nodes) ERROR_PTR_RETURN_LOG("Cannot get the number of nodes in the service");
+
+	uint32_t level;
+	for(level = 0; level < _REQUEST_POOL_LEVELS && (1u << level) < num_nodes; level ++);
+
+	_request_entry_t* ret;
+	if(level < _REQUEST_POOL_LEVELS)
+	    ret = (_request_entry_t*)mempool_objpool_alloc(_request_pool[level]);
+	else
+	    ret = (_request_entry_t*)malloc(sizeof(_request_entry_t) + sizeof(_task_entry_t) * num_nodes), level = ERROR_CODE(uint32_t);
+
 	if(NULL == ret)
 	    ERROR_PTR_RETURN_LOG("Cannot allocate memory for the new request");
+
+	ret->pool_level = level;
+	ret->num_slots = (uint32_t)num_nodes;
+
 	if(NULL == (ret->scope = sched_rscope_new()))
 	{
-		ERROR_PTR_RETURN_LOG("Cannot create scope object for the new request");
-		mempool_objpool_dealloc(_request_pool, ret);
+		LOG_ERROR("Cannot create scope object for the new request");
+		if(level != ERROR_CODE(uint32_t)) mempool_objpool_dealloc(_request_pool[level], ret);
+		else free(ret);
 		return NULL;
 	}
+
+	uint32_t i;
+	for(i = 0; i < num_nodes; i ++)
+	    ret->tasks[i].state = _SLOT_UNUSED;
+
 	ret->num_pending_tasks = 0;
+	ret->num_ready_tasks = 0;
 	ret->request_id = request;
+	ret->service = service;
 	ret->next = NULL;
+	ret->rejected = 0;
+	ret->responded = 0;
+	ret->start = 0;
+
+	uint64_t deadline = sched_service_deadline(service);
+	if(deadline == 0 || deadline == ERROR_CODE(uint64_t))
+	    ret->deadline = UINT64_MAX;
+	else
+	    ret->deadline = (arrival == 0 ? utils_clock_now_ns() : arrival) + deadline;
+
+	LOG_DEBUG("New request entry has been created");
 
 	return ret;
 }
 
 /**
- * @brief dispose a used request entry object
+ * @brief dispose a used request entry object, all the task slots are disposed as well
  * @param entry the request entry object
  * @return status code
  **/
@@ -178,7 +336,9 @@ static inline int _request_entry_free(_request_entry_t* entry)
 	if(NULL != entry->scope && sched_rscope_free(entry->scope) == ERROR_CODE(int))
 	    rc = ERROR_CODE(int);
 
-	if(ERROR_CODE(int) == mempool_objpool_dealloc(_request_pool, entry))
+	if(entry->pool_level == ERROR_CODE(uint32_t))
+	    free(entry);
+	else if(ERROR_CODE(int) == mempool_objpool_dealloc(_request_pool[entry->pool_level], entry))
 	    rc = ERROR_CODE(int);
 
 	return rc;
@@ -201,13 +361,15 @@ static inline _request_entry_t* _request_entry_find(const sched_task_context_t*
  * @brief inset a new request entry with the given request id to the request table
  * @note this do not guarantee the uniqueness of the request id in the table
  * @param request the request id
+ * @param service the service this request runs on
+ * @param arrival the time when the request has been accepted
  * @param ctx The scheduler task context
  * @return the newly created entry or NULL on error case
  **/
-static inline _request_entry_t* _request_entry_insert(sched_task_context_t* ctx, sched_task_request_t request)
+static inline _request_entry_t* _request_entry_insert(sched_task_context_t* ctx, sched_task_request_t request, const sched_service_t* service, uint64_t arrival)
 {
 	uint32_t slot = (uint32_t)(request % SCHED_TASK_TABLE_SLOT_SIZE);
-	_request_entry_t* ret = _request_entry_new(request);
+	_request_entry_t* ret = _request_entry_new(request, service, arrival);
 	if(NULL == ret) ERROR_PTR_RETURN_LOG("Canont create new request node for the request");
 
 	ctx->num_reqs ++;
@@ -246,16 +408,6 @@ static inline int _request_entry_delete(sched_task_context_t* ctx, sched_task_re
 	return 1;
 }
 
-static inline uint32_t _hash(const sched_service_t* service, sched_task_request_t request_id, sched_service_node_id_t node_id)
-{
-	uintptr_t service_id = (uintptr_t)service;
-	uint64_t hash = ((uint64_t)service_id << (8 * (sizeof(uint64_t) - sizeof(uintptr_t)))) +
-	                ((uint64_t)service_id << 32) +
-	                (request_id << 16) +
-	                node_id;
-	return (uint32_t)(hash % SCHED_TASK_TABLE_SLOT_SIZE);
-}
-
 /**
  * @brief this function is used to make sure that the runtime task is instantiated
  * @note the purpose of this function is allowing lazy instantiation of a runtime task. If the
@@ -272,96 +424,99 @@ static inline int _task_guareentee_instantiated(_task_entry_t* task)
 	return 0;
 }
 
-static inline _task_entry_t* _task_entry_new(sched_task_context_t* ctx, const sched_service_t* service, sched_task_request_t request, sched_service_node_id_t node)
+/**
+ * @brief get the task slot for the given node of the request
+ * @param ctx the scheduler task context
+ * @param service the service
+ * @param request the request id
+ * @param node the node id
+ * @return the task slot, NULL if the request doesn't exist
+ **/
+static inline _task_entry_t* _task_slot(const sched_task_context_t* ctx, const sched_service_t* service, sched_task_request_t request, sched_service_node_id_t node)
 {
-	/* The reason why we initialize the pool here is beacuse we may want to start multiple thread later,
-	 * But init function won't get called when a thread gets spawn. So it init here. */
 	_request_entry_t* req = _request_entry_find(ctx, request);
-	if(NULL == req) ERROR_PTR_RETURN_LOG("Cannot get the request entry object");
+	if(PREDICT_FALSE(NULL == req || req->service != service || node >= req->num_slots))
+	    return NULL;
+	return req->tasks + node;
+}
+
+static inline _task_entry_t* _task_table_find(const sched_task_context_t* ctx, const sched_service_t* service, sched_task_request_t request, sched_service_node_id_t node)
+{
+	_task_entry_t* ret = _task_slot(ctx, service, request, node);
+	return NULL != ret && ret->state == _SLOT_PENDING ? ret : NULL;
+}
+
+/**
+ * @brief initialize an unused task slot of the request
+ * @param ctx the scheduler task context
+ * @param req the request entry
+ * @param node the node id
+ * @param num_inputs the number of inputs the task requires
+ * @return the task slot, NULL on error
+ **/
+static inline _task_entry_t* _task_slot_init(sched_task_context_t* ctx, _request_entry_t* req, sched_service_node_id_t node, uint32_t num_inputs)
+{
+	_task_entry_t* ret = req->tasks + node;
+
+	if(ret->state != _SLOT_UNUSED)
+	    ERROR_PTR_RETURN_LOG("The task slot for <RequestId=%"PRIu64", NodeId=%"PRIu32"> is already used", req->request_id, node);
 
-	_task_entry_t* ret = mempool_objpool_alloc(_task_pool);
-	if(NULL == ret) ERROR_PTR_RETURN_LOG("Cannot allocate memory for the new task entry");
 	ret->task.ctx = ctx;
-	ret->task.exec_task = NULL;
 	ret->prev = ret->next = NULL;
 
 	ret->task.scope = req->scope;
 
-	if(NULL == sched_service_get_incoming_pipes(service, node, &ret->num_required_inputs))
-	    ERROR_LOG_GOTO(ERR, "Cannot get the incoming pipe list");
-
+	ret->num_required_inputs = num_inputs;
 	ret->num_awaiting_inputs = ret->num_required_inputs;
 	ret->num_cancelled_inputs = 0;
 
-	ret->task.service = service;
+	ret->task.service = req->service;
 	ret->task.node    = node;
-	ret->task.request = request;
+	ret->task.request = req->request_id;
 	/* This function do not actually instanitate a runtime task, because it may be cancelled
 	 * The runtime task will be created by _task_instantiate function and should be called
 	 * if there's a pipe which is not cancelled */
 	ret->task.exec_task = NULL;
+	ret->state = _SLOT_PENDING;
 	req->num_pending_tasks ++;
 
 	return ret;
-ERR:
-
-	if(NULL != ret) mempool_objpool_dealloc(_task_pool, ret);
-	return NULL;
-}
-
-static inline _task_entry_t* _task_table_find(const sched_task_context_t* ctx, const sched_service_t* service, sched_task_request_t request, sched_service_node_id_t node)
-{
-	uint32_t h = _hash(service, request, node);
-
-	_task_entry_t* ret;
-	for(ret = ctx->task_table[h];
-	    NULL != ret && PREDICT_FALSE(ret->task.service != service || ret->task.request != request || ret->task.node != node);
-	    ret = ret->next);
-	return ret;
 }
 
 static inline _task_entry_t* _task_table_insert(sched_task_context_t* ctx, const sched_service_t* service, sched_task_request_t request, sched_service_node_id_t node)
 {
-	_task_entry_t* ret = _task_entry_new(ctx, service, request, node);
-
-	if(NULL == ret) ERROR_PTR_RETURN_LOG("Cannot create new task for service");
-
-	uint32_t h = _hash(service, request, node);
+	_request_entry_t* req = _request_entry_find(ctx, request);
+	if(NULL == req || req->service != service || node >= req->num_slots)
+	    ERROR_PTR_RETURN_LOG("Cannot get the task slot for the request");
 
-	ret->next = ctx->task_table[h];
-	if(NULL != ctx->task_table[h]) ctx->task_table[h]->prev = ret;
-	ctx->task_table[h] = ret;
+	uint32_t num_inputs;
+	if(NULL == sched_service_get_incoming_pipes(service, node, &num_inputs))
+	    ERROR_PTR_RETURN_LOG("Cannot get the incoming pipe list");
 
-	return ret;
+	return _task_slot_init(ctx, req, node, num_inputs);
 }
 
 
 static inline void _task_table_delete(sched_task_context_t* ctx, _task_entry_t* task)
 {
-	uint32_t h = _hash(task->task.service, task->task.request, task->task.node);
-
-	if(task->prev != NULL) task->prev->next = task->next;
-	else ctx->task_table[h] = task->next;
-	if(task->next != NULL) task->next->prev = task->prev;
-
+	(void)ctx;
+	task->state = _SLOT_DETACHED;
 	task->prev = task->next = NULL;
 }
 
 int sched_task_init()
 {
-	if(NULL == (_task_pool = mempool_objpool_new(sizeof(_task_entry_t))))
-	    ERROR_RETURN_LOG(int, "Cannot create new object pool for the task entry");
-	if(NULL == (_request_pool = mempool_objpool_new(sizeof(_request_entry_t))))
-	    ERROR_RETURN_LOG(int, "Cannot create new object pool for the request entry");
+	uint32_t i;
+	for(i = 0; i < _REQUEST_POOL_LEVELS; i ++)
+	    if(NULL == (_request_pool[i] = mempool_objpool_new((uint32_t)(sizeof(_request_entry_t) + (sizeof(_task_entry_t) << i)))))
+	        ERROR_RETURN_LOG(int, "Cannot create new object pool for the request entry with %u task slots", 1u << i);
 	return 0;
 }
 
 sched_task_context_t* sched_task_context_new(sched_loop_t* thread_ctx)
 {
 	sched_task_context_t* ret = (sched_task_context_t*)calloc(1, sizeof(*ret));
-
-	if(NULL == (ret->task_table = (_task_entry_t**)calloc(SCHED_TASK_TABLE_SLOT_SIZE, sizeof(ret->task_table[0]))))
-	    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the task hash table");
+	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the scheduler task context");
 
 	if(NULL == (ret->request_table = (_request_entry_t**)calloc(SCHED_TASK_TABLE_SLOT_SIZE, sizeof(ret->request_table[0]))))
 	    ERROR_LOG_ERRNO_GOTO(ERR, "Cannot allocate memory for the request hash table");
@@ -373,7 +528,6 @@ sched_task_context_t* sched_task_context_new(sched_loop_t* thread_ctx)
 	return ret;
 
 ERR:
-	if(NULL != ret->task_table) free(ret->task_table);
 	if(NULL != ret->request_table) free(ret->request_table);
 	free(ret);
 	return NULL;
@@ -387,48 +541,24 @@ int sched_task_context_free(sched_task_context_t* ctx)
 	int i = 0;
 	int rc = 0;
 
-	/* dispose the task table first */
-	if(ctx->task_table != NULL)
+	/* dispose the chained task and the tasks in the ready queue first */
+	if(NULL != ctx->chained)
 	{
-		for(i = 0; i < SCHED_TASK_TABLE_SLOT_SIZE; i ++)
-		{
-			_task_entry_t* ptr;
-			for(ptr = ctx->task_table[i]; NULL != ptr;)
-			{
-				_task_entry_t* cur = ptr;
-				ptr = ptr->next;
-				if(cur->task.exec_task != NULL && runtime_task_free(cur->task.exec_task) == ERROR_CODE(int))
-				{
-					LOG_WARNING("Cannot dispose the servlet task from the table");
-					rc = ERROR_CODE(int);
-				}
-
-				if(mempool_objpool_dealloc(_task_pool, cur) == ERROR_CODE(int))
-				{
-					LOG_WARNING("Cannot dispose the scheduler task from the table");
-					rc = ERROR_CODE(int);
-				}
-			}
-		}
-
-		_task_entry_t *ptr;
-		for(ptr = ctx->queue_head; ptr;)
+		ctx->chained->next = ctx->queue_head;
+		ctx->queue_head = ctx->chained;
+		ctx->chained = NULL;
+	}
+	_task_entry_t *ptr;
+	for(ptr = ctx->queue_head; ptr;)
+	{
+		_task_entry_t* cur = ptr;
+		ptr = ptr->next;
+		if(cur->task.exec_task != NULL && runtime_task_free(cur->task.exec_task) == ERROR_CODE(int))
 		{
-			_task_entry_t* cur = ptr;
-			ptr = ptr->next;
-			if(cur->task.exec_task != NULL && runtime_task_free(cur->task.exec_task) == ERROR_CODE(int))
-			{
-				LOG_WARNING("Cannot dispose the servlet task from the qeueue");
-				rc = ERROR_CODE(int);
-			}
-
-			if(mempool_objpool_dealloc(_task_pool, cur) == ERROR_CODE(int))
-			{
-				LOG_WARNING("Cannot dispose the schuler task from the ready list");
-				rc = ERROR_CODE(int);
-			}
+			LOG_WARNING("Cannot dispose the servlet task from the qeueue");
+			rc = ERROR_CODE(int);
 		}
-		free(ctx->task_table);
+		cur->task.exec_task = NULL;
 	}
 
 	/* then dispose the request table */
@@ -441,6 +571,17 @@ int sched_task_context_free(sched_task_context_t* ctx)
 			{
 				_request_entry_t* cur = req;
 				req = req->next;
+
+				/* Then all the tasks which are still waiting for inputs */
+				uint32_t j;
+				for(j = 0; j < cur->num_slots; j ++)
+				    if(cur->tasks[j].state == _SLOT_PENDING && cur->tasks[j].task.exec_task != NULL &&
+				       ERROR_CODE(int) == runtime_task_free(cur->tasks[j].task.exec_task))
+				    {
+					    LOG_WARNING("Cannot dispose the servlet task from the table");
+					    rc = ERROR_CODE(int);
+				    }
+
 				if(ERROR_CODE(int) == _request_entry_free(cur))
 				{
 					LOG_WARNING("Cannot dispose the memory used by the request entry in the request table");
@@ -461,17 +602,13 @@ int sched_task_finalize()
 {
 	int rc = 0;
 
-	if(_task_pool != NULL && mempool_objpool_free(_task_pool) == ERROR_CODE(int))
-	{
-		LOG_WARNING("Cannot dispose the object memory pool for task table");
-		rc = ERROR_CODE(int);
-	}
-
-	if(_request_pool != NULL && ERROR_CODE(int) == mempool_objpool_free(_request_pool))
-	{
-		LOG_WARNING("Cannot dispose the object memory pool for the request table");
-		rc = ERROR_CODE(int);
-	}
+	uint32_t i;
+	for(i = 0; i < _REQUEST_POOL_LEVELS; i ++)
+	    if(_request_pool[i] != NULL && ERROR_CODE(int) == mempool_objpool_free(_request_pool[i]))
+	    {
+		    LOG_WARNING("Cannot dispose the object memory pool for the request table");
+		    rc = ERROR_CODE(int);
+	    }
 
 	return rc;
 }
@@ -520,13 +657,20 @@ int sched_task_pipe_ready(sched_task_t* task)
 		          "remove it from the task table and add it to ready queue",
 		          task->request, task->node);
 		_task_table_delete(task->ctx, task_internal);
-		_enqueue(task->ctx, task_internal);
+
+		/* If the task is chained with its upstream, the upstream is the task we are currently
+		 * working on. So we make it run right after the upstream on the same worker, while
+		 * the output of the upstream is still hot in the cache */
+		if(sched_service_node_chained(task->service, task->node) > 0)
+		    _handoff_chained(task->ctx, task_internal);
+		else
+		    _enqueue(task->ctx, task_internal);
 	}
 
 	return 0;
 }
 
-sched_task_request_t sched_task_new_request(sched_task_context_t* ctx, const sched_service_t* service, itc_module_pipe_t* input_pipe, itc_module_pipe_t* output_pipe)
+sched_task_request_t sched_task_new_request(sched_task_context_t* ctx, const sched_service_t* service, itc_module_pipe_t* input_pipe, itc_module_pipe_t* output_pipe, uint64_t arrival)
 {
 	static __thread sched_task_request_t ret = 0;
 	const sched_service_pipe_descriptor_t* pipe_model;
@@ -535,7 +679,7 @@ sched_task_request_t sched_task_new_request(sched_task_context_t* ctx, const sch
 
 	if(NULL == service || NULL == input_pipe || NULL == output_pipe) ERROR_RETURN_LOG(sched_task_request_t, "Invalid arguments");
 
-	if(NULL == (req_ent = (_request_entry_insert(ctx, ret))))
+	if(NULL == (req_ent = (_request_entry_insert(ctx, ret, service, arrival))))
 	    ERROR_RETURN_LOG(sched_task_request_t, "Cannot create new request entry object");
 
 	pipe_model = sched_service_to_pipe_desc(service);
@@ -588,13 +732,17 @@ static inline int _input_ready(_task_entry_t* entry, itc_module_pipe_t* handle)
 	return 0;
 }
 
-int sched_task_input_pipe(sched_task_context_t* ctx, const sched_service_t* service, sched_task_request_t request,
-                          sched_service_node_id_t node, runtime_api_pipe_id_t pipe,
-                          itc_module_pipe_t* handle, int async)
+/**
+ * @brief assign the input pipe to the downstream task and set it ready if it's possible
+ * @param task the downstream task, NULL if the task slot can not be initialized
+ * @param pipe the pipe id
+ * @param handle the pipe handle
+ * @param async if we should only assign the pipe (see sched_task_input_pipe)
+ * @return status code
+ **/
+static inline int _task_assign_input(_task_entry_t* task, runtime_api_pipe_id_t pipe, itc_module_pipe_t* handle, int async)
 {
-	_task_entry_t* task = _task_table_find(ctx, service, request, node);
-	if(NULL == task) task = _task_table_insert(ctx, service, request, node);
-
+	if(NULL == task) ERROR_RETURN_LOG(int, "Cannot get the downstream task");
 
 	if(handle != NULL && ERROR_CODE(int) == _task_add_pipe(task, pipe, handle, 1))
 	    ERROR_RETURN_LOG(int, "Cannot add pipe to the task");
@@ -608,6 +756,34 @@ int sched_task_input_pipe(sched_task_context_t* ctx, const sched_service_t* serv
 	return 0;
 }
 
+int sched_task_input_pipe(sched_task_context_t* ctx, const sched_service_t* service, sched_task_request_t request,
+                          sched_service_node_id_t node, runtime_api_pipe_id_t pipe,
+                          itc_module_pipe_t* handle, int async)
+{
+	_task_entry_t* task = _task_table_find(ctx, service, request, node);
+	if(NULL == task) task = _task_table_insert(ctx, service, request, node);
+
+	return _task_assign_input(task, pipe, handle, async);
+}
+
+int sched_task_input_pipe_planned(sched_task_t* task, const sched_service_edge_plan_t* plan, itc_module_pipe_t* handle, int async)
+{
+	if(NULL == task || NULL == plan)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_request_entry_t* req = _task_request((_task_entry_t*)task);
+
+	if(PREDICT_FALSE(plan->downstream_slot >= req->num_slots))
+	    ERROR_RETURN_LOG(int, "Invalid downstream task slot %"PRIu32, plan->downstream_slot);
+
+	_task_entry_t* downstream = req->tasks + plan->downstream_slot;
+
+	if(downstream->state != _SLOT_PENDING)
+	    downstream = _task_slot_init(task->ctx, req, plan->downstream_slot, plan->downstream_inputs);
+
+	return _task_assign_input(downstream, plan->desc.destination_pipe_desc, handle, async);
+}
+
 int sched_task_async_completed(sched_task_t* task)
 {
 	/* TODO: this function do not check if the task is an async task, but we need
@@ -707,17 +883,163 @@ static inline int _pipe_cancel(sched_task_context_t* ctx, const sched_service_t*
 	    return 0;
 }
 
+/**
+ * @brief write the deadline response of the service to the output of the rejected request
+ * @details this is called when the output task of the rejected request is cancelled, so that the client gets
+ *          the configured error response instead of a closed connection
+ * @param req the request entry
+ * @param out_task the output task of the request
+ * @return status code
+ **/
+static inline int _write_deadline_response(_request_entry_t* req, _task_entry_t* out_task)
+{
+	if(!req->rejected || req->responded) return 0;
+	req->responded = 1;
+
+	size_t size;
+	const char* response = sched_service_deadline_response(req->service, &size);
+	if(NULL == response || NULL == out_task->task.exec_task) return 0;
+
+	const sched_service_pipe_descriptor_t* pipe_model = sched_service_to_pipe_desc(req->service);
+	if(NULL == pipe_model) ERROR_RETURN_LOG(int, "Cannot get the service pipe descriptor");
+
+	itc_module_pipe_t* handle = out_task->task.exec_task->pipes[pipe_model->destination_pipe_desc];
+	if(NULL == handle) ERROR_RETURN_LOG(int, "The output pipe is not assigned");
+
+	while(size > 0)
+	{
+		size_t rc = itc_module_pipe_write(response, size, handle);
+		if(ERROR_CODE(size_t) == rc) ERROR_RETURN_LOG(int, "Cannot write the deadline response to the output pipe");
+		response += rc;
+		size -= rc;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief cancel the task and all the downstream tasks which depend on it
+ * @param ctx The scheduler task context
+ * @param task the task to cancel
+ * @return status code
+ **/
+static inline int _task_cancel(sched_task_context_t* ctx, _task_entry_t* task)
+{
+	_request_entry_t* req = _task_request(task);
+
+	sched_service_node_id_t output = sched_service_get_output_node(task->task.service);
+	if(ERROR_CODE(sched_service_node_id_t) == output) ERROR_RETURN_LOG(int, "Cannot get the output node id");
+
+	if(output == task->task.node && ERROR_CODE(int) == _write_deadline_response(req, task))
+	    LOG_WARNING("Cannot write the deadline response");
+
+	const sched_cnode_info_t* cnodes = sched_service_get_cnode_info(task->task.service);
+	if(NULL == cnodes) ERROR_RETURN_LOG(int, "Cannot get the critical node info of the service");
+
+	if(cnodes->boundary[task->task.node] == NULL)
+	{
+		uint32_t i, size;
+		const sched_service_pipe_descriptor_t* result = sched_service_get_outgoing_pipes(task->task.service, task->task.node, &size);
+
+		if(NULL == result) ERROR_RETURN_LOG(int, "Cannot get outgoing pipe for task");
+
+		for(i = 0; i < size; i ++)
+		    if(ERROR_CODE(int) == _pipe_cancel(ctx, task->task.service, task->task.request, result[i].destination_node_id, result[i].destination_pipe_desc))
+		        ERROR_RETURN_LOG(int, "Cannot cancel the downstream pipe");
+	}
+	else
+	{
+		LOG_TRACE("Critical task has been cancelled, cancel all the task in the cluster");
+		const sched_cnode_boundary_t* boundary = cnodes->boundary[task->task.node];
+
+		uint32_t i;
+		for(i = 0; i < boundary->count; i ++)
+		    if(ERROR_CODE(int) == _pipe_cancel(ctx, task->task.service, task->task.request, boundary->dest[i].node_id, boundary->dest[i].pipe_desc))
+		        ERROR_RETURN_LOG(int, "Cannot cancel the cluster boundary pipe");
+
+		if(boundary->output_cancelled && output != task->task.node)
+		{
+			LOG_TRACE("Output task is in the critical cluster, cancel it");
+
+			_task_entry_t* out_task = _task_table_find(ctx, task->task.service, task->task.request, output);
+			if(NULL == out_task) ERROR_RETURN_LOG(int, "Cannot cancel the output task");
+
+			if(ERROR_CODE(int) == _write_deadline_response(req, out_task))
+			    LOG_WARNING("Cannot write the deadline response");
+
+			_task_table_delete(ctx, out_task);
+
+			if(ERROR_CODE(int) == sched_task_free(&out_task->task)) ERROR_RETURN_LOG(int, "Cannot dispose the output task");
+		}
+
+	}
+
+	if(ERROR_CODE(int) == sched_task_free(&task->task))
+	    ERROR_RETURN_LOG(int, "Cannot dispose the cancelled task");
+
+	return 0;
+}
+
+/**
+ * @brief check if the task should be dropped because its request can not meet the deadline
+ * @details the request is rejected before it starts if the estimated execution time exceeds the remaining time,
+ *          and any task of the request is dropped once the deadline has passed
+ * @param ctx The scheduler task context
+ * @param task the task to check
+ * @return the check result
+ **/
+static inline int _task_expired(sched_task_context_t* ctx, _task_entry_t* task)
+{
+	_request_entry_t* req = _task_request(task);
+
+	if(PREDICT_TRUE(req->deadline == UINT64_MAX)) return 0;
+
+	if(req->rejected) return 1;
+
+	uint64_t now = utils_clock_now_ns();
+
+	if(req->start == 0)
+	{
+		if(now + ctx->exec_estimate > req->deadline)
+		{
+			LOG_DEBUG("Request %"PRIu64" is rejected because it can not be done before the deadline", req->request_id);
+			/* The rejected request never gives us a sample, so if we only learn from the finished requests, one slow
+			 * burst could make us reject everything forever. Thus we count the rejected request as a zero-time sample,
+			 * which lets the estimate decay until a request gets admitted and measured again */
+			ctx->exec_estimate -= ctx->exec_estimate / 8;
+			return req->rejected = 1;
+		}
+		req->start = now;
+		return 0;
+	}
+
+	if(now > req->deadline)
+	{
+		LOG_DEBUG("Request %"PRIu64" has passed its deadline, drop the remaining tasks", req->request_id);
+		return req->rejected = 1;
+	}
+
+	return 0;
+}
+
 sched_task_t* sched_task_next_ready_task(sched_task_context_t* ctx)
 {
 	for(;;)
 	{
 		_task_entry_t* next = NULL;
+		int expired = 0;
+		/* The task chained with the previous one runs right after it */
+		if(NULL != (next = _take_chained(ctx)))
+		    expired = _task_expired(ctx, next);
 		/* The first thing is we need to look at the compelted async task list, if there's some task, we can move on */
-		if(NULL != (next = _async_comp_dequeue(ctx)))
+		else if(NULL != (next = _async_comp_dequeue(ctx)))
 		    LOG_DEBUG("Picking up the completed async task from the completion list");
 		else
 		{
-			next = _dequeue(ctx);
+			/* The task which is waiting for the async completion have done its work already, so the
+			 * deadline only applies to the tasks from the ready queue */
+			if(NULL != (next = _dequeue(ctx)))
+			    expired = _task_expired(ctx, next);
 			LOG_DEBUG("Picking up the next runnable sync task to run");
 		}
 
@@ -725,56 +1047,15 @@ sched_task_t* sched_task_next_ready_task(sched_task_context_t* ctx)
 		if(NULL == next) return NULL;
 
 		/* Check if this task is cancelled */
-		if(next->num_required_inputs > 0 && next->num_cancelled_inputs == next->num_required_inputs)
+		if(expired || (next->num_required_inputs > 0 && next->num_cancelled_inputs == next->num_required_inputs))
 		{
 #ifdef LOG_DEBUG_ENABLED
 			char arg_buffer[1024];
 			_get_task_args(next, arg_buffer, sizeof(arg_buffer));
-			LOG_DEBUG("Task `%s' is cancelled because the all its inputs are marked as cancelled", arg_buffer);
+			LOG_DEBUG("Task `%s' is cancelled because the all its inputs are marked as cancelled or the request is expired", arg_buffer);
 #endif
-
-			const sched_cnode_info_t* cnodes = sched_service_get_cnode_info(next->task.service);
-			if(NULL == cnodes) ERROR_PTR_RETURN_LOG("Cannot get the critical node info of the service");
-
-			if(cnodes->boundary[next->task.node] == NULL)
-			{
-				uint32_t i, size;
-				const sched_service_pipe_descriptor_t* result = sched_service_get_outgoing_pipes(next->task.service, next->task.node, &size);
-
-				if(NULL == result) ERROR_PTR_RETURN_LOG("Cannot get outgoing pipe for task");
-
-				for(i = 0; i < size; i ++)
-				    if(ERROR_CODE(int) == _pipe_cancel(ctx, next->task.service, next->task.request, result[i].destination_node_id, result[i].destination_pipe_desc))
-				        ERROR_PTR_RETURN_LOG("Cannot cancel the downstream pipe");
-			}
-			else
-			{
-				LOG_TRACE("Critical task has been cancelled, cancel all the task in the cluster");
-				const sched_cnode_boundary_t* boundary = cnodes->boundary[next->task.node];
-
-				uint32_t i;
-				for(i = 0; i < boundary->count; i ++)
-				    if(ERROR_CODE(int) == _pipe_cancel(ctx, next->task.service, next->task.request, boundary->dest[i].node_id, boundary->dest[i].pipe_desc))
-				        ERROR_PTR_RETURN_LOG("Cannot cancel the cluster boundary pipe");
-
-				if(boundary->output_cancelled)
-				{
-					LOG_TRACE("Output task is in the critical cluster, cancel it");
-					sched_service_node_id_t output = sched_service_get_output_node(next->task.service);
-					if(ERROR_CODE(sched_service_node_id_t) == output) ERROR_PTR_RETURN_LOG("Cannot get the output node id");
-
-					_task_entry_t* out_task = _task_table_find(ctx, next->task.service, next->task.request, output);
-					if(NULL == out_task) ERROR_PTR_RETURN_LOG("Cannot cancel the output task");
-
-					_task_table_delete(ctx, out_task);
-
-					if(ERROR_CODE(int) == sched_task_free(&out_task->task)) ERROR_PTR_RETURN_LOG("Cannot dispose the output task");
-				}
-
-			}
-
-			if(ERROR_CODE(int) == sched_task_free(&next->task))
-			    ERROR_PTR_RETURN_LOG("Cannot dispose the cancelled task");
+			if(ERROR_CODE(int) == _task_cancel(ctx, next))
+			    ERROR_PTR_RETURN_LOG("Cannot cancel the task");
 		}
 		else
 		{
@@ -794,18 +1075,27 @@ int sched_task_free(sched_task_t* task)
 {
 	int rc = 0;
 	sched_task_context_t* ctx = task->ctx;
-	_request_entry_t* req = _request_entry_find(ctx, task->request);
-	if(NULL == req) rc = ERROR_CODE(int);
+	_task_entry_t* task_internal = (_task_entry_t*)task;
+	_request_entry_t* req = _task_request(task_internal);
 
 	if(NULL != task->exec_task)
 	    rc = runtime_task_free(task->exec_task);
 
-	if(mempool_objpool_dealloc(_task_pool, task) == ERROR_CODE(int))
-	    rc = ERROR_CODE(int);
+	task->exec_task = NULL;
+	task_internal->state = _SLOT_UNUSED;
 
-	if(NULL != req && 0 == --req->num_pending_tasks)
+	/* The task slot is owned by the request entry, so it will be disposed along with the request */
+	if(0 == --req->num_pending_tasks)
 	{
 		LOG_DEBUG("Request %"PRIu64" is done", req->request_id);
+
+		/* Update the estimated execution time with the request which has been actually done */
+		if(req->start > 0 && !req->rejected)
+		{
+			uint64_t elapsed = utils_clock_now_ns() - req->start;
+			ctx->exec_estimate = ctx->exec_estimate - ctx->exec_estimate / 8 + elapsed / 8;
+		}
+
 		if(ERROR_CODE(int) == _request_entry_delete(ctx, req->request_id))
 		    rc = ERROR_CODE(int);
 	}
@@ -839,6 +1129,62 @@ int sched_task_launch_async(sched_task_t* task)
 	return rc;
 }
 
+int sched_task_offload(sched_task_t* task, sched_loop_t* peer)
+{
+	if(NULL == task || NULL == peer || runtime_task_is_async(task->exec_task))
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_task_entry_t* task_internal = (_task_entry_t*)task;
+
+	/* The task comes back via the same path as the async task completion, so it should be
+	 * in the pending list until the peer finishes its work */
+	_async_pending_add(task->ctx, task_internal);
+	task_internal->state = _SLOT_OFFLOADED;
+
+	if(ERROR_CODE(int) == sched_loop_offload_task(peer, task))
+	{
+		_async_pending_remove(task->ctx, task_internal);
+		task_internal->state = _SLOT_DETACHED;
+		ERROR_RETURN_LOG(int, "Cannot post the task to the peer scheduler");
+	}
+
+	LOG_DEBUG("The task has been handed over to the peer scheduler");
+
+	return 0;
+}
+
+int sched_task_offloaded(const sched_task_t* task)
+{
+	if(NULL == task) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	return ((const _task_entry_t*)task)->state == _SLOT_OFFLOADED;
+}
+
+uint32_t sched_task_num_ready_siblings(sched_task_t* task)
+{
+	if(NULL == task) ERROR_RETURN_LOG(uint32_t, "Invalid arguments");
+
+	return _task_request((_task_entry_t*)task)->num_ready_tasks;
+}
+
+uint64_t sched_task_ready_time(const sched_task_t* task)
+{
+	if(NULL == task) ERROR_RETURN_LOG(uint64_t, "Invalid arguments");
+
+#ifdef ENABLE_PROFILER
+	return ((const _task_entry_t*)task)->ready_time;
+#else
+	return 0;
+#endif
+}
+
+sched_loop_t* sched_task_get_loop(const sched_task_t* task)
+{
+	if(NULL == task) ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	return task->ctx->thread_handle;
+}
+
 uint32_t sched_task_num_concurrent_requests(const sched_task_context_t* ctx)
 {
 	if(NULL == ctx) ERROR_RETURN_LOG(uint32_t, "Invalid argumenets");
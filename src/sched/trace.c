@@ -0,0 +1,428 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <constants.h>
+#include <error.h>
+
+#include <itc/module_types.h>
+#include <itc/module.h>
+
+#include <runtime/api.h>
+#include <runtime/pdt.h>
+#include <runtime/servlet.h>
+#include <runtime/task.h>
+#include <runtime/stab.h>
+
+#include <sched/service.h>
+#include <sched/rscope.h>
+#include <sched/loop.h>
+#include <sched/task.h>
+#include <sched/trace.h>
+
+#include <lang/prop.h>
+
+#include <utils/log.h>
+#include <utils/static_assertion.h>
+#include <utils/thread.h>
+#include <utils/clock.h>
+
+/**
+ * @brief a recorded span
+ **/
+typedef struct {
+	sched_task_request_t    request;     /*!< the request id */
+	uint32_t                owner;       /*!< the worker id that owns the request */
+	sched_service_node_id_t node;        /*!< the node id */
+	sched_trace_phase_t     phase;       /*!< the execution phase */
+	uint32_t                npipes;      /*!< the number of output pipes we have recorded */
+	uint64_t                start;       /*!< the start timestamp */
+	uint64_t                end;         /*!< the end timestamp */
+	struct {
+		runtime_api_pipe_id_t pid;       /*!< the pipe id */
+		uint64_t              bytes;     /*!< the number of bytes written to the pipe */
+	}                       pipes[SCHED_TRACE_MAX_PIPES];  /*!< the bytes written to each output pipe */
+} _span_t;
+
+/**
+ * @brief the span buffer of a thread
+ * @note only the owner thread writes the buffer, and the buffers are linked together, so that
+ *       the finalization can write the remaining spans of all the threads
+ **/
+typedef struct _buffer_t {
+	struct _buffer_t*       next;        /*!< the next buffer in the buffer list */
+	uint32_t                tid;         /*!< the thread id */
+	thread_type_t           type;        /*!< the thread type */
+	uint32_t                named_seq;   /*!< the sequence number of the output we have written the thread name metadata to */
+	uint32_t                size;        /*!< the number of spans in the buffer */
+	uint32_t                capacity;    /*!< the capacity of the buffer */
+	uintpad_t __padding__[0];
+	_span_t                 data[0];     /*!< the spans */
+} _buffer_t;
+STATIC_ASSERTION_SIZE(_buffer_t, data, 0);
+STATIC_ASSERTION_LAST(_buffer_t, data);
+
+/**
+ * @brief trace one of every N requests, 0 means the tracer is disabled
+ **/
+static uint32_t _sample_rate = 0;
+
+/**
+ * @brief the number of spans a thread buffers
+ **/
+static uint32_t _buffer_size = 4096;
+
+/**
+ * @brief the trace output file
+ **/
+static FILE* _output;
+
+/**
+ * @brief the lock that protects the output file
+ * @details the worker threads write their buffers to the output with the lock held, so that the output
+ *          can be swapped or closed only when no thread is writing to it
+ **/
+static pthread_mutex_t _output_mutex;
+
+/**
+ * @brief the sequence number of the output file, which is increased each time the output is replaced
+ **/
+static uint32_t _output_seq = 1;
+
+/**
+ * @brief if we have written any event to the output, which means we need a comma before the next one
+ **/
+static int _output_nonempty;
+
+/**
+ * @brief the list of all the span buffers
+ **/
+static _buffer_t* _buffers;
+
+/**
+ * @brief the generation of the tracer, which is increased on each finalization, so that a thread
+ *        will not touch the buffer which has been disposed
+ **/
+static uint32_t _generation;
+
+/**
+ * @brief the span buffer of current thread
+ **/
+static __thread _buffer_t* _local_buffer;
+
+/**
+ * @brief the generation when current thread allocates its buffer
+ **/
+static __thread uint32_t _local_generation;
+
+/**
+ * @brief get the name of the phase
+ * @param phase the phase
+ * @return the name
+ **/
+static inline const char* _phase_name(sched_trace_phase_t phase)
+{
+	switch(phase)
+	{
+		case SCHED_TRACE_PHASE_EXEC:          return "exec";
+		case SCHED_TRACE_PHASE_ASYNC_SETUP:   return "async_setup";
+		case SCHED_TRACE_PHASE_ASYNC_EXEC:    return "async_exec";
+		case SCHED_TRACE_PHASE_ASYNC_CLEANUP: return "async_cleanup";
+		default:                              return "unknown";
+	}
+}
+
+/**
+ * @brief get the name of the thread type shown in the trace
+ * @param type the thread type
+ * @return the name
+ **/
+static inline const char* _thread_name(thread_type_t type)
+{
+	if(type & THREAD_TYPE_WORKER) return "worker";
+	if(type & THREAD_TYPE_ASYNC)  return "async";
+	if(type & THREAD_TYPE_EVENT)  return "event";
+	if(type & THREAD_TYPE_IO)     return "io";
+	return "thread";
+}
+
+/**
+ * @brief write the event separator if needed
+ * @note the caller should hold the output mutex
+ * @return nothing
+ **/
+static inline void _write_separator(void)
+{
+	if(_output_nonempty) fputs(",\n", _output);
+	else fputc('\n', _output);
+	_output_nonempty = 1;
+}
+
+/**
+ * @brief write all the spans in the buffer to the output
+ * @note the caller should hold the output mutex
+ * @param buf the buffer
+ * @return nothing
+ **/
+static inline void _buffer_write(_buffer_t* buf)
+{
+	uint32_t i, j;
+	int pid = (int)getpid();
+
+	if(buf->named_seq != _output_seq)
+	{
+		_write_separator();
+		fprintf(_output, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+		        pid, buf->tid, _thread_name(buf->type), buf->tid);
+		buf->named_seq = _output_seq;
+	}
+
+	for(i = 0; i < buf->size; i ++)
+	{
+		const _span_t* span = buf->data + i;
+		uint64_t dur = span->end > span->start ? span->end - span->start : 0;
+		_write_separator();
+		fprintf(_output, "{\"name\":\"node %u\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+		                 "\"ts\":%"PRIu64".%03u,\"dur\":%"PRIu64".%03u,"
+		                 "\"args\":{\"request\":\"%u.%"PRIu64"\",\"node\":%u,\"phase\":\"%s\",\"pipes\":{",
+		        span->node, _phase_name(span->phase), pid, buf->tid,
+		        span->start / 1000, (unsigned)(span->start % 1000), dur / 1000, (unsigned)(dur % 1000),
+		        span->owner, span->request, span->node, _phase_name(span->phase));
+		for(j = 0; j < span->npipes; j ++)
+		    fprintf(_output, "%s\"%u\":%"PRIu64, j ? "," : "", span->pipes[j].pid, span->pipes[j].bytes);
+		fputs("}}}", _output);
+	}
+
+	fflush(_output);
+}
+
+/**
+ * @brief write all the spans in the buffer to the output and reset the buffer
+ * @param buf the buffer
+ * @return nothing
+ **/
+static inline void _buffer_flush(_buffer_t* buf)
+{
+	if((errno = pthread_mutex_lock(&_output_mutex)) != 0)
+	{
+		LOG_WARNING_ERRNO("Cannot acquire the trace output mutex, %u spans are dropped", buf->size);
+		buf->size = 0;
+		return;
+	}
+
+	if(NULL != _output)
+	    _buffer_write(buf);
+
+	buf->size = 0;
+
+	if((errno = pthread_mutex_unlock(&_output_mutex)) != 0)
+	    LOG_WARNING_ERRNO("Cannot release the trace output mutex");
+}
+
+/**
+ * @brief get the span buffer of current thread, allocate a new one if it doesn't exist
+ * @return the buffer or NULL on error
+ **/
+static inline _buffer_t* _get_local_buffer(void)
+{
+	if(NULL != _local_buffer && _local_generation == _generation)
+	    return _local_buffer;
+
+	_buffer_t* ret = (_buffer_t*)malloc(sizeof(_buffer_t) + sizeof(_span_t) * _buffer_size);
+	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the trace buffer");
+
+	ret->tid = thread_get_id();
+	ret->type = thread_get_current_type();
+	ret->named_seq = 0;
+	ret->size = 0;
+	ret->capacity = _buffer_size;
+
+	do {
+		ret->next = _buffers;
+	} while(!__sync_bool_compare_and_swap(&_buffers, ret->next, ret));
+
+	_local_buffer = ret;
+	_local_generation = _generation;
+
+	return ret;
+}
+
+int sched_trace_sampled(const sched_task_t* task)
+{
+	if(_sample_rate == 0 || NULL == _output || NULL == task) return 0;
+
+	return task->request % _sample_rate == 0;
+}
+
+int sched_trace_span(const sched_task_t* task, sched_trace_phase_t phase, uint64_t start)
+{
+	if(NULL == task || ERROR_CODE(sched_service_node_id_t) == task->node)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	uint64_t end = utils_clock_now_ns();
+
+	_buffer_t* buf = _get_local_buffer();
+	if(NULL == buf) ERROR_RETURN_LOG(int, "Cannot get the trace buffer for current thread");
+
+	_span_t* span = buf->data + buf->size;
+	const sched_loop_t* loop = sched_task_get_loop(task);
+
+	span->request = task->request;
+	span->owner = NULL == loop ? ERROR_CODE(uint32_t) : sched_loop_get_id(loop);
+	span->node = task->node;
+	span->phase = phase;
+	span->start = start;
+	span->end = end;
+	span->npipes = 0;
+
+	if((phase == SCHED_TRACE_PHASE_EXEC || phase == SCHED_TRACE_PHASE_ASYNC_CLEANUP) && NULL != task->exec_task)
+	{
+		uint32_t size, i;
+		const sched_service_edge_plan_t* plan = sched_service_get_outgoing_plan(task->service, task->node, &size);
+		if(NULL == plan) ERROR_RETURN_LOG(int, "Cannot get the execution plan of the outgoing pipes");
+
+		for(i = 0; i < size && span->npipes < SCHED_TRACE_MAX_PIPES; i ++)
+		{
+			runtime_api_pipe_id_t pid = RUNTIME_API_PIPE_TO_PID(plan[i].desc.source_pipe_desc);
+			const itc_module_pipe_t* pipe = pid < task->exec_task->npipes ? task->exec_task->pipes[pid] : NULL;
+			if(NULL == pipe) continue;
+
+			size_t bytes = itc_module_pipe_bytes_written(pipe);
+			if(ERROR_CODE(size_t) == bytes) continue;
+
+			span->pipes[span->npipes].pid = pid;
+			span->pipes[span->npipes].bytes = bytes;
+			span->npipes ++;
+		}
+	}
+
+	if(++ buf->size >= buf->capacity)
+	    _buffer_flush(buf);
+
+	return 0;
+}
+
+/**
+ * @brief replace the trace output file and close the previous one
+ * @details the previous output is only closed after all the threads writing to it are done, the spans
+ *          buffered by the threads at this point will go to the new output
+ * @param output the new output file, NULL if we just close the current one
+ * @return status code
+ **/
+static inline int _swap_output(FILE* output)
+{
+	if((errno = pthread_mutex_lock(&_output_mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the trace output mutex");
+
+	FILE* prev = _output;
+	_output = output;
+	_output_nonempty = 0;
+	_output_seq ++;
+
+	if((errno = pthread_mutex_unlock(&_output_mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot release the trace output mutex");
+
+	if(NULL != prev)
+	{
+		fputs("\n]}\n", prev);
+		fclose(prev);
+	}
+
+	return 0;
+}
+
+static inline int _set_prop(const char* symbol, lang_prop_value_t value, const void* data)
+{
+	(void) data;
+	if(NULL == symbol || LANG_PROP_TYPE_ERROR == value.type || LANG_PROP_TYPE_NONE == value.type)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+	if(strcmp(symbol, "sample_rate") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(value.num < 0) ERROR_RETURN_LOG(int, "Invalid sample rate");
+		_sample_rate = (uint32_t)value.num;
+		if(_sample_rate) LOG_TRACE("Tracer is enabled, sample rate 1/%u", _sample_rate);
+		else LOG_TRACE("Tracer is disabled");
+	}
+	else if(strcmp(symbol, "output") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_STRING) ERROR_RETURN_LOG(int, "Type mismatch");
+		const char* path = value.str;
+		if(NULL == path) ERROR_RETURN_LOG(int, "Cannot get the string value");
+		FILE* output = NULL;
+		if(path[0] != 0)
+		{
+			if(NULL == (output = fopen(path, "w")))
+			    ERROR_RETURN_LOG_ERRNO(int, "Cannot open the trace output file %s", path);
+			/* Flush the header, otherwise it will be written twice if the process forks later */
+			fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", output);
+			fflush(output);
+		}
+		if(ERROR_CODE(int) == _swap_output(output))
+		{
+			if(NULL != output) fclose(output);
+			ERROR_RETURN_LOG(int, "Cannot replace the trace output file");
+		}
+	}
+	else if(strcmp(symbol, "buffer_size") == 0)
+	{
+		if(value.type != LANG_PROP_TYPE_INTEGER) ERROR_RETURN_LOG(int, "Type mismatch");
+		if(value.num <= 0) ERROR_RETURN_LOG(int, "Invalid buffer size");
+		/* The buffers already allocated keep their capacity */
+		_buffer_size = (uint32_t)value.num;
+	}
+	else
+	{
+		LOG_WARNING("Unrecognized symbol name %s", symbol);
+		return 0;
+	}
+
+	return 1;
+}
+
+int sched_trace_init()
+{
+	if((errno = pthread_mutex_init(&_output_mutex, NULL)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot initialize the trace output mutex");
+
+	lang_prop_callback_t cb = {
+		.param = NULL,
+		.get   = NULL,
+		.set   = _set_prop,
+		.symbol_prefix = "tracer"
+	};
+
+	if(ERROR_CODE(int) == lang_prop_register_callback(&cb))
+	    ERROR_RETURN_LOG(int, "Cannot register callback for the runtime prop callback");
+
+	return 0;
+}
+
+int sched_trace_finalize()
+{
+	_buffer_t* buf;
+
+	while(NULL != (buf = _buffers))
+	{
+		_buffers = buf->next;
+		if(buf->size > 0) _buffer_flush(buf);
+		free(buf);
+	}
+
+	_generation ++;
+
+	int rc = _swap_output(NULL);
+
+	if((errno = pthread_mutex_destroy(&_output_mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot destroy the trace output mutex");
+
+	return rc;
+}
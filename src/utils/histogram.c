@@ -0,0 +1,70 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+#include <stdint.h>
+#include <string.h>
+
+#include <error.h>
+
+#include <utils/log.h>
+#include <utils/histogram.h>
+
+uint64_t utils_histogram_bucket_upper_bound(uint32_t bucket)
+{
+	if(bucket < UTILS_HISTOGRAM_SUB_BUCKETS) return bucket;
+
+	if(bucket >= UTILS_HISTOGRAM_NBUCKETS - 1) return UINT64_MAX;
+
+	uint32_t exp = (bucket >> UTILS_HISTOGRAM_SUB_BITS) + UTILS_HISTOGRAM_SUB_BITS - 1;
+	uint64_t sub = bucket & (UTILS_HISTOGRAM_SUB_BUCKETS - 1);
+	uint32_t shift = exp - UTILS_HISTOGRAM_SUB_BITS;
+
+	return ((UTILS_HISTOGRAM_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+int utils_histogram_merge(utils_histogram_t* dest, const utils_histogram_t* src)
+{
+	if(NULL == dest || NULL == src) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	uint32_t i;
+	for(i = 0; i < UTILS_HISTOGRAM_NBUCKETS; i ++)
+	    dest->buckets[i] += src->buckets[i];
+
+	dest->count += src->count;
+	dest->sum += src->sum;
+	if(dest->max < src->max) dest->max = src->max;
+
+	return 0;
+}
+
+uint64_t utils_histogram_percentile(const utils_histogram_t* hist, double percentile)
+{
+	if(NULL == hist || percentile < 0 || percentile > 100) ERROR_RETURN_LOG(uint64_t, "Invalid arguments");
+
+	if(hist->count == 0) return 0;
+
+	/* The rank of the value we are looking for, which is at least 1 */
+	uint64_t rank = (uint64_t)((double)hist->count * percentile / 100.0 + 0.5);
+	if(rank == 0) rank = 1;
+
+	uint64_t seen = 0;
+	uint32_t i;
+	for(i = 0; i < UTILS_HISTOGRAM_NBUCKETS; i ++)
+	    if((seen += hist->buckets[i]) >= rank)
+	    {
+		    uint64_t ret = utils_histogram_bucket_upper_bound(i);
+		    return ret < hist->max ? ret : hist->max;
+	    }
+
+	return hist->max;
+}
+
+int utils_histogram_reset(utils_histogram_t* hist)
+{
+	if(NULL == hist) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	memset(hist, 0, sizeof(*hist));
+
+	return 0;
+}
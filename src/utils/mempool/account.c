@@ -0,0 +1,271 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <error.h>
+#include <utils/log.h>
+#include <utils/static_assertion.h>
+#include <utils/mempool/account.h>
+
+/**
+ * @brief the memory counter with watermarks
+ **/
+typedef struct {
+	size_t   bytes;      /*!< the bytes currently charged */
+	size_t   peak;       /*!< the peak value of the bytes */
+	size_t   high;       /*!< the high watermark, 0 means no limit */
+	size_t   low;        /*!< the low watermark */
+	uint32_t over;       /*!< if the counter is over limit */
+} _counter_t;
+
+/**
+ * @brief the actual data structure for a memory account
+ **/
+struct _mempool_account_t {
+	_counter_t                 counter;  /*!< the memory counter of this account */
+	struct _mempool_account_t* prev;     /*!< the previous account in the account list */
+	struct _mempool_account_t* next;     /*!< the next account in the account list */
+	uintpad_t __padding__[0];
+	char                       name[0];  /*!< the name of the account */
+};
+STATIC_ASSERTION_LAST(mempool_account_t, name);
+STATIC_ASSERTION_SIZE(mempool_account_t, name, 0);
+
+/**
+ * @brief the counter for all the accounts, which is limited by the global budget
+ **/
+static _counter_t _total;
+
+/**
+ * @brief the list of all the accounts
+ **/
+static mempool_account_t* _accounts;
+
+/**
+ * @brief the mutex protects the account list
+ **/
+static pthread_mutex_t _mutex;
+
+/**
+ * @brief add bytes to the counter
+ * @param counter the counter
+ * @param bytes the number of bytes
+ * @return 1 if the counter just went beyond the high watermark, otherwise 0
+ **/
+static inline int _counter_add(_counter_t* counter, size_t bytes)
+{
+	size_t value = __sync_add_and_fetch(&counter->bytes, bytes);
+
+	size_t peak;
+	for(peak = counter->peak; peak < value && !__sync_bool_compare_and_swap(&counter->peak, peak, value); peak = counter->peak);
+
+	return counter->high > 0 && value > counter->high && !counter->over &&
+	       __sync_bool_compare_and_swap(&counter->over, 0, 1);
+}
+
+/**
+ * @brief remove bytes from the counter
+ * @param counter the counter
+ * @param bytes the number of bytes
+ * @return 1 if the counter just dropped to the low watermark, otherwise 0
+ **/
+static inline int _counter_sub(_counter_t* counter, size_t bytes)
+{
+	size_t value = __sync_sub_and_fetch(&counter->bytes, bytes);
+
+	return counter->over && value <= counter->low &&
+	       __sync_bool_compare_and_swap(&counter->over, 1, 0);
+}
+
+/**
+ * @brief fill the snapshot buffer with the counter
+ * @param counter the counter
+ * @param name the name of the counter
+ * @param buf the snapshot buffer
+ * @return nothing
+ **/
+static inline void _counter_stat(const _counter_t* counter, const char* name, mempool_account_stat_t* buf)
+{
+	buf->name = name;
+	buf->bytes = counter->bytes;
+	buf->peak = counter->peak;
+	buf->high_watermark = counter->high;
+	buf->low_watermark = counter->low;
+	buf->over_limit = (counter->over != 0);
+}
+
+int mempool_account_init()
+{
+	memset(&_total, 0, sizeof(_total));
+	_accounts = NULL;
+
+	if((errno = pthread_mutex_init(&_mutex, NULL)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot initialize the account list mutex");
+
+	return 0;
+}
+
+int mempool_account_finalize()
+{
+	int rc = 0;
+
+	for(;NULL != _accounts;)
+	{
+		mempool_account_t* account = _accounts;
+		_accounts = account->next;
+		LOG_WARNING("Memory account %s is not disposed before finalization", account->name);
+		free(account);
+	}
+
+	if((errno = pthread_mutex_destroy(&_mutex)) != 0)
+	{
+		LOG_ERROR_ERRNO("Cannot dispose the account list mutex");
+		rc = ERROR_CODE(int);
+	}
+
+	return rc;
+}
+
+mempool_account_t* mempool_account_new(const char* name)
+{
+	if(NULL == name) ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	size_t len = strlen(name);
+	mempool_account_t* ret = (mempool_account_t*)malloc(sizeof(mempool_account_t) + len + 1);
+	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the memory account");
+
+	memset(&ret->counter, 0, sizeof(ret->counter));
+	memcpy(ret->name, name, len + 1);
+	ret->prev = NULL;
+
+	if((errno = pthread_mutex_lock(&_mutex)) != 0)
+	{
+		free(ret);
+		ERROR_PTR_RETURN_LOG_ERRNO("Cannot acquire the account list mutex");
+	}
+
+	ret->next = _accounts;
+	if(NULL != _accounts) _accounts->prev = ret;
+	_accounts = ret;
+
+	if((errno = pthread_mutex_unlock(&_mutex)) != 0)
+	    LOG_WARNING_ERRNO("Cannot release the account list mutex");
+
+	LOG_DEBUG("Memory account %s has been created", name);
+
+	return ret;
+}
+
+int mempool_account_free(mempool_account_t* account)
+{
+	if(NULL == account) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if((errno = pthread_mutex_lock(&_mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the account list mutex");
+
+	if(NULL != account->prev) account->prev->next = account->next;
+	else _accounts = account->next;
+	if(NULL != account->next) account->next->prev = account->prev;
+
+	if((errno = pthread_mutex_unlock(&_mutex)) != 0)
+	    LOG_WARNING_ERRNO("Cannot release the account list mutex");
+
+	if(account->counter.bytes > 0)
+	{
+		LOG_DEBUG("Memory account %s still has %zu bytes charged", account->name, account->counter.bytes);
+		_counter_sub(&_total, account->counter.bytes);
+	}
+
+	free(account);
+
+	return 0;
+}
+
+int mempool_account_set_watermark(mempool_account_t* account, size_t high, size_t low)
+{
+	_counter_t* counter = NULL == account ? &_total : &account->counter;
+
+	if(low == 0 || low > high) low = high;
+
+	counter->high = high;
+	counter->low = low;
+	counter->over = (uint32_t)(high > 0 && (counter->bytes > high || (counter->over && counter->bytes > low)));
+
+	return 0;
+}
+
+int mempool_account_charge(mempool_account_t* account, size_t bytes)
+{
+	if(NULL == account || bytes == 0) return 0;
+
+	if(_counter_add(&account->counter, bytes))
+	    LOG_WARNING("Memory account %s is over its high watermark (%zu bytes)", account->name, account->counter.high);
+
+	if(_counter_add(&_total, bytes))
+	    LOG_WARNING("The process is over the memory budget (%zu bytes)", _total.high);
+
+	return 0;
+}
+
+int mempool_account_uncharge(mempool_account_t* account, size_t bytes)
+{
+	if(NULL == account || bytes == 0) return 0;
+
+	if(_counter_sub(&account->counter, bytes))
+	    LOG_INFO("Memory account %s is back to its low watermark", account->name);
+
+	if(_counter_sub(&_total, bytes))
+	    LOG_INFO("The process is back to the low watermark of the memory budget");
+
+	return 0;
+}
+
+int mempool_account_over_limit(const mempool_account_t* account)
+{
+	return _total.over || (NULL != account && account->counter.over);
+}
+
+int mempool_account_get_stat(const mempool_account_t* account, mempool_account_stat_t* buf)
+{
+	if(NULL == buf) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if(NULL == account)
+	    _counter_stat(&_total, NULL, buf);
+	else
+	    _counter_stat(&account->counter, account->name, buf);
+
+	return 0;
+}
+
+int mempool_account_foreach(int (*func)(const mempool_account_stat_t* stat, void* data), void* data)
+{
+	if(NULL == func) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	int rc = 0;
+
+	if((errno = pthread_mutex_lock(&_mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the account list mutex");
+
+	const mempool_account_t* account;
+	for(account = _accounts; NULL != account; account = account->next)
+	{
+		mempool_account_stat_t stat;
+		_counter_stat(&account->counter, account->name, &stat);
+		if(ERROR_CODE(int) == func(&stat, data))
+		{
+			LOG_ERROR("The account callback returns an error");
+			rc = ERROR_CODE(int);
+			break;
+		}
+	}
+
+	if((errno = pthread_mutex_unlock(&_mutex)) != 0)
+	    LOG_WARNING_ERRNO("Cannot release the account list mutex");
+
+	return rc;
+}
@@ -22,6 +22,8 @@
 
 #include <utils/thread.h>
 
+#include <barrier.h>
+
 extern void  __libc_free(void* ptr);
 
 /**
@@ -38,30 +40,71 @@ typedef struct _page_t {
  **/
 typedef struct _cached_object_t {
 	struct _cached_object_t* next;   /*!< the next object in the list */
-	struct _cached_object_t* prev;   /*!< the previous object in the list */
 } _cached_object_t;
 
+/**
+ * @brief a magazine is a list of objects which the threads exchange through the depot
+ * @note the magazine is never disposed until the pool is disposed, so it's safe to read the next pointer
+ *       of a magazine which has been popped from the depot by another thread
+ **/
+typedef struct _magazine_t {
+	struct _magazine_t* next;       /*!< the next magazine in the depot stack */
+	struct _magazine_t* next_alloc; /*!< the next magazine in the list of all the magazines of the pool */
+	uint32_t            count;      /*!< the number of objects in this magazine */
+	_cached_object_t*   objects;    /*!< the object list */
+} _magazine_t;
+
+/**
+ * @brief the head of a lock-free magazine stack, which is a magazine pointer with a tag in the high bits
+ * @details the tag is increased on each update, so that the CAS fails if the head has been popped and pushed
+ *          back between we read it and we update it (the ABA problem)
+ **/
+typedef uint64_t _tagged_t;
+
+#if UINTPTR_MAX > 0xffffffffu
+/** @brief the user space address on a 64 bit machine uses at most 48 bits */
+#	define _TAG_SHIFT 48
+#else
+#	define _TAG_SHIFT 32
+#endif
+/** @brief get the magazine pointer from the tagged pointer */
+#define _TAGGED_PTR(t) ((_magazine_t*)(uintptr_t)((t) & ((1ull << _TAG_SHIFT) - 1)))
+/** @brief make a new tagged pointer which has a different tag than the old one */
+#define _TAGGED_NEXT(old, ptr) (((((old) >> _TAG_SHIFT) + 1) << _TAG_SHIFT) | (uint64_t)(uintptr_t)(ptr))
+
 /**
  * @brief the actual memory pool data structure
+ * @details Each thread caches two magazines, the loaded one and the previous one. The thread only goes to the depot
+ *          when both of them are empty (for allocation) or full (for deallocation), in which case it exchanges
+ *          a whole magazine with the depot. This makes the objects flow from the threads which only deallocates to
+ *          the threads which only allocates without taking the pool mutex. <br/>
+ *          The mutex is only used when the depot has no full magazine, in which case we carve new objects from the pages
  **/
 struct _mempool_objpool_t {
 	uint32_t                     page_count;                     /*!< the number of pages */
 	uint32_t                     obj_size;                       /*!< the size of each object in the pool */
 	_page_t*                     pages;                          /*!< the pages used by the pool */
-	_cached_object_t*            cached;                         /*!< the cahced object list */
-	pthread_mutex_t              mutex;                          /*!< the mutex use for the multi-thread pool */
+	_cached_object_t*            cached;                         /*!< the objects returned to the global pool when we cannot get a magazine for them */
+	pthread_mutex_t              mutex;                          /*!< the mutex protects the pages and the cached object list */
+	_tagged_t                    full;                           /*!< the depot stack of the full magazines */
+	_tagged_t                    empty;                          /*!< the depot stack of the empty magazines */
+	_magazine_t*                 magazines;                      /*!< all the magazines allocated for this pool */
+	mempool_objpool_pool_stat_t  stat;                           /*!< the depot statistics */
+	mempool_account_t*           account;                        /*!< the memory account the pages are charged to */
 	thread_pset_t                local_pool;                     /*!< the thread local object pool */
 	mempool_objpool_tlp_policy_t policy[THREAD_NUM_TYPES];       /*!< the allocation policy for each type of thread */
 };
 
 /**
  * @brief the thread local pool
+ * @note the capacity of a magazine for current thread is min(cache_limit, UTILS_MEMPOOL_OBJPOOL_MAGAZINE_SIZE),
+ *       so the thread caches 2 * capacity objects at most
  **/
 typedef struct {
-	uint32_t            count;   /*!< the number of object cahced */
-	_cached_object_t*   begin;   /*!< the cached objects list begin */
-	_cached_object_t*   exceeded;/*!< the point that the cached object is more than the maximum value allowed */
-	_cached_object_t*   end;     /*!< the end of the cached objects */
+	uint32_t            loaded_count;   /*!< the number of objects in the loaded magazine */
+	uint32_t            previous_count; /*!< the number of objects in the previous magazine */
+	_cached_object_t*   loaded;         /*!< the loaded magazine, which we allocate from and deallocate to */
+	_cached_object_t*   previous;       /*!< the previous magazine */
 } _thread_local_pool_t;
 
 /**
@@ -76,6 +119,26 @@ static int _pool_disabled = 0;
  **/
 static const uint32_t _thread_object_max = 0x10000;
 
+/**
+ * @brief the number of object pools which are currently alive
+ **/
+static uint32_t _num_pools = 0;
+
+/**
+ * @brief the number of pages currently used by all the object pools
+ **/
+static uint64_t _num_pages = 0;
+
+/**
+ * @brief the number of times a thread refilled its cache with a full magazine from the depot of any pool
+ **/
+static uint64_t _depot_hits = 0;
+
+/**
+ * @brief the number of times a thread found no full magazine in the depot of any pool
+ **/
+static uint64_t _depot_misses = 0;
+
 #ifndef FULL_OPTIMIZATION
 /**
  * @brief the size of one page in current operating system
@@ -147,18 +210,59 @@ static inline uint32_t _thread_type_to_idx(void)
 STATIC_ASSERTION_EQ_ID(THREAD_NUM_IS_4, THREAD_NUM_TYPES, 4);
 
 /**
- * @brief get the current cached object limit
+ * @brief get the capacity of the magazine for current thread
  * @param pool the pool we want to get
- * @return the cached object limit for current thread, or error code
+ * @return the magazine capacity, which is the cached object limit for current thread but no larger than the magazine size
  **/
-static inline uint32_t _get_current_thread_cache_limit(const mempool_objpool_t* pool)
+static inline uint32_t _get_current_magazine_capacity(const mempool_objpool_t* pool)
 {
 	uint32_t idx = _thread_type_to_idx();
+	uint32_t ret = PREDICT_FALSE(idx >= THREAD_NUM_TYPES) ? _thread_object_max : pool->policy[idx].cache_limit;
 
-	if(PREDICT_FALSE(idx >= THREAD_NUM_TYPES))
-	    return _thread_object_max;
+	return ret > UTILS_MEMPOOL_OBJPOOL_MAGAZINE_SIZE ? UTILS_MEMPOOL_OBJPOOL_MAGAZINE_SIZE : ret;
+}
+
+/**
+ * @brief push a magazine to a depot stack
+ * @param head the head of the stack
+ * @param mag the magazine
+ * @return nothing
+ **/
+static inline void _magazine_push(_tagged_t* head, _magazine_t* mag)
+{
+	for(;;)
+	{
+		_tagged_t old = *head;
+		mag->next = _TAGGED_PTR(old);
+
+		BARRIER();
+
+		if(__sync_bool_compare_and_swap(head, old, _TAGGED_NEXT(old, mag)))
+		    break;
+	}
+}
+
+/**
+ * @brief pop a magazine from a depot stack
+ * @param head the head of the stack
+ * @return the magazine or NULL if the stack is empty
+ **/
+static inline _magazine_t* _magazine_pop(_tagged_t* head)
+{
+	for(;;)
+	{
+		_tagged_t old = *head;
+		_magazine_t* top = _TAGGED_PTR(old);
+
+		if(NULL == top) return NULL;
+
+		_magazine_t* next = top->next;
 
-	return pool->policy[idx].cache_limit;
+		BARRIER();
+
+		if(__sync_bool_compare_and_swap(head, old, _TAGGED_NEXT(old, next)))
+		    return top;
+	}
 }
 
 /**
@@ -192,8 +296,8 @@ static inline void* _thread_pool_alloc(uint32_t tid, const void* data)
 
 	_thread_local_pool_t* ret = (_thread_local_pool_t*)malloc(sizeof(_thread_local_pool_t));
 	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the thread local pool");
-	ret->begin = ret->exceeded = ret->end = 0;
-	ret->count = 0;
+	ret->loaded = ret->previous = NULL;
+	ret->loaded_count = ret->previous_count = 0;
 	return ret;
 }
 
@@ -229,6 +333,10 @@ mempool_objpool_t* mempool_objpool_new(uint32_t size)
 	ret->pages = NULL;
 	ret->cached = NULL;
 	ret->page_count = 0;
+	ret->full = ret->empty = 0;
+	ret->magazines = NULL;
+	ret->account = NULL;
+	memset(&ret->stat, 0, sizeof(ret->stat));
 
 	if(NULL == thread_pset_new(1, _thread_pool_alloc , _thread_pool_free, ret, &ret->local_pool))
 	    ERROR_LOG_GOTO(ERR, "Cannot create thread local pointer set as the lcoal thread pool");
@@ -243,6 +351,8 @@ mempool_objpool_t* mempool_objpool_new(uint32_t size)
 		ret->policy[i].alloc_unit = 1;
 	}
 
+	__sync_fetch_and_add(&_num_pools, 1);
+
 	goto RET;
 ERR:
 	thread_pset_free(&ret->local_pool);
@@ -270,6 +380,17 @@ int mempool_objpool_free(mempool_objpool_t* pool)
 		free(current);
 	}
 
+	for(;pool->magazines;)
+	{
+		_magazine_t* mag = pool->magazines;
+		pool->magazines = mag->next_alloc;
+		free(mag);
+	}
+
+	__sync_fetch_and_sub(&_num_pages, (uint64_t)pool->page_count);
+	__sync_fetch_and_sub(&_num_pools, 1);
+	mempool_account_uncharge(pool->account, (size_t)pool->page_count * _pagesize);
+
 	if(thread_pset_free(&pool->local_pool) == ERROR_CODE(int))
 	{
 		LOG_ERROR("Cannot dispose the thread local memory pool");
@@ -284,9 +405,8 @@ int mempool_objpool_free(mempool_objpool_t* pool)
 __attribute__((noinline))
 /**
  * @brief perform a global allocation from the global object memory pool
- * @note  this function will get min(alloc_unit, 2 * cache_limit - local_count) memory objects from the global pool.
- *        This means we we get at most alloc_unit memory objects, otherwise, we want to fill the local buffer as much
- *        as possible. <br/>
+ * @note  this function will get min(alloc_unit, capacity) memory objects from the global pool, where capacity
+ *        is the magazine capacity of current thread. <br/>
  *        However, if we used up all the cached object, then we allocate objects at most one page, because otherwise
  *        we actually waste our time on meaningless things.
  * @param pool the memory pool to allocate
@@ -301,8 +421,8 @@ static uint32_t _global_alloc(mempool_objpool_t* pool, _thread_local_pool_t* tlp
 	    ERROR_RETURN_LOG_ERRNO(uint32_t, "Cannot acquire the pool mutex");
 
 	uint32_t to_alloc = _get_current_global_alloc_unit(pool);
-	uint32_t cache_limit = _get_current_thread_cache_limit(pool);
-	to_alloc = to_alloc > cache_limit ? cache_limit : to_alloc;
+	uint32_t capacity = _get_current_magazine_capacity(pool);
+	to_alloc = to_alloc > capacity ? capacity : to_alloc;
 
 	_cached_object_t *begin = NULL, *end = NULL;
 	uint32_t count = 0;
@@ -314,15 +434,10 @@ static uint32_t _global_alloc(mempool_objpool_t* pool, _thread_local_pool_t* tlp
 		end = begin = pool->cached;
 
 		for(count = 1; count < to_alloc && end->next != NULL; count ++)
-		{
-			_cached_object_t* current = end;
-			end = end->next;
-			end->prev = current;
-		}
+		    end = end->next;
 
 		pool->cached = end->next;
 		end->next = NULL;
-		begin->prev = NULL;
 
 		LOG_DEBUG("%u memory objects has been allocated from the global pool cache", count);
 	}
@@ -340,6 +455,8 @@ static uint32_t _global_alloc(mempool_objpool_t* pool, _thread_local_pool_t* tlp
 			new_page->next = pool->pages;
 			pool->pages = new_page;
 			pool->page_count ++;
+			__sync_fetch_and_add(&_num_pages, 1);
+			mempool_account_charge(pool->account, _pagesize);
 			LOG_DEBUG("Allocated one more page in the object memory pool");
 		}
 
@@ -348,19 +465,16 @@ static uint32_t _global_alloc(mempool_objpool_t* pool, _thread_local_pool_t* tlp
 			_cached_object_t* new_obj = (_cached_object_t*)(((uint8_t*)pool->pages->page) + pool->pages->unused_start);
 			pool->pages->unused_start += pool->obj_size;
 			new_obj->next = NULL;
-			new_obj->prev = end;
 			if(begin == NULL)
 			    begin = end = new_obj;
 			else
 			    end->next = new_obj, end = new_obj;
 			count ++;
 		}
-		if(NULL != end) end->next = NULL;
 	}
 
-	tlp->begin = begin;
-	tlp->end = end;
-	ret = tlp->count = count;
+	tlp->loaded = begin;
+	ret = tlp->loaded_count = count;
 
 	goto RET;
 ERR:
@@ -375,6 +489,54 @@ RET:
 	    ERROR_RETURN_LOG_ERRNO(uint32_t, "Cannot release the pool mutex");
 	return ret;
 }
+
+__attribute__((noinline))
+/**
+ * @brief refill the loaded magazine of the thread local pool when it's empty
+ * @details we try the previous magazine first, then a full magazine from the depot and
+ *          only take the pool mutex when the depot has no full magazine
+ * @param pool the memory pool
+ * @param tlp the thread local pool
+ * @return status code
+ **/
+static int _refill(mempool_objpool_t* pool, _thread_local_pool_t* tlp)
+{
+	if(tlp->previous_count > 0)
+	{
+		_cached_object_t* objects = tlp->loaded;
+		tlp->loaded = tlp->previous;
+		tlp->loaded_count = tlp->previous_count;
+		tlp->previous = objects;
+		tlp->previous_count = 0;
+		return 0;
+	}
+
+	_magazine_t* mag = _magazine_pop(&pool->full);
+	if(NULL != mag)
+	{
+		__sync_fetch_and_sub(&pool->stat.full_magazines, 1);
+		__sync_fetch_and_add(&pool->stat.alloc_hits, 1);
+		__sync_fetch_and_add(&_depot_hits, 1);
+
+		tlp->loaded = mag->objects;
+		tlp->loaded_count = mag->count;
+		mag->objects = NULL;
+		mag->count = 0;
+
+		_magazine_push(&pool->empty, mag);
+		__sync_fetch_and_add(&pool->stat.empty_magazines, 1);
+		return 0;
+	}
+
+	__sync_fetch_and_add(&pool->stat.alloc_misses, 1);
+	__sync_fetch_and_add(&_depot_misses, 1);
+
+	if(ERROR_CODE(uint32_t) == _global_alloc(pool, tlp))
+	    ERROR_RETURN_LOG(int, "Cannot allocate memory from the global object memory pool");
+
+	return 0;
+}
+
 /* Since OSX do not support this trick, we must disable this on darwin */
 #if defined(FULL_OPTIMIZATION) && !defined(__DARWIN__)
 __attribute__((weak, alias("_mempool_objpool_alloc_no_check")))
@@ -382,7 +544,7 @@ void* mempool_objpool_alloc(mempool_objpool_t* pool);
 #endif
 static void* _mempool_objpool_alloc_no_check(mempool_objpool_t* pool)
 {
-	void* ret = NULL;
+	_cached_object_t* ret = NULL;
 
 	/* First try to get the object from the local pool */
 	_thread_local_pool_t* tlp = thread_pset_acquire(&pool->local_pool);
@@ -392,27 +554,17 @@ static void* _mempool_objpool_alloc_no_check(mempool_objpool_t* pool)
 	    ERROR_PTR_RETURN_LOG("Cannot acquire the thread local pool for current thread TID=%u", thread_get_id());
 #endif
 
-	if(PREDICT_FALSE(tlp->count == 0))
+	if(PREDICT_FALSE(tlp->loaded_count == 0))
 	{
-		if(PREDICT_FALSE(ERROR_CODE(uint32_t) == _global_alloc(pool, tlp)))
-		    ERROR_PTR_RETURN_LOG("Cannot allocate memory from the global object memory pool");
+		if(PREDICT_FALSE(ERROR_CODE(int) == _refill(pool, tlp) || tlp->loaded_count == 0))
+		    ERROR_PTR_RETURN_LOG("Cannot refill the thread local pool");
 	}
 	else
 	    LOG_DEBUG("The thread-local pool contains unused objects, reuse it");
 
-	ret = tlp->end;
-	tlp->end = tlp->end->prev;
-	if(tlp->count == 1)
-	    tlp->begin = tlp->exceeded = NULL;
-	else if(PREDICT_FALSE(tlp->exceeded == ret))
-	    tlp->exceeded = NULL;
-
-	tlp->count --;
-
-#ifndef FULL_OPTIMIZATION
-	if(PREDICT_FALSE(NULL == ret))
-	    LOG_ERROR("Cannot allocate memory from the object pool");
-#endif
+	ret = tlp->loaded;
+	tlp->loaded = ret->next;
+	tlp->loaded_count --;
 
 	return ret;
 }
@@ -439,20 +591,20 @@ int mempool_objpool_disabled(int val)
 
 /**
  * @brief return a list of cached object to the global pool
- * @param begin the begin pointer of the list
- * @param end the end pointer of the list
  * @param pool the target memory pool
+ * @param begin the begin pointer of the list
  * @return status code
  **/
-static inline int _global_dealloc(mempool_objpool_t* pool, _cached_object_t* begin, _cached_object_t* end)
+static inline int _global_dealloc(mempool_objpool_t* pool, _cached_object_t* begin)
 {
+	_cached_object_t* end;
+	for(end = begin; NULL != end->next; end = end->next);
+
 	if((errno = pthread_mutex_lock(&pool->mutex)) != 0)
 	    ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the pool mutex");
 
 	end->next = pool->cached;
-	if(NULL != pool->cached) pool->cached->prev = end;
 	pool->cached = begin;
-	begin->prev = NULL;
 
 	if((errno = pthread_mutex_unlock(&pool->mutex)) != 0)
 	    ERROR_RETURN_LOG_ERRNO(int, "Cannot release the pool mutex");
@@ -460,16 +612,62 @@ static inline int _global_dealloc(mempool_objpool_t* pool, _cached_object_t* beg
 	return 0;
 }
 
-__attribute__((noinline)) static int _do_global_dealloc(mempool_objpool_t* pool, _thread_local_pool_t* tlp, uint32_t cache_limit)
+__attribute__((noinline))
+/**
+ * @brief make room in the loaded magazine of the thread local pool when it's full
+ * @details if the previous magazine is empty, we just swap it with the loaded one. Otherwise the previous magazine
+ *          goes to the depot with an empty magazine from the depot, or a newly allocated one when the depot has no
+ *          empty magazine. The global pool mutex is only used when we cannot allocate the magazine
+ * @param pool the memory pool
+ * @param tlp the thread local pool
+ * @return status code
+ **/
+static int _flush(mempool_objpool_t* pool, _thread_local_pool_t* tlp)
 {
-	_cached_object_t* new_end = tlp->exceeded->prev;
-	if(PREDICT_FALSE(ERROR_CODE(int) == _global_dealloc(pool, tlp->exceeded, tlp->end)))
-	    ERROR_RETURN_LOG(int, "Cannot deallocate the exceeded objects to the global pool");
+	if(tlp->previous_count > 0)
+	{
+		_magazine_t* mag = _magazine_pop(&pool->empty);
+		if(NULL != mag)
+		{
+			__sync_fetch_and_sub(&pool->stat.empty_magazines, 1);
+			__sync_fetch_and_add(&pool->stat.dealloc_hits, 1);
+		}
+		else
+		{
+			__sync_fetch_and_add(&pool->stat.dealloc_misses, 1);
+			if(NULL != (mag = (_magazine_t*)malloc(sizeof(_magazine_t))))
+			{
+				for(;;)
+				{
+					mag->next_alloc = pool->magazines;
+					if(__sync_bool_compare_and_swap(&pool->magazines, mag->next_alloc, mag))
+					    break;
+				}
+			}
+			else
+			{
+				LOG_WARNING_ERRNO("Cannot allocate a new magazine, return the objects to the global pool");
+				if(ERROR_CODE(int) == _global_dealloc(pool, tlp->previous))
+				    ERROR_RETURN_LOG(int, "Cannot deallocate the objects to the global pool");
+			}
+		}
+
+		if(NULL != mag)
+		{
+			mag->objects = tlp->previous;
+			mag->count = tlp->previous_count;
+			_magazine_push(&pool->full, mag);
+			__sync_fetch_and_add(&pool->stat.full_magazines, 1);
+		}
 
-	tlp->exceeded = NULL;
-	tlp->end = new_end;
-	tlp->end->next = NULL;
-	tlp->count = cache_limit;
+		tlp->previous = NULL;
+		tlp->previous_count = 0;
+	}
+
+	tlp->previous = tlp->loaded;
+	tlp->previous_count = tlp->loaded_count;
+	tlp->loaded = NULL;
+	tlp->loaded_count = 0;
 
 	return 0;
 }
@@ -487,25 +685,16 @@ static int _mempool_objpool_dealloc_no_check(mempool_objpool_t* pool, void* mem)
 	    ERROR_RETURN_LOG(int, "Cannot acquire the thread local pool for current thread TID=%u", thread_get_id());
 #endif
 
-	_cached_object_t* cur = (_cached_object_t*)mem;
-	cur->prev = tlp->end;
-	cur->next = NULL;
-	if(PREDICT_TRUE(tlp->end != NULL))
-	    tlp->end->next = cur;
-	else
-	    tlp->begin = cur;
-
-	tlp->end = cur;
-
-	uint32_t cache_limit = _get_current_thread_cache_limit(pool);
-
-	if(PREDICT_FALSE(tlp->count == cache_limit))
-	    tlp->exceeded = tlp->end;
-
-	tlp->count ++;
+	if(PREDICT_FALSE(tlp->loaded_count >= _get_current_magazine_capacity(pool)))
+	{
+		if(PREDICT_FALSE(ERROR_CODE(int) == _flush(pool, tlp)))
+		    ERROR_RETURN_LOG(int, "Cannot flush the thread local pool");
+	}
 
-	if(PREDICT_FALSE(tlp->count > cache_limit * 2))
-	    return _do_global_dealloc(pool, tlp, cache_limit);
+	_cached_object_t* cur = (_cached_object_t*)mem;
+	cur->next = tlp->loaded;
+	tlp->loaded = cur;
+	tlp->loaded_count ++;
 
 	return 0;
 }
@@ -541,6 +730,27 @@ uint32_t mempool_objpool_get_page_count(const mempool_objpool_t* pool)
 	return pool->page_count;
 }
 
+int mempool_objpool_get_stat(mempool_objpool_stat_t* buf)
+{
+	if(NULL == buf) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	buf->num_pools = _num_pools;
+	buf->num_pages = _num_pages;
+	buf->depot_hits = _depot_hits;
+	buf->depot_misses = _depot_misses;
+
+	return 0;
+}
+
+int mempool_objpool_get_pool_stat(const mempool_objpool_t* pool, mempool_objpool_pool_stat_t* buf)
+{
+	if(NULL == pool || NULL == buf) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	*buf = pool->stat;
+
+	return 0;
+}
+
 int mempool_objpool_set_thread_policy(mempool_objpool_t* pool, unsigned thread_mask, mempool_objpool_tlp_policy_t policy)
 {
 	if(NULL == pool || policy.cache_limit < 1 || policy.alloc_unit == 0)
@@ -565,3 +775,21 @@ int mempool_objpool_set_thread_policy(mempool_objpool_t* pool, unsigned thread_m
 
 	return 0;
 }
+
+int mempool_objpool_set_account(mempool_objpool_t* pool, mempool_account_t* account)
+{
+	if(NULL == pool) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if((errno = pthread_mutex_lock(&pool->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the pool mutex");
+
+	size_t bytes = (size_t)pool->page_count * _pagesize;
+	mempool_account_uncharge(pool->account, bytes);
+	mempool_account_charge(account, bytes);
+	pool->account = account;
+
+	if((errno = pthread_mutex_unlock(&pool->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot release the pool mutex");
+
+	return 0;
+}
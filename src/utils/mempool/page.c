@@ -3,46 +3,102 @@
  **/
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdlib.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <string.h>
 #include <barrier.h>
 #include <errno.h>
+#include <sys/mman.h>
 
 #include <pthread.h>
 
 #include <error.h>
 #include <arch/arch.h>
 #include <utils/mempool/page.h>
+#include <utils/thread.h>
 #include <utils/log.h>
 
 #include <constants.h>
 
-#ifdef __GLIBC__
-extern void  __libc_free(void* ptr);
-#	define __free__ __libc_free
-#else
-#	define __free__ free
-#endif
 /**
  * @brief represents a unused page
  **/
 typedef struct _page_t {
-	struct _page_t* prev;  /*!< the prev free page */
 	struct _page_t* next;  /*!< the next free page */
 } _page_t;
 
 /**
- * @brief the free page list
+ * @brief a batch of free pages, which is the unit we exchange pages between the thread local pools
+ *        and the global pool
+ * @note the batch header lives in the first page of the batch
+ **/
+typedef struct _batch_t {
+	struct _batch_t* next;   /*!< the next batch in the global stack */
+	_page_t*         pages;  /*!< the remaining pages in this batch */
+	uint32_t         count;  /*!< the number of pages in this batch, including the header page */
+} _batch_t;
+
+/**
+ * @brief the head of the lock-free batch stack, which is a batch pointer with a tag in the high bits
+ * @details the tag is increased on each update, so that the CAS will fail if the head has been popped and pushed
+ *          back between we read it and we update it (the ABA problem). <br/>
+ *          Because the pages are never unmapped until the page allocator is finalized, it's safe to read the
+ *          next pointer of a batch which has been claimed by other thread, the CAS fails in this case anyway
+ **/
+typedef uint64_t _tagged_t;
+
+#if UINTPTR_MAX > 0xffffffffu
+/** @brief the user space address on a 64 bit machine uses at most 48 bits */
+#	define _TAG_SHIFT 48
+#else
+#	define _TAG_SHIFT 32
+#endif
+/** @brief get the batch pointer from the tagged pointer */
+#define _TAGGED_PTR(t) ((_batch_t*)(uintptr_t)((t) & ((1ull << _TAG_SHIFT) - 1)))
+/** @brief make a new tagged pointer which has a different tag than the old one */
+#define _TAGGED_NEXT(old, ptr) (((((old) >> _TAG_SHIFT) + 1) << _TAG_SHIFT) | (uint64_t)(uintptr_t)(ptr))
+
+/**
+ * @brief a memory region reserved by the arena
+ **/
+typedef struct _region_t {
+	void*             base;  /*!< the base address */
+	size_t            size;  /*!< the size of the region */
+	struct _region_t* next;  /*!< the next region */
+} _region_t;
+
+/**
+ * @brief the global page pool of a NUMA node
+ * @note Since the page is first touched by the thread that carves it from the arena, the page is usually
+ *       placed on the node of the allocating thread. To keep the page local, each node has its own arena regions
+ *       and the pages returned to the global pool are kept in the stack of the node the returning thread runs on.
  **/
-static _page_t* _free_list;
+typedef struct {
+	_tagged_t       batches;      /*!< the stack of free page batches */
+	pthread_mutex_t mutex;        /*!< the mutex protects the arena of this node */
+	char*           arena_begin;  /*!< the first unused page in current region */
+	char*           arena_end;    /*!< the end of current region */
+	_region_t*      regions;      /*!< all the regions reserved for this node */
+	void**          retired;      /*!< the pages whose memory has been returned to the OS */
+	size_t          num_retired;  /*!< the number of retired pages */
+	size_t          retired_cap;  /*!< the capacity of the retired page array */
+} _node_t;
+
+/**
+ * @brief the global page pool for each NUMA node
+ **/
+static _node_t _nodes[UTILS_MEMPOOL_PAGE_MAX_NUMA_NODES];
 
 /**
  * @brief the number of free pages
  **/
 static size_t _num_free_pages;
 
+/**
+ * @brief the number of pages reserved by the arena
+ **/
+static size_t _num_arena_pages;
+
 /**
  * @brief the max number of the thread pages
  * @note the default limit is 512M memory, 0x20000 pages
@@ -54,14 +110,17 @@ static size_t _max_cached_pages = 0x20000;
  **/
 static size_t _max_thread_cached_pages = 0x1000;
 
+/**
+ * @brief how we use the huge pages
+ **/
+static mempool_page_huge_page_t _huge_page = (mempool_page_huge_page_t)UTILS_MEMPOOL_PAGE_HUGE_PAGE;
+
 /**
  * @brief a thread page pool
  **/
 typedef struct _thread_page_pool_t{
 	uint32_t page_count;      /*!< how many pages in the thread pool */
-	_page_t* page_list_begin; /*!< the first page in the free list */
-	_page_t* exceeded;        /*!< the first element that exceeded the thread pool size limit */
-	_page_t* page_list_end;   /*!< the last element */
+	_page_t* page_list;       /*!< the free page list */
 	struct _thread_page_pool_t* next; /*!< the next thread page pool */
 } _thread_page_pool_t;
 
@@ -71,41 +130,125 @@ static _thread_page_pool_t* _local_page_pool_list = NULL;
 
 static int _pool_disabled = 0;
 
-pthread_mutex_t mutex;
+/**
+ * @brief get the size of each page
+ **/
+static inline size_t _get_page_size(void)
+{
+	int ret = getpagesize();
+	if(ret < 0) return 0;
+	return (size_t) ret;
+}
+
+/**
+ * @brief get the global pool for current thread
+ * @return the node
+ **/
+static inline _node_t* _get_node(void)
+{
+	return _nodes + thread_get_current_numa_node() % UTILS_MEMPOOL_PAGE_MAX_NUMA_NODES;
+}
+
+/**
+ * @brief push a batch to the global stack of the node
+ * @param node the node
+ * @param batch the batch
+ * @return nothing
+ **/
+static inline void _batch_push(_node_t* node, _batch_t* batch)
+{
+	for(;;)
+	{
+		_tagged_t old = node->batches;
+		batch->next = _TAGGED_PTR(old);
+
+		BARRIER();
+
+		if(__sync_bool_compare_and_swap(&node->batches, old, _TAGGED_NEXT(old, batch)))
+		    break;
+	}
+}
+
+/**
+ * @brief pop a batch from the global stack of the node
+ * @param node the node
+ * @return the batch or NULL if the stack is empty
+ **/
+static inline _batch_t* _batch_pop(_node_t* node)
+{
+	for(;;)
+	{
+		_tagged_t old = node->batches;
+		_batch_t* top = _TAGGED_PTR(old);
+
+		if(NULL == top) return NULL;
+
+		_batch_t* next = top->next;
+
+		BARRIER();
+
+		if(__sync_bool_compare_and_swap(&node->batches, old, _TAGGED_NEXT(old, next)))
+		    return top;
+	}
+}
 
 int mempool_page_init()
 {
-	_free_list = NULL;
+	uint32_t i;
+	memset(_nodes, 0, sizeof(_nodes));
+	for(i = 0; i < UTILS_MEMPOOL_PAGE_MAX_NUMA_NODES; i ++)
+	    if((errno = pthread_mutex_init(&_nodes[i].mutex, NULL)) != 0)
+	    {
+		    LOG_ERROR_ERRNO("Cannot initialize the page arena mutex");
+		    for(;i > 0; i --)
+		        pthread_mutex_destroy(&_nodes[i - 1].mutex);
+		    return ERROR_CODE(int);
+	    }
 	_num_free_pages = 0;
+	_num_arena_pages = 0;
 	return 0;
 }
 
 int mempool_page_finalize()
 {
-	_page_t* tmp;
-	for(;_free_list != NULL;)
+	int rc = 0;
+	uint32_t i;
+	for(i = 0; i < UTILS_MEMPOOL_PAGE_MAX_NUMA_NODES; i ++)
 	{
-		tmp = _free_list;
-		_free_list = _free_list->next;
-		__free__(tmp);
+		_node_t* node = _nodes + i;
+		for(;node->regions != NULL;)
+		{
+			_region_t* region = node->regions;
+			node->regions = region->next;
+			if(munmap(region->base, region->size) < 0)
+			{
+				LOG_ERROR_ERRNO("Cannot unmap the page arena region");
+				rc = ERROR_CODE(int);
+			}
+			free(region);
+		}
+
+		if(NULL != node->retired) free(node->retired);
+
+		if((errno = pthread_mutex_destroy(&node->mutex)) != 0)
+		{
+			LOG_ERROR_ERRNO("Cannot dispose the page arena mutex");
+			rc = ERROR_CODE(int);
+		}
 	}
+	memset(_nodes, 0, sizeof(_nodes));
 
+	/* All the pages in the thread local pools has been unmapped with the regions */
 	_thread_page_pool_t* curpool;
 	for(;NULL != _local_page_pool_list;)
 	{
 		curpool = _local_page_pool_list;
 		_local_page_pool_list = _local_page_pool_list->next;
-		_page_t* curpage;
-		for(;curpool->page_list_begin != NULL;)
-		{
-			curpage = curpool->page_list_begin;
-			curpool->page_list_begin = curpool->page_list_begin->next;
-			__free__(curpage);
-		}
 		free(curpool);
 	}
+	_local_page_pool = NULL;
 
-	return 0;
+	return rc;
 }
 
 
@@ -115,86 +258,222 @@ int mempool_page_set_free_page_limit(size_t npages)
 	return 0;
 }
 
+int mempool_page_set_huge_page(mempool_page_huge_page_t mode)
+{
+	if(mode != MEMPOOL_PAGE_HUGE_PAGE_NONE && mode != MEMPOOL_PAGE_HUGE_PAGE_TRANSPARENT && mode != MEMPOOL_PAGE_HUGE_PAGE_EXPLICIT)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_huge_page = mode;
+	return 0;
+}
+
 /**
- * @brief get the size of each page
+ * @brief reserve a new region for the node and make it the current region
+ * @note the caller should hold the node mutex
+ * @param node the node
+ * @return status code
  **/
-static inline size_t _get_page_size(void)
+static inline int _region_new(_node_t* node)
 {
-	int ret = getpagesize();
-	if(ret < 0) return 0;
-	return (size_t) ret;
+	size_t size = UTILS_MEMPOOL_PAGE_ARENA_REGION_SIZE;
+	size_t align = UTILS_MEMPOOL_PAGE_HUGE_PAGE_SIZE;
+	char* mem = (char*)MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+	if(_huge_page == MEMPOOL_PAGE_HUGE_PAGE_EXPLICIT &&
+	   MAP_FAILED == (mem = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0)))
+	    LOG_DEBUG_ERRNO("Cannot map the region from the hugetlb pool, fall back to the transparent huge page");
+#endif
+
+	if(MAP_FAILED == mem)
+	{
+		if(_huge_page == MEMPOOL_PAGE_HUGE_PAGE_NONE) align = _get_page_size();
+
+		/* Reserve one more huge page, so that we can align the region to the huge page boundary */
+		char* raw = (char*)mmap(NULL, size + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(MAP_FAILED == raw) ERROR_RETURN_LOG_ERRNO(int, "Cannot reserve the page arena region");
+
+		mem = (char*)(((uintptr_t)raw + align - 1) & ~(uintptr_t)(align - 1));
+		if(mem > raw && munmap(raw, (size_t)(mem - raw)) < 0)
+		    LOG_WARNING_ERRNO("Cannot unmap the unaligned head of the region");
+		if(raw + size + align > mem + size && munmap(mem + size, (size_t)(raw + size + align - (mem + size))) < 0)
+		    LOG_WARNING_ERRNO("Cannot unmap the unaligned tail of the region");
+
+#ifdef MADV_HUGEPAGE
+		if(_huge_page != MEMPOOL_PAGE_HUGE_PAGE_NONE && madvise(mem, size, MADV_HUGEPAGE) < 0)
+		    LOG_DEBUG_ERRNO("Cannot enable the transparent huge page for the region");
+#endif
+	}
+
+	_region_t* region = (_region_t*)malloc(sizeof(_region_t));
+	if(NULL == region)
+	{
+		munmap(mem, size);
+		ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the region descriptor");
+	}
+
+	region->base = mem;
+	region->size = size;
+	region->next = node->regions;
+	node->regions = region;
+
+	node->arena_begin = mem;
+	node->arena_end = mem + size;
+
+	__sync_fetch_and_add(&_num_arena_pages, size / _get_page_size());
+
+	LOG_DEBUG("The page arena has reserved a new region %p of %zu bytes", mem, size);
+
+	return 0;
 }
 
 /**
- * @brief allocate n contiguous pages
- * @param n the number of pages to allocate
- * @return the allocate memory
+ * @brief take a batch of pages from the arena of the node, the retired pages are used first
+ * @param node the node
+ * @param list the page list to append the pages
+ * @return the number of pages we get, or error code
  **/
-static inline void* _page_alloc(int n)
+static inline uint32_t _arena_alloc(_node_t* node, _page_t** list)
 {
-	void* ret = NULL;
-	if(posix_memalign(&ret, _get_page_size(), _get_page_size() * (size_t)n) < 0)
-	    ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate a full page");
+	uint32_t ret = 0;
+	size_t page_size = _get_page_size();
+
+	if((errno = pthread_mutex_lock(&node->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(uint32_t, "Cannot acquire the page arena mutex");
+
+	for(;ret < UTILS_MEMPOOL_PAGE_BATCH_SIZE && node->num_retired > 0; ret ++)
+	{
+		_page_t* page = (_page_t*)node->retired[-- node->num_retired];
+		page->next = *list;
+		*list = page;
+	}
+
+	if(ret == 0 && node->arena_begin >= node->arena_end && ERROR_CODE(int) == _region_new(node))
+	    ERROR_LOG_GOTO(ERR, "Cannot reserve a new region for the page arena");
+
+	for(;ret < UTILS_MEMPOOL_PAGE_BATCH_SIZE && node->arena_begin < node->arena_end; ret ++)
+	{
+		_page_t* page = (_page_t*)node->arena_begin;
+		node->arena_begin += page_size;
+		page->next = *list;
+		*list = page;
+	}
+
+	if((errno = pthread_mutex_unlock(&node->mutex)) != 0)
+	    LOG_WARNING_ERRNO("Cannot release the page arena mutex");
 
 	return ret;
+ERR:
+	pthread_mutex_unlock(&node->mutex);
+	return ERROR_CODE(uint32_t);
 }
 
-static inline _page_t* _global_alloc(void)
+/**
+ * @brief return the memory of the pages to the OS and keep the pages in the arena for later use
+ * @param node the node
+ * @param list the page list
+ * @param n the number of pages in the list
+ * @return status code
+ **/
+static inline int _arena_retire(_node_t* node, _page_t* list, size_t n)
 {
-	_page_t* claimed = NULL;
+	if((errno = pthread_mutex_lock(&node->mutex)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot acquire the page arena mutex");
 
-	/* try to claim one */
-	for(;_free_list;)
+	if(node->num_retired + n > node->retired_cap)
 	{
-		_page_t* candidate = _free_list;
-		_page_t* new_head = candidate->next;
-
-		BARRIER();
-
-		if(__sync_bool_compare_and_swap(&_free_list, candidate, new_head))
+		size_t new_cap = node->retired_cap == 0 ? UTILS_MEMPOOL_PAGE_BATCH_SIZE : node->retired_cap * 2;
+		for(;new_cap < node->num_retired + n; new_cap *= 2);
+		void** new_arr = (void**)realloc(node->retired, sizeof(void*) * new_cap);
+		if(NULL == new_arr)
 		{
-			claimed = candidate;
-			break;
+			pthread_mutex_unlock(&node->mutex);
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot resize the retired page array");
 		}
+		node->retired = new_arr;
+		node->retired_cap = new_cap;
 	}
 
-	if(NULL == claimed)
+	/* The page must not be visible to the allocation before its content has been dropped */
+	size_t page_size = _get_page_size();
+	for(;NULL != list;)
 	{
-		LOG_DEBUG("the page pool do not have page for current allocation, ask the system for a new one");
-		return (_page_t*)_page_alloc(1);
+		_page_t* page = list;
+		list = list->next;
+		if(madvise(page, page_size, MADV_DONTNEED) < 0)
+		    LOG_DEBUG_ERRNO("Cannot return the page memory to the OS");
+		node->retired[node->num_retired ++] = page;
 	}
-	else LOG_DEBUG("Use cached page %p", claimed);
 
-	return claimed;
+	if((errno = pthread_mutex_unlock(&node->mutex)) != 0)
+	    LOG_WARNING_ERRNO("Cannot release the page arena mutex");
+
+	return 0;
 }
 
-static inline int _global_dealloc(_page_t* begin, _page_t* end, size_t n)
+static inline _page_t* _global_alloc(void)
 {
-	for(;begin != NULL && _max_cached_pages <= _num_free_pages + n;)
+	_node_t* node = _get_node();
+	_batch_t* batch = _batch_pop(node);
+	uint32_t i;
+
+	/* If current node has run out of free pages, try to steal from other nodes before we reserve new memory */
+	for(i = 0; NULL == batch && i < UTILS_MEMPOOL_PAGE_MAX_NUMA_NODES; i ++)
+	    if(_nodes + i != node)
+	        batch = _batch_pop(_nodes + i);
+
+	_page_t* list = NULL;
+	uint32_t count;
+
+	if(NULL != batch)
 	{
-		LOG_DEBUG("The number of free pages is larger than the free page limit, free the page directly");
-		_page_t* tmp = begin;
-		begin = begin->next;
-		__free__(tmp);
-		n--;
+		LOG_DEBUG("Use cached page batch %p", batch);
+		__sync_fetch_and_sub(&_num_free_pages, batch->count);
+		count = batch->count;
+		list = batch->pages;
+		((_page_t*)batch)->next = list;
+		list = (_page_t*)batch;
+	}
+	else
+	{
+		LOG_DEBUG("the page pool do not have page for current allocation, carve new pages from the arena");
+		if(ERROR_CODE(uint32_t) == (count = _arena_alloc(node, &list)) || count == 0)
+		    ERROR_PTR_RETURN_LOG("Cannot allocate pages from the arena");
 	}
 
-	if(begin == NULL) return 0;
+	/* Keep the first page for the caller and the rest goes to the thread local pool */
+	_page_t* ret = list;
+	_local_page_pool->page_list = list->next;
+	_local_page_pool->page_count = count - 1;
 
-	__sync_fetch_and_add(&_num_free_pages, n);
-	BARRIER();
-	for(;;)
-	{
-		_page_t* old_head = _free_list;
-		end->next = old_head;
+	return ret;
+}
 
-		BARRIER();
+/**
+ * @brief return the pages to the global pool
+ * @param list the page list
+ * @param n the number of pages in the list
+ * @return status code
+ **/
+static inline int _global_dealloc(_page_t* list, uint32_t n)
+{
+	_node_t* node = _get_node();
 
-		if(__sync_bool_compare_and_swap(&_free_list, old_head, begin))
-		    break;
+	if(_max_cached_pages < _num_free_pages + n)
+	{
+		LOG_DEBUG("The number of free pages is larger than the free page limit, return the memory to the OS");
+		return _arena_retire(node, list, n);
 	}
 
-	LOG_DEBUG("%zu pages has been return to the global pool", n);
+	_batch_t* batch = (_batch_t*)list;
+	batch->pages = list->next;
+	batch->count = n;
+
+	__sync_fetch_and_add(&_num_free_pages, n);
+
+	_batch_push(node, batch);
+
+	LOG_DEBUG("%u pages has been return to the global pool", n);
 
 	return 0;
 }
@@ -205,10 +484,11 @@ static inline int _check_local_pool(void)
 		_local_page_pool = (_thread_page_pool_t*)malloc(sizeof(_thread_page_pool_t));
 		if(NULL == _local_page_pool)
 		    ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate the thread local page pool");
-		_local_page_pool->page_list_begin = _local_page_pool->page_list_end = _local_page_pool->exceeded = NULL;
+		_local_page_pool->page_list = NULL;
 		_local_page_pool->page_count = 0;
-		_local_page_pool->next = _local_page_pool_list;
-		_local_page_pool_list = _local_page_pool;
+		do {
+			_local_page_pool->next = _local_page_pool_list;
+		} while(!__sync_bool_compare_and_swap(&_local_page_pool_list, _local_page_pool->next, _local_page_pool));
 		LOG_DEBUG("Thread local page pool has been initialized");
 	}
 
@@ -224,24 +504,14 @@ void* mempool_page_alloc()
 	if(_check_local_pool() == ERROR_CODE(int))
 	    ERROR_PTR_RETURN_LOG("cannot initialize the local pool");
 
-	_page_t* ret = NULL;
-
-	if(_local_page_pool->page_list_begin != NULL)
-	{
-		LOG_DEBUG("Reuse the cached page");
-		ret = _local_page_pool->page_list_begin;
-		_local_page_pool->page_list_begin = _local_page_pool->page_list_begin->next;
-		_local_page_pool->page_count --;
-		if(_local_page_pool->exceeded != NULL)
-		    _local_page_pool->exceeded = _local_page_pool->exceeded->next;
-		if(_local_page_pool->page_list_begin != NULL)
-		    _local_page_pool->page_list_begin->prev = NULL;
-		else
-		    _local_page_pool->page_list_end = NULL;
-	}
+	_page_t* ret = _local_page_pool->page_list;
 
 	if(NULL == ret) return _global_alloc();
 
+	LOG_DEBUG("Reuse the cached page");
+	_local_page_pool->page_list = ret->next;
+	_local_page_pool->page_count --;
+
 	return ret;
 }
 
@@ -258,38 +528,77 @@ int mempool_page_dealloc(void* mem)
 
 	_page_t* page = (_page_t*)mem;
 
-	page->next = _local_page_pool->page_list_begin;
-	page->prev = NULL;
-	if(_local_page_pool->page_list_begin != NULL)
-	    _local_page_pool->page_list_begin->prev = page;
-	_local_page_pool->page_list_begin = page;
-	if(_local_page_pool->page_list_end == NULL) _local_page_pool->page_list_end = page;
-
-
-	if(_local_page_pool->page_count ++ == _max_thread_cached_pages)
-	    _local_page_pool->exceeded = _local_page_pool->page_list_end;
-	else if(_local_page_pool->exceeded != NULL)
-	    _local_page_pool->exceeded = _local_page_pool->exceeded->prev;
+	page->next = _local_page_pool->page_list;
+	_local_page_pool->page_list = page;
 
 	int rc = 0;
 
-	if(_local_page_pool->page_count >= _max_thread_cached_pages * 2)
+	if(++ _local_page_pool->page_count >= _max_thread_cached_pages * 2)
 	{
-		/* Because the exceeded page may be disposed, so make sure we saved the value first */
-		_page_t* end = _local_page_pool->exceeded->prev;
+		/* Move the pages exceed the thread limit to the global pool batch by batch */
+		for(;_local_page_pool->page_count > _max_thread_cached_pages;)
+		{
+			uint32_t n = _local_page_pool->page_count - (uint32_t)_max_thread_cached_pages;
+			if(n > UTILS_MEMPOOL_PAGE_BATCH_SIZE) n = UTILS_MEMPOOL_PAGE_BATCH_SIZE;
 
-		rc = _global_dealloc(_local_page_pool->exceeded, _local_page_pool->page_list_end, _local_page_pool->page_count - _max_thread_cached_pages);
-		_local_page_pool->page_list_end = end;
-		_local_page_pool->page_list_end->next = NULL;
+			_page_t* begin = _local_page_pool->page_list;
+			_page_t* end = begin;
+			uint32_t i;
+			for(i = 1; i < n; i ++) end = end->next;
 
-		_local_page_pool->exceeded = NULL;
-		_local_page_pool->page_count = (uint32_t)_max_thread_cached_pages;
-	}
+			_local_page_pool->page_list = end->next;
+			_local_page_pool->page_count -= n;
+			end->next = NULL;
 
+			if(ERROR_CODE(int) == _global_dealloc(begin, n))
+			    rc = ERROR_CODE(int);
+		}
+	}
 
 	return rc;
 }
 
+void* mempool_page_alloc_account(mempool_account_t* account)
+{
+	void* ret = mempool_page_alloc();
+
+	if(NULL != ret) mempool_account_charge(account, _get_page_size());
+
+	return ret;
+}
+
+int mempool_page_dealloc_account(mempool_account_t* account, void* page)
+{
+	mempool_account_uncharge(account, _get_page_size());
+
+	return mempool_page_dealloc(page);
+}
+
+int mempool_page_get_stat(mempool_page_stat_t* buf)
+{
+	if(NULL == buf) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	buf->free_pages = _num_free_pages;
+	buf->max_free_pages = _max_cached_pages;
+	buf->cached_pages = 0;
+	buf->num_thread_pools = 0;
+	buf->arena_pages = _num_arena_pages;
+	buf->retired_pages = 0;
+
+	uint32_t i;
+	for(i = 0; i < UTILS_MEMPOOL_PAGE_MAX_NUMA_NODES; i ++)
+	    buf->retired_pages += _nodes[i].num_retired;
+
+	const _thread_page_pool_t* pool;
+	for(pool = _local_page_pool_list; NULL != pool; pool = pool->next)
+	{
+		buf->cached_pages += pool->page_count;
+		buf->num_thread_pools ++;
+	}
+
+	return 0;
+}
+
 void mempool_page_disable(int val)
 {
 	_pool_disabled = val;
@@ -1,6 +1,7 @@
 /**
  * Copyright (C) 2017, Hao Hou
  **/
+#define _GNU_SOURCE
 #include <constants.h>
 
 #include <stdlib.h>
@@ -13,7 +14,9 @@
 #include <stdarg.h>
 
 #ifdef __LINUX__
+#include <sched.h>
 #include <sys/prctl.h>
+#include <sys/syscall.h>
 #endif
 
 #include <arch/arch.h>
@@ -36,6 +39,26 @@ static const char* _type_name[] = {
 	NULL
 };
 
+/**
+ * @brief the CPU affinity policy for a type of thread
+ **/
+typedef struct {
+	char*     spec;    /*!< the CPU list string */
+	uint32_t  count;   /*!< the number of CPUs in the list */
+	uint32_t  next;    /*!< the index of the CPU the next thread should be pinned to */
+	uint32_t* cpus;    /*!< the CPU ids */
+} _affinity_policy_t;
+
+/**
+ * @brief the affinity policy for each type of thread
+ **/
+static _affinity_policy_t _affinity[THREAD_NUM_TYPES];
+
+/**
+ * @brief the NUMA node current thread is running on
+ **/
+static __thread uint32_t _numa_node = ERROR_CODE(uint32_t);
+
 /**
  * @brief the represent a cleanup hook
  **/
@@ -56,6 +79,7 @@ struct _thread_t {
 	thread_type_t type;        /*!< the type of this thread */
 #endif
 	void*         arg;         /*!< the thread argument */
+	uint32_t      cpu;         /*!< the CPU this thread should be pinned to, error code if the thread is not pinned */
 	_cleanup_hook_t* hooks;    /*!< the cleanup hooks */
 #ifdef STACK_SIZE
 	char             mem[STACK_SIZE * 2 + sizeof(thread_stack_t)]; /*!< The memory used for task */
@@ -300,6 +324,79 @@ uint32_t thread_get_id()
 	return _get_thread_id();
 }
 
+/**
+ * @brief parse the CPU list string, e.g. "0-3,8,10-11"
+ * @param spec the CPU list string
+ * @param buf the buffer for the CPU ids, NULL if we only want to count the CPUs
+ * @return the number of CPUs in the list or error code
+ **/
+static inline int _parse_cpu_list(const char* spec, uint32_t* buf)
+{
+	int ret = 0;
+	const char* ptr = spec;
+	for(;;)
+	{
+		char* end;
+		for(;*ptr == ' ' || *ptr == '\t'; ptr ++);
+		if(*ptr < '0' || *ptr > '9') ERROR_RETURN_LOG(int, "Invalid CPU list %s", spec);
+		unsigned long first = strtoul(ptr, &end, 10), last = first;
+		ptr = end;
+
+		if(*ptr == '-')
+		{
+			ptr ++;
+			if(*ptr < '0' || *ptr > '9') ERROR_RETURN_LOG(int, "Invalid CPU list %s", spec);
+			last = strtoul(ptr, &end, 10);
+			ptr = end;
+		}
+
+		if(last < first || last >= UTILS_THREAD_MAX_CPUS) ERROR_RETURN_LOG(int, "Invalid CPU range %lu-%lu", first, last);
+
+		/* The same CPU may be listed more than once, so the range limit doesn't bound the size of the list */
+		if((unsigned long)ret + (last - first) >= UTILS_THREAD_MAX_CPUS)
+		    ERROR_RETURN_LOG(int, "Too many CPUs in the CPU list %s", spec);
+
+		for(;first <= last; first ++, ret ++)
+		    if(NULL != buf) buf[ret] = (uint32_t)first;
+
+		for(;*ptr == ' ' || *ptr == '\t'; ptr ++);
+		if(*ptr == 0) break;
+		if(*ptr != ',') ERROR_RETURN_LOG(int, "Invalid CPU list %s", spec);
+		ptr ++;
+	}
+
+	return ret;
+}
+
+/**
+ * @brief pin current thread to the given set of CPUs
+ * @param cpus the CPU ids
+ * @param count the number of CPUs
+ * @return status code
+ **/
+static inline int _set_current_affinity(const uint32_t* cpus, uint32_t count)
+{
+	/* The thread may be moved to another node, so the cached node id isn't valid anymore */
+	_numa_node = ERROR_CODE(uint32_t);
+#ifdef __LINUX__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	uint32_t i;
+	for(i = 0; i < count; i ++)
+	    CPU_SET(cpus[i], &set);
+
+	if((errno = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0)
+	    ERROR_RETURN_LOG_ERRNO(int, "Cannot set the CPU affinity of current thread");
+
+	return 0;
+#else
+	(void)cpus;
+	(void)count;
+	LOG_WARNING("Thread affinity is not supported on this platform, ignored");
+	return 0;
+#endif
+}
+
 static void* _thread_main(void* data)
 {
 #ifdef STACK_SIZE
@@ -313,6 +410,15 @@ static void* _thread_main(void* data)
 #endif
 
 	thread_t* thread = (thread_t*)data;
+
+	if(thread->cpu != ERROR_CODE(uint32_t))
+	{
+		if(ERROR_CODE(int) == _set_current_affinity(&thread->cpu, 1))
+		    LOG_WARNING("Cannot pin the thread to CPU %u", thread->cpu);
+		else
+		    LOG_DEBUG("The thread has been pinned to CPU %u", thread->cpu);
+	}
+
 	void* ret = thread->main(thread->arg);
 
 	_cleanup_hook_t* ptr;
@@ -394,6 +500,14 @@ thread_t* thread_new(thread_main_t main, void* data, thread_type_t type)
 	ret->main = main;
 	ret->arg  = data;
 	ret->hooks = NULL;
+	ret->cpu  = ERROR_CODE(uint32_t);
+
+	if(type != THREAD_TYPE_GENERIC)
+	{
+		_affinity_policy_t* policy = _affinity + __builtin_ctz((unsigned)type);
+		if(policy->count > 0)
+		    ret->cpu = policy->cpus[__sync_fetch_and_add(&policy->next, 1) % policy->count];
+	}
 #ifdef STACK_SIZE
 	uintptr_t offset = (STACK_SIZE - ((uintptr_t)ret->mem) % STACK_SIZE) % STACK_SIZE;
 	if(offset >= sizeof(thread_stack_t))
@@ -551,3 +665,84 @@ int thread_start_with_aligned_stack(int (*main)(int argc, char** argv), int argc
 	return arch_switch_stack(th.stack->base, STACK_SIZE, main, argc, argv);
 }
 #endif
+
+int thread_set_affinity_policy(thread_type_t type, const char* cpus)
+{
+	if(type == THREAD_TYPE_GENERIC || type >= THREAD_TYPE_MAX || (type & (type - 1)) != 0)
+	    ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	_affinity_policy_t* policy = _affinity + __builtin_ctz((unsigned)type);
+	_affinity_policy_t new_policy = {};
+
+	if(NULL != cpus && cpus[0] != 0)
+	{
+		int count = _parse_cpu_list(cpus, NULL);
+		if(ERROR_CODE(int) == count) ERROR_RETURN_LOG(int, "Invalid CPU list");
+
+		if(NULL == (new_policy.cpus = (uint32_t*)malloc(sizeof(uint32_t) * (size_t)count)))
+		    ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the CPU list");
+
+		if(NULL == (new_policy.spec = strdup(cpus)))
+		{
+			free(new_policy.cpus);
+			ERROR_RETURN_LOG_ERRNO(int, "Cannot duplicate the CPU list string");
+		}
+
+		_parse_cpu_list(cpus, new_policy.cpus);
+		new_policy.count = (uint32_t)count;
+	}
+
+	if(NULL != policy->spec) free(policy->spec);
+	if(NULL != policy->cpus) free(policy->cpus);
+
+	*policy = new_policy;
+
+	return 0;
+}
+
+const char* thread_get_affinity_policy(thread_type_t type)
+{
+	if(type == THREAD_TYPE_GENERIC || type >= THREAD_TYPE_MAX || (type & (type - 1)) != 0)
+	    ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	const _affinity_policy_t* policy = _affinity + __builtin_ctz((unsigned)type);
+
+	return NULL == policy->spec ? "" : policy->spec;
+}
+
+int thread_set_current_affinity(const char* cpus)
+{
+	if(NULL == cpus) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	int count = _parse_cpu_list(cpus, NULL);
+	if(ERROR_CODE(int) == count) ERROR_RETURN_LOG(int, "Invalid CPU list");
+
+	uint32_t* buf = (uint32_t*)malloc(sizeof(uint32_t) * (size_t)count);
+	if(NULL == buf) ERROR_RETURN_LOG_ERRNO(int, "Cannot allocate memory for the CPU list");
+
+	_parse_cpu_list(cpus, buf);
+
+	int rc = _set_current_affinity(buf, (uint32_t)count);
+
+	free(buf);
+
+	return rc;
+}
+
+uint32_t thread_get_current_numa_node(void)
+{
+	if(PREDICT_TRUE(_numa_node != ERROR_CODE(uint32_t)))
+	    return _numa_node;
+#if defined(__LINUX__) && defined(SYS_getcpu)
+	unsigned cpu, node;
+	if(syscall(SYS_getcpu, &cpu, &node, NULL) < 0)
+	{
+		LOG_WARNING_ERRNO("Cannot get the NUMA node of current thread, assume it's node 0");
+		node = 0;
+	}
+	_numa_node = node;
+#else
+	_numa_node = 0;
+#endif
+	return _numa_node;
+}
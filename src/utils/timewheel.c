@@ -0,0 +1,290 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <error.h>
+
+#include <utils/timewheel.h>
+#include <utils/log.h>
+#include <utils/static_assertion.h>
+
+/**
+ * @brief the number of bits of the slot index in each level
+ **/
+#define _SLOT_BITS 6
+
+/**
+ * @brief the number of slots in each level
+ **/
+#define _SLOTS_PER_LEVEL (1u << _SLOT_BITS)
+
+/**
+ * @brief the mask of the slot index
+ **/
+#define _SLOT_MASK ((uint64_t)(_SLOTS_PER_LEVEL - 1))
+
+/**
+ * @brief the number of levels, with 6 bits per level, the wheel covers 2^24 ticks, which is about
+ *        194 days if the tick is a second. The timer beyond that will be placed in the last slot and
+ *        revisited when it gets cascaded.
+ **/
+#define _LEVELS 4
+
+/**
+ * @brief the total number of slots
+ **/
+#define _NSLOTS (_SLOTS_PER_LEVEL * _LEVELS)
+
+/**
+ * @brief the pseudo slot that holds the timers which are being expired
+ **/
+#define _EXPIRING _NSLOTS
+
+/**
+ * @brief the nil pointer of the slot list
+ **/
+#define _NIL ERROR_CODE(uint32_t)
+
+/**
+ * @brief the maximum distance between the expiration time and current time
+ **/
+#define _MAX_DELTA ((((uint64_t)1) << (_SLOT_BITS * _LEVELS)) - 1)
+
+/**
+ * @brief a timer in the wheel
+ **/
+typedef struct {
+	time_t   expire;    /*!< when the timer expires */
+	uint32_t prev;      /*!< the previous timer in the same slot */
+	uint32_t next;      /*!< the next timer in the same slot */
+	uint32_t slot;      /*!< which slot this timer is in, _NIL if it's not armed */
+} _node_t;
+
+/**
+ * @brief the actual data structure of the timing wheel
+ **/
+struct _timewheel_t {
+	uint32_t capacity;               /*!< the number of timers */
+	uint32_t size;                   /*!< the number of armed timers */
+	time_t   current;                /*!< the next tick that hasn't been processed yet */
+	uint32_t head[_NSLOTS + 1];      /*!< the list heads of each slot, plus the expiring list */
+	_node_t  node[0];                /*!< the timers */
+};
+STATIC_ASSERTION_LAST(timewheel_t, node);
+STATIC_ASSERTION_SIZE(timewheel_t, node, 0);
+
+timewheel_t* timewheel_new(uint32_t capacity, time_t now)
+{
+	if(capacity == 0 || capacity == _NIL) ERROR_PTR_RETURN_LOG("Invalid arguments");
+
+	timewheel_t* ret = (timewheel_t*)malloc(sizeof(timewheel_t) + sizeof(_node_t) * capacity);
+	if(NULL == ret) ERROR_PTR_RETURN_LOG_ERRNO("Cannot allocate memory for the timing wheel");
+
+	ret->capacity = capacity;
+	ret->size = 0;
+	ret->current = now;
+
+	uint32_t i;
+	for(i = 0; i <= _NSLOTS; i ++)
+	    ret->head[i] = _NIL;
+
+	for(i = 0; i < capacity; i ++)
+	    ret->node[i].slot = _NIL;
+
+	return ret;
+}
+
+int timewheel_free(timewheel_t* wheel)
+{
+	if(NULL == wheel) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	free(wheel);
+
+	return 0;
+}
+
+/**
+ * @brief compute which slot the timer should be placed in based on the current time
+ * @param wheel the timing wheel
+ * @param expire the expiration time
+ * @return the slot index
+ **/
+static inline uint32_t _slot_of(const timewheel_t* wheel, time_t expire)
+{
+	if(expire < wheel->current) expire = wheel->current;
+
+	uint64_t delta = (uint64_t)(expire - wheel->current);
+	if(delta > _MAX_DELTA)
+	{
+		delta = _MAX_DELTA;
+		expire = wheel->current + (time_t)_MAX_DELTA;
+	}
+
+	uint32_t level;
+	for(level = 0; level < _LEVELS - 1 && delta >> (_SLOT_BITS * (level + 1)); level ++);
+
+	return level * _SLOTS_PER_LEVEL + (uint32_t)(((uint64_t)expire >> (_SLOT_BITS * level)) & _SLOT_MASK);
+}
+
+static inline void _link(timewheel_t* wheel, uint32_t id, uint32_t slot)
+{
+	_node_t* node = wheel->node + id;
+	node->slot = slot;
+	node->prev = _NIL;
+	node->next = wheel->head[slot];
+	if(node->next != _NIL)
+	    wheel->node[node->next].prev = id;
+	wheel->head[slot] = id;
+}
+
+static inline void _unlink(timewheel_t* wheel, uint32_t id)
+{
+	_node_t* node = wheel->node + id;
+	if(node->prev != _NIL)
+	    wheel->node[node->prev].next = node->next;
+	else
+	    wheel->head[node->slot] = node->next;
+
+	if(node->next != _NIL)
+	    wheel->node[node->next].prev = node->prev;
+
+	node->slot = _NIL;
+}
+
+int timewheel_arm(timewheel_t* wheel, uint32_t id, time_t expire)
+{
+	if(NULL == wheel || id >= wheel->capacity) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if(wheel->node[id].slot != _NIL)
+	    _unlink(wheel, id);
+	else
+	    wheel->size ++;
+
+	wheel->node[id].expire = expire;
+	_link(wheel, id, _slot_of(wheel, expire));
+
+	return 0;
+}
+
+int timewheel_cancel(timewheel_t* wheel, uint32_t id)
+{
+	if(NULL == wheel || id >= wheel->capacity) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if(wheel->node[id].slot == _NIL) return 0;
+
+	_unlink(wheel, id);
+	wheel->size --;
+
+	return 0;
+}
+
+int timewheel_armed(const timewheel_t* wheel, uint32_t id)
+{
+	if(NULL == wheel || id >= wheel->capacity) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	return wheel->node[id].slot != _NIL;
+}
+
+uint32_t timewheel_size(const timewheel_t* wheel)
+{
+	if(NULL == wheel) ERROR_RETURN_LOG(uint32_t, "Invalid arguments");
+
+	return wheel->size;
+}
+
+int timewheel_next_expire(const timewheel_t* wheel, time_t* result)
+{
+	if(NULL == wheel || NULL == result) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	if(wheel->size == 0) return 0;
+
+	/* Only the slots before the next cascade are exact, after that the timers in higher level may move down */
+	uint32_t i;
+	for(i = 0; i < _SLOTS_PER_LEVEL; i ++)
+	{
+		time_t tick = wheel->current + (time_t)i;
+		if(i > 0 && ((uint64_t)tick & _SLOT_MASK) == 0) break;
+		if(wheel->head[(uint64_t)tick & _SLOT_MASK] != _NIL)
+		    break;
+	}
+
+	*result = wheel->current + (time_t)i;
+
+	return 1;
+}
+
+/**
+ * @brief move all the timers in the slot of the given level down to the lower levels
+ * @param wheel the timing wheel
+ * @param level the level
+ * @return nothing
+ **/
+static inline void _cascade(timewheel_t* wheel, uint32_t level)
+{
+	uint32_t slot = level * _SLOTS_PER_LEVEL + (uint32_t)(((uint64_t)wheel->current >> (_SLOT_BITS * level)) & _SLOT_MASK);
+	uint32_t id = wheel->head[slot];
+	wheel->head[slot] = _NIL;
+
+	while(id != _NIL)
+	{
+		uint32_t next = wheel->node[id].next;
+		_link(wheel, id, _slot_of(wheel, wheel->node[id].expire));
+		id = next;
+	}
+}
+
+int timewheel_advance(timewheel_t* wheel, time_t now, timewheel_expire_func_t func, void* data)
+{
+	if(NULL == wheel || NULL == func) ERROR_RETURN_LOG(int, "Invalid arguments");
+
+	int ret = 0;
+
+	while(wheel->size > 0 && wheel->current <= now)
+	{
+		time_t tick = wheel->current;
+
+		/* Detach the slot first, so that the timers re-armed by the callback never go back to the list we are walking */
+		uint32_t slot = (uint32_t)((uint64_t)tick & _SLOT_MASK);
+		uint32_t id;
+		for(id = wheel->head[slot]; id != _NIL; id = wheel->node[id].next)
+		    wheel->node[id].slot = _EXPIRING;
+		wheel->head[_EXPIRING] = wheel->head[slot];
+		wheel->head[slot] = _NIL;
+
+		wheel->current = tick + 1;
+
+		/* Once we reach a new round of the lower level, move the timers in the corresponding higher level slot down,
+		 * so that the lowest level always holds all the timers before the next round */
+		uint32_t level;
+		for(level = 1; level < _LEVELS && (((uint64_t)wheel->current >> (_SLOT_BITS * (level - 1))) & _SLOT_MASK) == 0; level ++)
+		    _cascade(wheel, level);
+
+		while(_NIL != (id = wheel->head[_EXPIRING]))
+		{
+			_unlink(wheel, id);
+
+			if(wheel->node[id].expire > tick)
+			{
+				/* This is the timer that is too far to fit the wheel at the time it's armed */
+				_link(wheel, id, _slot_of(wheel, wheel->node[id].expire));
+				continue;
+			}
+
+			wheel->size --;
+			ret ++;
+
+			if(ERROR_CODE(int) == func(id, data))
+			    LOG_WARNING("The timer expiration callback returns an error, timer id = %u", id);
+		}
+	}
+
+	/* Nothing is in the wheel, so we can simply jump to the current time */
+	if(wheel->size == 0 && wheel->current <= now)
+	    wheel->current = now + 1;
+
+	return ret;
+}
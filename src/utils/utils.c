@@ -6,11 +6,13 @@
 #include <utils/utils.h>
 #include <utils/log.h>
 #include <utils/mempool/page.h>
+#include <utils/mempool/account.h>
 #include <utils/init.h>
 
 INIT_VEC(modules) = {
 	INIT_MODULE(log),
-	INIT_MODULE(mempool_page)
+	INIT_MODULE(mempool_page),
+	INIT_MODULE(mempool_account)
 };
 
 int utils_init()
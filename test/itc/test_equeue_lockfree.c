@@ -0,0 +1,161 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+#include <testenv.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define NTHREADS 16
+#define NEVENTS  10000
+
+pthread_t T[NTHREADS];
+itc_equeue_token_t sched_token;
+static volatile uint32_t ready = 0;
+
+void* thread_main(void* d)
+{
+	uintptr_t id = (uintptr_t)d;
+	uintptr_t i;
+	itc_equeue_token_t token = itc_equeue_module_token(1, ITC_EQUEUE_EVENT_TYPE_IO);
+	if(ERROR_CODE(itc_equeue_token_t) == token) return (void*)-1;
+
+	__sync_fetch_and_add(&ready, 1);
+
+	/* The producers are much faster than the consumer, so the ring will be full and the producers get blocked */
+	for(i = 0; i < NEVENTS; i ++)
+	{
+		itc_equeue_event_t e = {
+			.type = ITC_EQUEUE_EVENT_TYPE_IO,
+			.io = {
+				.in  = (itc_module_pipe_t*)(id * NEVENTS + i + 1),
+				.out = (itc_module_pipe_t*)(id + 1)
+			}
+		};
+
+		if(ERROR_CODE(int) == itc_equeue_put(token, e))
+		    return (void*)-1;
+	}
+
+	return NULL;
+}
+
+static int interrupt_count = 0;
+
+static itc_equeue_event_mask_t _interrupt(void* data)
+{
+	(void)data;
+	interrupt_count ++;
+	itc_equeue_event_mask_t mask = ITC_EQUEUE_EVENT_MASK_NONE;
+	ITC_EQUEUE_EVENT_MASK_ADD(mask, ITC_EQUEUE_EVENT_TYPE_TASK);
+	return mask;
+}
+
+static void* _interrupt_main(void* data)
+{
+	int* killed = (int*)data;
+	usleep(100000);
+	*killed = 1;
+	itc_equeue_wait_interrupt();
+	return NULL;
+}
+
+int test_mode_locked(void)
+{
+	ASSERT_RETOK(itc_equeue_token_t, sched_token = itc_equeue_scheduler_token(), CLEANUP_NOP);
+	ASSERT(ERROR_CODE(int) == itc_equeue_set_lock_free(0), CLEANUP_NOP);
+
+	lang_prop_value_t value = lang_prop_get("itc.equeue.lock_free");
+	ASSERT(value.type == LANG_PROP_TYPE_INTEGER, CLEANUP_NOP);
+	ASSERT(value.num == 1, CLEANUP_NOP);
+
+	return 0;
+}
+
+int test_multi_producer(void)
+{
+	static uintptr_t last[NTHREADS];
+	static int seen[NTHREADS * NEVENTS];
+	uintptr_t i;
+	itc_equeue_event_mask_t mask = ITC_EQUEUE_EVENT_MASK_NONE;
+	ITC_EQUEUE_EVENT_MASK_ADD(mask, ITC_EQUEUE_EVENT_TYPE_IO);
+
+	for(i = 0; i < NTHREADS; i ++)
+	    ASSERT_OK(pthread_create(T + i, NULL, thread_main, (void*)i), CLEANUP_NOP);
+
+	for(;ready < NTHREADS; usleep(1000));
+
+	for(i = 0; i < NTHREADS * NEVENTS;)
+	{
+		itc_equeue_event_t buf[64];
+		ASSERT_OK(itc_equeue_wait(sched_token, NULL, NULL), CLEANUP_NOP);
+		uint32_t n = itc_equeue_take(sched_token, mask, buf, sizeof(buf) / sizeof(buf[0]));
+		ASSERT_RETOK(uint32_t, n, CLEANUP_NOP);
+		ASSERT(n > 0, CLEANUP_NOP);
+
+		uint32_t j;
+		for(j = 0; j < n; j ++, i ++)
+		{
+			uintptr_t val = (uintptr_t)buf[j].io.in;
+			uintptr_t tid = (uintptr_t)buf[j].io.out - 1;
+			ASSERT(tid < NTHREADS, CLEANUP_NOP);
+			ASSERT(val > 0 && val <= NTHREADS * NEVENTS, CLEANUP_NOP);
+			ASSERT((val - 1) / NEVENTS == tid, CLEANUP_NOP);
+			ASSERT(seen[val - 1] == 0, CLEANUP_NOP);
+			/* The events from the same producer should be in order */
+			ASSERT(last[tid] < val, CLEANUP_NOP);
+			seen[val - 1] = 1;
+			last[tid] = val;
+		}
+	}
+
+	ASSERT(itc_equeue_empty(sched_token) == 1, CLEANUP_NOP);
+
+	for(i = 0; i < NTHREADS; i ++)
+	{
+		void* ret;
+		ASSERT_OK(pthread_join(T[i], &ret), CLEANUP_NOP);
+		ASSERT(NULL == ret, CLEANUP_NOP);
+	}
+
+	return 0;
+}
+
+int test_interrupt(void)
+{
+	int killed = 0;
+	pthread_t thread;
+	itc_equeue_wait_interrupt_t interrupt = {
+		.func = _interrupt,
+		.data = NULL
+	};
+
+	ASSERT_OK(pthread_create(&thread, NULL, _interrupt_main, &killed), CLEANUP_NOP);
+	ASSERT_OK(itc_equeue_wait(sched_token, &killed, &interrupt), CLEANUP_NOP);
+	ASSERT(killed == 1, CLEANUP_NOP);
+	ASSERT(interrupt_count >= 1, CLEANUP_NOP);
+	ASSERT_OK(pthread_join(thread, NULL), CLEANUP_NOP);
+
+	return 0;
+}
+
+int setup(void)
+{
+	ASSERT_OK(itc_equeue_set_lock_free(1), CLEANUP_NOP);
+	return 0;
+}
+
+int teardown(void)
+{
+	int i;
+	/* One for each producer and one for the interrupt thread */
+	for(i = 0; i < NTHREADS + 1; i ++)
+	    expected_memory_leakage();
+	return 0;
+}
+
+TEST_LIST_BEGIN
+    TEST_CASE(test_mode_locked),
+    TEST_CASE(test_multi_producer),
+    TEST_CASE(test_interrupt)
+TEST_LIST_END;
@@ -0,0 +1,111 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+#include <testenv.h>
+#include <utils/mempool/page.h>
+#include <itc/module_types.h>
+#include <module/mem/api.h>
+
+static int _num_freed = 0;
+
+static int _buffer_free(void* buffer, void* data)
+{
+	(void)buffer;
+	_num_freed += (int)(uintptr_t)data;
+	return 0;
+}
+
+static int _cntl(itc_module_pipe_t* pipe, uint32_t opcode, ...)
+{
+	itc_module_type_t mod = itc_modtab_get_module_type_from_path("pipe.mem");
+	va_list ap;
+	va_start(ap, opcode);
+	int rc = itc_module_pipe_cntl(pipe, RUNTIME_API_PIPE_CNTL_MOD_OPCODE((uint32_t)mod, opcode), ap);
+	va_end(ap);
+	return rc;
+}
+
+int zero_copy(void)
+{
+	itc_module_type_t mod = itc_modtab_get_module_type_from_path("pipe.mem");
+	itc_module_pipe_param_t param = {
+		.input_flags = RUNTIME_API_PIPE_INPUT,
+		.output_flags = RUNTIME_API_PIPE_OUTPUT,
+		.args = NULL
+	};
+	itc_module_pipe_t *out_a = NULL, *in_a = NULL, *out_b = NULL, *in_b = NULL;
+	static char buffer[] = "donated buffer|";
+	char* page = NULL;
+	int accepted = 0;
+	int rc = ERROR_CODE(int);
+
+	ASSERT_OK(itc_module_pipe_allocate(mod, 0, param, &out_a, &in_a), goto ERR);
+	ASSERT_OK(itc_module_pipe_allocate(mod, 0, param, &out_b, &in_b), goto ERR);
+
+	ASSERT(6 == itc_module_pipe_write("hello|", 6, out_a), goto ERR);
+
+	ASSERT_PTR(page = (char*)mempool_page_alloc(), goto ERR);
+	memcpy(page, "donated page|", 13);
+	ASSERT_OK(_cntl(out_a, MODULE_MEM_CNTL_WRITE_PAGE, page, (size_t)13, &accepted), goto ERR);
+	ASSERT(accepted == 1, goto ERR);
+	page = NULL;
+
+	accepted = 0;
+	ASSERT_OK(_cntl(out_a, MODULE_MEM_CNTL_WRITE_BUFFER, buffer, sizeof(buffer) - 1, _buffer_free, (void*)1, &accepted), goto ERR);
+	ASSERT(accepted == 1, goto ERR);
+
+	ASSERT(4 == itc_module_pipe_write("tail", 4, out_a), goto ERR);
+	ASSERT_OK(itc_module_pipe_deallocate(out_a), goto ERR);
+	out_a = NULL;
+
+	/* Consume some bytes, and the remaining data should be moved */
+	char buf[1024];
+	ASSERT(3 == itc_module_pipe_read(buf, 3, in_a), goto ERR);
+	ASSERT(0 == memcmp(buf, "hel", 3), goto ERR);
+
+	void* source = NULL;
+	size_t moved = 0;
+	ASSERT_OK(_cntl(in_a, MODULE_MEM_CNTL_GET_BUFFER, &source), goto ERR);
+	ASSERT_PTR(source, goto ERR);
+	ASSERT(1 == itc_module_pipe_write(">", 1, out_b), goto ERR);
+	ASSERT_OK(_cntl(out_b, MODULE_MEM_CNTL_MOVE, source, &moved), goto ERR);
+	ASSERT(moved == 3 + 13 + sizeof(buffer) - 1 + 4, goto ERR);
+	ASSERT(1 == itc_module_pipe_write("<", 1, out_b), goto ERR);
+
+	/* All the data of the input pipe has been moved */
+	ASSERT(0 == itc_module_pipe_read(buf, sizeof(buf), in_a), goto ERR);
+	ASSERT_OK(itc_module_pipe_deallocate(in_a), goto ERR);
+	in_a = NULL;
+	ASSERT(_num_freed == 0, goto ERR);
+
+	ASSERT_OK(itc_module_pipe_deallocate(out_b), goto ERR);
+	out_b = NULL;
+
+	static const char expected[] = ">lo|donated page|donated buffer|tail<";
+	size_t size = 0, rd;
+	while(0 < (rd = itc_module_pipe_read(buf + size, sizeof(buf) - size, in_b)))
+	    size += rd;
+	ASSERT(size == sizeof(expected) - 1, goto ERR);
+	ASSERT(0 == memcmp(buf, expected, size), goto ERR);
+
+	ASSERT_OK(itc_module_pipe_deallocate(in_b), goto ERR);
+	in_b = NULL;
+	ASSERT(_num_freed == 1, goto ERR);
+
+	rc = 0;
+ERR:
+	if(NULL != page) mempool_page_dealloc(page);
+	if(NULL != out_a) itc_module_pipe_deallocate(out_a);
+	if(NULL != in_a) itc_module_pipe_deallocate(in_a);
+	if(NULL != out_b) itc_module_pipe_deallocate(out_b);
+	if(NULL != in_b) itc_module_pipe_deallocate(in_b);
+	return rc;
+}
+
+DEFAULT_SETUP;
+DEFAULT_TEARDOWN;
+
+TEST_LIST_BEGIN
+    TEST_CASE(zero_copy)
+TEST_LIST_END;
@@ -6,12 +6,14 @@
 #include <stdlib.h>
 #include <testenv.h>
 #include <module/tcp/async.h>
+#include <os/os.h>
 #include <pthread.h>
 #ifdef __LINUX__
 #include <sys/eventfd.h>
 #endif
 #include <unistd.h>
 #include <errno.h>
+#include <sys/socket.h>
 /**
  * @brief a mocked TCP connection
  **/
@@ -564,6 +566,244 @@ int parallel_write(void)
 	return 0;
 }
 
+/** @brief the data exposed by the iov callback */
+static const char _gather_data[] = "abcdefghi";
+/** @brief the segments of the gathered data, which simulates the pending pages */
+static const size_t _gather_seg[] = {0, 3, 7, sizeof(_gather_data) - 1};
+/** @brief how many bytes has been consumed */
+static size_t _gather_consumed = 0;
+
+int _get_iov_1(uint32_t id, struct iovec* iov, int iovcnt, module_tcp_async_loop_t* loop)
+{
+	(void)id;
+	(void)loop;
+	int ret = 0;
+	uint32_t i;
+	for(i = 0; i + 1 < sizeof(_gather_seg) / sizeof(*_gather_seg) && ret < iovcnt; i ++)
+	{
+		size_t begin = _gather_seg[i] > _gather_consumed ? _gather_seg[i] : _gather_consumed;
+		if(begin >= _gather_seg[i + 1]) continue;
+		iov[ret].iov_base = (void*)(uintptr_t)(_gather_data + begin);
+		iov[ret].iov_len  = _gather_seg[i + 1] - begin;
+		ret ++;
+	}
+	return ret;
+}
+
+int _consume_1(uint32_t id, size_t nbytes, module_tcp_async_loop_t* loop)
+{
+	(void)id;
+	(void)loop;
+	_gather_consumed += nbytes;
+	return 0;
+}
+
+int gathered_write(void)
+{
+	module_tcp_async_loop_stat_t stat;
+	uint32_t cid = sizeof(conn) / sizeof(*conn) - 1;
+
+	ASSERT_PTR(loop = module_tcp_async_loop_new(128, 32, 240, 240, test_write), CLEANUP_NOP);
+	ASSERT_OK(module_tcp_async_loop_set_gather(loop, _get_iov_1, _consume_1), CLEANUP_NOP);
+
+	_set_block_bits(cid, 0);
+	_set_connction_busy(cid, 0);
+	conn[cid].bytes_to_accept = 4096;
+	dh[cid].stage = 1;   /* The data source callback has nothing */
+
+	ASSERT_OK(module_tcp_async_write_register(loop, cid, conn[cid].efd, 16, _get_data_1, _handler_empty_1, _dispose_handler_1, _error_handler_1, dh + cid), CLEANUP_NOP);
+	ASSERT_OK(module_tcp_async_write_data_ready(loop, cid), CLEANUP_NOP);
+	ASSERT_OK(module_tcp_async_write_data_ends(loop, cid), CLEANUP_NOP);
+
+	_wait_async_thread(AS_DISPOSE);
+
+	/* All the buffers are written by a single gathered write */
+	ASSERT(_gather_consumed == sizeof(_gather_data) - 1, CLEANUP_NOP);
+	ASSERT(0 == memcmp(conn[cid].buf, "hi", 2), CLEANUP_NOP);
+	ASSERT_OK(module_tcp_async_loop_get_stat(loop, &stat), CLEANUP_NOP);
+	ASSERT(stat.write_calls == 1, CLEANUP_NOP);
+	ASSERT(stat.finished == 1, CLEANUP_NOP);
+
+	ASSERT_OK(module_tcp_async_loop_free(loop), CLEANUP_NOP);
+
+	return 0;
+}
+
+/** @brief the file which carries the data for the sendfile test */
+static int _file_fd = -1;
+/** @brief the size of the file */
+static size_t _file_size = 0;
+/** @brief how many bytes of the file has been consumed */
+static size_t _file_consumed = 0;
+
+int _get_iov_2(uint32_t id, struct iovec* iov, int iovcnt, module_tcp_async_loop_t* loop)
+{
+	(void)id;
+	(void)iov;
+	(void)iovcnt;
+	(void)loop;
+	return 0;
+}
+
+int _consume_2(uint32_t id, size_t nbytes, module_tcp_async_loop_t* loop)
+{
+	(void)id;
+	(void)loop;
+	_file_consumed += nbytes;
+	return 0;
+}
+
+int _get_file_2(uint32_t id, int* fd_buf, off_t* offset_buf, size_t* size_buf, module_tcp_async_loop_t* loop)
+{
+	(void)id;
+	(void)loop;
+	if(_file_consumed >= _file_size) return 0;
+	*fd_buf = _file_fd;
+	*offset_buf = (off_t)_file_consumed;
+	*size_buf = _file_size - _file_consumed;
+	return 1;
+}
+
+int sendfile_write(void)
+{
+#ifdef __LINUX__
+	module_tcp_async_loop_stat_t stat;
+	uint32_t cid = sizeof(conn) / sizeof(*conn) - 2;
+	char path[] = "/tmp/plumber-sendfile-XXXXXX";
+	int sock[2] = {-1, -1};
+	char expected[3000], buf[3000];
+	size_t i, received = 0;
+	int rc = ERROR_CODE(int);
+
+	for(i = 0; i < sizeof(expected); i ++)
+	    expected[i] = (char)('a' + i % 26);
+
+	ASSERT((_file_fd = mkstemp(path)) >= 0, goto ERR);
+	unlink(path);
+	ASSERT(write(_file_fd, expected, sizeof(expected)) == (ssize_t)sizeof(expected), goto ERR);
+	_file_size = sizeof(expected);
+	ASSERT_OK(socketpair(AF_UNIX, SOCK_STREAM, 0, sock), goto ERR);
+
+	/* The sendfile system call is only used when the write function is not mocked */
+	ASSERT_PTR(loop = module_tcp_async_loop_new(128, 32, 240, 240, NULL), goto ERR);
+	ASSERT_OK(module_tcp_async_loop_set_gather(loop, _get_iov_2, _consume_2), goto ERR);
+	ASSERT_OK(module_tcp_async_loop_set_sendfile(loop, _get_file_2), goto ERR);
+
+	_set_block_bits(cid, 0);
+	dh[cid].stage = 1;   /* The data source callback has nothing */
+
+	ASSERT_OK(module_tcp_async_write_register(loop, cid, sock[0], 16, _get_data_1, _handler_empty_1, _dispose_handler_1, _error_handler_1, dh + cid), goto ERR);
+	ASSERT_OK(module_tcp_async_write_data_ready(loop, cid), goto ERR);
+	ASSERT_OK(module_tcp_async_write_data_ends(loop, cid), goto ERR);
+
+	_wait_async_thread(AS_DISPOSE);
+
+	while(received < sizeof(buf))
+	{
+		ssize_t bytes = read(sock[1], buf + received, sizeof(buf) - received);
+		ASSERT(bytes > 0, goto ERR);
+		received += (size_t)bytes;
+	}
+	ASSERT(0 == memcmp(buf, expected, sizeof(expected)), goto ERR);
+	ASSERT(_file_consumed == sizeof(expected), goto ERR);
+
+	ASSERT_OK(module_tcp_async_loop_get_stat(loop, &stat), goto ERR);
+	ASSERT(stat.sendfile_bytes == sizeof(expected), goto ERR);
+
+	rc = 0;
+ERR:
+	if(NULL != loop) module_tcp_async_loop_free(loop);
+	loop = NULL;
+	if(sock[0] >= 0) close(sock[0]);
+	if(sock[1] >= 0) close(sock[1]);
+	if(_file_fd >= 0) close(_file_fd);
+	_file_fd = -1;
+	return rc;
+#else
+	return 0;
+#endif
+}
+
+int io_uring_write(void)
+{
+#ifdef __LINUX__
+	module_tcp_async_loop_stat_t stat;
+	uint32_t cid = sizeof(conn) / sizeof(*conn) - 3;
+	char path[] = "/tmp/plumber-io-uring-XXXXXX";
+	int sock[2] = {-1, -1};
+	static char expected[1 << 20], buf[1 << 20];
+	size_t i, received = 0;
+	int rc = ERROR_CODE(int);
+
+	for(i = 0; i < sizeof(expected); i ++)
+	    expected[i] = (char)('a' + i % 26);
+
+	if(ERROR_CODE(int) == os_event_set_backend(OS_EVENT_BACKEND_IO_URING))
+	{
+		LOG_WARNING("Skip io_uring test, because the io_uring backend is not compiled");
+		return 0;
+	}
+
+	/* The file is much larger than the socket buffer, so the async loop has to wait for the socket gets writable */
+	ASSERT((_file_fd = mkstemp(path)) >= 0, goto ERR);
+	unlink(path);
+	ASSERT(write(_file_fd, expected, sizeof(expected)) == (ssize_t)sizeof(expected), goto ERR);
+	_file_size = sizeof(expected);
+	_file_consumed = 0;
+	ASSERT_OK(socketpair(AF_UNIX, SOCK_STREAM, 0, sock), goto ERR);
+
+	ASSERT_PTR(loop = module_tcp_async_loop_new(128, 32, 240, 240, NULL), goto ERR);
+	ASSERT_OK(module_tcp_async_loop_set_gather(loop, _get_iov_2, _consume_2), goto ERR);
+	ASSERT_OK(module_tcp_async_loop_set_sendfile(loop, _get_file_2), goto ERR);
+
+	/* The poll object falls back to epoll silently when the kernel doesn't support io_uring */
+	ASSERT_OK(module_tcp_async_loop_get_stat(loop, &stat), goto ERR);
+	if(stat.backend != OS_EVENT_BACKEND_IO_URING)
+	{
+		LOG_WARNING("Skip io_uring test, because the kernel doesn't support io_uring");
+		rc = 0;
+		goto ERR;
+	}
+
+	_set_block_bits(cid, 0);
+	dh[cid].stage = 1;
+
+	ASSERT_OK(module_tcp_async_write_register(loop, cid, sock[0], 16, _get_data_1, _handler_empty_1, _dispose_handler_1, _error_handler_1, dh + cid), goto ERR);
+	ASSERT_OK(module_tcp_async_write_data_ready(loop, cid), goto ERR);
+	ASSERT_OK(module_tcp_async_write_data_ends(loop, cid), goto ERR);
+
+	while(received < sizeof(buf))
+	{
+		ssize_t bytes = read(sock[1], buf + received, sizeof(buf) - received);
+		ASSERT(bytes > 0, goto ERR);
+		received += (size_t)bytes;
+	}
+
+	_wait_async_thread(AS_DISPOSE);
+
+	ASSERT(0 == memcmp(buf, expected, sizeof(expected)), goto ERR);
+	ASSERT(1 == dh[cid].disposed, goto ERR);
+	ASSERT(0 == dh[cid].error, goto ERR);
+
+	ASSERT_OK(module_tcp_async_loop_get_stat(loop, &stat), goto ERR);
+	ASSERT(stat.sendfile_bytes == sizeof(expected), goto ERR);
+	ASSERT(stat.backend == OS_EVENT_BACKEND_IO_URING, goto ERR);
+
+	rc = 0;
+ERR:
+	if(NULL != loop) module_tcp_async_loop_free(loop);
+	loop = NULL;
+	if(sock[0] >= 0) close(sock[0]);
+	if(sock[1] >= 0) close(sock[1]);
+	if(_file_fd >= 0) close(_file_fd);
+	_file_fd = -1;
+	os_event_set_backend(OS_EVENT_BACKEND_DEFAULT);
+	return rc;
+#else
+	return 0;
+#endif
+}
+
 int setup(void)
 {
 	expected_memory_leakage();
@@ -611,5 +851,8 @@ TEST_LIST_BEGIN
     TEST_CASE(create_loop),
     TEST_CASE(single_async_write),
     TEST_CASE(parallel_write),
-    TEST_CASE(cleanup_loop)
+    TEST_CASE(cleanup_loop),
+    TEST_CASE(gathered_write),
+    TEST_CASE(sendfile_write),
+    TEST_CASE(io_uring_write)
 TEST_LIST_END;
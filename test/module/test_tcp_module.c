@@ -8,10 +8,14 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <itc/module_types.h>
 #include <module/tcp/pool.h>
 #include <module/tcp/module.h>
 #include <sys/wait.h>
+#include <poll.h>
+#include <pthread.h>
 itc_module_type_t mod_tcp;
 struct {
 	module_tcp_pool_configure_t pool_conf;            /*!< the TCP pool configuration */
@@ -32,24 +36,33 @@ static const char request[] =  "GET / HTTP/1.1\r\n"
                                "\r\n";
 int do_request(void)
 {
-
-	int sock = socket(AF_INET, SOCK_STREAM, 0);
+	int sock, retry;
 	struct sockaddr_in addr;
-	if(sock == -1)
-	{
-		perror("socket");
-		return -1;
-	}
 
 	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
 	addr.sin_family = AF_INET;
 	addr.sin_port = htons(port);
 
-	if(connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+	/* The parent starts listening when it accepts the first time, so it may not be ready yet */
+	for(retry = 0;; retry ++)
 	{
-		perror("connect");
-		shutdown(sock, 2);
-		return -1;
+		if((sock = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		{
+			perror("socket");
+			return -1;
+		}
+
+		if(connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == 0) break;
+
+		if(errno != ECONNREFUSED || retry >= 100)
+		{
+			perror("connect");
+			close(sock);
+			return -1;
+		}
+
+		close(sock);
+		usleep(10000);
 	}
 
 	if(send(sock, request, sizeof(request) - 1, 0) < 0)
@@ -141,6 +154,492 @@ ERR:
 	return -1;
 }
 
+int event_loops_test(void)
+{
+	const itc_modtab_instance_t* inst = itc_modtab_get_from_module_type(mod_tcp);
+	ASSERT_PTR(inst, CLEANUP_NOP);
+
+	itc_module_property_value_t value = {
+		.type = ITC_MODULE_PROPERTY_TYPE_INT,
+		.num  = 3
+	};
+
+	ASSERT(1 == inst->module->set_property(inst->context, "event_loops", value), CLEANUP_NOP);
+
+	value = inst->module->get_property(inst->context, "event_loops");
+	ASSERT(value.type == ITC_MODULE_PROPERTY_TYPE_INT, CLEANUP_NOP);
+	ASSERT(value.num == 3, CLEANUP_NOP);
+
+	/* Each event loop is a forked module instance which has its own connection pool */
+	itc_module_type_t fork1 = itc_modtab_get_module_type_from_path("pipe.tcp.port_8888$1");
+	itc_module_type_t fork2 = itc_modtab_get_module_type_from_path("pipe.tcp.port_8888$2");
+	ASSERT(ERROR_CODE(itc_module_type_t) != fork1, CLEANUP_NOP);
+	ASSERT(ERROR_CODE(itc_module_type_t) != fork2, CLEANUP_NOP);
+	ASSERT(module_tcp_module_get_pool(itc_module_get_context(fork1)) != module_tcp_module_get_pool(itc_module_get_context(mod_tcp)), CLEANUP_NOP);
+	ASSERT(itc_module_get_flags(fork1) & ITC_MODULE_FLAGS_EVENT_LOOP, CLEANUP_NOP);
+
+	/* The number of event loops can not be reduced */
+	value.num = 1;
+	ASSERT(ERROR_CODE(int) == inst->module->set_property(inst->context, "event_loops", value), CLEANUP_NOP);
+
+	/* And a forked instance can not add event loops */
+	const itc_modtab_instance_t* fork_inst = itc_modtab_get_from_module_type(fork1);
+	ASSERT_PTR(fork_inst, CLEANUP_NOP);
+	value.num = 4;
+	ASSERT(ERROR_CODE(int) == fork_inst->module->set_property(fork_inst->context, "event_loops", value), CLEANUP_NOP);
+	ASSERT(ERROR_CODE(itc_module_type_t) == itc_modtab_get_module_type_from_path("pipe.tcp.port_8888$3"), CLEANUP_NOP);
+
+	return 0;
+}
+
+int mem_watermark_test(void)
+{
+	const itc_modtab_instance_t* inst = itc_modtab_get_from_module_type(mod_tcp);
+	ASSERT_PTR(inst, CLEANUP_NOP);
+
+	char const* argv[] = {"8889"};
+	ASSERT_OK(itc_modtab_insmod(&module_tcp_module_def, 1, argv), CLEANUP_NOP);
+	const itc_modtab_instance_t* other = itc_modtab_get_from_module_type(itc_modtab_get_module_type_from_path("pipe.tcp.port_8889"));
+	ASSERT_PTR(other, CLEANUP_NOP);
+
+	itc_module_property_value_t value = {
+		.type = ITC_MODULE_PROPERTY_TYPE_INT,
+		.num  = 1048576
+	};
+
+	ASSERT(1 == inst->module->set_property(inst->context, "mem_high_watermark", value), CLEANUP_NOP);
+
+	/* The memory account is shared, so another instance can only agree with the budget */
+	ASSERT(1 == other->module->set_property(other->context, "mem_high_watermark", value), CLEANUP_NOP);
+	value.num = 4096;
+	ASSERT(ERROR_CODE(int) == other->module->set_property(other->context, "mem_high_watermark", value), CLEANUP_NOP);
+
+	value = other->module->get_property(other->context, "mem_high_watermark");
+	ASSERT(value.type == ITC_MODULE_PROPERTY_TYPE_INT, CLEANUP_NOP);
+	ASSERT(value.num == 1048576, CLEANUP_NOP);
+
+	/* But the instance which has set the watermark is still able to change it */
+	value.num = 0;
+	ASSERT(1 == inst->module->set_property(inst->context, "mem_high_watermark", value), CLEANUP_NOP);
+
+	return 0;
+}
+
+int async_watermark_test(void)
+{
+	const itc_modtab_instance_t* inst = itc_modtab_get_from_module_type(mod_tcp);
+	ASSERT_PTR(inst, CLEANUP_NOP);
+
+	itc_module_property_value_t value = {
+		.type = ITC_MODULE_PROPERTY_TYPE_INT,
+		.num  = 65536
+	};
+
+	ASSERT(1 == inst->module->set_property(inst->context, "async_high_watermark", value), CLEANUP_NOP);
+	value.num = 1048576;
+	ASSERT(1 == inst->module->set_property(inst->context, "async_total_high_watermark", value), CLEANUP_NOP);
+
+	value = inst->module->get_property(inst->context, "async_high_watermark");
+	ASSERT(value.type == ITC_MODULE_PROPERTY_TYPE_INT, CLEANUP_NOP);
+	ASSERT(value.num == 65536, CLEANUP_NOP);
+
+	value = inst->module->get_property(inst->context, "async_total_high_watermark");
+	ASSERT(value.type == ITC_MODULE_PROPERTY_TYPE_INT, CLEANUP_NOP);
+	ASSERT(value.num == 1048576, CLEANUP_NOP);
+
+	/* Nothing is queued yet, so the writes shouldn't be paused */
+	value = inst->module->get_property(inst->context, "stats");
+	ASSERT(value.type == ITC_MODULE_PROPERTY_TYPE_STRING, CLEANUP_NOP);
+	ASSERT_PTR(strstr(value.str, "write.queued_bytes 0\n"), free(value.str));
+	ASSERT_PTR(strstr(value.str, "write.paused 0\n"), free(value.str));
+	free(value.str);
+
+	return 0;
+}
+
+/**
+ * @brief connect to the port and send one byte, so that the connection will be picked up by the pool
+ * @param rcvbuf the size of the receive buffer, 0 for the default
+ **/
+static int _connect_port(uint16_t p, int rcvbuf)
+{
+	int sock = socket(AF_INET, SOCK_STREAM, 0);
+	ASSERT(sock >= 0, CLEANUP_NOP);
+
+	if(rcvbuf > 0)
+	    ASSERT_OK(setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)), goto ERR);
+
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(p),
+		.sin_addr = {
+			.s_addr = inet_addr("127.0.0.1")
+		}
+	};
+
+	ASSERT_OK(connect(sock, (struct sockaddr*)&addr, sizeof(addr)), goto ERR);
+	ASSERT(1 == send(sock, "x", 1, 0), goto ERR);
+
+	return sock;
+ERR:
+	close(sock);
+	return -1;
+}
+
+/**
+ * @brief create a master pool with two forks listening to the same port
+ **/
+static int _pool_forks(uint16_t p, int reuseport, module_tcp_pool_t** pools)
+{
+	module_tcp_pool_configure_t conf = {
+		.port = p,
+		.ttl = 240,
+		.min_timeout = 1,
+		.tcp_backlog = 16,
+		.reuseaddr = 1,
+		.reuseport = reuseport,
+		.ipv6 = 0,
+		.size = 16,
+		.bind_addr = "127.0.0.1",
+		.event_size = 16,
+		.accept_retry_interval = 5,
+		.nodelay = 0,
+		.dispose_data = NULL,
+		.account = NULL,
+		.backpressure = NULL
+	};
+
+	uint32_t i;
+	ASSERT_PTR(pools[0] = module_tcp_pool_new(), CLEANUP_NOP);
+	for(i = 1; i < 3; i ++)
+	    ASSERT_PTR(pools[i] = module_tcp_pool_fork(pools[0]), CLEANUP_NOP);
+
+	ASSERT(2 == module_tcp_pool_num_forks(pools[0]), CLEANUP_NOP);
+
+	for(i = 0; i < 3; i ++)
+	    ASSERT_OK(module_tcp_pool_configure(pools[i], &conf), CLEANUP_NOP);
+
+	return 0;
+}
+
+static int _free_pools(module_tcp_pool_t** pools)
+{
+	int rc = 0;
+	uint32_t i;
+	for(i = 3; i > 0; i --)
+	    if(NULL != pools[i - 1] && ERROR_CODE(int) == module_tcp_pool_free(pools[i - 1]))
+	        rc = ERROR_CODE(int);
+	return rc;
+}
+
+int reuseport_test(void)
+{
+	module_tcp_pool_t* pools[3] = {};
+	module_tcp_pool_stat_t stat[3];
+	module_tcp_pool_conninfo_t conn;
+	struct pollfd pfd[3];
+	int sock = -1, rc = ERROR_CODE(int);
+	uint32_t i, j, ready = 0;
+
+	ASSERT_OK(_pool_forks(9100, 1, pools), goto ERR);
+
+	/* Each fork should own a listening socket bound to the same port */
+	for(i = 0; i < 3; i ++)
+	{
+		ASSERT_OK(module_tcp_pool_get_stat(pools[i], stat + i), goto ERR);
+		ASSERT(stat[i].listen_fd >= 0, goto ERR);
+		for(j = 0; j < i; j ++)
+		    ASSERT(stat[i].listen_fd != stat[j].listen_fd, goto ERR);
+
+		struct sockaddr_in addr;
+		socklen_t len = sizeof(addr);
+		ASSERT_OK(getsockname(stat[i].listen_fd, (struct sockaddr*)&addr, &len), goto ERR);
+		ASSERT(9100 == ntohs(addr.sin_port), goto ERR);
+
+		pfd[i].fd = stat[i].listen_fd;
+		pfd[i].events = POLLIN;
+		pfd[i].revents = 0;
+	}
+
+	/* The kernel should hand the new connection to exactly one of the listening sockets */
+	ASSERT((sock = _connect_port(9100, 0)) >= 0, goto ERR);
+	ASSERT(1 == poll(pfd, 3, 1000), goto ERR);
+	for(i = 0; i < 3; i ++)
+	    if(pfd[i].revents & POLLIN) ready = i;
+
+	/* And the pool owns that socket should accept it */
+	ASSERT_OK(module_tcp_pool_connection_get(pools[ready], &conn), goto ERR);
+	ASSERT(conn.fd >= 0, goto ERR);
+	ASSERT_OK(module_tcp_pool_connection_release(pools[ready], conn.idx, NULL, MODULE_TCP_POOL_RELEASE_MODE_PURGE), goto ERR);
+
+	rc = 0;
+ERR:
+	if(sock >= 0) close(sock);
+	if(ERROR_CODE(int) == _free_pools(pools)) rc = ERROR_CODE(int);
+	return rc;
+}
+
+int shared_listener_test(void)
+{
+	module_tcp_pool_t* pools[3] = {};
+	module_tcp_pool_stat_t stat;
+	module_tcp_pool_conninfo_t conn;
+	int sock = -1, rc = ERROR_CODE(int);
+	uint32_t i;
+
+	ASSERT_OK(_pool_forks(9101, 0, pools), goto ERR);
+
+	/* Without reuseport, the forks share the listening socket of the master */
+	ASSERT_OK(module_tcp_pool_get_stat(pools[0], &stat), goto ERR);
+	ASSERT(stat.listen_fd >= 0, goto ERR);
+	int master_fd = stat.listen_fd;
+	for(i = 1; i < 3; i ++)
+	{
+		ASSERT_OK(module_tcp_pool_get_stat(pools[i], &stat), goto ERR);
+		ASSERT(stat.listen_fd == master_fd, goto ERR);
+	}
+
+	/* And any of them still accepts the connection from the shared socket */
+	ASSERT((sock = _connect_port(9101, 0)) >= 0, goto ERR);
+	ASSERT_OK(module_tcp_pool_connection_get(pools[2], &conn), goto ERR);
+	ASSERT(conn.fd >= 0, goto ERR);
+	ASSERT_OK(module_tcp_pool_connection_release(pools[2], conn.idx, NULL, MODULE_TCP_POOL_RELEASE_MODE_PURGE), goto ERR);
+
+	rc = 0;
+ERR:
+	if(sock >= 0) close(sock);
+	if(ERROR_CODE(int) == _free_pools(pools)) rc = ERROR_CODE(int);
+	return rc;
+}
+
+#define BACKPRESSURE_BYTES (8u << 20)
+
+static struct {
+	itc_module_pipe_t* out;
+	size_t             written;
+	int                done;
+	int                rc;
+} _writer;
+
+static void* _writer_main(void* data)
+{
+	(void)data;
+	static char chunk[4096];
+	memset(chunk, 'x', sizeof(chunk));
+
+	_writer.rc = 0;
+	while(_writer.written < BACKPRESSURE_BYTES)
+	{
+		size_t rc = itc_module_pipe_write(chunk, sizeof(chunk), _writer.out);
+		if(ERROR_CODE(size_t) == rc)
+		{
+			_writer.rc = ERROR_CODE(int);
+			break;
+		}
+		__sync_fetch_and_add(&_writer.written, rc);
+	}
+
+	__sync_synchronize();
+	_writer.done = 1;
+	return NULL;
+}
+
+#define BACKPRESSURE_SOURCE_BYTES 65536u
+
+/**
+ * @brief the data source written after the connection is throttled, which records who reads it
+ **/
+static struct {
+	size_t    remaining;
+	uint32_t  reads;
+	pthread_t reader;
+	int       closed;
+} _source;
+
+static size_t _source_read(void* __restrict handle, void* __restrict buffer, size_t count, itc_module_data_source_event_t* event_buf)
+{
+	(void)handle;
+	(void)event_buf;
+	if(count > _source.remaining) count = _source.remaining;
+	memset(buffer, 'y', count);
+	_source.remaining -= count;
+	_source.reader = pthread_self();
+	__sync_fetch_and_add(&_source.reads, 1);
+	return count;
+}
+
+static int _source_eos(const void* __restrict handle)
+{
+	(void)handle;
+	return _source.remaining == 0;
+}
+
+static int _source_close(void* __restrict handle)
+{
+	(void)handle;
+	__sync_synchronize();
+	_source.closed = 1;
+	return 0;
+}
+
+/**
+ * @brief check if the stats of the TCP module contains the given line
+ **/
+static int _stats_has(const char* line)
+{
+	const itc_modtab_instance_t* inst = itc_modtab_get_from_module_type(mod_tcp);
+	itc_module_property_value_t value = inst->module->get_property(inst->context, "stats");
+	ASSERT(value.type == ITC_MODULE_PROPERTY_TYPE_STRING, CLEANUP_NOP);
+	int ret = (NULL != strstr(value.str, line));
+	free(value.str);
+	return ret;
+}
+
+/**
+ * @brief wait up to 5 seconds until the stats of the TCP module contains the given line
+ **/
+static int _stats_wait(const char* line, int poll_pool)
+{
+	int i, rc;
+	module_tcp_pool_t* pool = (module_tcp_pool_t*)module_tcp_module_get_pool(itc_module_get_context(mod_tcp));
+	for(i = 0; i < 500 && 0 == (rc = _stats_has(line)); i ++)
+	{
+		if(poll_pool) ASSERT_OK(module_tcp_pool_poll_event(pool), CLEANUP_NOP);
+		else usleep(10000);
+	}
+	ASSERT(rc == 1, CLEANUP_NOP);
+	return 0;
+}
+
+static int _set_watermark(const char* sym, long long num)
+{
+	const itc_modtab_instance_t* inst = itc_modtab_get_from_module_type(mod_tcp);
+	itc_module_property_value_t value = {
+		.type = ITC_MODULE_PROPERTY_TYPE_INT,
+		.num  = num
+	};
+	ASSERT(1 == inst->module->set_property(inst->context, sym, value), CLEANUP_NOP);
+	return 0;
+}
+
+int async_backpressure_test(void)
+{
+	itc_module_pipe_param_t param = {
+		.input_flags = RUNTIME_API_PIPE_INPUT,
+		.output_flags = RUNTIME_API_PIPE_OUTPUT | RUNTIME_API_PIPE_ASYNC,
+		.args = NULL
+	};
+	itc_module_pipe_t *in = NULL, *out = NULL;
+	int sock = -1, sock2 = -1, started = 0, rc = ERROR_CODE(int);
+	static char buffer[65536];
+	size_t received = 0;
+	char ch;
+
+	ASSERT_OK(_set_watermark("async_high_watermark", 65536), goto ERR);
+	ASSERT_OK(_set_watermark("async_low_watermark", 16384), goto ERR);
+	ASSERT_OK(_set_watermark("async_total_high_watermark", 65536), goto ERR);
+	ASSERT_OK(_set_watermark("async_total_low_watermark", 16384), goto ERR);
+
+	/* The peer doesn't read anything for now, and it advertises a small window */
+	ASSERT((sock = _connect_port(9000, 4096)) >= 0, goto ERR);
+	ASSERT_OK(itc_module_pipe_accept(mod_tcp, param, &in, &out), goto ERR);
+	ASSERT(1 == itc_module_pipe_read(&ch, 1, in), goto ERR);
+
+	_writer.out = out;
+	_writer.written = 0;
+	_writer.done = 0;
+	pthread_t writer;
+	ASSERT_OK(pthread_create(&writer, NULL, _writer_main, NULL), goto ERR);
+	started = 1;
+
+	/* The worker thread is shared by other requests, so it should never wait for the connection, even if the peer
+	 * doesn't read anything */
+	int i;
+	for(i = 0; i < 500 && !_writer.done; i ++) usleep(10000);
+	ASSERT(_writer.done, goto ERR);
+	ASSERT_OK(pthread_join(writer, NULL), goto ERR);
+	started = 0;
+	ASSERT_OK(_writer.rc, goto ERR);
+	ASSERT(BACKPRESSURE_BYTES == _writer.written, goto ERR);
+
+	ASSERT_OK(_stats_wait("write.throttled_conns 1\n", 0), goto ERR);
+	ASSERT_OK(_stats_wait("write.paused 1\n", 0), goto ERR);
+
+	/* The data source written to the throttled connection shouldn't be read by the worker thread */
+	_source.remaining = BACKPRESSURE_SOURCE_BYTES;
+	_source.reads = 0;
+	_source.closed = 0;
+	itc_module_data_source_t source = {
+		.data_handle = &_source,
+		.read        = _source_read,
+		.eos         = _source_eos,
+		.close       = _source_close,
+		.fd_range    = NULL
+	};
+	ASSERT(1 == itc_module_pipe_write_data_source(source, NULL, out), goto ERR);
+	ASSERT(0 == _source.reads, goto ERR);
+
+	/* And the pool should leave the new connection in the backlog */
+	ASSERT((sock2 = _connect_port(9000, 0)) >= 0, goto ERR);
+	ASSERT_OK(_stats_wait("conn.paused 1\n", 1), goto ERR);
+
+	/* Once the peer starts reading, the queued bytes are written, and then the async loop resumes the data source */
+	while(received < BACKPRESSURE_BYTES + BACKPRESSURE_SOURCE_BYTES)
+	{
+		ssize_t bytes = read(sock, buffer, sizeof(buffer));
+		ASSERT(bytes > 0, goto ERR);
+		if(received + (size_t)bytes > BACKPRESSURE_BYTES)
+		{
+			size_t begin = received < BACKPRESSURE_BYTES ? BACKPRESSURE_BYTES - received : 0;
+			ASSERT(buffer[begin] == 'y' && buffer[bytes - 1] == 'y', goto ERR);
+		}
+		else ASSERT(buffer[bytes - 1] == 'x', goto ERR);
+		received += (size_t)bytes;
+	}
+
+	ASSERT(_source.reads > 0, goto ERR);
+	ASSERT(!pthread_equal(_source.reader, pthread_self()), goto ERR);
+
+	/* The peer closes the connection first, so that the port isn't left in TIME_WAIT for the next run */
+	close(sock);
+	sock = -1;
+	ASSERT_OK(itc_module_pipe_deallocate(in), goto ERR);
+	in = NULL;
+	ASSERT_OK(itc_module_pipe_deallocate(out), goto ERR);
+	out = NULL;
+
+	ASSERT_OK(_stats_wait("write.throttled_conns 0\n", 0), goto ERR);
+	ASSERT_OK(_stats_wait("write.paused 0\n", 0), goto ERR);
+	ASSERT_OK(_stats_wait("write.queued_bytes 0\n", 0), goto ERR);
+	ASSERT(_source.closed, goto ERR);
+
+	/* And the pool should accept the connection again */
+	ASSERT_OK(_stats_wait("conn.paused 0\n", 1), goto ERR);
+	ASSERT_OK(itc_module_pipe_accept(mod_tcp, param, &in, &out), goto ERR);
+	ASSERT(1 == itc_module_pipe_read(&ch, 1, in), goto ERR);
+	close(sock2);
+	sock2 = -1;
+	ASSERT_OK(itc_module_pipe_deallocate(in), goto ERR);
+	in = NULL;
+	ASSERT_OK(itc_module_pipe_deallocate(out), goto ERR);
+	out = NULL;
+
+	rc = 0;
+ERR:
+	if(started)
+	{
+		/* Let the writer go */
+		shutdown(sock, SHUT_RDWR);
+		pthread_join(writer, NULL);
+	}
+	if(NULL != in) itc_module_pipe_deallocate(in);
+	if(NULL != out) itc_module_pipe_deallocate(out);
+	if(sock >= 0) close(sock);
+	if(sock2 >= 0) close(sock2);
+	_set_watermark("async_total_high_watermark", 0);
+	return rc;
+}
+
 int setup(void)
 {
 	mod_tcp = itc_modtab_get_module_type_from_path("pipe.tcp.port_8888");
@@ -153,5 +652,11 @@ int setup(void)
 DEFAULT_TEARDOWN;
 
 TEST_LIST_BEGIN
-    TEST_CASE(accept_test)
+    TEST_CASE(event_loops_test),
+    TEST_CASE(accept_test),
+    TEST_CASE(mem_watermark_test),
+    TEST_CASE(async_watermark_test),
+    TEST_CASE(reuseport_test),
+    TEST_CASE(shared_listener_test),
+    TEST_CASE(async_backpressure_test)
 TEST_LIST_END;
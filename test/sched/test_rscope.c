@@ -2,7 +2,9 @@
  * Copyright (C) 2017, Hao Hou
  **/
 
+#include <unistd.h>
 #include <testenv.h>
+#include <utils/mempool/page.h>
 
 #define N 10240
 static int status[N];
@@ -317,6 +319,105 @@ int test_stream_interface(void)
 	return 0;
 }
 
+static int _shared_value[2];
+
+static void* _shared_copy_func(const void* ptr)
+{
+	const int* p = (const int*)ptr;
+	_shared_value[1] = *p;
+	return _shared_value + 1;
+}
+
+static int _shared_free_func(void* ptr)
+{
+	*(int*)ptr = 0;
+	return 0;
+}
+
+int test_shared_table(void)
+{
+	sched_rscope_t* scope = NULL;
+	sched_rscope_table_t* table;
+	int dummy;
+
+	/* The table owned by other thread can't be used unless the tables are shared */
+	ASSERT(NULL == sched_rscope_switch_table((sched_rscope_table_t*)&dummy), CLEANUP_NOP);
+	ASSERT_PTR(table = sched_rscope_thread_table(), CLEANUP_NOP);
+	ASSERT(table == sched_rscope_switch_table(table), CLEANUP_NOP);
+
+	ASSERT_OK(sched_rscope_set_shared(1), CLEANUP_NOP);
+	ASSERT(table == sched_rscope_switch_table(table), goto ERR);
+	ASSERT_PTR(scope = sched_rscope_new(), goto ERR);
+
+	_shared_value[0] = 1;
+	_shared_value[1] = 2;
+	runtime_api_scope_entity_t ent = {
+		.data = _shared_value + 0,
+		.copy_func = _shared_copy_func,
+		.free_func = _shared_free_func
+	};
+	runtime_api_scope_token_t token;
+	sched_rscope_copy_result_t result;
+	ASSERT_RETOK(runtime_api_scope_token_t, token = sched_rscope_add(scope, &ent), goto ERR);
+	ASSERT(sched_rscope_get(scope, token) == _shared_value + 0, goto ERR);
+
+	/* The copy adds a new entry to the table, which shouldn't dead lock */
+	ASSERT_OK(sched_rscope_copy(scope, token, &result), goto ERR);
+	ASSERT(result.ptr == _shared_value + 1, goto ERR);
+	ASSERT(1 == _shared_value[1], goto ERR);
+	ASSERT(sched_rscope_get(scope, result.token) == _shared_value + 1, goto ERR);
+
+	ASSERT_OK(sched_rscope_free(scope), goto ERR);
+	ASSERT(0 == _shared_value[0] && 0 == _shared_value[1], CLEANUP_NOP);
+
+	return sched_rscope_set_shared(0);
+ERR:
+	if(NULL != scope) sched_rscope_free(scope);
+	sched_rscope_set_shared(0);
+	return ERROR_CODE(int);
+}
+
+int test_arena(void)
+{
+	sched_rscope_t* scope = NULL;
+	char* small[1024];
+	char* large = NULL;
+	uint32_t i;
+	mempool_page_stat_t before, after;
+
+	ASSERT_OK(mempool_page_get_stat(&before), CLEANUP_NOP);
+	ASSERT_PTR(scope = sched_rscope_new(), CLEANUP_NOP);
+
+	ASSERT(NULL == sched_rscope_arena_alloc(scope, 0), goto ERR);
+	ASSERT(NULL == sched_rscope_arena_alloc(scope, SIZE_MAX), goto ERR);
+	ASSERT(NULL == sched_rscope_arena_alloc(scope, SIZE_MAX - SCHED_RSCOPE_ARENA_ALIGNMENT + 1), goto ERR);
+
+	for(i = 0; i < sizeof(small) / sizeof(*small); i ++)
+	{
+		ASSERT_PTR(small[i] = (char*)sched_rscope_arena_alloc(scope, i % 37 + 1), goto ERR);
+		ASSERT(((uintptr_t)small[i] & (SCHED_RSCOPE_ARENA_ALIGNMENT - 1)) == 0, goto ERR);
+		memset(small[i], (int)(i & 0xff), i % 37 + 1);
+	}
+
+	/* The allocation which doesn't fit in a page */
+	ASSERT_PTR(large = (char*)sched_rscope_arena_alloc(scope, 3 * (size_t)getpagesize()), goto ERR);
+	memset(large, -1, 3 * (size_t)getpagesize());
+
+	for(i = 0; i < sizeof(small) / sizeof(*small); i ++)
+	    ASSERT(small[i][i % 37] == (char)(i & 0xff), goto ERR);
+
+	ASSERT_OK(sched_rscope_free(scope), CLEANUP_NOP);
+
+	/* All the arena pages should be returned to the page pool */
+	ASSERT_OK(mempool_page_get_stat(&after), CLEANUP_NOP);
+	ASSERT(after.cached_pages + after.free_pages >= before.cached_pages + before.free_pages, CLEANUP_NOP);
+
+	return 0;
+ERR:
+	if(NULL != scope) sched_rscope_free(scope);
+	return ERROR_CODE(int);
+}
+
 int setup(void)
 {
 	return sched_rscope_init_thread();
@@ -329,5 +430,7 @@ int teardown(void)
 
 TEST_LIST_BEGIN
     TEST_CASE(test_multiple_request),
-    TEST_CASE(test_stream_interface)
+    TEST_CASE(test_stream_interface),
+    TEST_CASE(test_shared_table),
+    TEST_CASE(test_arena)
 TEST_LIST_END;
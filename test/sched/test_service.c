@@ -90,6 +90,41 @@ int build_service(void)
 	return 0;
 }
 
+int chain_handoff(void)
+{
+	ASSERT_PTR(service, CLEANUP_NOP);
+
+	/* The only output of node 2 is the only input of node 5 */
+	ASSERT(1 == sched_service_node_chained(service, nodes[5]), CLEANUP_NOP);
+
+	uint32_t i;
+	for(i = 0; i < 5; i ++)
+	    ASSERT(0 == sched_service_node_chained(service, nodes[i]), CLEANUP_NOP);
+
+	return 0;
+}
+
+int execution_plan(void)
+{
+	ASSERT_PTR(service, CLEANUP_NOP);
+
+	uint32_t i, j, size, ninputs;
+	for(i = 0; i < 6; i ++)
+	{
+		const sched_service_edge_plan_t* plan = sched_service_get_outgoing_plan(service, nodes[i], &size);
+		ASSERT_PTR(plan, CLEANUP_NOP);
+		for(j = 0; j < size; j ++)
+		{
+			ASSERT(plan[j].desc.source_node_id == nodes[i], CLEANUP_NOP);
+			ASSERT(plan[j].downstream_slot == plan[j].desc.destination_node_id, CLEANUP_NOP);
+			ASSERT_PTR(sched_service_get_incoming_pipes(service, plan[j].desc.destination_node_id, &ninputs), CLEANUP_NOP);
+			ASSERT(plan[j].downstream_inputs == ninputs, CLEANUP_NOP);
+		}
+	}
+
+	return 0;
+}
+
 int serialize_service(void)
 {
 	ASSERT_PTR(service, CLEANUP_NOP);
@@ -265,6 +300,8 @@ int teardown(void)
 TEST_LIST_BEGIN
     TEST_CASE(service_buffer),
     TEST_CASE(build_service),
+    TEST_CASE(chain_handoff),
+    TEST_CASE(execution_plan),
     TEST_CASE(serialize_service),
     TEST_CASE(service_validation_invalid_input),
     TEST_CASE(service_validation_circular_dep),
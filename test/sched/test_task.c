@@ -4,8 +4,11 @@
 
 #include <testenv.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <itc/module_types.h>
 #include <module/test/module.h>
+#include <utils/clock.h>
 
 runtime_stab_entry_t servletA[10], servletB[10];
 
@@ -108,7 +111,7 @@ int single_node_test(void)
 		ASSERT_OK(itc_module_pipe_deallocate(input[0]), goto ERR);
 		input[0] = NULL;
 
-		ASSERT_RETOK(sched_task_request_t, sched_task_new_request(stc, service, input[1], output[0]), goto ERR);
+		ASSERT_RETOK(sched_task_request_t, sched_task_new_request(stc, service, input[1], output[0], 0), goto ERR);
 		input[1] = NULL;
 		output[0] = NULL;
 
@@ -148,6 +151,322 @@ ERR:
 }
 #endif /* DO_NOT_COMPILE_ITC_MODULE_TEST */
 
+int request_deadline(void)
+#if DO_NOT_COMPILE_ITC_MODULE_TEST == 0
+{
+	int rc = -1;
+	sched_service_buffer_t* buffer = NULL;
+	sched_service_node_id_t node = 0;
+	sched_service_t* service = NULL;
+	sched_task_t* task = NULL;
+	itc_module_pipe_t *input[2] = {}, *output[2] = {};
+	sched_task_request_t request;
+	char result[32] = {};
+	int data = 0;
+	itc_module_pipe_param_t param = {
+		.input_flags = RUNTIME_API_PIPE_INPUT,
+		.output_flags = RUNTIME_API_PIPE_OUTPUT,
+		.args = NULL
+	};
+	ASSERT_PTR(buffer = sched_service_buffer_new(), CLEANUP_NOP);
+	ASSERT_OK(sched_service_buffer_allow_reuse_servlet(buffer), goto ERR);
+
+	ASSERT_RETOK(sched_service_node_id_t, node = sched_service_buffer_add_node(buffer, servletA[5]), goto ERR);
+
+	ASSERT_OK(sched_service_buffer_set_input(buffer, node, A_in), goto ERR);
+	ASSERT_OK(sched_service_buffer_set_output(buffer, node, A_out), goto ERR);
+
+	ASSERT_OK(sched_service_set_request_deadline(1000), goto ERR);
+	ASSERT_OK(sched_service_set_deadline_response("timeout"), goto ERR);
+	ASSERT_PTR(service = sched_service_from_buffer(buffer), goto ERR);
+	ASSERT_OK(sched_service_set_request_deadline(0), goto ERR);
+	ASSERT_OK(sched_service_set_deadline_response(NULL), goto ERR);
+
+	ASSERT(sched_service_deadline(service) == 1000000000ull, goto ERR);
+
+	/* The request accepted long time ago has already passed its deadline */
+	ASSERT_OK(itc_module_pipe_allocate(mod_test, 0, param, input + 0, input + 1), goto ERR);
+	ASSERT_OK(itc_module_pipe_allocate(mod_test, 0, param, output + 0, output + 1), goto ERR);
+	ASSERT_RETOK(size_t, itc_module_pipe_write(&data, sizeof(int), input[0]), goto ERR);
+	ASSERT_OK(itc_module_pipe_deallocate(input[0]), goto ERR);
+	input[0] = NULL;
+
+	ASSERT_RETOK(sched_task_request_t, request = sched_task_new_request(stc, service, input[1], output[0], 1), goto ERR);
+	input[1] = output[0] = NULL;
+
+	ASSERT(NULL == sched_task_next_ready_task(stc), goto ERR);
+	ASSERT(0 == sched_task_request_status(stc, request), goto ERR);
+
+	ASSERT(strlen("timeout") == itc_module_pipe_read(result, strlen("timeout"), output[1]), goto ERR);
+	ASSERT_STREQ(result, "timeout", goto ERR);
+	ASSERT_OK(itc_module_pipe_deallocate(output[1]), goto ERR);
+	output[1] = NULL;
+
+	/* The request accepted right now should run as usual */
+	ASSERT_OK(itc_module_pipe_allocate(mod_test, 0, param, input + 0, input + 1), goto ERR);
+	ASSERT_OK(itc_module_pipe_allocate(mod_test, 0, param, output + 0, output + 1), goto ERR);
+	ASSERT_RETOK(size_t, itc_module_pipe_write(&data, sizeof(int), input[0]), goto ERR);
+	ASSERT_OK(itc_module_pipe_deallocate(input[0]), goto ERR);
+	input[0] = NULL;
+
+	ASSERT_RETOK(sched_task_request_t, sched_task_new_request(stc, service, input[1], output[0], 0), goto ERR);
+	input[1] = output[0] = NULL;
+
+	ASSERT_PTR(task = sched_task_next_ready_task(stc), goto ERR);
+	ASSERT_OK(runtime_task_start(task->exec_task), goto ERR);
+	ASSERT_OK(sched_task_free(task), goto ERR);
+	task = NULL;
+
+	ASSERT(NULL == sched_task_next_ready_task(stc), goto ERR);
+
+	rc = 0;
+ERR:
+	if(NULL != task) sched_task_free(task);
+	if(NULL != buffer) sched_service_buffer_free(buffer);
+	if(NULL != service) sched_service_free(service);
+	if(NULL != input[0]) itc_module_pipe_deallocate(input[0]);
+	if(NULL != input[1]) itc_module_pipe_deallocate(input[1]);
+	if(NULL != output[0]) itc_module_pipe_deallocate(output[0]);
+	if(NULL != output[1]) itc_module_pipe_deallocate(output[1]);
+	return rc;
+}
+#else
+{
+	LOG_WARNING("Test case disabled because no testing module compiled");
+	return 0;
+}
+#endif /* DO_NOT_COMPILE_ITC_MODULE_TEST */
+
+/**
+ * @brief start a request of the single node service which reads an integer
+ * @param ctx the scheduler task context
+ * @param service the service
+ * @param arrival the arrival time of the request
+ * @param output the buffer for the output end of the request
+ * @return the request id
+ **/
+static sched_task_request_t _new_int_request(sched_task_context_t* ctx, const sched_service_t* service, uint64_t arrival, itc_module_pipe_t** output)
+{
+	itc_module_pipe_t *input[2] = {}, *out = NULL;
+	int data = 1;
+	itc_module_pipe_param_t param = {
+		.input_flags = RUNTIME_API_PIPE_INPUT,
+		.output_flags = RUNTIME_API_PIPE_OUTPUT,
+		.args = NULL
+	};
+	sched_task_request_t ret;
+
+	if(ERROR_CODE(int) == itc_module_pipe_allocate(mod_test, 0, param, input + 0, input + 1)) return ERROR_CODE(sched_task_request_t);
+	if(ERROR_CODE(int) == itc_module_pipe_allocate(mod_test, 0, param, &out, output)) goto ERR;
+	if(ERROR_CODE(size_t) == itc_module_pipe_write(&data, sizeof(int), input[0])) goto ERR;
+	itc_module_pipe_deallocate(input[0]);
+	input[0] = NULL;
+
+	if(ERROR_CODE(sched_task_request_t) == (ret = sched_task_new_request(ctx, service, input[1], out, arrival))) goto ERR;
+
+	return ret;
+ERR:
+	if(NULL != input[0]) itc_module_pipe_deallocate(input[0]);
+	if(NULL != input[1]) itc_module_pipe_deallocate(input[1]);
+	if(NULL != out) itc_module_pipe_deallocate(out);
+	if(NULL != *output) itc_module_pipe_deallocate(*output);
+	*output = NULL;
+	return ERROR_CODE(sched_task_request_t);
+}
+
+static sched_service_t* _deadline_service(uint32_t deadline)
+{
+	sched_service_buffer_t* buffer = NULL;
+	sched_service_node_id_t node;
+	sched_service_t* ret = NULL;
+
+	if(NULL == (buffer = sched_service_buffer_new())) return NULL;
+	if(ERROR_CODE(int) == sched_service_buffer_allow_reuse_servlet(buffer)) goto RET;
+	if(ERROR_CODE(sched_service_node_id_t) == (node = sched_service_buffer_add_node(buffer, servletA[5]))) goto RET;
+	if(ERROR_CODE(int) == sched_service_buffer_set_input(buffer, node, A_in)) goto RET;
+	if(ERROR_CODE(int) == sched_service_buffer_set_output(buffer, node, A_out)) goto RET;
+	if(ERROR_CODE(int) == sched_service_set_request_deadline(deadline)) goto RET;
+	ret = sched_service_from_buffer(buffer);
+	sched_service_set_request_deadline(0);
+RET:
+	sched_service_buffer_free(buffer);
+	return ret;
+}
+
+int deadline_order(void)
+#if DO_NOT_COMPILE_ITC_MODULE_TEST == 0
+{
+	int rc = ERROR_CODE(int);
+	sched_task_context_t* ctx = NULL;
+	sched_service_t* service = NULL;
+	sched_task_t* task = NULL;
+	itc_module_pipe_t* out[3] = {};
+	sched_task_request_t req[3];
+	uint32_t i;
+
+	ASSERT_PTR(ctx = sched_task_context_new(NULL), goto ERR);
+	ASSERT_PTR(service = _deadline_service(1000), goto ERR);
+
+	/* The requests are queued in the order they come, but the one accepted earlier has the earlier deadline */
+	uint64_t now = utils_clock_now_ns();
+	ASSERT_RETOK(sched_task_request_t, req[0] = _new_int_request(ctx, service, now - 100000000ull, out + 0), goto ERR);
+	ASSERT_RETOK(sched_task_request_t, req[1] = _new_int_request(ctx, service, now - 300000000ull, out + 1), goto ERR);
+	ASSERT_RETOK(sched_task_request_t, req[2] = _new_int_request(ctx, service, now - 200000000ull, out + 2), goto ERR);
+
+	const uint32_t expected[] = {1, 2, 0};
+	for(i = 0; i < 3; i ++)
+	{
+		ASSERT_PTR(task = sched_task_next_ready_task(ctx), goto ERR);
+		ASSERT(task->request == req[expected[i]], goto ERR);
+		ASSERT_OK(runtime_task_start(task->exec_task), goto ERR);
+		ASSERT_OK(sched_task_free(task), goto ERR);
+		task = NULL;
+	}
+
+	ASSERT(NULL == sched_task_next_ready_task(ctx), goto ERR);
+
+	rc = 0;
+ERR:
+	if(NULL != task) sched_task_free(task);
+	for(i = 0; i < 3; i ++)
+	    if(NULL != out[i]) itc_module_pipe_deallocate(out[i]);
+	if(NULL != ctx) sched_task_context_free(ctx);
+	if(NULL != service) sched_service_free(service);
+	return rc;
+}
+#else
+{
+	LOG_WARNING("Test case disabled because no testing module compiled");
+	return 0;
+}
+#endif /* DO_NOT_COMPILE_ITC_MODULE_TEST */
+
+int deadline_recovery(void)
+#if DO_NOT_COMPILE_ITC_MODULE_TEST == 0
+{
+	int rc = ERROR_CODE(int);
+	sched_task_context_t* ctx = NULL;
+	sched_service_t* service = NULL;
+	sched_task_t* task = NULL;
+	itc_module_pipe_t* out = NULL;
+	sched_task_request_t req;
+	uint32_t rejected = 0;
+
+	ASSERT_PTR(ctx = sched_task_context_new(NULL), goto ERR);
+	ASSERT_PTR(service = _deadline_service(5), goto ERR);
+
+	/* A slow request makes the estimated execution time far beyond the 5ms budget */
+	ASSERT_RETOK(sched_task_request_t, _new_int_request(ctx, service, 0, &out), goto ERR);
+	ASSERT_PTR(task = sched_task_next_ready_task(ctx), goto ERR);
+	usleep(100000);
+	ASSERT_OK(runtime_task_start(task->exec_task), goto ERR);
+	ASSERT_OK(sched_task_free(task), goto ERR);
+	task = NULL;
+	ASSERT_OK(itc_module_pipe_deallocate(out), goto ERR);
+	out = NULL;
+
+	/* The following requests are shed, but the estimate decays, so eventually a request gets admitted again */
+	for(;;)
+	{
+		ASSERT(rejected < 64, goto ERR);
+		ASSERT_RETOK(sched_task_request_t, req = _new_int_request(ctx, service, 0, &out), goto ERR);
+		task = sched_task_next_ready_task(ctx);
+		if(NULL != task) break;
+
+		ASSERT(0 == sched_task_request_status(ctx, req), goto ERR);
+		ASSERT_OK(itc_module_pipe_deallocate(out), goto ERR);
+		out = NULL;
+		rejected ++;
+	}
+
+	ASSERT(rejected > 0, goto ERR);
+	ASSERT(task->request == req, goto ERR);
+	ASSERT_OK(runtime_task_start(task->exec_task), goto ERR);
+	ASSERT_OK(sched_task_free(task), goto ERR);
+	task = NULL;
+
+	rc = 0;
+ERR:
+	if(NULL != task) sched_task_free(task);
+	if(NULL != out) itc_module_pipe_deallocate(out);
+	if(NULL != ctx) sched_task_context_free(ctx);
+	if(NULL != service) sched_service_free(service);
+	return rc;
+}
+#else
+{
+	LOG_WARNING("Test case disabled because no testing module compiled");
+	return 0;
+}
+#endif /* DO_NOT_COMPILE_ITC_MODULE_TEST */
+
+int chain_handoff(void)
+#if DO_NOT_COMPILE_ITC_MODULE_TEST == 0
+{
+	int rc = ERROR_CODE(int);
+	sched_task_context_t* ctx = NULL;
+	sched_service_buffer_t* buffer = NULL;
+	sched_service_t* service = NULL;
+	sched_service_node_id_t node[2];
+	itc_module_pipe_t* out[2] = {};
+	sched_task_request_t req[2];
+	uint32_t i;
+
+	ASSERT_PTR(ctx = sched_task_context_new(NULL), goto ERR);
+	ASSERT_PTR(buffer = sched_service_buffer_new(), goto ERR);
+	ASSERT_OK(sched_service_buffer_allow_reuse_servlet(buffer), goto ERR);
+	ASSERT_RETOK(sched_service_node_id_t, node[0] = sched_service_buffer_add_node(buffer, servletA[5]), goto ERR);
+	ASSERT_RETOK(sched_service_node_id_t, node[1] = sched_service_buffer_add_node(buffer, servletA[6]), goto ERR);
+	sched_service_pipe_descriptor_t desc = {
+		.source_node_id = node[0],
+		.source_pipe_desc = A_out,
+		.destination_node_id = node[1],
+		.destination_pipe_desc = A_in
+	};
+	ASSERT_OK(sched_service_buffer_add_pipe(buffer, desc), goto ERR);
+	ASSERT_OK(sched_service_buffer_set_input(buffer, node[0], A_in), goto ERR);
+	ASSERT_OK(sched_service_buffer_set_output(buffer, node[1], A_out), goto ERR);
+	ASSERT_PTR(service = sched_service_from_buffer(buffer), goto ERR);
+	ASSERT(1 == sched_service_node_chained(service, node[1]), goto ERR);
+
+	for(i = 0; i < 2; i ++)
+	    ASSERT_RETOK(sched_task_request_t, req[i] = _new_int_request(ctx, service, 0, out + i), goto ERR);
+
+	/* The first request's downstream node is handed to the worker right after its upstream, so the
+	 * first request is done before the second one even starts, instead of having them interleaved */
+	ASSERT(1 == sched_step_next(ctx, mod_mem), goto ERR);
+	ASSERT(1 == sched_step_next(ctx, mod_mem), goto ERR);
+	ASSERT(0 == sched_task_request_status(ctx, req[0]), goto ERR);
+	ASSERT(1 == sched_task_request_status(ctx, req[1]), goto ERR);
+
+	ASSERT(1 == sched_step_next(ctx, mod_mem), goto ERR);
+	ASSERT(1 == sched_step_next(ctx, mod_mem), goto ERR);
+	ASSERT(0 == sched_task_request_status(ctx, req[1]), goto ERR);
+	ASSERT(0 == sched_step_next(ctx, mod_mem), goto ERR);
+
+	for(i = 0; i < 2; i ++)
+	{
+		int result = 0;
+		ASSERT(sizeof(int) == itc_module_pipe_read(&result, sizeof(int), out[i]), goto ERR);
+		ASSERT(result == (args[5] + 1) * (args[6] + 1), goto ERR);
+	}
+
+	rc = 0;
+ERR:
+	for(i = 0; i < 2; i ++)
+	    if(NULL != out[i]) itc_module_pipe_deallocate(out[i]);
+	if(NULL != ctx) sched_task_context_free(ctx);
+	if(NULL != buffer) sched_service_buffer_free(buffer);
+	if(NULL != service) sched_service_free(service);
+	return rc;
+}
+#else
+{
+	LOG_WARNING("Test case disabled because no testing module compiled");
+	return 0;
+}
+#endif /* DO_NOT_COMPILE_ITC_MODULE_TEST */
+
 int build_buffer(void)
 {
 	ASSERT_PTR(buffer = sched_service_buffer_new(), CLEANUP_NOP);
@@ -203,7 +522,7 @@ static inline int request_test(int seed)
 	if(itc_module_pipe_deallocate(sp[0]) == ERROR_CODE(int)) goto ERR;
 	sched_task_request_t reqid;
 
-	if((reqid = sched_task_new_request(stc, service, sp[1], out[0])) == ERROR_CODE(sched_task_request_t)) goto ERR;
+	if((reqid = sched_task_new_request(stc, service, sp[1], out[0], 0)) == ERROR_CODE(sched_task_request_t)) goto ERR;
 
 	while(NULL != (task = sched_task_next_ready_task(stc)))
 	{
@@ -280,6 +599,151 @@ int build_service(void)
 
 	return 0;
 }
+typedef struct {
+	sched_task_t*         task;
+	sched_rscope_table_t* table;
+	int                   rc;
+} offload_arg_t;
+
+static void* _offload_main(void* data)
+{
+	offload_arg_t* arg = (offload_arg_t*)data;
+	if(ERROR_CODE(int) == sched_rscope_init_thread()) return NULL;
+	arg->rc = sched_step_run_offloaded(arg->task, arg->table);
+	if(ERROR_CODE(int) == sched_rscope_finalize_thread()) arg->rc = ERROR_CODE(int);
+	return NULL;
+}
+
+int offloaded_run(void)
+#if DO_NOT_COMPILE_ITC_MODULE_TEST == 0
+{
+	int outval = 0, seed = 7, num_offloaded = 0;
+	itc_module_pipe_t *sp[2] = {}, *out[2] = {};
+	sched_task_t* task = NULL;
+	sched_rscope_table_t* table;
+	itc_module_pipe_param_t param = {
+		.input_flags = RUNTIME_API_PIPE_INPUT,
+		.output_flags = RUNTIME_API_PIPE_OUTPUT,
+		.args = NULL
+	};
+
+	ASSERT_PTR(table = sched_rscope_thread_table(), CLEANUP_NOP);
+	ASSERT_OK(sched_rscope_set_shared(1), CLEANUP_NOP);
+
+	ASSERT_OK(itc_module_pipe_allocate(mod_test, 0, param, sp + 0, sp + 1), goto ERR);
+	ASSERT_OK(itc_module_pipe_allocate(mod_test, 0, param, out + 0, out + 1), goto ERR);
+	ASSERT_RETOK(size_t, itc_module_pipe_write(&seed, sizeof(int), sp[0]), goto ERR);
+	ASSERT_OK(itc_module_pipe_deallocate(sp[0]), goto ERR);
+	sp[0] = NULL;
+
+	ASSERT_RETOK(sched_task_request_t, sched_task_new_request(stc, service, sp[1], out[0], 0), goto ERR);
+	sp[1] = out[0] = NULL;
+
+	while(NULL != (task = sched_task_next_ready_task(stc)))
+	{
+		uint32_t size, i;
+		const sched_service_pipe_descriptor_t* result;
+		itc_module_pipe_t *pipes[2];
+
+		ASSERT_PTR(result = sched_service_get_outgoing_pipes(task->service, task->node, &size), goto ERR);
+		for(i = 0; i < size; i ++)
+		{
+			ASSERT_OK(itc_module_pipe_allocate(mod_test, 0, param, pipes + 0, pipes + 1), goto ERR);
+			ASSERT_OK(sched_task_output_pipe(task, result[i].source_pipe_desc, pipes[0]), goto ERR);
+			ASSERT_OK(sched_task_input_pipe(stc, task->service, task->request, result[i].destination_node_id, result[i].destination_pipe_desc, pipes[1], 0), goto ERR);
+		}
+
+		if(task->node != node[0] && task->node != node[9])
+		{
+			/* Run the task on another thread with the entry table of the owner, just like a peer scheduler does */
+			pthread_t thread;
+			offload_arg_t arg = {
+				.task  = task,
+				.table = table,
+				.rc    = ERROR_CODE(int)
+			};
+			ASSERT(0 == pthread_create(&thread, NULL, _offload_main, &arg), goto ERR);
+			ASSERT(0 == pthread_join(thread, NULL), goto ERR);
+			ASSERT_OK(arg.rc, goto ERR);
+			num_offloaded ++;
+		}
+		else ASSERT_OK(runtime_task_start(task->exec_task), goto ERR);
+
+		ASSERT_OK(sched_task_free(task), goto ERR);
+		task = NULL;
+	}
+
+	ASSERT(8 == num_offloaded, goto ERR);
+
+	ASSERT(sizeof(int) == itc_module_pipe_read(&outval, sizeof(int), out[1]), goto ERR);
+	ASSERT_OK(itc_module_pipe_deallocate(out[1]), goto ERR);
+	out[1] = NULL;
+
+	ASSERT(outval == 18 * seed, goto ERR);
+
+	return sched_rscope_set_shared(0);
+ERR:
+	sched_rscope_set_shared(0);
+	if(NULL != task) sched_task_free(task);
+	if(NULL != sp[0]) itc_module_pipe_deallocate(sp[0]);
+	if(NULL != sp[1]) itc_module_pipe_deallocate(sp[1]);
+	if(NULL != out[0]) itc_module_pipe_deallocate(out[0]);
+	if(NULL != out[1]) itc_module_pipe_deallocate(out[1]);
+	return ERROR_CODE(int);
+}
+#else
+{
+	LOG_WARNING("Test case disabled because no testing module compiled");
+	return 0;
+}
+#endif /* DO_NOT_COMPILE_ITC_MODULE_TEST */
+
+int pipe_companion(void)
+#if DO_NOT_COMPILE_ITC_MODULE_TEST == 0
+{
+	itc_module_pipe_t *in = NULL, *out = NULL, *fork = NULL;
+	itc_module_pipe_param_t param = {
+		.input_flags = RUNTIME_API_PIPE_INPUT,
+		.output_flags = RUNTIME_API_PIPE_OUTPUT,
+		.args = NULL
+	};
+	int rc = ERROR_CODE(int);
+
+	ASSERT_OK(itc_module_pipe_allocate(mod_test, 0, param, &out, &in), goto ERR);
+	ASSERT(1 == itc_module_pipe_has_companion(in), goto ERR);
+	ASSERT(1 == itc_module_pipe_has_companion(out), goto ERR);
+
+	/* Once the upstream end is gone, the input pipe is the only user of the resource */
+	ASSERT_OK(itc_module_pipe_deallocate(out), goto ERR);
+	out = NULL;
+	ASSERT(0 == itc_module_pipe_has_companion(in), goto ERR);
+
+	/* But the forked pipe shares the companion list with it, so neither of them can be handed over */
+	ASSERT_PTR(fork = itc_module_pipe_fork(in, RUNTIME_API_PIPE_INPUT | RUNTIME_API_PIPE_SHADOW, 0, NULL), goto ERR);
+	ASSERT(1 == itc_module_pipe_has_companion(in), goto ERR);
+	ASSERT(1 == itc_module_pipe_has_companion(fork), goto ERR);
+
+	/* A shadow pipe is in hold mode after the fork, so the first deallocation only disposes the output end
+	 * place holder, and the second one disposes the input end which releases the handle */
+	ASSERT_OK(itc_module_pipe_deallocate(fork), goto ERR);
+	ASSERT_OK(itc_module_pipe_deallocate(fork), goto ERR);
+	fork = NULL;
+	ASSERT(0 == itc_module_pipe_has_companion(in), goto ERR);
+
+	rc = 0;
+ERR:
+	if(NULL != fork) itc_module_pipe_deallocate(fork);
+	if(NULL != in) itc_module_pipe_deallocate(in);
+	if(NULL != out) itc_module_pipe_deallocate(out);
+	return rc;
+}
+#else
+{
+	LOG_WARNING("Test case disabled because no testing module compiled");
+	return 0;
+}
+#endif /* DO_NOT_COMPILE_ITC_MODULE_TEST */
+
 static int executed_flags[8];
 static void _trap(int n)
 {
@@ -361,7 +825,7 @@ int pipe_disable(void)
 	ASSERT_OK(module_test_set_request(&a, sizeof(uint32_t)), goto ERR);
 
 	itc_module_pipe_accept(mod_test, param, &in, &out);
-	sched_task_new_request(stc, service, in, out);
+	sched_task_new_request(stc, service, in, out, 0);
 
 	while((src = sched_step_next(stc, mod_mem)) > 0);
 
@@ -452,7 +916,7 @@ int task_cancel(void)
 	ASSERT_OK(module_test_set_request(message, strlen(message)), goto ERR);
 
 	itc_module_pipe_accept(mod_test, param, &in, &out);
-	sched_task_new_request(stc, service, in, out);
+	sched_task_new_request(stc, service, in, out, 0);
 
 	while((src = sched_step_next(stc, mod_mem)) > 0);
 
@@ -492,6 +956,7 @@ int setup(void)
 	ASSERT(ERROR_CODE(itc_module_type_t) != mod_mem, CLEANUP_NOP);
 	ASSERT_OK(runtime_servlet_append_search_path(TESTDIR), CLEANUP_NOP);
 	ASSERT_PTR(stc = sched_task_context_new(NULL), CLEANUP_NOP);
+	ASSERT_OK(sched_rscope_init_thread(), CLEANUP_NOP);
 
 	return 0;
 }
@@ -508,15 +973,22 @@ int teardown(void)
 		ASSERT_OK(sched_service_free(service), CLEANUP_NOP);
 	}
 	ASSERT_OK(sched_task_context_free(stc), CLEANUP_NOP);
+	ASSERT_OK(sched_rscope_finalize_thread(), CLEANUP_NOP);
 	return 0;
 }
 
 TEST_LIST_BEGIN
     TEST_CASE(load_servlet),
     TEST_CASE(single_node_test),
+    TEST_CASE(request_deadline),
+    TEST_CASE(deadline_order),
+    TEST_CASE(deadline_recovery),
+    TEST_CASE(chain_handoff),
     TEST_CASE(build_buffer),
     TEST_CASE(build_service),
     TEST_CASE(do_request_test),
+    TEST_CASE(offloaded_run),
+    TEST_CASE(pipe_companion),
     TEST_CASE(task_cancel),
     TEST_CASE(pipe_disable)
 TEST_LIST_END;
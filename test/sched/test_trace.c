@@ -0,0 +1,164 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+#include <testenv.h>
+#include <stdio.h>
+#include <string.h>
+#include <itc/module_types.h>
+#include <module/test/module.h>
+
+#define TRACE_FILE_A TESTDIR"/trace_a.json"
+#define TRACE_FILE_B TESTDIR"/trace_b.json"
+
+static itc_module_type_t mod_test, mod_mem;
+static sched_service_t* service;
+static sched_task_context_t* stc;
+static char buffer[65536];
+
+static int _set_str(const char* symbol, const char* str)
+{
+	lang_prop_value_t value = {
+		.type = LANG_PROP_TYPE_STRING,
+		.str  = (char*)str
+	};
+	return lang_prop_set(symbol, value);
+}
+
+static int _set_int(const char* symbol, int64_t num)
+{
+	lang_prop_value_t value = {
+		.type = LANG_PROP_TYPE_INTEGER,
+		.num  = num
+	};
+	return lang_prop_set(symbol, value);
+}
+
+static int _run_request(int data)
+{
+	itc_module_pipe_param_t param = {
+		.input_flags = RUNTIME_API_PIPE_INPUT,
+		.output_flags = RUNTIME_API_PIPE_OUTPUT,
+		.args = NULL
+	};
+	itc_module_pipe_t *in, *out;
+	int rc;
+
+	ASSERT_OK(module_test_set_request(&data, sizeof(int)), CLEANUP_NOP);
+	ASSERT_OK(itc_module_pipe_accept(mod_test, param, &in, &out), CLEANUP_NOP);
+	ASSERT_RETOK(sched_task_request_t, sched_task_new_request(stc, service, in, out, 0), CLEANUP_NOP);
+
+	while((rc = sched_step_next(stc, mod_mem)) > 0);
+	ASSERT_OK(rc, CLEANUP_NOP);
+
+	ASSERT(data * 6 == *(const int*)module_test_get_response(), CLEANUP_NOP);
+
+	return 0;
+}
+
+static const char* _read_file(const char* path)
+{
+	FILE* fp = fopen(path, "r");
+	if(NULL == fp) return NULL;
+	size_t size = fread(buffer, 1, sizeof(buffer) - 1, fp);
+	fclose(fp);
+	buffer[size] = 0;
+	return buffer;
+}
+
+static int _check_trace(const char* path, int nspans)
+{
+	const char* content;
+	ASSERT_PTR(content = _read_file(path), CLEANUP_NOP);
+
+	/* The output should be a complete Chrome trace JSON object */
+	const char* header = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	ASSERT(0 == strncmp(content, header, strlen(header)), CLEANUP_NOP);
+	size_t len = strlen(content);
+	ASSERT(len > 4 && 0 == strcmp(content + len - 4, "\n]}\n"), CLEANUP_NOP);
+
+	/* Each output has its own thread name metadata */
+	ASSERT_PTR(strstr(content, "\"name\":\"thread_name\",\"ph\":\"M\""), CLEANUP_NOP);
+
+	int count = 0;
+	const char* ptr;
+	for(ptr = content; NULL != (ptr = strstr(ptr, "\"ph\":\"X\"")); ptr ++, count ++);
+	ASSERT(count == nspans, CLEANUP_NOP);
+
+	ASSERT_PTR(strstr(content, "\"cat\":\"exec\""), CLEANUP_NOP);
+	ASSERT_PTR(strstr(content, "\"phase\":\"exec\""), CLEANUP_NOP);
+
+	/* The events are separated by commas, so there shouldn't be any dangling one */
+	ASSERT(NULL == strstr(content, ",\n]"), CLEANUP_NOP);
+	ASSERT(NULL == strstr(content, "[,"), CLEANUP_NOP);
+
+	return 0;
+}
+
+int trace_output(void)
+{
+	ASSERT_OK(_set_int("tracer.buffer_size", 1), CLEANUP_NOP);
+	ASSERT_OK(_set_int("tracer.sample_rate", 1), CLEANUP_NOP);
+
+	ASSERT_OK(_set_str("tracer.output", TRACE_FILE_A), CLEANUP_NOP);
+	ASSERT_OK(_run_request(1), CLEANUP_NOP);
+	ASSERT_OK(_run_request(2), CLEANUP_NOP);
+
+	/* Switching the output closes the previous one, and the following spans go to the new output */
+	ASSERT_OK(_set_str("tracer.output", TRACE_FILE_B), CLEANUP_NOP);
+	ASSERT_OK(_check_trace(TRACE_FILE_A, 2), CLEANUP_NOP);
+	ASSERT_OK(_run_request(3), CLEANUP_NOP);
+
+	ASSERT_OK(_set_str("tracer.output", ""), CLEANUP_NOP);
+	ASSERT_OK(_check_trace(TRACE_FILE_B, 1), CLEANUP_NOP);
+
+	/* Without an output, nothing is traced */
+	ASSERT_OK(_run_request(4), CLEANUP_NOP);
+
+	ASSERT_OK(_set_int("tracer.sample_rate", 0), CLEANUP_NOP);
+
+	return 0;
+}
+
+int setup(void)
+{
+	mod_test = itc_modtab_get_module_type_from_path("pipe.test.test");
+	ASSERT(ERROR_CODE(itc_module_type_t) != mod_test, CLEANUP_NOP);
+	mod_mem = itc_modtab_get_module_type_from_path("pipe.mem");
+	ASSERT(ERROR_CODE(itc_module_type_t) != mod_mem, CLEANUP_NOP);
+	ASSERT_OK(runtime_servlet_append_search_path(TESTDIR), CLEANUP_NOP);
+
+	const char* argv[] = {"serv_helperA", "5"};
+	runtime_stab_entry_t servlet;
+	ASSERT_RETOK(runtime_stab_entry_t, servlet = runtime_stab_load(2, argv, NULL), CLEANUP_NOP);
+
+	sched_service_buffer_t* buf;
+	sched_service_node_id_t node;
+	ASSERT_PTR(buf = sched_service_buffer_new(), CLEANUP_NOP);
+	ASSERT_RETOK(sched_service_node_id_t, node = sched_service_buffer_add_node(buf, servlet), sched_service_buffer_free(buf));
+	ASSERT_OK(sched_service_buffer_set_input(buf, node, runtime_stab_get_pipe(servlet, "stdin")), sched_service_buffer_free(buf));
+	ASSERT_OK(sched_service_buffer_set_output(buf, node, runtime_stab_get_pipe(servlet, "stdout")), sched_service_buffer_free(buf));
+	ASSERT_PTR(service = sched_service_from_buffer(buf), sched_service_buffer_free(buf));
+	ASSERT_OK(sched_service_buffer_free(buf), CLEANUP_NOP);
+
+	ASSERT_PTR(stc = sched_task_context_new(NULL), CLEANUP_NOP);
+	ASSERT_OK(sched_rscope_init_thread(), CLEANUP_NOP);
+
+	expected_memory_leakage();
+
+	return 0;
+}
+
+int teardown(void)
+{
+	ASSERT_OK(sched_task_context_free(stc), CLEANUP_NOP);
+	ASSERT_OK(sched_service_free(service), CLEANUP_NOP);
+	ASSERT_OK(sched_rscope_finalize_thread(), CLEANUP_NOP);
+	remove(TRACE_FILE_A);
+	remove(TRACE_FILE_B);
+	return 0;
+}
+
+TEST_LIST_BEGIN
+    TEST_CASE(trace_output)
+TEST_LIST_END;
@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+#include <testenv.h>
+#include <utils/histogram.h>
+
+static utils_histogram_t hist_a, hist_b;
+
+int test_bucket(void)
+{
+	uint64_t v;
+	/* The small values are exact */
+	for(v = 0; v < 2 * UTILS_HISTOGRAM_SUB_BUCKETS; v ++)
+	    ASSERT(utils_histogram_bucket_upper_bound(utils_histogram_bucket(v)) == v, CLEANUP_NOP);
+
+	/* Each value is in its bucket and the relative error is bounded */
+	for(v = 1; v < (1ull << 30); v = v * 3 + 1)
+	{
+		uint32_t b = utils_histogram_bucket(v);
+		uint64_t upper = utils_histogram_bucket_upper_bound(b);
+		ASSERT(b < UTILS_HISTOGRAM_NBUCKETS, CLEANUP_NOP);
+		ASSERT(upper >= v, CLEANUP_NOP);
+		ASSERT(upper - v <= v / UTILS_HISTOGRAM_SUB_BUCKETS, CLEANUP_NOP);
+		ASSERT(b == 0 || utils_histogram_bucket_upper_bound(b - 1) < v, CLEANUP_NOP);
+	}
+
+	ASSERT(utils_histogram_bucket(UINT64_MAX) == UTILS_HISTOGRAM_NBUCKETS - 1, CLEANUP_NOP);
+	ASSERT(utils_histogram_bucket(1ull << UTILS_HISTOGRAM_MAX_BITS) == UTILS_HISTOGRAM_NBUCKETS - 1, CLEANUP_NOP);
+	ASSERT(utils_histogram_bucket((1ull << UTILS_HISTOGRAM_MAX_BITS) - 1) == UTILS_HISTOGRAM_NBUCKETS - 1, CLEANUP_NOP);
+
+	return 0;
+}
+
+int test_percentile(void)
+{
+	uint64_t i;
+	ASSERT(0 == utils_histogram_percentile(&hist_a, 50), CLEANUP_NOP);
+
+	for(i = 1; i <= 1000; i ++)
+	    utils_histogram_record(&hist_a, i);
+
+	ASSERT(hist_a.count == 1000, CLEANUP_NOP);
+	ASSERT(hist_a.sum == 500500, CLEANUP_NOP);
+	ASSERT(hist_a.max == 1000, CLEANUP_NOP);
+
+	uint64_t p50 = utils_histogram_percentile(&hist_a, 50);
+	uint64_t p99 = utils_histogram_percentile(&hist_a, 99);
+	ASSERT(p50 >= 500 && p50 <= 500 + 500 / UTILS_HISTOGRAM_SUB_BUCKETS, CLEANUP_NOP);
+	ASSERT(p99 >= 990 && p99 <= 1000, CLEANUP_NOP);
+	ASSERT(utils_histogram_percentile(&hist_a, 100) == 1000, CLEANUP_NOP);
+	ASSERT(utils_histogram_percentile(&hist_a, 0) == 1, CLEANUP_NOP);
+	ASSERT(ERROR_CODE(uint64_t) == utils_histogram_percentile(&hist_a, 101), CLEANUP_NOP);
+
+	return 0;
+}
+
+int test_merge(void)
+{
+	uint64_t i;
+	for(i = 0; i < 1000; i ++)
+	    utils_histogram_record(&hist_b, 1000000);
+
+	ASSERT_OK(utils_histogram_merge(&hist_b, &hist_a), CLEANUP_NOP);
+
+	ASSERT(hist_b.count == 2000, CLEANUP_NOP);
+	ASSERT(hist_b.max == 1000000, CLEANUP_NOP);
+	ASSERT(utils_histogram_percentile(&hist_b, 25) <= 500 + 500 / UTILS_HISTOGRAM_SUB_BUCKETS, CLEANUP_NOP);
+	ASSERT(utils_histogram_percentile(&hist_b, 75) == 1000000, CLEANUP_NOP);
+
+	ASSERT_OK(utils_histogram_reset(&hist_b), CLEANUP_NOP);
+	ASSERT(hist_b.count == 0, CLEANUP_NOP);
+	ASSERT(0 == utils_histogram_percentile(&hist_b, 99), CLEANUP_NOP);
+
+	return 0;
+}
+
+int setup(void)
+{
+	ASSERT_OK(utils_histogram_reset(&hist_a), CLEANUP_NOP);
+	ASSERT_OK(utils_histogram_reset(&hist_b), CLEANUP_NOP);
+	return 0;
+}
+
+int teardown(void)
+{
+	return 0;
+}
+
+TEST_LIST_BEGIN
+    TEST_CASE(test_bucket),
+    TEST_CASE(test_percentile),
+    TEST_CASE(test_merge)
+TEST_LIST_END;
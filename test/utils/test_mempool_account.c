@@ -0,0 +1,162 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+#include <stdlib.h>
+#include <unistd.h>
+#include <testenv.h>
+#include <utils/mempool/account.h>
+#include <utils/mempool/page.h>
+#include <utils/mempool/objpool.h>
+
+static int _count_account(const mempool_account_stat_t* stat, void* data)
+{
+	if(strcmp(stat->name, "test.account") == 0)
+	    (*(int*)data) ++;
+	return 0;
+}
+
+int account_watermark(void)
+{
+	mempool_account_t* account = NULL;
+	mempool_account_stat_t stat;
+	int count = 0;
+
+	ASSERT_PTR(account = mempool_account_new("test.account"), goto ERR);
+	ASSERT_OK(mempool_account_foreach(_count_account, &count), goto ERR);
+	ASSERT(count == 1, goto ERR);
+
+	ASSERT_OK(mempool_account_set_watermark(account, 1000, 500), goto ERR);
+	ASSERT(!mempool_account_over_limit(account), goto ERR);
+
+	ASSERT_OK(mempool_account_charge(account, 800), goto ERR);
+	ASSERT(!mempool_account_over_limit(account), goto ERR);
+
+	ASSERT_OK(mempool_account_charge(account, 400), goto ERR);
+	ASSERT(mempool_account_over_limit(account), goto ERR);
+
+	/* The account stays over limit until it drops to the low watermark */
+	ASSERT_OK(mempool_account_uncharge(account, 400), goto ERR);
+	ASSERT(mempool_account_over_limit(account), goto ERR);
+
+	ASSERT_OK(mempool_account_uncharge(account, 300), goto ERR);
+	ASSERT(!mempool_account_over_limit(account), goto ERR);
+
+	ASSERT_OK(mempool_account_get_stat(account, &stat), goto ERR);
+	ASSERT(stat.bytes == 500, goto ERR);
+	ASSERT(stat.peak == 1200, goto ERR);
+	ASSERT(stat.high_watermark == 1000, goto ERR);
+	ASSERT(stat.low_watermark == 500, goto ERR);
+	ASSERT(stat.over_limit == 0, goto ERR);
+
+	ASSERT_OK(mempool_account_uncharge(account, 500), goto ERR);
+	ASSERT_OK(mempool_account_free(account), goto ERR);
+	account = NULL;
+
+	count = 0;
+	ASSERT_OK(mempool_account_foreach(_count_account, &count), goto ERR);
+	ASSERT(count == 0, goto ERR);
+
+	return 0;
+ERR:
+	if(NULL != account) mempool_account_free(account);
+	return ERROR_CODE(int);
+}
+
+int account_budget(void)
+{
+	mempool_account_t *a = NULL, *b = NULL;
+	mempool_account_stat_t stat;
+	size_t base;
+
+	ASSERT_OK(mempool_account_get_stat(NULL, &stat), goto ERR);
+	base = stat.bytes;
+
+	ASSERT_PTR(a = mempool_account_new("test.budget.a"), goto ERR);
+	ASSERT_PTR(b = mempool_account_new("test.budget.b"), goto ERR);
+	ASSERT_OK(mempool_account_set_watermark(NULL, base + 1000, 0), goto ERR);
+
+	ASSERT_OK(mempool_account_charge(a, 600), goto ERR);
+	ASSERT(!mempool_account_over_limit(b), goto ERR);
+	ASSERT_OK(mempool_account_charge(b, 600), goto ERR);
+
+	/* The sum of the accounts is over the budget, so every account is over limit */
+	ASSERT(mempool_account_over_limit(a), goto ERR);
+	ASSERT(mempool_account_over_limit(NULL), goto ERR);
+
+	/* Disposing an account gives back the memory charged to it */
+	ASSERT_OK(mempool_account_free(b), goto ERR);
+	b = NULL;
+	ASSERT(!mempool_account_over_limit(a), goto ERR);
+
+	ASSERT_OK(mempool_account_get_stat(NULL, &stat), goto ERR);
+	ASSERT(stat.bytes == base + 600, goto ERR);
+
+	ASSERT_OK(mempool_account_uncharge(a, 600), goto ERR);
+	ASSERT_OK(mempool_account_free(a), goto ERR);
+	a = NULL;
+	ASSERT_OK(mempool_account_set_watermark(NULL, 0, 0), goto ERR);
+
+	return 0;
+ERR:
+	if(NULL != a) mempool_account_free(a);
+	if(NULL != b) mempool_account_free(b);
+	mempool_account_set_watermark(NULL, 0, 0);
+	return ERROR_CODE(int);
+}
+
+int account_pool(void)
+{
+	mempool_account_t* account = NULL;
+	mempool_objpool_t* pool = NULL;
+	mempool_account_stat_t stat;
+	void* page = NULL;
+	void* obj = NULL;
+	size_t page_size = (size_t)getpagesize();
+
+	ASSERT_PTR(account = mempool_account_new("test.pool"), goto ERR);
+
+	ASSERT_PTR(page = mempool_page_alloc_account(account), goto ERR);
+	ASSERT_OK(mempool_account_get_stat(account, &stat), goto ERR);
+	ASSERT(stat.bytes == page_size, goto ERR);
+	ASSERT_OK(mempool_page_dealloc_account(account, page), goto ERR);
+	page = NULL;
+	ASSERT_OK(mempool_account_get_stat(account, &stat), goto ERR);
+	ASSERT(stat.bytes == 0, goto ERR);
+
+	ASSERT_PTR(pool = mempool_objpool_new(32), goto ERR);
+	ASSERT_PTR(obj = mempool_objpool_alloc(pool), goto ERR);
+	ASSERT_OK(mempool_objpool_dealloc(pool, obj), goto ERR);
+
+	/* The pages already allocated by the pool are moved to the account */
+	ASSERT_OK(mempool_objpool_set_account(pool, account), goto ERR);
+	ASSERT_OK(mempool_account_get_stat(account, &stat), goto ERR);
+	ASSERT(stat.bytes > 0, goto ERR);
+	ASSERT(stat.bytes % page_size == 0, goto ERR);
+
+	ASSERT_OK(mempool_objpool_free(pool), goto ERR);
+	pool = NULL;
+	ASSERT_OK(mempool_account_get_stat(account, &stat), goto ERR);
+	ASSERT(stat.bytes == 0, goto ERR);
+
+	ASSERT_OK(mempool_account_free(account), goto ERR);
+
+	return 0;
+ERR:
+	if(NULL != page) mempool_page_dealloc_account(account, page);
+	if(NULL != pool) mempool_objpool_free(pool);
+	if(NULL != account) mempool_account_free(account);
+	return ERROR_CODE(int);
+}
+
+int setup(void)
+{
+	return mempool_objpool_disabled(0);
+}
+
+DEFAULT_TEARDOWN;
+
+TEST_LIST_BEGIN
+    TEST_CASE(account_watermark),
+    TEST_CASE(account_budget),
+    TEST_CASE(account_pool)
+TEST_LIST_END;
@@ -2,6 +2,7 @@
  * Copyright (C) 2017, Hao Hou
  **/
 #include <testenv.h>
+#include <utils/thread.h>
 #include <utils/mempool/objpool.h>
 
 mempool_objpool_t* pool;
@@ -113,6 +114,62 @@ int disabled_pool(void)
 
 	return 0;
 }
+static void* objs[4096];
+
+static void* _alloc_main(void* data)
+{
+	uint32_t i;
+	for(i = 0; i < sizeof(objs) / sizeof(*objs); i ++)
+	    if(NULL == (objs[i] = mempool_objpool_alloc(pool)))
+	        return NULL;
+	return data;
+}
+
+int depot_transfer(void)
+{
+	uint32_t i;
+	void* ret;
+	thread_t* thread;
+	mempool_objpool_pool_stat_t before, after;
+
+	expected_memory_leakage();
+	expected_memory_leakage();
+
+	ASSERT_PTR(thread = thread_new(_alloc_main, objs, THREAD_TYPE_GENERIC), CLEANUP_NOP);
+	ASSERT_OK(thread_free(thread, &ret), CLEANUP_NOP);
+	ASSERT(ret == objs, CLEANUP_NOP);
+
+	/* The objects allocated by another thread goes to the depot as full magazines */
+	ASSERT_OK(mempool_objpool_get_pool_stat(pool, &before), CLEANUP_NOP);
+	for(i = 0; i < sizeof(objs) / sizeof(*objs); i ++)
+	    ASSERT_OK(mempool_objpool_dealloc(pool, objs[i]), CLEANUP_NOP);
+
+	ASSERT_OK(mempool_objpool_get_pool_stat(pool, &after), CLEANUP_NOP);
+	ASSERT(after.full_magazines > before.full_magazines, CLEANUP_NOP);
+
+	uint32_t pc = mempool_objpool_get_page_count(pool);
+
+	/* And the allocating thread gets them back without carving new objects */
+	ASSERT_PTR(thread = thread_new(_alloc_main, objs, THREAD_TYPE_GENERIC), CLEANUP_NOP);
+	ASSERT_OK(thread_free(thread, &ret), CLEANUP_NOP);
+	ASSERT(ret == objs, CLEANUP_NOP);
+
+	ASSERT_OK(mempool_objpool_get_pool_stat(pool, &before), CLEANUP_NOP);
+	ASSERT(before.alloc_hits >= after.alloc_hits + after.full_magazines - before.full_magazines, CLEANUP_NOP);
+	ASSERT(before.empty_magazines > 0, CLEANUP_NOP);
+
+	for(i = 0; i < sizeof(objs) / sizeof(*objs); i ++)
+	    ASSERT_OK(mempool_objpool_dealloc(pool, objs[i]), CLEANUP_NOP);
+
+	ASSERT(pc == mempool_objpool_get_page_count(pool), CLEANUP_NOP);
+
+	mempool_objpool_stat_t stat;
+	ASSERT_OK(mempool_objpool_get_stat(&stat), CLEANUP_NOP);
+	ASSERT(stat.depot_hits >= before.alloc_hits, CLEANUP_NOP);
+
+	return 0;
+}
+
 int setup(void)
 {
 	return mempool_objpool_disabled(0);
@@ -126,5 +183,6 @@ int teardown(void)
 TEST_LIST_BEGIN
     TEST_CASE(pool_creation),
     TEST_CASE(pool_allocation),
-    TEST_CASE(disabled_pool)
+    TEST_CASE(disabled_pool),
+    TEST_CASE(depot_transfer)
 TEST_LIST_END;
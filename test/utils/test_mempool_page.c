@@ -0,0 +1,160 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+#include <stdlib.h>
+#include <unistd.h>
+#include <testenv.h>
+#include <utils/thread.h>
+#include <utils/mempool/page.h>
+
+#define N 10000
+
+static void* pages[N];
+
+static int compare(const void* a, const void* b)
+{
+	uintptr_t x = (uintptr_t)*(void* const*)a;
+	uintptr_t y = (uintptr_t)*(void* const*)b;
+	return x < y ? -1 : (x > y);
+}
+
+int page_alloc(void)
+{
+	uint32_t i;
+	size_t page_size = (size_t)getpagesize();
+	for(i = 0; i < N; i ++)
+	{
+		ASSERT_PTR(pages[i] = mempool_page_alloc(), CLEANUP_NOP);
+		ASSERT(((uintptr_t)pages[i] & (page_size - 1)) == 0, CLEANUP_NOP);
+		memset(pages[i], (int)(i & 0xff), page_size);
+	}
+
+	for(i = 0; i < N; i ++)
+	    ASSERT(((uint8_t*)pages[i])[page_size - 1] == (i & 0xff), CLEANUP_NOP);
+
+	qsort(pages, N, sizeof(void*), compare);
+	for(i = 1; i < N; i ++)
+	    ASSERT(pages[i - 1] != pages[i], CLEANUP_NOP);
+
+	return 0;
+}
+
+int page_reuse(void)
+{
+	uint32_t i;
+	mempool_page_stat_t before, after;
+
+	for(i = 0; i < N; i ++)
+	    ASSERT_OK(mempool_page_dealloc(pages[i]), CLEANUP_NOP);
+
+	ASSERT_OK(mempool_page_get_stat(&before), CLEANUP_NOP);
+	/* The pages exceeds the thread local limit goes to the global pool */
+	ASSERT(before.free_pages > 0, CLEANUP_NOP);
+	ASSERT(before.arena_pages >= N, CLEANUP_NOP);
+
+	for(i = 0; i < N; i ++)
+	    ASSERT_PTR(pages[i] = mempool_page_alloc(), CLEANUP_NOP);
+
+	ASSERT_OK(mempool_page_get_stat(&after), CLEANUP_NOP);
+	ASSERT(after.arena_pages == before.arena_pages, CLEANUP_NOP);
+	ASSERT(after.free_pages == 0, CLEANUP_NOP);
+
+	for(i = 0; i < N; i ++)
+	    ASSERT_OK(mempool_page_dealloc(pages[i]), CLEANUP_NOP);
+
+	return 0;
+}
+
+int page_retire(void)
+{
+	uint32_t i;
+	mempool_page_stat_t before, after;
+
+	ASSERT_OK(mempool_page_get_stat(&before), CLEANUP_NOP);
+	ASSERT_OK(mempool_page_set_free_page_limit(0), CLEANUP_NOP);
+
+	for(i = 0; i < N; i ++)
+	    ASSERT_PTR(pages[i] = mempool_page_alloc(), CLEANUP_NOP);
+	for(i = 0; i < N; i ++)
+	    ASSERT_OK(mempool_page_dealloc(pages[i]), CLEANUP_NOP);
+
+	ASSERT_OK(mempool_page_get_stat(&after), CLEANUP_NOP);
+	ASSERT(after.retired_pages > 0, CLEANUP_NOP);
+
+	/* The retired pages are reused before the arena reserves new memory */
+	for(i = 0; i < N; i ++)
+	    ASSERT_PTR(pages[i] = mempool_page_alloc(), CLEANUP_NOP);
+
+	ASSERT_OK(mempool_page_get_stat(&after), CLEANUP_NOP);
+	ASSERT(after.arena_pages == before.arena_pages, CLEANUP_NOP);
+	ASSERT(after.retired_pages == 0, CLEANUP_NOP);
+
+	ASSERT_OK(mempool_page_set_free_page_limit(0x20000), CLEANUP_NOP);
+
+	for(i = 0; i < N; i ++)
+	    ASSERT_OK(mempool_page_dealloc(pages[i]), CLEANUP_NOP);
+
+	return 0;
+}
+
+static void* _thread_main(void* data)
+{
+	uintptr_t id = (uintptr_t)data;
+	static __thread void* local[N];
+	uint32_t round, i;
+
+	for(round = 0; round < 4; round ++)
+	{
+		for(i = 0; i < N; i ++)
+		{
+			if(NULL == (local[i] = mempool_page_alloc())) return NULL;
+			*(uintptr_t*)local[i] = id;
+		}
+
+		for(i = 0; i < N; i ++)
+		    if(*(uintptr_t*)local[i] != id) return NULL;
+
+		for(i = 0; i < N; i ++)
+		    if(ERROR_CODE(int) == mempool_page_dealloc(local[i])) return NULL;
+	}
+
+	return data;
+}
+
+int page_concurrent(void)
+{
+	thread_t* threads[4];
+	uintptr_t i;
+
+	for(i = 0; i < sizeof(threads) / sizeof(*threads); i ++)
+	    expected_memory_leakage();
+
+	for(i = 0; i < sizeof(threads) / sizeof(*threads); i ++)
+	    ASSERT_PTR(threads[i] = thread_new(_thread_main, (void*)(i + 1), THREAD_TYPE_GENERIC), CLEANUP_NOP);
+
+	for(i = 0; i < sizeof(threads) / sizeof(*threads); i ++)
+	{
+		void* ret;
+		ASSERT_OK(thread_free(threads[i], &ret), CLEANUP_NOP);
+		ASSERT(ret == (void*)(i + 1), CLEANUP_NOP);
+	}
+
+	return 0;
+}
+
+int setup(void)
+{
+	return 0;
+}
+
+int teardown(void)
+{
+	return 0;
+}
+
+TEST_LIST_BEGIN
+    TEST_CASE(page_alloc),
+    TEST_CASE(page_reuse),
+    TEST_CASE(page_retire),
+    TEST_CASE(page_concurrent)
+TEST_LIST_END;
@@ -1,7 +1,9 @@
 /**
  * Copyright (C) 2017, Hao Hou
  **/
+#define _GNU_SOURCE
 #include <pthread.h>
+#include <sched.h>
 #include <testenv.h>
 #include <utils/thread.h>
 #define N 128
@@ -157,6 +159,41 @@ int thread_obj(void)
 	return 0;
 }
 
+static void* affinity_main(void* arg)
+{
+	(void)arg;
+#ifdef __LINUX__
+	cpu_set_t set;
+	if(pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0) return NULL;
+	if(CPU_COUNT(&set) != 1 || !CPU_ISSET(0, &set)) return NULL;
+#endif
+	return arg;
+}
+
+int affinity(void)
+{
+	ASSERT(ERROR_CODE(int) == thread_set_affinity_policy(THREAD_TYPE_WORKER, "1-0"), CLEANUP_NOP);
+	ASSERT(ERROR_CODE(int) == thread_set_affinity_policy(THREAD_TYPE_WORKER, "0,a"), CLEANUP_NOP);
+	ASSERT(ERROR_CODE(int) == thread_set_affinity_policy(THREAD_TYPE_WORKER, "0-1023,0-1023"), CLEANUP_NOP);
+	ASSERT(ERROR_CODE(int) == thread_set_current_affinity("0-1023,0"), CLEANUP_NOP);
+	ASSERT(ERROR_CODE(int) == thread_set_affinity_policy(THREAD_TYPE_WORKER | THREAD_TYPE_ASYNC, "0"), CLEANUP_NOP);
+	ASSERT_STREQ(thread_get_affinity_policy(THREAD_TYPE_WORKER), "", CLEANUP_NOP);
+
+	ASSERT_OK(thread_set_affinity_policy(THREAD_TYPE_WORKER, "0"), CLEANUP_NOP);
+	ASSERT_STREQ(thread_get_affinity_policy(THREAD_TYPE_WORKER), "0", CLEANUP_NOP);
+
+	thread_t* thread;
+	void* ret;
+	ASSERT_PTR(thread = thread_new(affinity_main, flag, THREAD_TYPE_WORKER), CLEANUP_NOP);
+	ASSERT_OK(thread_free(thread, &ret), CLEANUP_NOP);
+	ASSERT(ret == flag, CLEANUP_NOP);
+
+	ASSERT_OK(thread_set_affinity_policy(THREAD_TYPE_WORKER, NULL), CLEANUP_NOP);
+	ASSERT_STREQ(thread_get_affinity_policy(THREAD_TYPE_WORKER), "", CLEANUP_NOP);
+
+	return 0;
+}
+
 int setup(void)
 {
 #if __i386__
@@ -173,5 +210,6 @@ TEST_LIST_BEGIN
     TEST_CASE(create),
     TEST_CASE(run),
     TEST_CASE(dispose),
-    TEST_CASE(thread_obj)
+    TEST_CASE(thread_obj),
+    TEST_CASE(affinity)
 TEST_LIST_END;
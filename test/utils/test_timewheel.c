@@ -0,0 +1,199 @@
+/**
+ * Copyright (C) 2017, Hao Hou
+ **/
+
+#include <testenv.h>
+#include <utils/timewheel.h>
+#include <stdlib.h>
+
+#define N 10000
+timewheel_t* wheel;
+time_t expected[N];
+time_t last, now;
+int fired[N];
+
+static int _check_expire(uint32_t id, void* data)
+{
+	(void)data;
+	ASSERT(id < N, CLEANUP_NOP);
+	ASSERT(expected[id] > last, CLEANUP_NOP);
+	ASSERT(expected[id] <= now, CLEANUP_NOP);
+	ASSERT(fired[id] == 0, CLEANUP_NOP);
+	fired[id] = 1;
+	return 0;
+}
+
+static int _advance(time_t to)
+{
+	int rc;
+	last = now;
+	now = to;
+	ASSERT_RETOK(int, rc = timewheel_advance(wheel, now, _check_expire, NULL), CLEANUP_NOP);
+	return rc;
+}
+
+int test_basic(void)
+{
+	uint32_t i;
+	for(i = 0; i < 100; i ++)
+	{
+		expected[i] = now + (time_t)i + 1;
+		ASSERT_OK(timewheel_arm(wheel, i, expected[i]), CLEANUP_NOP);
+		ASSERT(timewheel_armed(wheel, i) == 1, CLEANUP_NOP);
+	}
+	ASSERT(timewheel_size(wheel) == 100, CLEANUP_NOP);
+
+	time_t next;
+	ASSERT(timewheel_next_expire(wheel, &next) == 1, CLEANUP_NOP);
+	ASSERT(next <= now + 1, CLEANUP_NOP);
+
+	ASSERT(_advance(now) == 0, CLEANUP_NOP);
+
+	for(i = 0; i < 100; i ++)
+	{
+		ASSERT(_advance(now + 1) == 1, CLEANUP_NOP);
+		ASSERT(fired[i] == 1, CLEANUP_NOP);
+		ASSERT(timewheel_armed(wheel, i) == 0, CLEANUP_NOP);
+		fired[i] = 0;
+	}
+
+	ASSERT(timewheel_size(wheel) == 0, CLEANUP_NOP);
+	ASSERT(timewheel_next_expire(wheel, &next) == 0, CLEANUP_NOP);
+
+	return 0;
+}
+
+int test_cancel_rearm(void)
+{
+	ASSERT_OK(timewheel_arm(wheel, 0, expected[0] = now + 10), CLEANUP_NOP);
+	ASSERT_OK(timewheel_arm(wheel, 1, expected[1] = now + 10), CLEANUP_NOP);
+	ASSERT_OK(timewheel_arm(wheel, 2, expected[2] = now + 10), CLEANUP_NOP);
+
+	ASSERT_OK(timewheel_cancel(wheel, 1), CLEANUP_NOP);
+	ASSERT_OK(timewheel_cancel(wheel, 1), CLEANUP_NOP);
+	ASSERT_OK(timewheel_arm(wheel, 2, expected[2] = now + 5000), CLEANUP_NOP);
+	ASSERT(timewheel_size(wheel) == 2, CLEANUP_NOP);
+
+	ASSERT(_advance(now + 10) == 1, CLEANUP_NOP);
+	ASSERT(fired[0] == 1 && fired[1] == 0 && fired[2] == 0, CLEANUP_NOP);
+	ASSERT(_advance(now + 4989) == 0, CLEANUP_NOP);
+	ASSERT(_advance(now + 1) == 1, CLEANUP_NOP);
+	ASSERT(fired[2] == 1, CLEANUP_NOP);
+
+	fired[0] = fired[2] = 0;
+
+	ASSERT(timewheel_arm(wheel, N, now) == ERROR_CODE(int), CLEANUP_NOP);
+
+	return 0;
+}
+
+int test_far_future(void)
+{
+	/* Beyond the range the wheel covers, it should be revisited and expire at the right time */
+	ASSERT_OK(timewheel_arm(wheel, 0, expected[0] = now + (1 << 24) + 100), CLEANUP_NOP);
+	ASSERT_OK(timewheel_arm(wheel, 1, expected[1] = now + 70000), CLEANUP_NOP);
+
+	ASSERT(_advance(now + 69999) == 0, CLEANUP_NOP);
+	ASSERT(_advance(now + 1) == 1, CLEANUP_NOP);
+	ASSERT(fired[1] == 1, CLEANUP_NOP);
+	ASSERT(_advance(expected[0] - 1) == 0, CLEANUP_NOP);
+	ASSERT(_advance(now + 1) == 1, CLEANUP_NOP);
+	ASSERT(fired[0] == 1, CLEANUP_NOP);
+
+	fired[0] = fired[1] = 0;
+	return 0;
+}
+
+static int _rearm(uint32_t id, void* data)
+{
+	int* count = (int*)data;
+	(*count) ++;
+	if(*count < 3)
+	    ASSERT_OK(timewheel_arm(wheel, id, now), CLEANUP_NOP);
+	return 0;
+}
+
+int test_rearm_in_callback(void)
+{
+	int count = 0;
+	ASSERT_OK(timewheel_arm(wheel, 0, now + 1), CLEANUP_NOP);
+	now ++;
+	ASSERT(timewheel_advance(wheel, now, _rearm, &count) == 1, CLEANUP_NOP);
+	ASSERT(count == 1, CLEANUP_NOP);
+	ASSERT(timewheel_armed(wheel, 0) == 1, CLEANUP_NOP);
+	ASSERT(timewheel_advance(wheel, now, _rearm, &count) == 0, CLEANUP_NOP);
+	now ++;
+	ASSERT(timewheel_advance(wheel, now, _rearm, &count) == 1, CLEANUP_NOP);
+	now ++;
+	ASSERT(timewheel_advance(wheel, now, _rearm, &count) == 1, CLEANUP_NOP);
+	ASSERT(count == 3, CLEANUP_NOP);
+	ASSERT(timewheel_size(wheel) == 0, CLEANUP_NOP);
+	return 0;
+}
+
+int test_random_ops(void)
+{
+	uint32_t i;
+	for(i = 0; i < N; i ++)
+	{
+		expected[i] = now + 1 + rand() % 200000;
+		ASSERT_OK(timewheel_arm(wheel, i, expected[i]), CLEANUP_NOP);
+	}
+
+	int remaining = N;
+	while(remaining > 0)
+	{
+		time_t min = -1, next;
+		for(i = 0; i < N; i ++)
+		    if(!fired[i] && (min == -1 || expected[i] < min))
+		        min = expected[i];
+		ASSERT(timewheel_next_expire(wheel, &next) == 1, CLEANUP_NOP);
+		ASSERT(next <= min, CLEANUP_NOP);
+		ASSERT(next > now, CLEANUP_NOP);
+
+		int j;
+		for(j = 0; j < 10; j ++)
+		{
+			i = (uint32_t)rand() % N;
+			if(fired[i]) continue;
+			if(rand() % 2)
+			    expected[i] = now + 1 + rand() % 200000;
+			else
+			    expected[i] = now + 1 + rand() % 64;
+			ASSERT_OK(timewheel_arm(wheel, i, expected[i]), CLEANUP_NOP);
+		}
+
+		int rc;
+		ASSERT_RETOK(int, rc = _advance(now + 1 + rand() % 100), CLEANUP_NOP);
+		remaining -= rc;
+	}
+
+	for(i = 0; i < N; i ++)
+	    ASSERT(fired[i] == 1, CLEANUP_NOP);
+
+	ASSERT(timewheel_size(wheel) == 0, CLEANUP_NOP);
+
+	return 0;
+}
+
+int setup(void)
+{
+	now = 1000;
+	wheel = timewheel_new(N, now);
+	ASSERT_PTR(wheel, CLEANUP_NOP);
+	return 0;
+}
+
+int teardown(void)
+{
+	ASSERT_OK(timewheel_free(wheel), CLEANUP_NOP);
+	return 0;
+}
+
+TEST_LIST_BEGIN
+    TEST_CASE(test_basic),
+    TEST_CASE(test_cancel_rearm),
+    TEST_CASE(test_far_future),
+    TEST_CASE(test_rearm_in_callback),
+    TEST_CASE(test_random_ops)
+TEST_LIST_END;
@@ -845,6 +845,69 @@ static pss_value_t _pscript_builtin_daemon_ping(pss_vm_t* vm, uint32_t argc, pss
 	return ret;
 }
 
+static pss_value_t _pscript_builtin_daemon_stats(pss_vm_t* vm, uint32_t argc, pss_value_t* argv)
+{
+	(void) vm;
+	pss_value_t ret = {
+		.kind = PSS_VALUE_KIND_ERROR,
+		.num  = PSS_VM_ERROR_ARGUMENT
+	};
+
+	if(argc != 1)
+	    return ret;
+
+	if(argv[0].kind != PSS_VALUE_KIND_REF)
+	    return ret;
+
+	if(pss_value_ref_type(argv[0]) != PSS_VALUE_REF_TYPE_STRING)
+	    return ret;
+
+	const char* daemon = (const char*)pss_value_get_data(argv[0]);
+
+	ret.num = PSS_VM_ERROR_INTERNAL;
+
+	char* text = NULL;
+	if(sched_daemon_stats(daemon, &text) == ERROR_CODE(int))
+	    return ret;
+
+	pss_dict_t* ret_dict = NULL;
+	ret = pss_value_ref_new(PSS_VALUE_REF_TYPE_DICT, NULL);
+	if(ret.kind == PSS_VALUE_KIND_ERROR)
+	    ERROR_LOG_GOTO(ERR, "Cannot create the result dictionary");
+
+	if(NULL == (ret_dict = (pss_dict_t*)pss_value_get_data(ret)))
+	    ERROR_LOG_GOTO(ERR, "Cannot get the result dictionary object");
+
+	/* Each line of the result is a "<key> <value>" pair */
+	char* line, *next;
+	for(line = text; *line; line = next)
+	{
+		if(NULL != (next = strchr(line, '\n'))) *(next ++) = 0;
+		else next = line + strlen(line);
+
+		char* sep = strrchr(line, ' ');
+		if(NULL == sep) continue;
+		*sep = 0;
+
+		pss_value_t val = {
+			.kind = PSS_VALUE_KIND_NUM,
+			.num  = (pss_bytecode_numeric_t)strtoll(sep + 1, NULL, 10)
+		};
+
+		if(ERROR_CODE(int) == pss_dict_set(ret_dict, line, val))
+		    ERROR_LOG_GOTO(ERR, "Cannot put the statistics to the result dictionary");
+	}
+
+	free(text);
+	return ret;
+ERR:
+	free(text);
+	pss_value_decref(ret);
+	ret.kind = PSS_VALUE_KIND_ERROR;
+	ret.num = PSS_VM_ERROR_INTERNAL;
+	return ret;
+}
+
 static pss_value_t _pscript_builtin_daemon_reload(pss_vm_t* vm, uint32_t argc, pss_value_t* argv)
 {
 	(void)vm;
@@ -1374,6 +1437,7 @@ static struct {
 	_B(version, "()", "Get the version string of current Plumber system"),
 	_P(daemon_ping, "(daemon_ping)", "Ping a daemon, test if the daemon is responding"),
 	_P(daemon_reload, "(daemon, service)", "Reload the daemon with the graph"),
+	_P(daemon_stats, "(daemon)", "Query the runtime statistics of the daemon"),
 	_P(daemon_stop, "(daemon_id)", "Stop the daemon with the given name"),
 	_P(service_input, "(serv, sid, port)", "Define the input port of the entire service as port port of servlet sid"),
 	_P(service_new, "()", "Create a new Plumber service object"),